@@ -35,7 +35,7 @@
 #include <gphoto2/gphoto2-result.h>
 #include "ax203.h"
 #ifdef HAVE_LIBJPEG
-#include "jpeg_memsrcdest.h"
+#include "libgphoto2/jpeg_memsrcdest.h"
 #endif
 
 static const struct eeprom_info {
@@ -29,7 +29,7 @@
 
 #include "ax203.h"
 #ifdef HAVE_LIBJPEG
-#include "jpeg_memsrcdest.h"
+#include "libgphoto2/jpeg_memsrcdest.h"
 #endif
 
 #if defined(HAVE_LIBGD) && defined(HAVE_LIBJPEG)
@@ -550,6 +550,13 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 		return GP_ERROR_IO_READ;
 	}
 
+	result = gp_file_reserve (file, stbuf.st_size);
+	if (result < GP_OK) {
+		free (buf);
+		close (fd);
+		return result;
+	}
+
 	curread = 0;
 	id = gp_context_progress_start (context, (1.0*stbuf.st_size/BLOCKSIZE), _("Getting file..."));
 	GP_DEBUG ("Progress id: %i", id);
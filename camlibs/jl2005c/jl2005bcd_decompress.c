@@ -36,7 +36,7 @@
 #ifdef HAVE_LIBJPEG
 #include "libgphoto2/gphoto2-endian.h"
 #include "jl2005bcd_decompress.h"
-#include "jpeg_memsrcdest.h"
+#include "libgphoto2/jpeg_memsrcdest.h"
 #include <libgphoto2/bayer.h>
 #include "img_enhance.h"
 #include <math.h>
@@ -29,7 +29,11 @@
 } while(0)
 
 /* The follow set of macros implements a generic array or list of TYPE.
- * This is basically a TYPE* pointer and a length integer. This structure
+ * This is basically a TYPE* pointer, a length and a capacity integer. The
+ * capacity grows geometrically, so a series of array_push_back calls costs
+ * amortized O(1) per element instead of one realloc each. Code that fills
+ * val and len by hand should also set cap (or leave it at 0, which is
+ * treated as 'exactly len elements allocated'). This structure
  * together with the typical use-cases repeats regularly throughout the
  * codebase. It raises the level of abstraction and improves code
  * readabilty. axxel is a c++ developer and misses his STL ;)
@@ -51,6 +55,7 @@
 { \
 	TYPE *val; \
 	uint32_t len; \
+	uint32_t cap; \
 }
 
 /* TODO: with support for C23, we can improve the for_each macro by dropping the TYPE argument
@@ -62,12 +67,14 @@
 #define array_init(ARRAY) do { \
 	(ARRAY)->val = 0; \
 	(ARRAY)->len = 0; \
+	(ARRAY)->cap = 0; \
 } while (0)
 
 #define free_array(ARRAY) do { \
 	free ((ARRAY)->val); \
 	(ARRAY)->val = 0; \
 	(ARRAY)->len = 0; \
+	(ARRAY)->cap = 0; \
 } while (0)
 
 #define free_array_recusive(ARRAY, DESTRUCTOR) do { \
@@ -76,13 +83,30 @@
 	free_array (ARRAY); \
 } while (0)
 
-#define array_extend_capacity(ARRAY, LEN) do { \
-	(ARRAY)->val = realloc((ARRAY)->val, ((ARRAY)->len + (LEN)) * sizeof((ARRAY)->val[0])); \
-	if (!(ARRAY)->val) { \
-		GP_LOG_E ("Out of memory: 'realloc' of %ld bytes failed.", ((ARRAY)->len + (LEN)) * sizeof((ARRAY)->val[0])); \
-		return GP_ERROR_NO_MEMORY; \
+/* Makes sure there is room for at least CAP elements in total, without
+ * touching len or the content. Grows by at least a factor of 2. */
+#define array_reserve(ARRAY, CAP) do { \
+	if ((CAP) > (ARRAY)->cap) { \
+		uint32_t _cap = (CAP); \
+		void *_val; \
+		if (_cap < 2 * (ARRAY)->len) \
+			_cap = 2 * (ARRAY)->len; \
+		if (_cap < 8) \
+			_cap = 8; \
+		_val = realloc((ARRAY)->val, _cap * sizeof((ARRAY)->val[0])); \
+		if (!_val) { \
+			GP_LOG_E ("Out of memory: 'realloc' of %ld bytes failed.", (long)(_cap * sizeof((ARRAY)->val[0]))); \
+			return GP_ERROR_NO_MEMORY; \
+		} \
+		(ARRAY)->val = _val; \
+		(ARRAY)->cap = _cap; \
 	} \
-	memset((ARRAY)->val + (ARRAY)->len, 0, LEN * sizeof((ARRAY)->val[0])); \
+} while(0)
+
+/* Makes room for LEN more elements behind len and zeroes them. */
+#define array_extend_capacity(ARRAY, LEN) do { \
+	array_reserve(ARRAY, (ARRAY)->len + (LEN)); \
+	memset((ARRAY)->val + (ARRAY)->len, 0, (LEN) * sizeof((ARRAY)->val[0])); \
 } while(0)
 
 #define array_push_back_empty(ARRAY, PITER) do { \
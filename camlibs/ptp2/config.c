@@ -55,36 +55,31 @@
 
 int
 have_prop(Camera *camera, uint16_t vendor, uint32_t prop) {
-	unsigned int i;
+	PTPParams	*params = &camera->pl->params;
+	int		vendormatch = (params->deviceinfo.VendorExtensionID == vendor);
 
 	/* prop 0 matches */
-	if (!prop && (camera->pl->params.deviceinfo.VendorExtensionID==vendor))
+	if (!prop && vendormatch)
 		return 1;
+	/* all DeviceInfo codes are 16 bit */
+	if (prop > 0xffff)
+		return 0;
 
 	if (	((prop & 0x7000) == 0x5000) ||
-		(NIKON_1(&camera->pl->params) && ((prop & 0xf000) == 0xf000))
+		(NIKON_1(params) && ((prop & 0xf000) == 0xf000))
 	) { /* properties */
-		for (i=0; i<camera->pl->params.deviceinfo.DeviceProps_len; i++) {
-			if (prop != camera->pl->params.deviceinfo.DeviceProps[i])
-				continue;
-			if ((prop & 0xf000) == 0x5000) { /* generic property */
-				if (!vendor || (camera->pl->params.deviceinfo.VendorExtensionID==vendor))
-					return 1;
-			}
-			if (camera->pl->params.deviceinfo.VendorExtensionID==vendor)
-				return 1;
-		}
+		if (!ptp_property_issupported (params, prop))
+			return 0;
+		if (((prop & 0xf000) == 0x5000) && !vendor) /* generic property */
+			return 1;
+		return vendormatch;
 	}
 	if ((prop & 0x7000) == 0x1000) { /* commands */
-		for (i=0; i<camera->pl->params.deviceinfo.Operations_len; i++) {
-
-			if (prop != camera->pl->params.deviceinfo.Operations[i])
-				continue;
-			if ((prop & 0xf000) == 0x1000) /* generic property */
-				return 1;
-			if (camera->pl->params.deviceinfo.VendorExtensionID==vendor)
-				return 1;
-		}
+		if (!ptp_operation_issupported (params, prop))
+			return 0;
+		if ((prop & 0xf000) == 0x1000) /* generic command */
+			return 1;
+		return vendormatch;
 	}
 	return 0;
 }
@@ -9241,15 +9236,11 @@ _put_Nikon_Movie(CONFIG_PUT_ARGS)
 
 		C_PTP_REP (ptp_nikon_startmovie (params));
 	} else {
-		unsigned int i, havec108 = 0;
+		int havec108;
 
 		C_PTP_REP (ptp_nikon_stopmovie (params));
 
-		for (i=0;i<params->deviceinfo.Events_len;i++)
-			if (params->deviceinfo.Events[i] == PTP_EC_Nikon_MovieRecordComplete) {
-				havec108 = 1;
-				break;
-			}
+		havec108 = ptp_event_issupported (params, PTP_EC_Nikon_MovieRecordComplete);
 
 		/* takes 3 seconds for a 10 second movie on Z6 */
 		if (havec108) {
@@ -12125,6 +12116,304 @@ static struct menu menus[] = {
 	{ N_("WIFI profiles"),              "wifiprofiles",     0,      0,      NULL,                           _get_wifi_profiles_menu, _put_wifi_profiles_menu },
 };
 
+/*
+ * Name index over menus[], so camera_get_single_config() and
+ * camera_set_single_config() only visit the entries carrying the asked for
+ * name instead of comparing it against the whole table.
+ *
+ * It is built on first use for each connected camera and only describes
+ * the static tables; whether a property is there is still checked by the
+ * config code as before. The entries of one name, and the entries of one
+ * property code, are chained in table order.
+ */
+struct config_entry {
+	unsigned short	menu, sub;
+	unsigned int	nextname;	/* next entry with this name, or NO_ENTRY */
+	unsigned int	nextprop;	/* next entry with this propid, or NO_ENTRY */
+};
+
+struct _PTPConfigIndex {
+	struct config_entry	*entries;
+	unsigned int		nentries;
+	unsigned int		*names;		/* hash slots, first entry of a name + 1 */
+	unsigned int		*props;		/* hash slots, first entry of a propid + 1 */
+	unsigned int		size;		/* slots in both tables, a power of 2 */
+	unsigned short		menulen[ARRAYSIZE(menus)]; /* position of the terminator */
+	unsigned int		*pos;		/* for struct config_iter, reused */
+	unsigned int		poslen;
+};
+
+/* The entries a single get or set has to look at, in table order */
+struct config_iter {
+	PTPConfigIndex		*idx;
+	unsigned int		*pos;
+	unsigned int		n, cur;
+};
+
+#define NO_ENTRY	(~0U)
+#define ENTRY_SUB(idx,e)	(&menus[(idx)->entries[e].menu].submenus[(idx)->entries[e].sub])
+
+/* FNV-1a */
+static unsigned int
+_config_name_hash (const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static unsigned int
+_config_prop_hash (uint32_t propid)
+{
+	return propid * 2654435761U;
+}
+
+/* slot holding the chain of name (or of propid, for name NULL) */
+static unsigned int*
+_config_index_slot (PTPConfigIndex *idx, const char *name, uint32_t propid)
+{
+	unsigned int	mask = idx->size - 1;
+	unsigned int	*slots = name ? idx->names : idx->props;
+	unsigned int	i;
+
+	i = (name ? _config_name_hash (name) : _config_prop_hash (propid)) & mask;
+	for (; slots[i]; i = (i + 1) & mask) {
+		struct submenu *sub = ENTRY_SUB(idx, slots[i] - 1);
+
+		if (name ? !strcmp (sub->name, name) : (sub->propid == propid))
+			break;
+	}
+	return &slots[i];
+}
+
+static int
+_config_index_build (PTPConfigIndex *idx)
+{
+	unsigned int	menuno, submenuno, n = 0, e;
+	unsigned int	*lastname, *lastprop;
+
+	for (menuno = 0; menuno < ARRAYSIZE(menus); menuno++) {
+		if (!menus[menuno].submenus)
+			continue;
+		for (submenuno = 0; menus[menuno].submenus[submenuno].name; submenuno++)
+			n++;
+		idx->menulen[menuno] = submenuno;
+	}
+	for (idx->size = 64; idx->size < 2 * n; idx->size *= 2)
+		;
+	idx->entries = calloc (n, sizeof(idx->entries[0]));
+	idx->names = calloc (idx->size, sizeof(idx->names[0]));
+	idx->props = calloc (idx->size, sizeof(idx->props[0]));
+	/* last entry of each chain so far, to append in table order */
+	lastname = calloc (idx->size, sizeof(lastname[0]));
+	lastprop = calloc (idx->size, sizeof(lastprop[0]));
+	if (!idx->entries || !idx->names || !idx->props || !lastname || !lastprop) {
+		free (lastname);
+		free (lastprop);
+		return GP_ERROR_NO_MEMORY;
+	}
+
+	for (menuno = 0; menuno < ARRAYSIZE(menus); menuno++) {
+		if (!menus[menuno].submenus)
+			continue;
+		for (submenuno = 0; menus[menuno].submenus[submenuno].name; submenuno++) {
+			struct submenu	*cursub = &menus[menuno].submenus[submenuno];
+			unsigned int	*slot;
+
+			e = idx->nentries++;
+			idx->entries[e].menu     = menuno;
+			idx->entries[e].sub      = submenuno;
+			idx->entries[e].nextname = NO_ENTRY;
+			idx->entries[e].nextprop = NO_ENTRY;
+
+			slot = _config_index_slot (idx, cursub->name, 0);
+			if (*slot)
+				idx->entries[lastname[slot - idx->names]].nextname = e;
+			else
+				*slot = e + 1;
+			lastname[slot - idx->names] = e;
+
+			if (!cursub->propid)
+				continue;
+			slot = _config_index_slot (idx, NULL, cursub->propid);
+			if (*slot)
+				idx->entries[lastprop[slot - idx->props]].nextprop = e;
+			else
+				*slot = e + 1;
+			lastprop[slot - idx->props] = e;
+		}
+	}
+	free (lastname);
+	free (lastprop);
+	return GP_OK;
+}
+
+void
+camera_free_config_index (Camera *camera)
+{
+	PTPConfigIndex *idx = camera->pl->configindex;
+
+	if (!idx)
+		return;
+	free (idx->entries);
+	free (idx->names);
+	free (idx->props);
+	free (idx->pos);
+	free (idx);
+	camera->pl->configindex = NULL;
+}
+
+static int
+_cmp_uint (const void *a, const void *b)
+{
+	unsigned int ua = *(const unsigned int*)a, ub = *(const unsigned int*)b;
+
+	return (ua > ub) - (ua < ub);
+}
+
+/* The index of the camera, built on first use */
+static int
+_config_index (Camera *camera, PTPConfigIndex **pidx)
+{
+	PTPConfigIndex	*idx = camera->pl->configindex;
+
+	if (!idx) {
+		C_MEM (idx = calloc (1, sizeof(*idx)));
+		camera->pl->configindex = idx;
+		if (_config_index_build (idx) != GP_OK) {
+			camera_free_config_index (camera);
+			return GP_ERROR_NO_MEMORY;
+		}
+	}
+	*pidx = idx;
+	return GP_OK;
+}
+
+/* Whether an entry of another name shares the property code of cursub, and
+ * is offered by _get_config() when the getfunc of cursub fails. */
+static int
+_config_prop_has_fallback (Camera *camera, struct submenu *cursub)
+{
+	PTPConfigIndex	*idx;
+	unsigned int	e;
+
+	if (_config_index (camera, &idx) != GP_OK)
+		return 1;
+	for (e = *_config_index_slot (idx, NULL, cursub->propid) - 1; e != NO_ENTRY; e = idx->entries[e].nextprop)
+		if (strcmp (ENTRY_SUB(idx, e)->name, cursub->name))
+			return 1;
+	return 0;
+}
+
+/* Collects the entries named confname. With withprops also the earlier
+ * entries sharing their property codes, as _get_config() skips a property
+ * already handled under another name. */
+static int
+_config_iter_init (Camera *camera, const char *confname, int withprops, struct config_iter *it)
+{
+	PTPConfigIndex	*idx;
+	unsigned int	e, first, last = 0, n = 0, k;
+
+	memset (it, 0, sizeof(*it));
+	CR (_config_index (camera, &idx));
+	it->idx = idx;
+
+	first = *_config_index_slot (idx, confname, 0);
+	if (!first)
+		return GP_OK;
+	first--;
+	for (e = first; e != NO_ENTRY; e = idx->entries[e].nextname, n++)
+		last = e;
+	if (withprops)
+		for (e = first; e != NO_ENTRY; e = idx->entries[e].nextname) {
+			uint32_t propid = ENTRY_SUB(idx, e)->propid;
+
+			if (propid)
+				for (k = *_config_index_slot (idx, NULL, propid) - 1; k < last; k = idx->entries[k].nextprop)
+					n++;
+		}
+
+	if (n > idx->poslen) {
+		unsigned int *pos = realloc (idx->pos, n * sizeof(pos[0]));
+
+		C_MEM (pos);
+		idx->pos = pos;
+		idx->poslen = n;
+	}
+	it->pos = idx->pos;
+	for (e = first; e != NO_ENTRY; e = idx->entries[e].nextname)
+		it->pos[it->n++] = e;
+	if (withprops) {
+		for (e = first; e != NO_ENTRY; e = idx->entries[e].nextname) {
+			uint32_t propid = ENTRY_SUB(idx, e)->propid;
+
+			if (propid)
+				for (k = *_config_index_slot (idx, NULL, propid) - 1; k < last; k = idx->entries[k].nextprop)
+					it->pos[it->n++] = k;
+		}
+		qsort (it->pos, it->n, sizeof(it->pos[0]), _cmp_uint);
+		for (e = k = 0; e < it->n; e++)
+			if (!k || (it->pos[k - 1] != it->pos[e]))
+				it->pos[k++] = it->pos[e];
+		it->n = k;
+	}
+	GP_LOG_D ("'%s': %u of %u config entries to look at", confname, it->n, idx->nentries);
+	return GP_OK;
+}
+
+/* Submenu loops: all entries of menuno without an iterator, otherwise only
+ * the collected ones; the terminator ends the loop. */
+static unsigned int
+_config_iter_sub (struct config_iter *it, unsigned int menuno, unsigned int submenuno)
+{
+	struct config_entry *entry;
+
+	if (!it)
+		return submenuno;
+	while (it->cur < it->n) {
+		entry = &it->idx->entries[it->pos[it->cur]];
+		if (entry->menu > menuno)
+			break;
+		it->cur++;
+		if (entry->menu == menuno)
+			return entry->sub;
+	}
+	return it->idx->menulen[menuno];
+}
+
+#define config_iter_first(it,menuno)		_config_iter_sub (it, menuno, 0)
+#define config_iter_next(it,menuno,submenuno)	_config_iter_sub (it, menuno, (submenuno) + 1)
+
+/* The generic "Other PTP Device Properties" are named by their code in 4 digit hex */
+static int
+_config_generic_propid (const char *confname)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		if (!strchr ("0123456789abcdef", confname[i]) || !confname[i])
+			return -1;
+	if (confname[4])
+		return -1;
+	return strtoul (confname, NULL, 16);
+}
+
+/* With the ptp2 setting lazyconfig=on, the tree only holds sections and
+ * named, labeled placeholders for the device properties. The descriptors
+ * are fetched (and cached) to pick the entries, their widgets and choices
+ * are only built when the application first looks at them. */
+static int
+_lazy_config_widget (Camera *camera, const char *label, const char *name, CameraWidget **widget)
+{
+	CR (gp_widget_new (GP_WIDGET_TEXT, label, widget));
+	gp_widget_set_name (*widget, name);
+	return gp_camera_defer_config_widget (camera, *widget);
+}
+
 /*
  * Can do 3 things:
  * - get the whole widget dialog tree (confname = NULL, list = NULL, widget = rootwidget)
@@ -12140,8 +12429,10 @@ _get_config (Camera *camera, const char *confname, CameraWidget **outwidget, Cam
 	uint32_t	*setprops = NULL;
 	unsigned int	i;
 	int		nrofsetprops = 0;
+	int		genericpropid = -1;
 	PTPParams	*params = &camera->pl->params;
 	CameraAbilities	ab;
+	struct config_iter iter, *it = NULL;
 
 	enum {
 		MODE_GET,
@@ -12155,11 +12446,17 @@ _get_config (Camera *camera, const char *confname, CameraWidget **outwidget, Cam
 		gp_list_reset (list);
 		mode = MODE_LIST;
 	}
+	if (mode == MODE_SINGLE_GET) {
+		CR (_config_iter_init (camera, confname, 1, &iter));
+		it = &iter;
+	}
 
 	SET_CONTEXT(camera, context);
 	memset (&ab, 0, sizeof(ab));
 	gp_camera_get_abilities (camera, &ab);
-	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+	/* in a batch, camera_set_multi_config() did this once for all */
+	if (	!camera->pl->configbatch &&
+		(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
 		(ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteRelease) ||
 		 ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteReleaseOn)
 		)
@@ -12205,7 +12502,10 @@ _get_config (Camera *camera, const char *confname, CameraWidget **outwidget, Cam
 				gp_widget_append (window, section);
 			}
 		}
-		for (submenuno = 0; menus[menuno].submenus[submenuno].name ; submenuno++ ) {
+		for (	submenuno = config_iter_first (it, menuno);
+			menus[menuno].submenus[submenuno].name;
+			submenuno = config_iter_next (it, menuno, submenuno)
+		) {
 			struct submenu *cursub = menus[menuno].submenus+submenuno;
 			widget = NULL;
 
@@ -12271,6 +12571,20 @@ _get_config (Camera *camera, const char *confname, CameraWidget **outwidget, Cam
 							continue;
 						/* FIXME: continue to search here instead of below? */
 					}
+					/* Only defer what the getfunc will take. A mismatching type
+					 * or another entry standing in for a failing getfunc needs
+					 * the widget built now, to know what to offer. */
+					if (	(mode == MODE_GET) && camera->pl->lazyconfig &&
+						(cursub->type == dpd.DataType) &&
+						!_config_prop_has_fallback (camera, cursub)
+					) {
+						ptp_free_devicepropdesc(&dpd);
+						if (_lazy_config_widget (camera, _(cursub->label), cursub->name, &widget) == GP_OK)
+							gp_widget_append (section, widget);
+						else if (widget)
+							gp_widget_free (widget);
+						continue;
+					}
 					ret = cursub->getfunc (camera, &widget, cursub, &dpd);
 					if ((ret == GP_OK) && (dpd.GetSet == PTP_DPGS_Get))
 						gp_widget_set_readonly (widget, 1);
@@ -12395,6 +12709,8 @@ _get_config (Camera *camera, const char *confname, CameraWidget **outwidget, Cam
 		gp_widget_append (window, section);
 	}
 
+	if (mode == MODE_SINGLE_GET)
+		genericpropid = _config_generic_propid (confname);
 	for (i=0;i<params->deviceinfo.DeviceProps_len;i++) {
 		uint16_t		propid = params->deviceinfo.DeviceProps[i];
 		char			buf[21], *label;
@@ -12413,18 +12729,35 @@ _get_config (Camera *camera, const char *confname, CameraWidget **outwidget, Cam
 		}
 #endif
 
-		sprintf(buf,"%04x", propid);
-		if ((mode == MODE_SINGLE_GET) && strcmp (buf, confname))
+		if ((mode == MODE_SINGLE_GET) && (propid != genericpropid))
 			continue;
 		if (mode == MODE_LIST) {
+			sprintf(buf,"%04x", propid);
 			gp_list_append (list, buf, NULL);
 			continue;
 		}
-
 		ret = ptp_generic_getdevicepropdesc (params,propid,&dpd);
 		if (ret != PTP_RC_OK)
 			continue;
 
+		if ((mode == MODE_GET) && camera->pl->lazyconfig) {
+			char name[5];
+
+			ptp_free_devicepropdesc(&dpd);
+			label = (char*)ptp_get_property_description(params, propid);
+			if (!label) {
+				sprintf (buf, N_("PTP Property 0x%04x"), propid);
+				label = buf;
+			}
+			sprintf (name, "%04x", propid);
+			widget = NULL;
+			if (_lazy_config_widget (camera, _(label), name, &widget) == GP_OK)
+				gp_widget_append (section, widget);
+			else if (widget)
+				gp_widget_free (widget);
+			continue;
+		}
+
 		label = (char*)ptp_get_property_description(params, propid);
 		if (!label) {
 			sprintf (buf, N_("PTP Property 0x%04x"), propid);
@@ -12672,18 +13005,26 @@ _set_config (Camera *camera, const char *confname, CameraWidget *window, GPConte
 	PTPPropValue	propval;
 	unsigned int	i;
 	CameraAbilities	ab;
+	struct config_iter iter, *it = NULL;
+	int		genericpropid = -1;
 	enum {
 		MODE_SET, MODE_SINGLE_SET
 	} mode = MODE_SET;
 
-	if (confname) mode = MODE_SINGLE_SET;
+	if (confname) {
+		mode = MODE_SINGLE_SET;
+		CR (_config_iter_init (camera, confname, 0, &iter));
+		it = &iter;
+		genericpropid = _config_generic_propid (confname);
+	}
 
 	SET_CONTEXT(camera, context);
 	memset (&ab, 0, sizeof(ab));
 	gp_camera_get_abilities (camera, &ab);
 
 	camera->pl->checkevents = TRUE;
-	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+	if (	!camera->pl->configbatch &&
+		(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
 		(ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteRelease) ||
 		 ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteReleaseOn)
 		)
@@ -12718,7 +13059,10 @@ _set_config (Camera *camera, const char *confname, CameraWidget *window, GPConte
 		}
 
 		/* Standard menu with submenus */
-		for (submenuno = 0; menus[menuno].submenus[submenuno].label ; submenuno++ ) {
+		for (	submenuno = config_iter_first (it, menuno);
+			menus[menuno].submenus[submenuno].label;
+			submenuno = config_iter_next (it, menuno, submenuno)
+		) {
 			struct submenu *cursub = menus[menuno].submenus+submenuno;
 			int alreadyset = 0;
 
@@ -12860,11 +13204,8 @@ _set_config (Camera *camera, const char *confname, CameraWidget *window, GPConte
 		char			buf[20], *label, *xval;
 		PTPDevicePropDesc	dpd;
 
-		if (mode == MODE_SINGLE_SET) {
-			sprintf(buf,"%04x", propid);
-			if (strcmp (confname, buf))
-				continue;
-		}
+		if ((mode == MODE_SINGLE_SET) && (propid != genericpropid))
+			continue;
 		label = (char*)ptp_get_property_description(params, propid);
 		if (!label) {
 			sprintf (buf, N_("PTP Property 0x%04x"), propid);
@@ -12957,6 +13298,75 @@ camera_set_single_config (Camera *camera, const char *confname, CameraWidget *wi
 	return _set_config (camera, confname, widget, context);
 }
 
+/*
+ * Sets a list of name / value pairs. The widgets of all of them are fetched
+ * and filled in first, so nothing is set if a name is wrong, a widget is
+ * read-only or a value does not parse. Menu and radio values are not checked
+ * against the choices, the put functions also take values not listed there
+ * (e.g. "Unknown value" hex codes), so those are only refused when set. Then
+ * the values go out back to back, with the EOS capture setup and event
+ * check done once for the batch instead of once per get and set. The
+ * descriptors of the first pass are reused from the property cache.
+ *
+ * There is nothing to pack: PTP SetDevicePropValue, EOS
+ * SetDevicePropValueEx (as used here) and Sony SetControlDeviceA all carry
+ * one property per transaction.
+ */
+int
+camera_set_multi_config (Camera *camera, CameraList *values, GPContext *context)
+{
+	PTPParams	*params = &camera->pl->params;
+	CameraWidget	**widgets;
+	const char	*name, *value;
+	int		i, n = gp_list_count (values), ro, ret = GP_OK;
+
+	if (n <= 0)
+		return GP_OK;
+	C_MEM (widgets = calloc (n, sizeof(widgets[0])));
+
+	SET_CONTEXT(camera, context);
+	camera->pl->checkevents = TRUE;
+	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+		(ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteRelease) ||
+		 ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteReleaseOn)
+		)
+	) {
+		if (!params->eos_captureenabled)
+			camera_prepare_capture (camera, context);
+		ptp_check_eos_events (params);
+		camera_keep_device_on (camera);
+	}
+	camera->pl->configbatch = 1;
+
+	for (i = 0; (ret == GP_OK) && (i < n); i++) {
+		gp_list_get_name (values, i, &name);
+		gp_list_get_value (values, i, &value);
+		if (!value)
+			value = "";
+		ret = _get_config (camera, name, &widgets[i], NULL, context);
+		if (ret == GP_OK) {
+			gp_widget_get_readonly (widgets[i], &ro);
+			if (ro)
+				ret = GP_ERROR_NOT_SUPPORTED;
+		}
+		if (ret == GP_OK)
+			ret = gp_widget_set_value_from_string (widgets[i], value);
+		if (ret != GP_OK)
+			gp_context_error (context, _("Could not set '%s' to '%s'."), name, value);
+	}
+	for (i = 0; (ret == GP_OK) && (i < n); i++) {
+		gp_list_get_name (values, i, &name);
+		ret = _set_config (camera, name, widgets[i], context);
+	}
+
+	camera->pl->configbatch = 0;
+	for (i = 0; i < n; i++)
+		if (widgets[i])
+			gp_widget_free (widgets[i]);
+	free (widgets);
+	return ret;
+}
+
 int
 camera_lookup_by_property(Camera *camera, PTPDevicePropDesc *dpd, char **name, char **content, GPContext *context)
 {
@@ -57,6 +57,9 @@
 static int normal_timeout = USB_NORMAL_TIMEOUT;
 #define USB_TIMEOUT_CAPTURE 100000
 static int capture_timeout = USB_TIMEOUT_CAPTURE;
+/* large data phases are read with several bulk transfers queued */
+#define USB_STREAM_DEPTH	8
+#define USB_STREAM_CHUNKSIZE	(256*1024)
 
 #define	SET_CONTEXT(camera, ctx) ((PTPData *) camera->pl->params.data)->context = ctx
 #define	SET_CONTEXT_P(p, ctx) ((PTPData *) p->data)->context = ctx
@@ -187,6 +190,9 @@ fixup_cached_deviceinfo (Camera *camera, PTPDeviceInfo *di) {
 	PTPParams	*params = &camera->pl->params;
 
 	gp_camera_get_abilities(camera, &a);
+	/* the lists get extended below, have the capability bitsets follow */
+	if (di == &params->deviceinfo)
+		ptp_deviceinfo_changed (params);
 
 	/* Panasonic GH5, GC9 */
 	if (    (di->VendorExtensionID == PTP_VENDOR_PANASONIC) &&
@@ -3334,8 +3340,16 @@ camera_exit (Camera *camera, GPContext *context)
 
 		if (camera->pl->checkevents)
 			ptp_check_event (params);
-		while (ptp_get_one_event (params, &event))
+		while (ptp_get_one_event (params, &event)) {
 			GP_LOG_D ("missed ptp event 0x%x (param1=%x)", event.Code, event.Param1);
+			/* a change the object cache did not follow */
+			if (	(event.Code == PTP_EC_ObjectAdded) || (event.Code == PTP_EC_ObjectRemoved) ||
+				(event.Code == PTP_EC_ObjectInfoChanged)
+			)
+				params->objectcache = 0;
+		}
+		if (params->objectcache)
+			ptp_objectcache_save (params);
 
 		/* 2016 EOS cameras do not like that and report 0x2005 on all following opcodes */
 		if (!DONT_CLOSE_SESSION(params)) {
@@ -3356,6 +3370,8 @@ exitfailed:
 		}
 
 		free (params->data);
+		camera_free_config_index (camera);
+		pthread_mutex_destroy (&params->pump_mutex);
 		free (camera->pl); /* also frees params */
 		params = NULL;
 		camera->pl = NULL;
@@ -4111,6 +4127,179 @@ ignoreerror:
 	return GP_ERROR_NOT_SUPPORTED;
 }
 
+/* Receives a live view frame straight into the memory of a preview stream
+ * frame, without adding it to the file yet: the JPEG is cut out of it in
+ * place afterwards. */
+typedef struct {
+	CameraFile	*file;
+	unsigned long	len;
+} PTPFrameHandlerPrivate;
+
+static uint16_t
+frame_putfunc (PTPParams *params, void *xpriv,
+	unsigned long sendlen, unsigned char *bytes
+) {
+	PTPFrameHandlerPrivate	*priv = xpriv;
+	char			*dest;
+
+	if (gp_file_get_append_buffer (priv->file, priv->len + sendlen, &dest) != GP_OK)
+		return PTP_ERROR_IO;
+	/* data received into frame_getbuffer() memory is already in place */
+	if ((char*)bytes != dest + priv->len)
+		memcpy (dest + priv->len, bytes, sendlen);
+	priv->len += sendlen;
+	return PTP_RC_OK;
+}
+
+static uint16_t
+frame_getbuffer (PTPParams *params, void *xpriv,
+	unsigned long wantlen, unsigned char **bytes
+) {
+	PTPFrameHandlerPrivate	*priv = xpriv;
+	char			*dest;
+
+	if (gp_file_get_append_buffer (priv->file, priv->len + wantlen, &dest) != GP_OK)
+		return PTP_RC_GeneralError;
+	*bytes = (unsigned char*)dest + priv->len;
+	return PTP_RC_OK;
+}
+
+static int
+camera_preview_stream (Camera *camera, int enable, GPContext *context)
+{
+	CameraFile	*file;
+	int		ret;
+
+	/* live view is left on as with capture_preview, camera_exit ends it */
+	if (!enable)
+		return GP_OK;
+
+	/* the regular preview path does the vendor specific live view setup,
+	 * its frame is dropped (the first one is corrupted on some Nikons anyway) */
+	CR (gp_file_new (&file));
+	ret = camera_capture_preview (camera, file, context);
+	gp_file_unref (file);
+	return ret;
+}
+
+static int
+camera_preview_frame_nikon (Camera *camera, CameraFile *file, GPContext *context)
+{
+	PTPParams		*params = &camera->pl->params;
+	PTPFrameHandlerPrivate	priv = { file, 0 };
+	PTPDataHandler		handler = { NULL, frame_putfunc, &priv, frame_getbuffer };
+	char			*data;
+	int			tries = 20, res;
+	uint16_t		ret;
+
+	SET_CONTEXT_P(params, context);
+	while (1) {
+		priv.len = 0;
+		ret = ptp_nikon_get_liveview_image_handler (params, &handler);
+		if (ret == PTP_RC_OK)
+			break;
+		if (ret == PTP_RC_NIKON_NotLiveView) {
+			/* switched off meanwhile, the regular path enables it again */
+			params->inliveview = 0;
+			return camera_capture_preview (camera, file, context);
+		}
+		if ((ret == PTP_RC_DeviceBusy) && tries--) {
+			GP_LOG_D ("busy, retrying after a bit of wait, try %d", tries);
+			usleep(10*1000);
+			continue;
+		}
+		SET_CONTEXT_P(params, NULL);
+		return translate_ptp_result (ret);
+	}
+	SET_CONTEXT_P(params, NULL);
+
+	CR (gp_file_get_append_buffer (file, priv.len, &data));
+	res = save_jpeg_in_data_to_preview ((unsigned char*)data, priv.len, file);
+	if (res < GP_OK) { /* no SOI -> no JPEG */
+		gp_context_error (context, _("Sorry, your Nikon camera does not seem to return a JPEG image in LiveView mode"));
+		return GP_ERROR;
+	}
+	return GP_OK;
+}
+
+static int
+camera_preview_frame_eos (Camera *camera, CameraFile *file, GPContext *context)
+{
+	PTPParams		*params = &camera->pl->params;
+	PTPFrameHandlerPrivate	priv = { file, 0 };
+	PTPDataHandler		handler = { NULL, frame_putfunc, &priv, frame_getbuffer };
+	struct timeval		event_start = time_now();
+	unsigned char		*data, *xdata;
+	int			try = 0;
+	uint16_t		ret;
+
+	/* Otherwise the camera will auto-shutdown */
+	CR (camera_keep_device_on (camera));
+
+	SET_CONTEXT_P(params, context);
+	while (1) {
+		/* Poll for camera events, but just call
+		 * it once and do not drain the queue now */
+		C_PTP (ptp_check_eos_events (params));
+
+		priv.len = 0;
+		ret = ptp_canon_eos_get_viewfinder_image_handler (params, &handler);
+		if (	((ret == 0xa102) || (ret == PTP_RC_DeviceBusy)) &&	/* means "not there yet" ... so wait */
+			(time_since (event_start) < 3*1000)
+		) {
+			usleep((++try)*5*1000);
+			continue;
+		}
+		break;
+	}
+	SET_CONTEXT_P(params, NULL);
+	C_PTP_MSG (ret, "get_viewfinder_image failed");
+
+	CR (gp_file_get_append_buffer (file, priv.len, (char**)&data));
+	/* blobs of uint32 len, uint32 type, data. 1 is JPEG, 11 too, 9 in movie mode */
+	for (xdata = data; (unsigned int)(xdata - data) + 8 <= priv.len; ) {
+		uint32_t	len  = dtoh32a(xdata);
+		uint32_t	type = dtoh32a(xdata+4);
+
+		if ((len < 8) || (len > priv.len - (xdata - data))) {
+			GP_LOG_E ("len=%d larger than rest size %lu", len, (priv.len - (xdata - data)));
+			break;
+		}
+		if ((type == 1) || (type == 9) || (type == 11)) {
+			CR (gp_file_append (file, (char*)xdata+8, len-8));
+			gp_file_set_mime_type (file, ((type == 1) || (type == 11)) ? GP_MIME_JPEG : GP_MIME_RAW);
+			/* Add an arbitrary file name so caller won't crash */
+			gp_file_set_name (file, "preview.jpg");
+			return GP_OK;
+		}
+		xdata += len;
+	}
+	return GP_ERROR;
+}
+
+/* Next frame of a preview stream, read straight into its memory. Vendors
+ * without a fast path take the regular capture_preview one. */
+static int
+camera_preview_frame (Camera *camera, CameraFile *file, GPContext *context)
+{
+	PTPParams	*params = &camera->pl->params;
+
+	camera->pl->checkevents = TRUE;
+	switch (params->deviceinfo.VendorExtensionID) {
+	case PTP_VENDOR_NIKON:
+		if (params->inliveview && ptp_operation_issupported(params, PTP_OC_NIKON_GetLiveViewImg))
+			return camera_preview_frame_nikon (camera, file, context);
+		break;
+	case PTP_VENDOR_CANON:
+		if (params->inliveview && ptp_operation_issupported(params, PTP_OC_CANON_EOS_GetViewFinderData))
+			return camera_preview_frame_eos (camera, file, context);
+		break;
+	default:
+		break;
+	}
+	return camera_capture_preview (camera, file, context);
+}
+
 static int
 add_objectid_and_upload (Camera *camera, CameraFilePath *path, GPContext *context,
 	uint32_t newobject, PTPObjectInfo *oi) {
@@ -6650,6 +6839,69 @@ camera_trigger_capture (Camera *camera, GPContext *context)
 	return GP_OK;
 }
 
+/* Whether camera_wait_for_event() asks the camera for its events with an
+ * operation, instead of just reading the interrupt endpoint */
+static int
+camera_events_polled (PTPParams *params)
+{
+	switch (params->deviceinfo.VendorExtensionID) {
+	case PTP_VENDOR_CANON:
+		return	ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteRelease) ||
+			ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteReleaseOn) ||
+			ptp_operation_issupported(params, PTP_OC_CANON_CheckEvent);
+	case PTP_VENDOR_NIKON:
+		return	ptp_operation_issupported(params, PTP_OC_NIKON_GetEvent);
+	case PTP_VENDOR_SONY:
+		return	ptp_operation_issupported(params, PTP_OC_SONY_SDIO_ControlDevice) ||
+			ptp_operation_issupported(params, PTP_OC_SONY_QX_GetAllDevicePropData);
+	case PTP_VENDOR_FUJI:
+		return	ptp_property_issupported(params, PTP_DPC_FUJI_CurrentState);
+	case PTP_VENDOR_GP_OLYMPUS_OMD:
+		return	1;
+	default:
+		return	(params->device_flags & DEVICE_FLAG_OLYMPUS_XML_WRAPPED) != 0;
+	}
+}
+
+static void
+camera_pump_event (PTPParams *params, uint16_t code, PTPContainer *event, void *data)
+{
+	*(PTPContainer *)data = *event;
+}
+
+static int
+camera_queue_pump_event (PTPParams *params, PTPContainer *event)
+{
+	array_push_back (&params->pump_events, *event);
+	return GP_OK;
+}
+
+/* Called by the event pump of the core without the camera lock, so besides
+ * the interrupt endpoint only pump_events may be touched. */
+static int
+camera_event_ready (Camera *camera, int timeout, GPContext *context)
+{
+	PTPParams	*params = &camera->pl->params;
+	PTPContainer	event;
+	uint16_t	ret;
+	int		result;
+
+	/* the others get polled with camera_wait_for_event() */
+	if (!params->pump_interrupts)
+		return GP_ERROR_NOT_SUPPORTED;
+
+	ret = ptp_usb_event_async (params, camera_pump_event, &event);
+	if (ret == PTP_ERROR_TIMEOUT)
+		return GP_ERROR_TIMEOUT;
+	if (ret != PTP_RC_OK)
+		return translate_ptp_result (ret);
+
+	pthread_mutex_lock (&params->pump_mutex);
+	result = camera_queue_pump_event (params, &event);
+	pthread_mutex_unlock (&params->pump_mutex);
+	return result;
+}
+
 static int
 camera_wait_for_event (Camera *camera, int timeout,
 		       CameraEventType *eventtype, void **eventdata,
@@ -8516,7 +8768,7 @@ mtp_get_playlist_string(
 	Camera *camera, uint32_t handle, char **xcontent, int *xcontentlen
 ) {
 	PTPParams *params = &camera->pl->params;
-	ArrayU32	object_handles;
+	ArrayU32	object_handles = {0};
 	int		contentlen = 0;
 	char		*content = NULL;
 
@@ -8648,6 +8900,17 @@ gpfile_putfunc (PTPParams *params, void *xpriv,
 	return PTP_RC_OK;
 }
 
+static uint16_t
+gpfile_getbuffer (PTPParams *params, void *xpriv,
+	unsigned long wantlen, unsigned char **bytes
+) {
+	PTPCFHandlerPrivate* priv= (PTPCFHandlerPrivate*)xpriv;
+
+	if (gp_file_get_append_buffer (priv->file, wantlen, (char**)bytes) != GP_OK)
+		return PTP_RC_GeneralError;
+	return PTP_RC_OK;
+}
+
 uint16_t
 ptp_init_camerafile_handler (PTPDataHandler *handler, CameraFile *file) {
 	PTPCFHandlerPrivate* priv = malloc (sizeof(PTPCFHandlerPrivate));
@@ -8655,6 +8918,7 @@ ptp_init_camerafile_handler (PTPDataHandler *handler, CameraFile *file) {
 	handler->priv = priv;
 	handler->getfunc = gpfile_getfunc;
 	handler->putfunc = gpfile_putfunc;
+	handler->getbuffer = gpfile_getbuffer;
 	priv->file = file;
 	return PTP_RC_OK;
 }
@@ -9030,6 +9294,8 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 			uint16_t	ret;
 			PTPDataHandler	handler;
 
+			/* allocate memory files once, the data is then received in place */
+			CR (gp_file_reserve (file, size));
 			ptp_init_camerafile_handler (&handler, file);
 			ret = ptp_getobject_to_handler(params, handle, &handler);
 			ptp_exit_camerafile_handler (&handler);
@@ -9076,6 +9342,64 @@ done:
 	return set_mimetype (file, params->deviceinfo.VendorExtensionID, ob->oi.ObjectFormat);
 }
 
+/* Batch download: every folder of the batch is looked up once and the
+ * ObjectInfos of its files are loaded together (one GetObjPropList on
+ * MTP devices), then the objects are fetched one after the other without
+ * any per file lookup round trips in between. */
+static int
+get_files_func (CameraFilesystem *fs, int count, const char *folders[],
+		const char *filenames[], CameraFileType type,
+		CameraFileBatchOpenFunc open_func, CameraFileBatchDoneFunc done_func,
+		void *batchdata, void *data, GPContext *context)
+{
+	Camera		*camera = data;
+	PTPParams	*params = &camera->pl->params;
+	const char	*lastfolder = NULL;
+	unsigned int	id;
+	int		i, ret = GP_OK;
+
+	SET_CONTEXT_P(params, context);
+
+	for (i = 0; i < count; i++) {
+		uint32_t	storage, handle;
+
+		if (lastfolder && !strcmp (lastfolder, folders[i]))
+			continue;
+		lastfolder = folders[i];
+		if (!strcmp (folders[i], "/special"))
+			continue;
+		/* errors show up again when the files are fetched */
+		if (find_storage_and_handle_from_path (params, folders[i], &storage, &handle) != GP_OK)
+			continue;
+		if (handle == PTP_HANDLER_SPECIAL)
+			continue;
+		if (ptp_list_folder (params, storage, handle, NULL) != PTP_RC_OK)
+			continue;
+		ptp_object_prefetch_children (params, handle);
+	}
+
+	id = gp_context_progress_start (context, count, _("Downloading files..."));
+	for (i = 0; i < count; i++) {
+		CameraFile	*file;
+		int		result;
+
+		ret = open_func (folders[i], filenames[i], type, &file, batchdata);
+		if (ret < GP_OK)
+			break;
+		result = get_file_func (fs, folders[i], filenames[i], type, file, data, context);
+		ret = done_func (folders[i], filenames[i], type, file, result, batchdata);
+		if (ret < GP_OK)
+			break;
+		if (result == GP_ERROR_CANCEL) {
+			ret = result;
+			break;
+		}
+		gp_context_progress_update (context, id, i + 1);
+	}
+	gp_context_progress_stop (context, id);
+	return ret;
+}
+
 static int
 put_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 		CameraFileType type, CameraFile *file, void *data, GPContext *context)
@@ -9558,6 +9882,7 @@ static CameraFilesystemFuncs fsfuncs = {
 	.get_info_func		= get_info_func,
 	.set_info_func		= set_info_func,
 	.get_file_func		= get_file_func,
+	.get_files_func		= get_files_func,
 	.read_file_func		= read_file_func,
 	.del_file_func		= delete_file_func,
 	.put_file_func		= put_file_func,
@@ -9600,13 +9925,18 @@ camera_init (Camera *camera, GPContext *context)
 	camera->functions->get_config = camera_get_config;
 	camera->functions->get_single_config = camera_get_single_config;
 	camera->functions->set_single_config = camera_set_single_config;
+	camera->functions->set_multi_config = camera_set_multi_config;
+	camera->functions->preview_stream = camera_preview_stream;
+	camera->functions->preview_frame = camera_preview_frame;
 	camera->functions->set_config = camera_set_config;
 	camera->functions->list_config = camera_list_config;
 	camera->functions->wait_for_event = camera_wait_for_event;
+	camera->functions->event_ready = camera_event_ready;
 
 	/* We need some data that we pass around */
 	C_MEM (camera->pl = calloc (1, sizeof (CameraPrivateLibrary)));
 	params = &camera->pl->params;
+	pthread_mutex_init (&params->pump_mutex, NULL);
 	params->debug_func = ptp_debug_func;
 	params->error_func = ptp_error_func;
 	C_MEM (params->data = calloc (1, sizeof (PTPData)));
@@ -9756,6 +10086,48 @@ camera_init (Camera *camera, GPContext *context)
 	} else {
 		params->cachetime = 2; /* 2 seconds */
 	}
+	/* property descriptors are refetched when the camera reports a change,
+	 * with propcache=timer only after cachetime, see ptp_dpd_cache_mode() */
+	if (	(GP_OK == gp_setting_get("ptp2","propcache",buf)) &&
+		!strcmp (buf, "timer")
+	)
+		params->dpd_cache_timer = 1;
+
+	/* keep the object cache across sessions, needs events telling about changes */
+	if (	(GP_OK == gp_setting_get("ptp2","objectcache",buf)) &&
+		(!strcmp (buf, "on") || !strcmp (buf, "1"))
+	) {
+		params->objectcache = 1;
+		GP_LOG_D("read objectcache %s", buf);
+	}
+
+	/* config trees with the property widgets loaded on first access */
+	if (	(GP_OK == gp_setting_get("ptp2","lazyconfig",buf)) &&
+		(!strcmp (buf, "on") || !strcmp (buf, "1"))
+	) {
+		camera->pl->lazyconfig = 1;
+		GP_LOG_D("read lazyconfig %s", buf);
+	}
+
+	/* ObjectInfos in bulk with GetObjPropList: "off", "folder" (default) or "all" */
+	params->prefetch_mode = PTP_PREFETCH_FOLDER;
+	if ((GP_OK == gp_setting_get("ptp2","objectprefetch",buf))) {
+		if (!strcmp (buf, "off"))
+			params->prefetch_mode = PTP_PREFETCH_OFF;
+		else if (!strcmp (buf, "all"))
+			params->prefetch_mode = PTP_PREFETCH_ALL;
+		GP_LOG_D("read objectprefetch %s", buf);
+	}
+
+	if (camera->port->type == GP_PORT_USB) {
+		params->usb_stream_depth = USB_STREAM_DEPTH;
+		params->usb_stream_chunksize = USB_STREAM_CHUNKSIZE;
+		if ((GP_OK == gp_setting_get("ptp2","usbstreamdepth",buf)))
+			sscanf(buf, "%d", &params->usb_stream_depth);
+		if ((GP_OK == gp_setting_get("ptp2","usbstreamchunksize",buf)))
+			sscanf(buf, "%d", &params->usb_stream_chunksize);
+		GP_LOG_D("USB data streaming with %d x %d bytes", params->usb_stream_depth, params->usb_stream_chunksize);
+	}
 
 	/* Establish a connection to the camera */
 	SET_CONTEXT(camera, context);
@@ -10039,6 +10411,16 @@ camera_init (Camera *camera, GPContext *context)
 		gp_port_set_timeout (camera->port, timeout);
 	}
 
+	/* the object cache of the last session, if nothing changed since */
+	if (	params->objectcache &&
+		!(ptp_event_issupported (params, PTP_EC_ObjectAdded) && ptp_event_issupported (params, PTP_EC_ObjectRemoved))
+	) {
+		GP_LOG_D ("no ObjectAdded/ObjectRemoved events, not keeping the object cache");
+		params->objectcache = 0;
+	}
+	if (params->objectcache)
+		ptp_objectcache_load (params);
+
 	/* initial reading of the root directory of each storage, which serves 2 purposes:
 	 * a) the ptp_list_folder caching of root queries depends on this being done once
 	 * b) this is needed for some reason for Canons EOS 1500D to not hang
@@ -10093,6 +10475,8 @@ camera_init (Camera *camera, GPContext *context)
 		*/
 	}
 
+	params->pump_interrupts = (params->event_check == ptp_usb_event_check) && !camera_events_polled (params);
+
 	SET_CONTEXT(camera, NULL);
 
 	GP_LOG_D("camera_init done\n");
@@ -0,0 +1,157 @@
+/** \file camlibs/ptp2/objectcache-bench.c
+ * \brief Micro benchmark for filling the ptp2 object cache
+ *
+ * Inserts N object handles (default 100000) into the PTPParams object
+ * cache, once one by one via ptp_find_or_insert_object_in_cache() and
+ * once in bulk via ptp_insert_objects_in_cache() as done for
+ * GetObjectHandles results, each in ascending and in random order.
+ *
+ * \copyright GNU Lesser General Public License 2 or later
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Usage (meson builds it as the ptp2-objectcache benchmark):
+ *   $ ./objectcache-bench [N]
+ */
+
+/* pull in the ptp2 core, so the static helpers are available as well */
+#include "ptp.c"
+
+#include <sys/time.h>
+
+
+/* normally provided by ptpip.c */
+void
+ptp_nikon_getptpipguid (unsigned char* guid)
+{
+	memset (guid, 0, 16);
+}
+
+static void
+quiet_debug (void *data, const char *format, va_list args)
+{
+}
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+init_params (PTPParams *params)
+{
+	memset (params, 0, sizeof(*params));
+	params->debug_func = quiet_debug;
+	params->error_func = quiet_debug;
+}
+
+static int
+check_sorted (PTPParams *params, unsigned int n)
+{
+	/* objects added one by one may still wait at the end to be merged in */
+	ptp_objects_merge (params);
+	if (params->objects.len != n) {
+		printf ("ERROR: %u objects cached, expected %u\n", params->objects.len, n);
+		return 1;
+	}
+	for (unsigned int i = 1; i < params->objects.len; i++) {
+		if (params->objects.val[i-1].oid >= params->objects.val[i].oid) {
+			printf ("ERROR: object cache not sorted at %u\n", i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+bench_single (const char *order, uint32_t *handles, unsigned int n)
+{
+	PTPParams	params;
+	PTPObject	*ob;
+	double		start;
+	int		ret;
+
+	init_params (&params);
+	start = now ();
+	for (unsigned int i = 0; i < n; i++) {
+		if (ptp_find_or_insert_object_in_cache (&params, handles[i], &ob) != PTP_RC_OK) {
+			printf ("ERROR: inserting 0x%08x failed\n", handles[i]);
+			return 1;
+		}
+	}
+	printf ("%-9s one by one: %u handles in %.3f s\n", order, n, now () - start);
+	ret = check_sorted (&params, n);
+	ptp_free_params (&params);
+	return ret;
+}
+
+static int
+bench_bulk (const char *order, uint32_t *handles, unsigned int n)
+{
+	PTPParams		params;
+	PTPObjectHandles	list = { handles, n, n }, newhandles;
+	double			start;
+	int			ret;
+
+	init_params (&params);
+	start = now ();
+	/* a folder listing arrives in chunks, mimic that with 100 GetObjectHandles results */
+	for (unsigned int i = 0; i < 100; i++) {
+		list.val = handles + (uint64_t)n * i / 100;
+		list.len = (uint64_t)n * (i + 1) / 100 - (uint64_t)n * i / 100;
+		if (ptp_insert_objects_in_cache (&params, &list, &newhandles) != PTP_RC_OK) {
+			printf ("ERROR: bulk insert failed\n");
+			return 1;
+		}
+		free_array (&newhandles);
+	}
+	printf ("%-9s bulk:       %u handles in %.3f s\n", order, n, now () - start);
+	ret = check_sorted (&params, n);
+	ptp_free_params (&params);
+	return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+	unsigned int	n = argc > 1 ? strtoul (argv[1], NULL, 0) : 100000;
+	uint32_t	*handles = calloc (n, sizeof(uint32_t));
+	int		ret = 0;
+
+	if (!handles)
+		return 1;
+	for (unsigned int i = 0; i < n; i++)
+		handles[i] = 0x10000 + i;
+	ret |= bench_single ("ascending", handles, n);
+	ret |= bench_bulk ("ascending", handles, n);
+
+	srand (42);
+	for (unsigned int i = n - 1; i > 0; i--) {
+		unsigned int j = rand () % (i + 1);
+		uint32_t tmp = handles[i];
+		handles[i] = handles[j];
+		handles[j] = tmp;
+	}
+	ret |= bench_single ("random", handles, n);
+	ret |= bench_bulk ("random", handles, n);
+
+	free (handles);
+	return ret;
+}
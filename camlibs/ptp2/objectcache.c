@@ -0,0 +1,329 @@
+/* objectcache.c
+ *
+ * Copyright (C) 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Persistent object cache, enabled with the ptp2 setting objectcache=on.
+ *
+ * The object cache of a camera (ObjectInfos and which folders were listed
+ * completely) is kept across sessions in a file in the gphoto settings
+ * directory, one per camera body. It is only taken over again if the body
+ * (serial number) and its storages (capacity, free space, volume label)
+ * are unchanged, so reconnecting to a card nobody touched needs no folder
+ * listings and no GetObjectInfo at all.
+ *
+ * While connected, the object cache follows the ObjectAdded/ObjectRemoved
+ * events as usual and is written back when the camera is closed. The file
+ * is removed once it was read, so a session that ends without camera_exit
+ * leaves nothing stale behind.
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-library.h>
+#include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-setting.h>
+
+#include "ptp.h"
+#include "ptp-private.h"
+
+#define OBJECTCACHE_MAGIC	"gp2ptpoc"
+#define OBJECTCACHE_VERSION	1
+#define OBJECTCACHE_BYTEORDER	0x01020304
+/* what stays true across sessions */
+#define OBJECTCACHE_FLAGS	(PTPOBJECT_OBJECTINFO_LOADED|PTPOBJECT_CANONFLAGS_LOADED|PTPOBJECT_DIRECTORY_LOADED|\
+				 PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED)
+/* the settings directory, plus room for the file name */
+#define OBJECTCACHE_PATH_MAX	(1024 + 300)
+
+static int
+objectcache_path (PTPParams *params, char *path, int size)
+{
+	PTPDeviceInfo	*di = &params->deviceinfo;
+	char		dir[1024], id[256];
+
+	/* without a serial number different bodies could not be told apart */
+	if (!di->SerialNumber || !di->SerialNumber[0])
+		return GP_ERROR_NOT_SUPPORTED;
+	CR (gp_setting_get_dir (dir, sizeof(dir)));
+	snprintf (id, sizeof(id), "%s-%s-%s", di->Manufacturer ? di->Manufacturer : "",
+		  di->Model ? di->Model : "", di->SerialNumber);
+	for (char *s = id; *s; s++)
+		if (!isalnum ((unsigned char)*s) && (*s != '-') && (*s != '.'))
+			*s = '_';
+	snprintf (path, size, "%s/ptp2-objects-%s", dir, id);
+	return GP_OK;
+}
+
+/* The camera state a cache file belongs to, as one string */
+static int
+objectcache_key (PTPParams *params, char *key, int size)
+{
+	PTPDeviceInfo	*di = &params->deviceinfo;
+	int		len;
+
+	if (!params->storageids.len || !ptp_operation_issupported (params, PTP_OC_GetStorageInfo))
+		return GP_ERROR_NOT_SUPPORTED;
+
+	len = snprintf (key, size, "%s\n%s\n%s\n", di->Model ? di->Model : "",
+			di->SerialNumber, di->DeviceVersion ? di->DeviceVersion : "");
+	for_each (uint32_t*, psid, params->storageids) {
+		PTPStorageInfo	si;
+
+		if (len >= size)
+			break;
+		if (ptp_getstorageinfo (params, *psid, &si) != PTP_RC_OK)
+			return GP_ERROR;
+		len += snprintf (key + len, size - len, "%08x %llu %llu %s\n", *psid,
+				 (unsigned long long)si.MaxCapability, (unsigned long long)si.FreeSpaceInBytes,
+				 si.VolumeLabel ? si.VolumeLabel : "");
+		free (si.StorageDescription);
+		free (si.VolumeLabel);
+	}
+	if (len >= size)
+		return GP_ERROR_FIXED_LIMIT_EXCEEDED;
+	return GP_OK;
+}
+
+static void
+put32 (FILE *f, uint32_t val)
+{
+	fwrite (&val, sizeof(val), 1, f);
+}
+
+static void
+put64 (FILE *f, uint64_t val)
+{
+	fwrite (&val, sizeof(val), 1, f);
+}
+
+static void
+putstr (FILE *f, const char *str)
+{
+	put32 (f, str ? strlen (str) : 0xffffffff);
+	if (str)
+		fwrite (str, strlen (str), 1, f);
+}
+
+static int
+get32 (FILE *f, uint32_t *val)
+{
+	return fread (val, sizeof(*val), 1, f) == 1;
+}
+
+static int
+get64 (FILE *f, uint64_t *val)
+{
+	return fread (val, sizeof(*val), 1, f) == 1;
+}
+
+static int
+getstr (FILE *f, char **str)
+{
+	uint32_t	len;
+
+	*str = NULL;
+	if (!get32 (f, &len))
+		return 0;
+	if (len == 0xffffffff)
+		return 1;
+	if (len > 65535)
+		return 0;
+	*str = malloc (len + 1);
+	if (!*str)
+		return 0;
+	if (len && (fread (*str, len, 1, f) != 1))
+		return 0;
+	(*str)[len] = '\0';
+	return 1;
+}
+
+static void
+put_object (FILE *f, PTPObject *ob)
+{
+	PTPObjectInfo	*oi = &ob->oi;
+
+	put32 (f, ob->oid);
+	put32 (f, ob->flags & OBJECTCACHE_FLAGS);
+	put32 (f, ob->canon_flags);
+	put32 (f, oi->StorageID);
+	put32 (f, oi->ObjectFormat);
+	put32 (f, oi->ProtectionStatus);
+	put64 (f, oi->ObjectSize);
+	put32 (f, oi->ThumbFormat);
+	put32 (f, oi->ThumbSize);
+	put32 (f, oi->ThumbPixWidth);
+	put32 (f, oi->ThumbPixHeight);
+	put32 (f, oi->ImagePixWidth);
+	put32 (f, oi->ImagePixHeight);
+	put32 (f, oi->ImageBitDepth);
+	put32 (f, oi->ParentObject);
+	put32 (f, oi->AssociationType);
+	put32 (f, oi->AssociationDesc);
+	put32 (f, oi->SequenceNumber);
+	put64 (f, oi->CaptureDate);
+	put64 (f, oi->ModificationDate);
+	putstr (f, oi->Filename);
+	putstr (f, oi->Keywords);
+}
+
+static int
+get_object (FILE *f, PTPObject *ob)
+{
+	PTPObjectInfo	*oi = &ob->oi;
+	uint32_t	v[17];
+	uint64_t	size, captured, modified;
+
+	for (int i = 0; i < 6; i++)
+		if (!get32 (f, &v[i]))
+			return 0;
+	if (!get64 (f, &size))
+		return 0;
+	for (int i = 6; i < 17; i++)
+		if (!get32 (f, &v[i]))
+			return 0;
+	if (!get64 (f, &captured) || !get64 (f, &modified))
+		return 0;
+
+	ob->oid			= v[0];
+	ob->flags		= v[1] & OBJECTCACHE_FLAGS;
+	ob->canon_flags		= v[2];
+	oi->Handle		= ob->oid;
+	oi->StorageID		= v[3];
+	oi->ObjectFormat	= v[4];
+	oi->ProtectionStatus	= v[5];
+	oi->ObjectSize		= size;
+	oi->ThumbFormat		= v[6];
+	oi->ThumbSize		= v[7];
+	oi->ThumbPixWidth	= v[8];
+	oi->ThumbPixHeight	= v[9];
+	oi->ImagePixWidth	= v[10];
+	oi->ImagePixHeight	= v[11];
+	oi->ImageBitDepth	= v[12];
+	oi->ParentObject	= v[13];
+	oi->AssociationType	= v[14];
+	oi->AssociationDesc	= v[15];
+	oi->SequenceNumber	= v[16];
+	oi->CaptureDate		= captured;
+	oi->ModificationDate	= modified;
+	return getstr (f, &oi->Filename) && getstr (f, &oi->Keywords);
+}
+
+/* Takes over the object cache saved for this camera, if it still matches.
+ * Must be called before anything was added to the object cache. */
+int
+ptp_objectcache_load (PTPParams *params)
+{
+	char		path[OBJECTCACHE_PATH_MAX], key[4096], *oldkey = NULL, magic[8];
+	PTPObjects	objects = {0};
+	uint32_t	version, byteorder, count;
+	FILE		*f;
+	int		ok;
+
+	CR (objectcache_path (params, path, sizeof(path)));
+	f = fopen (path, "rb");
+	if (!f) {
+		GP_LOG_D ("no object cache '%s'", path);
+		return GP_OK;
+	}
+	ok =	(fread (magic, sizeof(magic), 1, f) == 1) && !memcmp (magic, OBJECTCACHE_MAGIC, sizeof(magic)) &&
+		get32 (f, &version) && (version == OBJECTCACHE_VERSION) &&
+		get32 (f, &byteorder) && (byteorder == OBJECTCACHE_BYTEORDER) &&
+		getstr (f, &oldkey) && oldkey &&
+		(objectcache_key (params, key, sizeof(key)) == GP_OK) && !strcmp (oldkey, key);
+	if (!ok)
+		GP_LOG_D ("object cache '%s' does not match the camera, rebuilding it", path);
+	if (ok && get32 (f, &count) && (count < 0x1000000)) {
+		objects.val = calloc (count ? count : 1, sizeof(PTPObject));
+		objects.cap = count;
+		ok = objects.val != NULL;
+		while (ok && (objects.len < count)) {
+			PTPObject *ob = &objects.val[objects.len++];
+
+			/* sorted by handle, as the object cache itself */
+			ok = get_object (f, ob) && ob->oid &&
+			     ((objects.len == 1) || (ob[-1].oid < ob->oid));
+		}
+		if (!ok)
+			GP_LOG_E ("object cache '%s' is damaged, rebuilding it", path);
+	} else
+		ok = 0;
+	fclose (f);
+	free (oldkey);
+	/* from now on the in memory copy is the only valid one */
+	unlink (path);
+
+	if (!ok || params->objects.len) {
+		free_array_recusive (&objects, ptp_free_object);
+		return GP_OK;
+	}
+	params->objects = objects;
+	if (ptp_objecttree_rebuild (params) != PTP_RC_OK) {
+		ptp_free_objects (params);
+		return GP_ERROR_NO_MEMORY;
+	}
+	GP_LOG_D ("object cache '%s': took over %u objects", path, objects.len);
+	return GP_OK;
+}
+
+/* Writes the object cache back for the next session */
+int
+ptp_objectcache_save (PTPParams *params)
+{
+	char	path[OBJECTCACHE_PATH_MAX], tmppath[OBJECTCACHE_PATH_MAX + 4], key[4096];
+	FILE	*f;
+	int	ok;
+
+	CR (objectcache_path (params, path, sizeof(path)));
+	CR (objectcache_key (params, key, sizeof(key)));
+	snprintf (tmppath, sizeof(tmppath), "%s.new", path);
+	f = fopen (tmppath, "wb");
+	if (!f) {
+		GP_LOG_E ("could not create object cache '%s'", tmppath);
+		return GP_ERROR;
+	}
+	fwrite (OBJECTCACHE_MAGIC, 8, 1, f);
+	put32 (f, OBJECTCACHE_VERSION);
+	put32 (f, OBJECTCACHE_BYTEORDER);
+	putstr (f, key);
+	put32 (f, params->objects.len);
+	if (params->objects_unsorted)
+		ptp_objects_sort (params);
+	for_each (PTPObject*, ob, params->objects)
+		put_object (f, ob);
+	ok = !ferror (f);
+	ok = !fclose (f) && ok;
+	if (ok) {
+		unlink (path);
+		ok = !rename (tmppath, path);
+	}
+	if (!ok) {
+		GP_LOG_E ("could not write object cache '%s'", path);
+		unlink (tmppath);
+		return GP_ERROR;
+	}
+	GP_LOG_D ("object cache '%s': saved %u objects", path, params->objects.len);
+	return GP_OK;
+}
@@ -360,6 +360,7 @@ ptp_unpack_ArrayU32 (PTPParams *params, const uint8_t* data, unsigned int data_s
 {
 	uint32_t offset = 0;
 	ptp_unpack_uint32_t_array(params, data, &offset, data_size, &array->val, &array->len);
+	array->cap = array->len;
 }
 
 /* StorageInfo pack/unpack */
@@ -1817,10 +1818,7 @@ ptp_pack_EOS_CustomFuncEx (PTPParams* params, unsigned char* data, char* str)
 static inline PTPDevicePropDesc*
 ptp_find_eos_devicepropdesc(PTPParams *params, uint32_t dpc)
 {
-	for_each (PTPDevicePropDesc*, pdpd, params->canon_props)
-		if (pdpd->DevicePropCode == dpc)
-			return pdpd;
-	return NULL;
+	return ptp_propindex_find (&params->canon_props_index, &params->canon_props, dpc);
 }
 
 /* this helper is required, since array_push_back contains a "return GP_ERROR_NO_MEMEORY" statement */
@@ -2031,6 +2029,7 @@ ptp_unpack_EOS_events (PTPParams *params, const unsigned char* data, unsigned in
 			ptp_debug (params, "%s prop %04x options changed, type %d, count %2d (%s) %s",
 			           prefix, dpc, dpd_type, dpd_count, ptp_get_property_description (params, dpc),
 			           dpd ? "" : "(unknown)");
+			ptp_dpd_cache_invalidate (params, dpc);
 			/* 1 - uint16 ?
 			 * 3 - uint16
 			 * 7 - string?
@@ -2107,6 +2106,9 @@ ptp_unpack_EOS_events (PTPParams *params, const unsigned char* data, unsigned in
 
 			PTPDevicePropDesc *dpd = _lookup_or_allocate_canon_prop(params, dpc);
 
+			/* the copy in the generic property cache is outdated now */
+			ptp_dpd_cache_invalidate (params, dpc);
+
 			e[i].type = PTP_EOSEvent_PropertyChanged;
 			e[i].u.propid = dpc;
 
@@ -2692,6 +2694,7 @@ static unsigned int olcsizes[0x15][13] = {
 	}
 	events->val = e;
 	events->len = i;
+	events->cap = i;
 	return i;
 	#undef INDENT
 }
@@ -2862,6 +2865,7 @@ ptp_unpack_canon_directory (
 	for (i=0;i<cnt;i++)
 		if (ISOBJECT(dir+i*0x4c)) nrofobs++;
 	handles->len = nrofobs;
+	handles->cap = nrofobs;
 	handles->val = calloc(nrofobs,sizeof(handles->val[0]));
 	if (!handles->val) return PTP_RC_GeneralError;
 	*oinfos = calloc(nrofobs,sizeof((*oinfos)[0]));
@@ -33,12 +33,14 @@ int camera_get_config_list (Camera *camera, CameraList *list, GPContext *context
 int camera_get_single_config (Camera *camera, const char *confname, CameraWidget **window, GPContext *context);
 int camera_set_config (Camera *camera, CameraWidget *window, GPContext *context);
 int camera_set_single_config (Camera *camera, const char *confname, CameraWidget *window, GPContext *context);
+int camera_set_multi_config (Camera *camera, CameraList *values, GPContext *context);
 int camera_list_config (Camera *camera, CameraList *list, GPContext *context);
 int camera_prepare_capture (Camera *camera, GPContext *context);
 int camera_unprepare_capture (Camera *camera, GPContext *context);
 int camera_canon_eos_update_capture_target(Camera *camera, GPContext *context, int value);
 int have_prop(Camera *camera, uint16_t vendor, uint32_t prop);
 int camera_lookup_by_property(Camera *camera, PTPDevicePropDesc *dpd, char **name, char **content, GPContext *context);
+void camera_free_config_index (Camera *camera);
 int camera_keep_device_on(Camera *camera);
 
 /* library.c */
@@ -50,6 +52,10 @@ int chdk_init(Camera*,GPContext*);
 uint16_t ptp_init_camerafile_handler (PTPDataHandler *handler, CameraFile *file);
 uint16_t ptp_exit_camerafile_handler (PTPDataHandler *handler);
 
+/* objectcache.c */
+int ptp_objectcache_load (PTPParams *params);
+int ptp_objectcache_save (PTPParams *params);
+
 
 
 inline static int log_on_ptp_error_helper( int _r, const char* _func, const char* file, int line, const char* func, int vendor ) {
@@ -136,15 +142,10 @@ is_canon_eos_m(PTPParams *params) {
 
 static inline int
 have_eos_prop(PTPParams *params, uint16_t vendor, uint16_t prop) {
-	unsigned int i;
-
 	/* The special Canon EOS property set gets special treatment. */
 	if ((params->deviceinfo.VendorExtensionID != PTP_VENDOR_CANON) || (vendor != PTP_VENDOR_CANON))
 		return 0;
-	for (i=0;i<params->canon_props.len;i++)
-		if (params->canon_props.val[i].DevicePropCode == prop)
-			return 1;
-	return 0;
+	return ptp_propindex_find (&params->canon_props_index, &params->canon_props, prop) != NULL;
 }
 
 static inline int
@@ -174,9 +175,14 @@ time_since (const struct timeval start) {
 	return ((curtime.tv_sec - start.tv_sec)*1000)+((curtime.tv_usec - start.tv_usec)/1000);
 }
 
+typedef struct _PTPConfigIndex PTPConfigIndex;
+
 struct _CameraPrivateLibrary {
 	PTPParams params;
 	int checkevents;
+	PTPConfigIndex *configindex;	/* see config.c */
+	int lazyconfig;
+	int configbatch;	/* inside camera_set_multi_config() */
 };
 
 struct _PTPData {
@@ -323,23 +323,54 @@ memory_getfunc(PTPParams* params, void* private,
 	return PTP_RC_OK;
 }
 
+/* Makes room for len more bytes. The first allocation is exact (USB asks
+ * for the whole object at once), later ones grow geometrically, as
+ * transports like PTP/IP hand over the data packet by packet. */
+static uint16_t
+memory_grow(PTPMemHandlerPrivate *priv, unsigned long len)
+{
+	unsigned long	newsize = priv->curoff + len;
+	unsigned char	*newdata;
+
+	if (newsize <= priv->size)
+		return PTP_RC_OK;
+	if (priv->size && (newsize < 2 * priv->size))
+		newsize = 2 * priv->size;
+	newdata = realloc (priv->data, newsize);
+	if (!newdata)
+		return PTP_RC_GeneralError;
+	priv->data = newdata;
+	priv->size = newsize;
+	return PTP_RC_OK;
+}
+
 static uint16_t
 memory_putfunc(PTPParams* params, void* private,
 	       unsigned long sendlen, unsigned char *data
 ) {
 	PTPMemHandlerPrivate* priv = (PTPMemHandlerPrivate*)private;
 
-	if (priv->curoff + sendlen > priv->size) {
-		priv->data = realloc (priv->data, priv->curoff+sendlen);
-		if (!priv->data)
-			return PTP_RC_GeneralError;
-		priv->size = priv->curoff + sendlen;
-	}
-	memcpy (priv->data + priv->curoff, data, sendlen);
+	if (memory_grow (priv, sendlen) != PTP_RC_OK)
+		return PTP_RC_GeneralError;
+	/* data received into memory_getbuffer() memory is already in place */
+	if (data != priv->data + priv->curoff)
+		memmove (priv->data + priv->curoff, data, sendlen);
 	priv->curoff += sendlen;
 	return PTP_RC_OK;
 }
 
+static uint16_t
+memory_getbuffer(PTPParams* params, void* private,
+	       unsigned long wantlen, unsigned char **data
+) {
+	PTPMemHandlerPrivate* priv = (PTPMemHandlerPrivate*)private;
+
+	if (memory_grow (priv, wantlen) != PTP_RC_OK)
+		return PTP_RC_GeneralError;
+	*data = priv->data + priv->curoff;
+	return PTP_RC_OK;
+}
+
 /* init private struct for receiving data. */
 static uint16_t
 ptp_init_recv_memory_handler(PTPDataHandler *handler)
@@ -351,6 +382,7 @@ ptp_init_recv_memory_handler(PTPDataHandler *handler)
 	handler->priv = priv;
 	handler->getfunc = memory_getfunc;
 	handler->putfunc = memory_putfunc;
+	handler->getbuffer = memory_getbuffer;
 	priv->data = NULL;
 	priv->size = 0;
 	priv->curoff = 0;
@@ -371,6 +403,7 @@ ptp_init_send_memory_handler(PTPDataHandler *handler,
 	handler->priv = priv;
 	handler->getfunc = memory_getfunc;
 	handler->putfunc = memory_putfunc;
+	handler->getbuffer = NULL;
 	priv->data = data;
 	priv->size = len;
 	priv->curoff = 0;
@@ -393,8 +426,15 @@ ptp_exit_recv_memory_handler (PTPDataHandler *handler,
 	unsigned char **data, unsigned long *size
 ) {
 	PTPMemHandlerPrivate* priv = (PTPMemHandlerPrivate*)handler->priv;
+	/* give back what memory_grow() reserved beyond the data */
+	if (priv->data && priv->curoff && (priv->curoff < priv->size)) {
+		unsigned char *newdata = realloc (priv->data, priv->curoff);
+
+		if (newdata)
+			priv->data = newdata;
+	}
 	*data = priv->data;
-	*size = priv->size;
+	*size = priv->curoff;
 	free (priv);
 	return PTP_RC_OK;
 }
@@ -443,6 +483,7 @@ ptp_init_fd_handler(PTPDataHandler *handler, int fd)
 	handler->priv = priv;
 	handler->getfunc = fd_getfunc;
 	handler->putfunc = fd_putfunc;
+	handler->getbuffer = NULL;
 	priv->fd = fd;
 	return PTP_RC_OK;
 }
@@ -539,6 +580,8 @@ ptp_getdeviceinfo (PTPParams* params, PTPDeviceInfo* deviceinfo)
 	CHECK_PTP_RC(ptp_transaction(params, &ptp, PTP_DP_GETDATA, 0, &data, &size));
 	ret = ptp_unpack_DI(params, data, deviceinfo, size) ? PTP_RC_OK : PTP_ERROR_IO;
 	free(data);
+	if (deviceinfo == &params->deviceinfo)
+		ptp_deviceinfo_changed (params);
 	return ret;
 }
 
@@ -2088,11 +2131,14 @@ ptp_free_params (PTPParams *params)
 	free (params->wifi_profiles);
 	free_array (&params->storageids);
 	free_array (&params->events);
+	free_array (&params->pump_events);
 
-	free_array_recusive (&params->objects, ptp_free_object);
+	ptp_free_objects (params);
 	free_array_recusive (&params->canon_props, ptp_free_devicepropdesc);
+	ptp_free_propindex (&params->canon_props_index);
 	free_array_recusive (&params->eos_events, ptp_free_eos_event);
 	free_array_recusive (&params->dpd_cache, ptp_free_devicepropdesc);
+	ptp_free_propindex (&params->dpd_cache_index);
 
 	ptp_free_deviceinfo (&params->deviceinfo);
 }
@@ -2180,8 +2226,7 @@ ptp_getobjecthandles (PTPParams* params, uint32_t storage,
 	unsigned char	*data = NULL;
 	unsigned int	size;
 
-	objecthandles->val = NULL;
-	objecthandles->len = 0;
+	array_init(objecthandles);
 
 	PTP_CNT_INIT(ptp, PTP_OC_GetObjectHandles, storage, objectformatcode, associationOH);
 	ret=ptp_transaction(params, &ptp, PTP_DP_GETDATA, 0, &data, &size);
@@ -3231,50 +3276,179 @@ ptp_add_event (PTPParams *params, PTPContainer *event)
 	return PTP_RC_OK;
 }
 
+/* Parent -> children index over params->objects.
+ *
+ * Every cached object is listed below its current oi.ParentObject (0 for the
+ * root and for objects whose ObjectInfo is not loaded yet), so any change of
+ * ParentObject has to go through ptp_object_set_parent() or be followed by
+ * ptp_objecttree_move(). */
+static int _cmp_children (const void *a, const void *b)
+{
+	const PTPObjectChildren *ca = a;
+	const PTPObjectChildren *cb = b;
+
+	if (ca->parent > cb->parent) return 1;
+	if (ca->parent < cb->parent) return -1;
+	return 0;
+}
+
+/* First position in the sorted VAL[0..LEN-1] holding a value >= X */
+static unsigned int
+_u32_lower_bound (const uint32_t *val, unsigned int len, uint32_t x)
+{
+	unsigned int	begin = 0, end = len;
+
+	while (begin < end) {
+		unsigned int cursor = begin + (end - begin) / 2;
+
+		if (val[cursor] < x)
+			begin = cursor + 1;
+		else
+			end = cursor;
+	}
+	return begin;
+}
+
+PTPObjectChildren*
+ptp_find_object_children (PTPParams *params, uint32_t parent)
+{
+	PTPObjectChildren	tmp;
+
+	tmp.parent = parent;
+	return bsearch (&tmp, params->objecttree.val, params->objecttree.len, sizeof(tmp), _cmp_children);
+}
+
+static void
+ptp_free_object_children (PTPObjectChildren *oc)
+{
+	free_array (&oc->children);
+}
+
+static uint16_t
+ptp_objecttree_add (PTPParams *params, uint32_t parent, uint32_t handle)
+{
+	PTPObjectChildren	*oc = ptp_find_object_children (params, parent);
+	unsigned int		pos;
+
+	if (!oc) {
+		pos = 0;
+		while (pos < params->objecttree.len && params->objecttree.val[pos].parent < parent)
+			pos++;
+		array_extend_capacity (&params->objecttree, 1);
+		if (pos < params->objecttree.len)
+			memmove (&params->objecttree.val[pos+1], &params->objecttree.val[pos], (params->objecttree.len-pos)*sizeof(PTPObjectChildren));
+		oc = &params->objecttree.val[pos];
+		memset (oc, 0, sizeof(*oc));
+		oc->parent = parent;
+		params->objecttree.len++;
+	}
+
+	/* handles mostly come in ascending order, so appending is the common case */
+	if (!oc->children.len || oc->children.val[oc->children.len-1] < handle) {
+		array_push_back (&oc->children, handle);
+		return PTP_RC_OK;
+	}
+	pos = _u32_lower_bound (oc->children.val, oc->children.len, handle);
+	if (oc->children.val[pos] == handle)
+		return PTP_RC_OK;
+	array_extend_capacity (&oc->children, 1);
+	memmove (&oc->children.val[pos+1], &oc->children.val[pos], (oc->children.len-pos)*sizeof(uint32_t));
+	oc->children.val[pos] = handle;
+	oc->children.len++;
+	return PTP_RC_OK;
+}
+
+static void
+ptp_objecttree_remove (PTPParams *params, uint32_t parent, uint32_t handle)
+{
+	PTPObjectChildren	*oc = ptp_find_object_children (params, parent);
+	unsigned int		pos;
+
+	if (!oc)
+		return;
+	pos = _u32_lower_bound (oc->children.val, oc->children.len, handle);
+	if (pos == oc->children.len || oc->children.val[pos] != handle)
+		return;
+	array_remove (&oc->children, &oc->children.val[pos]);
+	if (!oc->children.len) {
+		ptp_free_object_children (oc);
+		array_remove (&params->objecttree, oc);
+	}
+}
+
+static uint16_t
+ptp_objecttree_move (PTPParams *params, uint32_t handle, uint32_t from, uint32_t to)
+{
+	if (from == to)
+		return PTP_RC_OK;
+	ptp_objecttree_remove (params, from, handle);
+	return ptp_objecttree_add (params, to, handle);
+}
+
+uint16_t
+ptp_object_set_parent (PTPParams *params, PTPObject *ob, uint32_t parent)
+{
+	uint32_t	oldparent = ob->oi.ParentObject;
+
+	ob->oi.ParentObject = parent;
+	return ptp_objecttree_move (params, ob->oid, oldparent, parent);
+}
+
+void
+ptp_free_objects (PTPParams *params)
+{
+	free_array_recusive (&params->objects, ptp_free_object);
+	params->objects_unsorted = 0;
+	free_array_recusive (&params->objecttree, ptp_free_object_children);
+	params->prefetch_all_done = 0;
+}
+
+/* Rebuilds the parent -> children index after the objects array was
+ * filled directly, like from the persistent object cache. */
+uint16_t
+ptp_objecttree_rebuild (PTPParams *params)
+{
+	free_array_recusive (&params->objecttree, ptp_free_object_children);
+	for_each (PTPObject*, ob, params->objects)
+		CHECK_PTP_RC (ptp_objecttree_add (params, ob->oi.ParentObject, ob->oid));
+	return PTP_RC_OK;
+}
+
 /* CANON EOS fast directory mode: uses ptp_canon_eos_getobjectinfoex to get list of
  * ObjectInfos instead of just a list of handles that have to be queried then one by one.*/
 static uint16_t
 ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle, PTPObjectHandles *children) {
-	unsigned int	last = 0, changed = 0;
 	PTPCANONFolderEntry *tmp = NULL;
 	unsigned int	nroftmp = 0;
+	PTPObjectHandles	handles = {0}, newhandles = {0};
+	uint16_t	ret;
 
 	ptp_debug (params, "list_folder_eos(storage=0x%08x, handle=0x%08x)", storage, handle);
 	/* the following call currently always fails for the R5m2 for an unkown reason */
 	CHECK_PTP_RC (ptp_canon_eos_getobjectinfoex (
 		params, storage, handle ? handle : PTP_HANDLER_SPECIAL, 0x100000, &tmp, &nroftmp));
 
-	if (children)
-		array_extend_capacity(children, nroftmp);
+	array_reserve(&handles, nroftmp);
+	for (unsigned int i=0; i<nroftmp; i++)
+		handles.val[handles.len++] = tmp[i].ObjectHandle;
+	ret = ptp_insert_objects_in_cache (params, &handles, &newhandles);
+	if (ret != PTP_RC_OK)
+		goto out;
 
 	/* convert read entries into objectinfos */
 	for (unsigned int i=0; i<nroftmp; i++) {
-		PTPObject	*ob = NULL;
-		unsigned int	j;
-
-		if (children)
-			children->val[children->len++] = tmp[i].ObjectHandle;
+		PTPObject	*ob;
 
-		/* TODO: the following is actually slow when adding new entries, as the complete list needs to be traversed.
-			* Make better use of the fact that the list is sorted. */
-		for (j=0; j<params->objects.len; j++) {
-			if (params->objects.val[(last+j) % params->objects.len].oid == tmp[i].ObjectHandle)  {
-				ob = &params->objects.val[(last+j) % params->objects.len];
-				break;
-			}
-		}
-		if (ob == NULL) {
-			ptp_debug (params, "adding new object: handle 0x%08x (nrofobs=%d,j=%d)", tmp[i].ObjectHandle, params->objects.len, j);
-
-			array_push_back_empty (&params->objects, &ob);
-
-			ob->oid = tmp[i].ObjectHandle;
-			ob->oi.Handle = tmp[i].ObjectHandle;
-			ob->flags = 0;
+		if (ptp_find_object_in_cache (params, tmp[i].ObjectHandle, &ob) != PTP_RC_OK)
+			continue;
+		if (ptp_handles_contain (&newhandles, tmp[i].ObjectHandle)) {
+			ptp_debug (params, "adding new object: handle 0x%08x (nrofobs=%d)", tmp[i].ObjectHandle, params->objects.len);
 
 			ob->oi.StorageID = storage;
 			ob->flags |= PTPOBJECT_STORAGEID_LOADED;
-			ob->oi.ParentObject = handle == PTP_HANDLER_SPECIAL ? 0 : handle;
+			ret = ptp_object_set_parent (params, ob, handle == PTP_HANDLER_SPECIAL ? 0 : handle);
+			if (ret != PTP_RC_OK)
+				goto out;
 			ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
 			ob->oi.Filename = strdup(tmp[i].Filename);
 			ob->oi.ObjectFormat = tmp[i].ObjectFormatCode;
@@ -3291,14 +3465,12 @@ ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle, PTPOb
 			ob->flags |= PTPOBJECT_OBJECTINFO_LOADED;
 
 			/*log_objectinfo(params, &ob->oi);*/
-			last = params->objects.len;
-			changed = 1;
 		} else {
-			ptp_debug (params, "adding old object: handle 0x%08x (nrofobs=%d,j=%d)", tmp[i].ObjectHandle, params->objects.len, j);
-			/* for speeding up search */
-			last = (last+j) % params->objects.len;
+			ptp_debug (params, "adding old object: handle 0x%08x (nrofobs=%d)", tmp[i].ObjectHandle, params->objects.len);
 			if (handle != PTP_HANDLER_SPECIAL) {
-				ob->oi.ParentObject = handle;
+				ret = ptp_object_set_parent (params, ob, handle);
+				if (ret != PTP_RC_OK)
+					goto out;
 				ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
 			}
 			if (storage != PTP_HANDLER_SPECIAL) {
@@ -3307,20 +3479,24 @@ ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle, PTPOb
 			}
 		}
 	}
+out:
 	free (tmp);
-
-	if (changed)
-		ptp_objects_sort (params);
-
-	return PTP_RC_OK;
+	free_array (&newhandles);
+	if (children && ret == PTP_RC_OK)
+		*children = handles;
+	else
+		free_array (&handles);
+	return ret;
 }
 
+static unsigned int ptp_object_prefetch_bulk (PTPParams *params, uint32_t parent);
+
 uint16_t
 ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle, PTPObjectHandles *children) {
-	unsigned int		changed, last;
 	uint16_t		ret;
 	uint32_t		xhandle = handle;
-	PTPObjectHandles	handles = {0};
+	PTPObjectHandles	handles = {0}, newhandles = {0};
+	unsigned int		missing = 0;
 
 	ptp_debug (params, "ptp_list_folder(storage=0x%08x, handle=0x%08x)", storage, handle);
 
@@ -3335,9 +3511,16 @@ ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle, PTPObject
 	 * subsequent calls asking for the root folder will simply return the cached list. This only works since we
 	 * assume the entries in the root folder can never change. */
 	if (!handle && children && params->objects.len != 0) {
-		for_each (PTPObject*, pob, params->objects)
-			if (pob->oi.ParentObject == 0 && pob->oi.StorageID == storage)
-				array_push_back(children, pob->oid);
+		PTPObjectChildren	*oc = ptp_find_object_children (params, 0);
+
+		if (oc) {
+			for_each (uint32_t*, pchild, oc->children) {
+				PTPObject	*ob;
+
+				if (ptp_find_object_in_cache (params, *pchild, &ob) == PTP_RC_OK && ob->oi.StorageID == storage)
+					array_push_back(children, *pchild);
+			}
+		}
 		return PTP_RC_OK;
 	}
 
@@ -3351,9 +3534,10 @@ ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle, PTPObject
 			return PTP_RC_GeneralError;
 		if (ob->flags & PTPOBJECT_DIRECTORY_LOADED) {
 			if (children) {
-				for_each (PTPObject*, pob, params->objects)
-					if (pob->oi.ParentObject == handle)
-						array_push_back(children, pob->oid);
+				PTPObjectChildren	*oc = ptp_find_object_children (params, handle);
+
+				if (oc)
+					array_append_copy(children, &oc->children);
 			}
 			return PTP_RC_OK;
 		}
@@ -3446,38 +3630,27 @@ fallback:
 	}
 	if (ret != PTP_RC_OK)
 		return ret;
-	last = changed = 0;
+	ret = ptp_insert_objects_in_cache (params, &handles, &newhandles);
+	if (ret != PTP_RC_OK)
+		goto out;
 	for_each (uint32_t*, phandle, handles) {
-		PTPObject	*ob = NULL;
-		unsigned int	j;
-
-		/* TODO: the following actually slow when adding new entries, as the complete list needs to be traversed.
-		 * Make better use of the fact that the list is sorted. */
-		for (j=0;j<params->objects.len;j++) {
-			if (params->objects.val[(last+j) % params->objects.len].oid == *phandle)  {
-				ob = &params->objects.val[(last+j) % params->objects.len];
-				break;
-			}
-		}
-		if (ob == NULL) {
-			ptp_debug (params, "adding new object: handle 0x%08x (nrofobs=%d,j=%d)", *phandle, params->objects.len, j);
+		PTPObject	*ob;
 
-			array_push_back_empty (&params->objects, &ob);
+		if (ptp_find_object_in_cache (params, *phandle, &ob) != PTP_RC_OK)
+			continue;
+		if (ptp_handles_contain (&newhandles, *phandle)) {
+			ptp_debug (params, "adding new object: handle 0x%08x (nrofobs=%d)", *phandle, params->objects.len);
 
-			ob->oid = *phandle;
-			ob->oi.Handle = *phandle;
-			ob->flags = 0;
 			/* root directory list files might return all files, so avoid tagging it */
 			/* except on Apple, as they have parentobject of 0x1, see https://github.com/gphoto/libgphoto2/issues/1258  */
 			if (	((handle != PTP_HANDLER_SPECIAL) && handle) ||
 				(params->deviceinfo.Manufacturer && !strcmp (params->deviceinfo.Manufacturer, "Apple Inc."))
 			) {
 				ptp_debug (params, "  parent 0x%08x", handle);
-				if (*phandle == handle) { /* EOS bug where handle == parent(handle) */
-					ob->oi.ParentObject = 0;
-				} else {
-					ob->oi.ParentObject = handle;
-				}
+				/* EOS bug where handle == parent(handle) */
+				ret = ptp_object_set_parent (params, ob, (*phandle == handle) ? 0 : handle);
+				if (ret != PTP_RC_OK)
+					goto out;
 				ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
 			}
 			if (storage != PTP_HANDLER_SPECIAL) {
@@ -3485,13 +3658,12 @@ fallback:
 				ob->oi.StorageID = storage;
 				ob->flags |= PTPOBJECT_STORAGEID_LOADED;
 			}
-			changed = 1;
 		} else {
-			ptp_debug (params, "adding old object: handle 0x%08x (nrofobs=%d,j=%d)", *phandle, params->objects.len, j);
-			/* for speeding up search */
-			last = (last+j) % params->objects.len;
+			ptp_debug (params, "adding old object: handle 0x%08x (nrofobs=%d)", *phandle, params->objects.len);
 			if (handle != PTP_HANDLER_SPECIAL) {
-				ob->oi.ParentObject = handle;
+				ret = ptp_object_set_parent (params, ob, handle);
+				if (ret != PTP_RC_OK)
+					goto out;
 				ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
 			}
 			if (storage != PTP_HANDLER_SPECIAL) {
@@ -3499,14 +3671,19 @@ fallback:
 				ob->flags |= PTPOBJECT_STORAGEID_LOADED;
 			}
 		}
-	}
-	if (changed)
-		ptp_objects_sort (params);
-	if (children)
+		if (!(ob->flags & PTPOBJECT_OBJECTINFO_LOADED))
+			missing++;
+	}
+	/* one GetObjPropList instead of a GetObjectInfo for each of them later */
+	if ((handle != PTP_HANDLER_SPECIAL) && (missing > 1))
+		ptp_object_prefetch_bulk (params, handle);
+out:
+	free_array (&newhandles);
+	if (children && ret == PTP_RC_OK)
 		*children = handles;
 	else
 		free_array (&handles);
-	return PTP_RC_OK;
+	return ret;
 }
 
 
@@ -3515,13 +3692,17 @@ handle_event_internal (PTPParams *params, PTPContainer *event)
 {
 	/* handle some PTP stack internal events */
 	switch (event->Code) {
-	case PTP_EC_DevicePropChanged: {
+	case PTP_EC_DevicePropChanged:
 		/* mark the property for a forced refresh on the next query */
-		PTPDevicePropDesc* dpd_in_cache = ptp_find_dpd_in_cache(params, event->Param1);
-		if (dpd_in_cache)
-			dpd_in_cache->timestamp = 0;
+		if (event->Param1)
+			ptp_dpd_cache_invalidate (params, event->Param1);
+		break;
+	case PTP_EC_Sony_DevicePropChanged:
+		/* not every body names the property, and one
+		 * GetAllExtDevicePropInfo refetches them all anyway */
+		if (params->deviceinfo.VendorExtensionID == PTP_VENDOR_SONY)
+			ptp_dpd_cache_invalidate (params, 0);
 		break;
-	}
 	case PTP_EC_StoreAdded:
 	case PTP_EC_StoreRemoved: {
 		/* FIXME: if we just remove 1 out of many storages, we do not need to invalidate/reload the entire tree? */
@@ -3532,7 +3713,7 @@ handle_event_internal (PTPParams *params, PTPContainer *event)
 
 		/* free object storage as it might be associated with the storage ids */
 		/* FIXME: enhance and just delete the ones from the storage */
-		free_array_recusive (&params->objects, ptp_free_object);
+		ptp_free_objects (params);
 
 		params->storagechanged		= 1;
 		break;
@@ -3542,12 +3723,37 @@ handle_event_internal (PTPParams *params, PTPContainer *event)
 	}
 }
 
+/* Takes over the events the event pump of the core read meanwhile */
+static unsigned int
+ptp_take_pump_events (PTPParams *params)
+{
+	PTPEvents	events;
+	unsigned int	count;
+
+	pthread_mutex_lock (&params->pump_mutex);
+	events = params->pump_events;
+	memset (&params->pump_events, 0, sizeof(params->pump_events));
+	pthread_mutex_unlock (&params->pump_mutex);
+
+	for_each (PTPContainer*, pevt, events) {
+		ptp_debug (params, "event (pump): nparams=0x%X, code=0x%X, trans_id=0x%X, p1=0x%X, p2=0x%X, p3=0x%X",
+		           pevt->Nparam, pevt->Code, pevt->Transaction_ID, pevt->Param1, pevt->Param2, pevt->Param3);
+		ptp_add_event (params, pevt);
+		handle_event_internal (params, pevt);
+	}
+	count = events.len;
+	free_array (&events);
+	return count;
+}
+
 uint16_t
 ptp_check_event_queue (PTPParams *params)
 {
 	PTPContainer	event;
 	uint16_t	ret;
 
+	ptp_take_pump_events (params);
+
 	/* We try to do a event check without I/O */
 	/* Basically this means just looking at the meanwhile queued events */
 
@@ -3570,6 +3776,8 @@ ptp_check_event (PTPParams *params)
 	PTPContainer	event;
 	uint16_t	ret;
 
+	ptp_take_pump_events (params);
+
 	if (params->deviceinfo.VendorExtensionID == PTP_VENDOR_NIKON) {
 		PTPEvents events = {0};
 		if (ptp_operation_issupported(params, PTP_OC_NIKON_GetEventEx)) {
@@ -3649,6 +3857,10 @@ ptp_wait_event (PTPParams *params)
 	PTPContainer	event;
 	uint16_t	ret;
 
+	/* no need to wait then */
+	if (ptp_take_pump_events (params))
+		return PTP_RC_OK;
+
 	ret = params->event_wait(params,&event);
 	if (ret == PTP_RC_OK) {
 		ptp_debug (params, "event: nparams=0x%X, code=0x%X, trans_id=0x%X, p1=0x%X, p2=0x%X, p3=0x%X", event.Nparam,event.Code,event.Transaction_ID, event.Param1, event.Param2, event.Param3);
@@ -3694,15 +3906,193 @@ ptp_get_one_event_by_type(PTPParams *params, uint16_t code, PTPContainer *event)
 	return 0;
 }
 
+static uint32_t
+ptp_propindex_hash (uint32_t dpc)
+{
+	dpc ^= dpc >> 16;
+	dpc *= 0x9e3779b1;
+	return dpc ^ (dpc >> 15);
+}
+
+static void
+ptp_propindex_insert (PTPPropIndex *index, PTPDevicePropDescs *dpds, uint32_t pos)
+{
+	uint32_t	dpc = dpds->val[pos].DevicePropCode;
+	uint32_t	mask = index->size - 1;
+	uint32_t	i;
+
+	for (i = ptp_propindex_hash (dpc) & mask; index->slots[i]; i = (i + 1) & mask)
+		if (dpds->val[index->slots[i] - 1].DevicePropCode == dpc)
+			return; /* the first entry of a code wins, as in a linear search */
+	index->slots[i] = pos + 1;
+}
+
+/* Indexes the entries appended to dpds since the last call, growing the
+ * table to keep it at most half full. */
+static int
+ptp_propindex_update (PTPPropIndex *index, PTPDevicePropDescs *dpds)
+{
+	uint32_t	pos = index->len;
+
+	if (dpds->len < index->len)	/* array was freed and started over */
+		pos = 0;
+	if (2 * dpds->len >= index->size) {
+		uint32_t size = index->size ? index->size : 64;
+		uint32_t *slots;
+
+		while (2 * dpds->len >= size)
+			size *= 2;
+		slots = calloc (size, sizeof(slots[0]));
+		if (!slots)
+			return 0;
+		free (index->slots);
+		index->slots = slots;
+		index->size = size;
+		pos = 0;
+	} else if (!pos)
+		memset (index->slots, 0, index->size * sizeof(index->slots[0]));
+	for (; pos < dpds->len; pos++)
+		ptp_propindex_insert (index, dpds, pos);
+	index->len = dpds->len;
+	return 1;
+}
+
 PTPDevicePropDesc*
-ptp_find_dpd_in_cache(PTPParams *params, uint32_t dpc)
+ptp_propindex_find (PTPPropIndex *index, PTPDevicePropDescs *dpds, uint32_t dpc)
 {
-	for_each (PTPDevicePropDesc*, pdpd, params->dpd_cache)
-		if (pdpd->DevicePropCode == dpc)
-			return pdpd;
+	uint32_t	mask, i;
+
+	if (!dpds->len)
+		return NULL;
+	if ((index->len != dpds->len) && !ptp_propindex_update (index, dpds)) {
+		/* out of memory, do it the slow way */
+		for_each (PTPDevicePropDesc*, pdpd, *dpds)
+			if (pdpd->DevicePropCode == dpc)
+				return pdpd;
+		return NULL;
+	}
+	mask = index->size - 1;
+	for (i = ptp_propindex_hash (dpc) & mask; index->slots[i]; i = (i + 1) & mask)
+		if (dpds->val[index->slots[i] - 1].DevicePropCode == dpc)
+			return &dpds->val[index->slots[i] - 1];
 	return NULL;
 }
 
+void
+ptp_free_propindex (PTPPropIndex *index)
+{
+	free (index->slots);
+	memset (index, 0, sizeof(*index));
+}
+
+PTPDevicePropDesc*
+ptp_find_dpd_in_cache(PTPParams *params, uint32_t dpc)
+{
+	return ptp_propindex_find (&params->dpd_cache_index, &params->dpd_cache, dpc);
+}
+
+static uint16_t
+ptp_dpd_cache_add (PTPParams *params, uint32_t dpc, PTPDevicePropDesc **dpd)
+{
+	array_push_back_empty (&params->dpd_cache, dpd);
+	(*dpd)->DevicePropCode = dpc;
+	return PTP_RC_OK;
+}
+
+/**
+ * ptp_dpd_cache_mode:
+ *
+ * Tells how the device keeps us informed about property changes, and so
+ * how long a cached property descriptor can be used.
+ *
+ * params:	PTPParams*
+ *
+ * Return values: One of PTP_DPD_CACHE_*.
+ */
+int
+ptp_dpd_cache_mode (PTPParams *params)
+{
+	uint16_t vendor = params->deviceinfo.VendorExtensionID;
+
+	if (params->dpd_cache_timer)
+		return PTP_DPD_CACHE_TIMER;
+	/* EOS: the descriptors are copied from canon_props, which follow the
+	 * PropValueChanged events of ptp_canon_eos_getevent() */
+	if ((vendor == PTP_VENDOR_CANON) && ptp_operation_issupported (params, PTP_OC_CANON_EOS_GetEvent))
+		return PTP_DPD_CACHE_EVENTS;
+	/* events come as the reply of a vendor command, see ptp_check_event() */
+	if (	((vendor == PTP_VENDOR_NIKON) &&
+		 (ptp_operation_issupported (params, PTP_OC_NIKON_GetEvent) ||
+		  ptp_operation_issupported (params, PTP_OC_NIKON_GetEventEx))) ||
+		((vendor == PTP_VENDOR_CANON) && ptp_operation_issupported (params, PTP_OC_CANON_CheckEvent))
+	)
+		return PTP_DPD_CACHE_POLL;
+	/* Fuji reports changes through a property which has to be polled itself */
+	if (vendor == PTP_VENDOR_FUJI)
+		return PTP_DPD_CACHE_TIMER;
+	if (!params->event_check_queue)
+		return PTP_DPD_CACHE_TIMER;
+	/* devices only listing the events might not send them (reliably),
+	 * so the change events just expire descriptors early */
+	if (	ptp_event_issupported (params, PTP_EC_DevicePropChanged) ||
+		((vendor == PTP_VENDOR_SONY) && ptp_event_issupported (params, PTP_EC_Sony_DevicePropChanged))
+	)
+		return PTP_DPD_CACHE_EVENTS_TIMER;
+	return PTP_DPD_CACHE_TIMER;
+}
+
+/* Marks one cached property, or all of them for dpc 0, for a refetch */
+void
+ptp_dpd_cache_invalidate (PTPParams *params, uint32_t dpc)
+{
+	PTPDevicePropDesc *dpd;
+
+	if (!dpc) {
+		for_each (PTPDevicePropDesc*, pdpd, params->dpd_cache)
+			pdpd->timestamp = 0;
+		return;
+	}
+	dpd = ptp_find_dpd_in_cache (params, dpc);
+	if (dpd)
+		dpd->timestamp = 0;
+}
+
+/* Whether a cached property descriptor is still current */
+static int
+ptp_dpd_cache_fresh (PTPParams *params, PTPDevicePropDesc *dpd, time_t now)
+{
+	PTPContainer	event;
+	unsigned int	i;
+	int		mode;
+
+	switch (mode = ptp_dpd_cache_mode (params)) {
+	case PTP_DPD_CACHE_EVENTS:
+	case PTP_DPD_CACHE_EVENTS_TIMER:
+		/* take in the change events which arrived meanwhile, without I/O */
+		for (i = 0; i < 64; i++) {
+			if (params->event_check_queue && (params->event_check_queue (params, &event) != PTP_RC_OK))
+				break;
+			ptp_debug (params, "event: nparams=0x%X, code=0x%X, trans_id=0x%X, p1=0x%X, p2=0x%X, p3=0x%X",
+			           event.Nparam, event.Code, event.Transaction_ID, event.Param1, event.Param2, event.Param3);
+			ptp_add_event (params, &event);
+			handle_event_internal (params, &event);
+		}
+		if (mode == PTP_DPD_CACHE_EVENTS_TIMER)
+			return dpd->timestamp && (dpd->timestamp + params->cachetime > now);
+		return dpd->timestamp != 0;
+	case PTP_DPD_CACHE_POLL:
+		/* a change would have been reported by the last poll */
+		if (params->dpd_cache_polled + params->cachetime <= now) {
+			params->dpd_cache_polled = now;
+			if (ptp_check_event (params) != PTP_RC_OK)
+				return 0;
+		}
+		return dpd->timestamp != 0;
+	default:
+		return dpd->timestamp + params->cachetime > now;
+	}
+}
+
 /**
  * ptp_canon_eos_getevent:
  *
@@ -3984,6 +4374,7 @@ ptp_canon_eos_setdevicepropvalue (PTPParams* params,
 	free (data);
 	if (ret == PTP_RC_OK) {
 		/* commit to cache only after successful setting */
+		ptp_dpd_cache_invalidate (params, propcode);
 		switch (propcode) {
 		case PTP_DPC_CANON_EOS_ImageFormat:
 		case PTP_DPC_CANON_EOS_ImageFormatCF:
@@ -4671,18 +5062,13 @@ ptp_generic_getdevicepropdesc (PTPParams *params, uint32_t propcode, PTPDevicePr
 
 	PTPDevicePropDesc* dpd_in_cache = ptp_find_dpd_in_cache(params, propcode);
 
-	if (!dpd_in_cache) {
-		array_push_back_empty(&params->dpd_cache, &dpd_in_cache);
-	}
-
-	if (dpd_in_cache->DataType != PTP_DTC_UNDEF) {
-		if (dpd_in_cache->timestamp + params->cachetime > now) {
+	if (dpd_in_cache && (dpd_in_cache->DataType != PTP_DTC_UNDEF)) {
+		if (ptp_dpd_cache_fresh (params, dpd_in_cache, now)) {
 			duplicate_DevicePropDesc(dpd_in_cache, dpd);
 			return PTP_RC_OK;
 		}
-		/* free cached entry as we will refetch it. */
+		/* free cached entry as we will refetch it, the slot is reused. */
 		ptp_free_devicepropdesc (dpd_in_cache);
-		dpd_in_cache = NULL;
 	}
 
 	/* Sony is handled directly here, also for "normal" properties */
@@ -4692,7 +5078,7 @@ ptp_generic_getdevicepropdesc (PTPParams *params, uint32_t propcode, PTPDevicePr
 		CHECK_PTP_RC(ptp_sony_getalldevicepropdesc (params));
 
 		dpd_in_cache = ptp_find_dpd_in_cache(params, propcode);
-		if (!dpd_in_cache) {
+		if (!dpd_in_cache || (dpd_in_cache->DataType == PTP_DTC_UNDEF)) {
 			if (params->sony_mode_ver==3) {
 				// Sony's GetAllExtDevicePropInfo API doesn't return some properties in mode 3.
 				// These are referred to as 'Controls' in the Sony documentation, if the Control is
@@ -4701,8 +5087,8 @@ ptp_generic_getdevicepropdesc (PTPParams *params, uint32_t propcode, PTPDevicePr
 				// values or even compound values.
 				for (i=0;i<ARRAYSIZE(sony_mode3_controls);i++) {
 					if (sony_mode3_controls[i].ControlCode == propcode) {
-						array_push_back_empty(&params->dpd_cache, &dpd_in_cache);
-						dpd_in_cache->DevicePropCode = propcode;
+						if (!dpd_in_cache)
+							CHECK_PTP_RC(ptp_dpd_cache_add (params, propcode, &dpd_in_cache));
 						dpd_in_cache->DataType = sony_mode3_controls[i].Datatype;
 						// Not so much get / but for sure set!
 						dpd_in_cache->GetSet = PTP_DPGS_GetSet;
@@ -4738,7 +5124,7 @@ ptp_generic_getdevicepropdesc (PTPParams *params, uint32_t propcode, PTPDevicePr
 		CHECK_PTP_RC(ptp_sony_getdevicepropdesc (params, propcode, &tmpdpd));
 
 		if (!dpd_in_cache)
-			array_push_back_empty(&params->dpd_cache, &dpd_in_cache);
+			CHECK_PTP_RC(ptp_dpd_cache_add (params, propcode, &dpd_in_cache));
 		else
 			ptp_free_devicepropdesc (dpd_in_cache);
 		move(*dpd_in_cache, tmpdpd);
@@ -4759,9 +5145,8 @@ ptp_generic_getdevicepropdesc (PTPParams *params, uint32_t propcode, PTPDevicePr
 			else
 				goto generic;
 		}
-		if (!dpd_in_cache) {
-			array_push_back_empty(&params->dpd_cache, &dpd_in_cache);
-		}
+		if (!dpd_in_cache)
+			CHECK_PTP_RC(ptp_dpd_cache_add (params, propcode, &dpd_in_cache));
 		duplicate_DevicePropDesc(eos_dpd, dpd_in_cache);
 		goto done;
 	}
@@ -4772,7 +5157,7 @@ generic:
 
 		CHECK_PTP_RC(ptp_getdevicepropdesc (params, propcode, &tmpdpd));
 		if (!dpd_in_cache)
-			array_push_back_empty(&params->dpd_cache, &dpd_in_cache);
+			CHECK_PTP_RC(ptp_dpd_cache_add (params, propcode, &dpd_in_cache));
 		else
 			ptp_free_devicepropdesc (dpd_in_cache);
 		move(*dpd_in_cache, tmpdpd);
@@ -4805,9 +5190,7 @@ ptp_generic_setdevicepropvalue (PTPParams* params, uint32_t propcode,
 	PTPPropValue *value, uint16_t datatype)
 {
 	/* reset the cache entry */
-	PTPDevicePropDesc *dpd_in_cache = ptp_find_dpd_in_cache(params, propcode);
-	if (dpd_in_cache)
-		dpd_in_cache->timestamp = 0;
+	ptp_dpd_cache_invalidate (params, propcode);
 
 	/* FIXME: change the cache? hmm */
 	/* this works for some methods, but not for all */
@@ -4910,6 +5293,15 @@ ptp_nikon_get_liveview_image (PTPParams* params, unsigned char **data, unsigned
 	return ptp_transaction(params, &ptp, PTP_DP_GETDATA, 0, data, size);
 }
 
+uint16_t
+ptp_nikon_get_liveview_image_handler (PTPParams* params, PTPDataHandler *handler)
+{
+	PTPContainer ptp;
+
+	PTP_CNT_INIT(ptp, PTP_OC_NIKON_GetLiveViewImg);
+	return ptp_transaction_new(params, &ptp, PTP_DP_GETDATA, 0, handler);
+}
+
 /**
  * ptp_nikon_get_preview_image:
  *
@@ -5448,7 +5840,10 @@ ptp_mtp_getobjectproplist (PTPParams* params, uint32_t handle, MTPObjectProp **p
 uint16_t
 ptp_mtp_getobjectproplist_single (PTPParams* params, uint32_t handle, MTPObjectProps *props)
 {
-	return ptp_mtp_getobjectproplist_level(params, handle, 0, &props->val, (int*)&props->len);
+	uint16_t ret = ptp_mtp_getobjectproplist_level(params, handle, 0, &props->val, (int*)&props->len);
+
+	props->cap = props->len;
+	return ret;
 }
 
 uint16_t
@@ -5884,9 +6279,7 @@ ptp_fuji_getevents (PTPParams* params, uint16_t** events, uint16_t* count)
 				ptp_debug(params, "param: %02x, value: %d ", param, value);
 
 				/* reset the property cache entry for refetch ... */
-				PTPDevicePropDesc *dpd_in_cache = ptp_find_dpd_in_cache(params, param);
-				if (dpd_in_cache)
-					dpd_in_cache->timestamp = 0;
+				ptp_dpd_cache_invalidate (params, param);
 			}
 		}
 	}
@@ -5898,28 +6291,24 @@ ptp_fuji_getevents (PTPParams* params, uint16_t** events, uint16_t* count)
 /* Non PTP protocol functions */
 /* devinfo testing functions */
 
-int
-ptp_event_issupported(PTPParams* params, uint16_t event)
+void
+ptp_codeset_build (PTPCodeSet *set, const uint16_t *codes, uint32_t codes_len)
 {
-	unsigned int i=0;
-
-	for (;i<params->deviceinfo.Events_len;i++) {
-		if (params->deviceinfo.Events[i]==event)
-			return 1;
-	}
-	return 0;
+	memset (set->bits, 0, sizeof(set->bits));
+	for (uint32_t i = 0; i < codes_len; i++)
+		set->bits[codes[i] >> 5] |= 1U << (codes[i] & 31);
+	set->codes	= codes;
+	set->codes_len	= codes_len;
+	set->valid	= 1;
 }
 
-
-int
-ptp_property_issupported(PTPParams* params, uint16_t property)
+/* The DeviceInfo lists were changed in place, rebuild the bitsets on next use */
+void
+ptp_deviceinfo_changed (PTPParams *params)
 {
-	unsigned int i;
-
-	for (i=0;i<params->deviceinfo.DeviceProps_len;i++)
-		if (params->deviceinfo.DeviceProps[i]==property)
-			return 1;
-	return 0;
+	params->operations_set.valid	= 0;
+	params->events_set.valid	= 0;
+	params->deviceprops_set.valid	= 0;
 }
 
 void
@@ -9879,7 +10268,10 @@ ptp_remove_object_from_cache(PTPParams *params, uint32_t handle)
 	PTPObject	*ob;
 
 	CHECK_PTP_RC(ptp_find_object_in_cache (params, handle, &ob));
+	ptp_objecttree_remove (params, ob->oi.ParentObject, handle);
 	ptp_free_object (ob);
+	if (ob >= params->objects.val + params->objects.len - params->objects_unsorted)
+		params->objects_unsorted--;
 	array_remove(&params->objects, ob);
 
 	return PTP_RC_OK;
@@ -9902,81 +10294,239 @@ void
 ptp_objects_sort (PTPParams *params)
 {
 	qsort (params->objects.val, params->objects.len, sizeof(PTPObject), _cmp_ob);
+	params->objects_unsorted = 0;
+}
+
+/* Merges the objects appended out of order by ptp_find_or_insert_object_in_cache
+ * into the sorted part, from the back, moving every object at most once. */
+static void
+ptp_objects_merge (PTPParams *params)
+{
+	unsigned int	n = params->objects_unsorted;
+	unsigned int	i = params->objects.len - n, j = n, k = params->objects.len;
+	PTPObject	*tail;
+
+	if (!n)
+		return;
+	tail = malloc (n * sizeof(PTPObject));
+	if (!tail) {
+		ptp_objects_sort (params);
+		return;
+	}
+	memcpy (tail, &params->objects.val[i], n * sizeof(PTPObject));
+	qsort (tail, n, sizeof(PTPObject), _cmp_ob);
+	while (j > 0) {
+		if (i > 0 && params->objects.val[i-1].oid > tail[j-1].oid)
+			params->objects.val[--k] = params->objects.val[--i];
+		else
+			params->objects.val[--k] = tail[--j];
+	}
+	free (tail);
+	params->objects_unsorted = 0;
 }
 
-/* Binary search in objects. Needs "objects" to be a sorted by oid!  */
+/* Binary search in the sorted objects, then a look at the few not merged in yet. */
 uint16_t
 ptp_find_object_in_cache (PTPParams *params, uint32_t handle, PTPObject **retob)
 {
+	unsigned int	sorted = params->objects.len - params->objects_unsorted;
 	PTPObject	tmpob;
 
 	tmpob.oid = handle;
-	*retob = bsearch (&tmpob, params->objects.val, params->objects.len, sizeof(tmpob), _cmp_ob);
-	if (!*retob)
-		return PTP_RC_GeneralError;
-	return PTP_RC_OK;
+	*retob = bsearch (&tmpob, params->objects.val, sorted, sizeof(tmpob), _cmp_ob);
+	if (*retob)
+		return PTP_RC_OK;
+	for (unsigned int i = sorted; i < params->objects.len; i++) {
+		if (params->objects.val[i].oid == handle) {
+			*retob = &params->objects.val[i];
+			return PTP_RC_OK;
+		}
+	}
+	return PTP_RC_GeneralError;
 }
 
-/* Binary search in objects + insert if not found. Needs "objects" to be a sorted by oid!  */
+/* Search in objects + insert if not found.
+ *
+ * Inserting in place would move the tail of the objects array each time, so
+ * filling the cache in random order would be quadratic. Instead new objects are
+ * appended and merged in once there are about sqrt(n) of them, keeping the
+ * linear part of the lookup short. Pointers into objects are only good until
+ * the next insert, as before. */
 uint16_t
 ptp_find_or_insert_object_in_cache (PTPParams *params, uint32_t handle, PTPObject **retob)
 {
-	unsigned int 	begin, end, cursor;
-	unsigned int	insertat;
+	unsigned int	unsorted = params->objects_unsorted;
 
 	if (!handle) return PTP_RC_GeneralError;
+	if (ptp_find_object_in_cache (params, handle, retob) == PTP_RC_OK)
+		return PTP_RC_OK;
 	*retob = NULL;
-	if (!params->objects.len) {
-		array_push_back_empty (&params->objects, retob);
-		(*retob)->oid = handle;
-		(*retob)->oi.Handle = handle;
+	if ((unsorted >= 16) && (unsorted * unsorted >= params->objects.len)) {
+		ptp_objects_merge (params);
+		unsorted = 0;
+	}
+	/* appending behind the largest handle keeps the array sorted */
+	if (unsorted || (params->objects.len && (handle < params->objects.val[params->objects.len-1].oid)))
+		unsorted++;
+	array_push_back_empty (&params->objects, retob);
+	(*retob)->oid = handle;
+	(*retob)->oi.Handle = handle;
+	params->objects_unsorted = unsorted;
+	return ptp_objecttree_add (params, 0, handle);
+}
+
+static int _cmp_u32 (const void *a, const void *b)
+{
+	uint32_t ua = *(const uint32_t*)a;
+	uint32_t ub = *(const uint32_t*)b;
+
+	if (ua > ub) return 1;
+	if (ua < ub) return -1;
+	return 0;
+}
+
+/* Binary search in a sorted handle list, like the one returned by ptp_insert_objects_in_cache. */
+int
+ptp_handles_contain (const PTPObjectHandles *handles, uint32_t handle)
+{
+	return bsearch (&handle, handles->val, handles->len, sizeof(uint32_t), _cmp_u32) != NULL;
+}
+
+/* Make sure all HANDLES (e.g. a ptp_getobjecthandles result) are in the object cache.
+ *
+ * Instead of inserting one by one (moving the tail of the sorted objects array each time),
+ * the missing handles are collected and sorted, the objects array is grown once and both
+ * sorted sequences are merged from the back. The handles that got added are returned
+ * sorted in NEWHANDLES. Objects added out of order one by one are merged in first. */
+uint16_t
+ptp_insert_objects_in_cache (PTPParams *params, const PTPObjectHandles *handles, PTPObjectHandles *newhandles)
+{
+	PTPObjectHandles	missing = {0};
+	unsigned int		i, j, k;
+
+	array_init (newhandles);
+	if (!handles->len)
 		return PTP_RC_OK;
+	ptp_objects_merge (params);
+
+	array_reserve (&missing, handles->len);
+	for_each (uint32_t*, phandle, *handles) {
+		PTPObject	*ob;
+
+		if (*phandle && ptp_find_object_in_cache (params, *phandle, &ob) != PTP_RC_OK)
+			missing.val[missing.len++] = *phandle;
 	}
-	begin = 0;
-	end = params->objects.len-1;
-	/*ptp_debug (params, "searching %08x, total=%d", handle, params->objects.len);*/
-	while (1) {
-		cursor = (end-begin)/2+begin;
-		/*ptp_debug (params, "ob %d: %08x [%d-%d]", cursor, params->objects[cursor].oid, begin, end);*/
-		if (params->objects.val[cursor].oid == handle) {
-			*retob = &params->objects.val[cursor];
-			return PTP_RC_OK;
+	if (!missing.len) {
+		free_array (&missing);
+		return PTP_RC_OK;
+	}
+
+	/* usually already ascending, otherwise sort and drop duplicates */
+	for (i = 1; i < missing.len && missing.val[i-1] < missing.val[i]; i++)
+		;
+	if (i < missing.len) {
+		qsort (missing.val, missing.len, sizeof(uint32_t), _cmp_u32);
+		for (i = j = 1; i < missing.len; i++)
+			if (missing.val[i] != missing.val[j-1])
+				missing.val[j++] = missing.val[i];
+		missing.len = j;
+	}
+
+	if (params->objects.len + missing.len > params->objects.cap) {
+		/* cannot use array_reserve here, as it would leak missing on failure */
+		uint32_t	cap = params->objects.len + missing.len;
+		PTPObject	*val;
+
+		if (cap < 2 * params->objects.len)
+			cap = 2 * params->objects.len;
+		val = realloc (params->objects.val, cap * sizeof(PTPObject));
+		if (!val) {
+			free_array (&missing);
+			return PTP_RC_GeneralError;
 		}
-		if (params->objects.val[cursor].oid < handle)
-			begin = cursor;
-		else
-			end = cursor;
-		if ((end - begin) <= 1)
-			break;
+		params->objects.val = val;
+		params->objects.cap = cap;
 	}
-	if (params->objects.val[begin].oid == handle) {
-		*retob = &params->objects.val[begin];
-		return PTP_RC_OK;
+
+	i = params->objects.len;	/* cached objects not yet moved */
+	j = missing.len;		/* new handles not yet placed */
+	k = i + j;			/* next slot to fill, from the back */
+	while (j > 0) {
+		if (i > 0 && params->objects.val[i-1].oid > missing.val[j-1]) {
+			params->objects.val[--k] = params->objects.val[--i];
+		} else {
+			PTPObject *ob = &params->objects.val[--k];
+
+			memset (ob, 0, sizeof(*ob));
+			ob->oid = missing.val[--j];
+			ob->oi.Handle = ob->oid;
+		}
 	}
-	if (params->objects.val[end].oid == handle) {
-		*retob = &params->objects.val[end];
-		return PTP_RC_OK;
+	params->objects.len += missing.len;
+
+	for_each (uint32_t*, phandle, missing) {
+		uint16_t ret = ptp_objecttree_add (params, 0, *phandle);
+		if (ret != PTP_RC_OK) {
+			free_array (&missing);
+			return ret;
+		}
 	}
-	if ((begin == 0) && (handle < params->objects.val[0].oid)) {
-		insertat=begin;
-	} else {
-		if ((end == params->objects.len-1) && (handle > params->objects.val[end].oid))
-			insertat=end+1;
-		else
-			insertat=begin+1;
-	}
-	/*ptp_debug (params, "inserting oid %x at [%x,%x], begin=%d, end=%d, insertat=%d\n", handle, params->objects[begin].oid, params->objects[end].oid, begin, end, insertat);*/
-	array_extend_capacity (&params->objects, 1);
-	if (insertat < params->objects.len)
-		memmove (&params->objects.val[insertat+1], &params->objects.val[insertat], (params->objects.len-insertat)*sizeof(PTPObject));
-	*retob = &params->objects.val[insertat];
-	memset(*retob, 0, sizeof(PTPObject));
-	(*retob)->oid = handle;
-	(*retob)->oi.Handle = handle;
-	params->objects.len++;
+
+	*newhandles = missing;
 	return PTP_RC_OK;
 }
 
+/* Override an ObjectInfo field with the value of an MTP object property */
+static void
+ptp_objectinfo_set_mtp_prop (PTPObjectInfo *oi, const MTPObjectProp *prop)
+{
+	switch (prop->PropCode) {
+	case PTP_OPC_StorageID:
+		oi->StorageID = prop->Value.u32;
+		break;
+	case PTP_OPC_ObjectFormat:
+		oi->ObjectFormat = prop->Value.u16;
+		break;
+	case PTP_OPC_ProtectionStatus:
+		oi->ProtectionStatus = prop->Value.u16;
+		break;
+	case PTP_OPC_ObjectSize:
+		if (prop->DataType == PTP_DTC_UINT64) {
+			oi->ObjectSize = prop->Value.u64;
+		} else if (prop->DataType == PTP_DTC_UINT32) {
+			oi->ObjectSize = prop->Value.u32;
+		}
+		break;
+	case PTP_OPC_AssociationType:
+		oi->AssociationType = prop->Value.u16;
+		break;
+	case PTP_OPC_AssociationDesc:
+		oi->AssociationDesc = prop->Value.u32;
+		break;
+	case PTP_OPC_ObjectFileName:
+		if (prop->Value.str) {
+			free(oi->Filename);
+			oi->Filename = strdup(prop->Value.str);
+		}
+		break;
+	case PTP_OPC_DateCreated:
+		oi->CaptureDate = ptp_unpack_PTPTIME(prop->Value.str);
+		break;
+	case PTP_OPC_DateModified:
+		oi->ModificationDate = ptp_unpack_PTPTIME(prop->Value.str);
+		break;
+	case PTP_OPC_Keywords:
+		if (prop->Value.str) {
+			free(oi->Keywords);
+			oi->Keywords = strdup(prop->Value.str);
+		}
+		break;
+	case PTP_OPC_ParentObject:
+		oi->ParentObject = prop->Value.u32;
+		break;
+	}
+}
+
 uint16_t
 ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObject **retob)
 {
@@ -10001,6 +10551,7 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 #define X (PTPOBJECT_OBJECTINFO_LOADED|PTPOBJECT_STORAGEID_LOADED|PTPOBJECT_PARENTOBJECT_LOADED)
 	if ((want & X) && ((ob->flags & X) != X)) {
 		uint32_t	saveparent = 0;
+		uint32_t	oldparent = ob->oi.ParentObject;
 
 		/* One EOS issue, where getobjecthandles(root) returns obs without root flag. */
 		if (ob->flags & PTPOBJECT_PARENTOBJECT_LOADED)
@@ -10009,6 +10560,7 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 		ret = ptp_getobjectinfo (params, handle, &ob->oi);
 		if (ret != PTP_RC_OK) {
 			/* kill it from the internal list ... */
+			ob->oi.ParentObject = oldparent;
 			ptp_remove_object_from_cache(params, handle);
 			return ret;
 		}
@@ -10068,6 +10620,7 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 		}
 
 		ob->flags |= X;
+		CHECK_PTP_RC(ptp_objecttree_move (params, handle, oldparent, ob->oi.ParentObject));
 	}
 #undef X
 
@@ -10086,58 +10639,15 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 
 		/* Override the ObjectInfo data with data from properties */
 		if ((ob->flags & PTPOBJECT_MTPPROPLIST_LOADED) && (params->device_flags & DEVICE_FLAG_PROPLIST_OVERRIDES_OI)) {
+			uint32_t	oldparent = ob->oi.ParentObject;
 
 			for_each (MTPObjectProp*, prop, ob->mtp_props) {
 				/* in case we got all subtree objects.
 				 * FIXME: we explicitly requested props for a single object, so this seems outdated. */
 				if (prop->ObjectHandle != handle) continue;
-
-				switch (prop->PropCode) {
-				case PTP_OPC_StorageID:
-					ob->oi.StorageID = prop->Value.u32;
-					break;
-				case PTP_OPC_ObjectFormat:
-					ob->oi.ObjectFormat = prop->Value.u16;
-					break;
-				case PTP_OPC_ProtectionStatus:
-					ob->oi.ProtectionStatus = prop->Value.u16;
-					break;
-				case PTP_OPC_ObjectSize:
-					if (prop->DataType == PTP_DTC_UINT64) {
-						ob->oi.ObjectSize = prop->Value.u64;
-					} else if (prop->DataType == PTP_DTC_UINT32) {
-						ob->oi.ObjectSize = prop->Value.u32;
-					}
-					break;
-				case PTP_OPC_AssociationType:
-					ob->oi.AssociationType = prop->Value.u16;
-					break;
-				case PTP_OPC_AssociationDesc:
-					ob->oi.AssociationDesc = prop->Value.u32;
-					break;
-				case PTP_OPC_ObjectFileName:
-					if (prop->Value.str) {
-						free(ob->oi.Filename);
-						ob->oi.Filename = strdup(prop->Value.str);
-					}
-					break;
-				case PTP_OPC_DateCreated:
-					ob->oi.CaptureDate = ptp_unpack_PTPTIME(prop->Value.str);
-					break;
-				case PTP_OPC_DateModified:
-					ob->oi.ModificationDate = ptp_unpack_PTPTIME(prop->Value.str);
-					break;
-				case PTP_OPC_Keywords:
-					if (prop->Value.str) {
-						free(ob->oi.Keywords);
-						ob->oi.Keywords = strdup(prop->Value.str);
-					}
-					break;
-				case PTP_OPC_ParentObject:
-					ob->oi.ParentObject = prop->Value.u32;
-					break;
-				}
+				ptp_objectinfo_set_mtp_prop (&ob->oi, prop);
 			}
+			CHECK_PTP_RC(ptp_objecttree_move (params, handle, oldparent, ob->oi.ParentObject));
 		}
 	}
 
@@ -10157,6 +10667,272 @@ ptp_add_object_to_cache(PTPParams *params, uint32_t handle)
 	return ptp_object_want (params, handle, PTPOBJECT_OBJECTINFO_LOADED|PTPOBJECT_MTPPROPLIST_LOADED, &ob);
 }
 
+static int
+_cmp_prop_handle (const void *a, const void *b)
+{
+	const MTPObjectProp *pa = a, *pb = b;
+
+	return (pa->ObjectHandle > pb->ObjectHandle) - (pa->ObjectHandle < pb->ObjectHandle);
+}
+
+/* which of the props of one object an ObjectInfo needs */
+#define MTPPROP_SEEN_FILENAME	0x001
+#define MTPPROP_SEEN_FORMAT	0x002
+#define MTPPROP_SEEN_SIZE	0x004
+#define MTPPROP_SEEN_STORAGE	0x008
+#define MTPPROP_SEEN_PARENT	0x010
+#define MTPPROP_SEEN_THUMBFORMAT 0x020
+#define MTPPROP_SEEN_THUMBSIZE	0x040
+#define MTPPROP_SEEN_THUMBWIDTH	0x080
+#define MTPPROP_SEEN_THUMBHEIGHT 0x100
+#define MTPPROP_SEEN_WIDTH	0x200
+#define MTPPROP_SEEN_HEIGHT	0x400
+#define MTPPROP_SEEN_OI		(MTPPROP_SEEN_FILENAME|MTPPROP_SEEN_FORMAT|MTPPROP_SEEN_SIZE)
+#define MTPPROP_SEEN_LOCATION	(MTPPROP_SEEN_STORAGE|MTPPROP_SEEN_PARENT)
+#define MTPPROP_SEEN_IMAGE	(MTPPROP_SEEN_THUMBFORMAT|MTPPROP_SEEN_THUMBSIZE|MTPPROP_SEEN_THUMBWIDTH|\
+				 MTPPROP_SEEN_THUMBHEIGHT|MTPPROP_SEEN_WIDTH|MTPPROP_SEEN_HEIGHT)
+
+static unsigned int
+ptp_mtp_props_seen (const MTPObjectProp *props, int nrofprops)
+{
+	unsigned int	seen = 0;
+
+	for (int i = 0; i < nrofprops; i++) {
+		switch (props[i].PropCode) {
+		case PTP_OPC_ObjectFileName:	seen |= MTPPROP_SEEN_FILENAME; break;
+		case PTP_OPC_ObjectFormat:	seen |= MTPPROP_SEEN_FORMAT; break;
+		case PTP_OPC_ObjectSize:	seen |= MTPPROP_SEEN_SIZE; break;
+		case PTP_OPC_StorageID:		seen |= MTPPROP_SEEN_STORAGE; break;
+		case PTP_OPC_ParentObject:	seen |= MTPPROP_SEEN_PARENT; break;
+		case PTP_OPC_RepresentativeSampleFormat: seen |= MTPPROP_SEEN_THUMBFORMAT; break;
+		case PTP_OPC_RepresentativeSampleSize:	 seen |= MTPPROP_SEEN_THUMBSIZE; break;
+		case PTP_OPC_RepresentativeSampleWidth:	 seen |= MTPPROP_SEEN_THUMBWIDTH; break;
+		case PTP_OPC_RepresentativeSampleHeight: seen |= MTPPROP_SEEN_THUMBHEIGHT; break;
+		case PTP_OPC_Width:		seen |= MTPPROP_SEEN_WIDTH; break;
+		case PTP_OPC_Height:		seen |= MTPPROP_SEEN_HEIGHT; break;
+		}
+	}
+	return seen;
+}
+
+/* The image fields of an ObjectInfo, which only the props of a bulk
+ * listing are trusted with */
+static void
+ptp_objectinfo_set_mtp_image_prop (PTPObjectInfo *oi, const MTPObjectProp *prop)
+{
+	switch (prop->PropCode) {
+	case PTP_OPC_RepresentativeSampleFormat:
+		oi->ThumbFormat = prop->Value.u16;
+		break;
+	case PTP_OPC_RepresentativeSampleSize:
+		oi->ThumbSize = prop->Value.u32;
+		break;
+	case PTP_OPC_RepresentativeSampleWidth:
+		oi->ThumbPixWidth = prop->Value.u32;
+		break;
+	case PTP_OPC_RepresentativeSampleHeight:
+		oi->ThumbPixHeight = prop->Value.u32;
+		break;
+	case PTP_OPC_Width:
+		oi->ImagePixWidth = prop->Value.u32;
+		break;
+	case PTP_OPC_Height:
+		oi->ImagePixHeight = prop->Value.u32;
+		break;
+	}
+}
+
+/* Whether the props make up everything GetObjectInfo gives for the
+ * object, as far as it is used. They have no Canon object flags (from
+ * GetObjectInfoEx), images need their thumbnail and pixel sizes, and a
+ * 32 bit size of 0xffffffff means the real size has to be asked for.
+ * SequenceNumber and ImageBitDepth stay 0, nothing uses them. */
+static int
+ptp_mtp_props_complete (PTPParams *params, const PTPObjectInfo *oi, unsigned int seen)
+{
+	if ((params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+	    ptp_operation_issupported(params, PTP_OC_CANON_GetObjectInfoEx))
+		return 0;
+	if (oi->ObjectSize == 0xffffffffUL)
+		return 0;
+	if ((oi->ObjectFormat & 0x0800) && ((seen & MTPPROP_SEEN_IMAGE) != MTPPROP_SEEN_IMAGE))
+		return 0;
+	return 1;
+}
+
+/* Fills in the ObjectInfos of a GetObjPropList result. Only objects which
+ * have none yet and whose props are complete are touched, the others are
+ * left to GetObjectInfo. With insert unset these are the cached children
+ * of parent, otherwise (a listing of the whole device) objects not cached
+ * yet are added too, if their props say where they belong.
+ * Returns the number of ObjectInfos filled in. */
+static unsigned int
+ptp_objects_from_mtp_props (PTPParams *params, MTPObjectProp *props, int nrofprops, uint32_t parent, int insert)
+{
+	unsigned int	need = MTPPROP_SEEN_OI | (insert ? MTPPROP_SEEN_LOCATION : 0);
+	unsigned int	loaded = 0;
+	int		i, j;
+
+	qsort (props, nrofprops, sizeof(props[0]), _cmp_prop_handle);
+
+	if (insert) {
+		PTPObjectHandles	handles = {0}, newhandles = {0};
+		uint16_t		ret;
+
+		handles.val = malloc (nrofprops * sizeof(uint32_t));
+		if (!handles.val)
+			return 0;
+		handles.cap = nrofprops;
+		for (i = 0; i < nrofprops; i = j) {
+			for (j = i; (j < nrofprops) && (props[j].ObjectHandle == props[i].ObjectHandle); j++)
+				;
+			if ((ptp_mtp_props_seen (props + i, j - i) & need) == need)
+				handles.val[handles.len++] = props[i].ObjectHandle;
+		}
+		ret = ptp_insert_objects_in_cache (params, &handles, &newhandles);
+		free_array (&handles);
+		free_array (&newhandles);
+		if (ret != PTP_RC_OK)
+			return 0;
+	}
+
+	for (i = 0; i < nrofprops; i = j) {
+		PTPObject	*ob;
+		PTPObjectInfo	oi;
+		uint32_t	oldparent;
+		unsigned int	seen;
+
+		for (j = i; (j < nrofprops) && (props[j].ObjectHandle == props[i].ObjectHandle); j++)
+			;
+		if ((ptp_find_object_in_cache (params, props[i].ObjectHandle, &ob) != PTP_RC_OK) ||
+		    (ob->flags & PTPOBJECT_OBJECTINFO_LOADED) || (!insert && (ob->oi.ParentObject != parent)))
+			continue;
+		seen = ptp_mtp_props_seen (props + i, j - i);
+		if ((seen & need) != need)
+			continue;
+
+		memset (&oi, 0, sizeof(oi));
+		oi.Handle	= ob->oid;
+		oi.StorageID	= ob->oi.StorageID;
+		oi.ParentObject	= ob->oi.ParentObject;
+		for (int k = i; k < j; k++) {
+			ptp_objectinfo_set_mtp_prop (&oi, &props[k]);
+			ptp_objectinfo_set_mtp_image_prop (&oi, &props[k]);
+		}
+		if (!ptp_mtp_props_complete (params, &oi, seen)) {
+			ptp_free_objectinfo (&oi);
+			continue;
+		}
+		/* the same quirks ptp_object_want handles for GetObjectInfo */
+		if (!oi.Filename)
+			oi.Filename = strdup("<none>");
+		if (oi.ParentObject == ob->oid)
+			oi.ParentObject = 0;
+		if (oi.ParentObject && (oi.ParentObject == oi.StorageID)) {
+			PTPObject *parentob;
+
+			if (ptp_find_object_in_cache (params, oi.ParentObject, &parentob) != PTP_RC_OK)
+				oi.ParentObject = 0;
+		}
+
+		oldparent = ob->oi.ParentObject;
+		ptp_free_objectinfo (&ob->oi);
+		ob->oi = oi;
+		ob->flags |= PTPOBJECT_OBJECTINFO_LOADED|PTPOBJECT_PARENTOBJECT_LOADED;
+		if (insert || (seen & MTPPROP_SEEN_STORAGE) || (ob->flags & PTPOBJECT_STORAGEID_LOADED))
+			ob->flags |= PTPOBJECT_STORAGEID_LOADED;
+		if (ptp_objecttree_move (params, ob->oid, oldparent, ob->oi.ParentObject) != PTP_RC_OK)
+			break;
+		loaded++;
+	}
+	return loaded;
+}
+
+/* Loads ObjectInfos in bulk with GetObjPropList: those of the children of
+ * parent, or in PTP_PREFETCH_ALL mode once those of the whole device.
+ * The first request doubles as probe whether the device gets it right;
+ * if it fails or delivers nothing usable, GetObjPropList is not used for
+ * this again in the session. Returns the number of ObjectInfos loaded. */
+static unsigned int
+ptp_object_prefetch_bulk (PTPParams *params, uint32_t parent)
+{
+	MTPObjectProp	*props = NULL;
+	int		nrofprops = 0, all;
+	unsigned int	loaded = 0;
+	uint16_t	ret;
+
+	if (	(params->prefetch_mode == PTP_PREFETCH_OFF) || (params->prefetch_state < 0) ||
+		!ptp_operation_issupported(params, PTP_OC_MTP_GetObjPropList) ||
+		(params->device_flags & DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST)
+	)
+		return 0;
+
+	all = (params->prefetch_mode == PTP_PREFETCH_ALL) && !params->prefetch_all_done &&
+	      !(params->device_flags & DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST_ALL);
+	if (all) {
+		params->prefetch_all_done = 1;
+		ret = ptp_mtp_getobjectproplist (params, PTP_HANDLER_SPECIAL, &props, &nrofprops);
+	} else if (parent) {
+		ret = ptp_mtp_getobjectproplist_level (params, parent, 1, &props, &nrofprops);
+	} else {
+		/* the root has no handle of its own to ask for */
+		return 0;
+	}
+	if (ret == PTP_RC_OK)
+		loaded = ptp_objects_from_mtp_props (params, props, nrofprops, parent, all);
+	for (int i = 0; i < nrofprops; i++)
+		ptp_free_object_prop (&props[i]);
+	free (props);
+
+	if (loaded) {
+		params->prefetch_state = 1;
+		ptp_debug (params, "ptp2/prefetch: GetObjPropList of 0x%08x loaded %u ObjectInfos, %u round trips saved",
+			   all ? PTP_HANDLER_SPECIAL : parent, loaded, loaded - 1);
+	} else if (!params->prefetch_state) {
+		params->prefetch_state = -1;
+		ptp_debug (params, "ptp2/prefetch: GetObjPropList of 0x%08x %s, using GetObjectInfo from now on",
+			   all ? PTP_HANDLER_SPECIAL : parent, (ret == PTP_RC_OK) ? "had no usable ObjectInfo" : "failed");
+	}
+	return loaded;
+}
+
+/* Makes sure all cached children of parent have their ObjectInfo loaded.
+ * Where GetObjPropList works, all of them come with one request instead
+ * of a GetObjectInfo per object; whatever that does not cover is loaded
+ * the usual way. */
+uint16_t
+ptp_object_prefetch_children (PTPParams *params, uint32_t parent)
+{
+	PTPObjectChildren	*oc = ptp_find_object_children (params, parent);
+	PTPObjectHandles	children = {0};
+	unsigned int		missing = 0;
+
+	if (!oc)
+		return PTP_RC_OK;
+	/* loading objects may move them around in the tree */
+	array_append_copy (&children, &oc->children);
+	for_each (uint32_t*, pchild, children) {
+		PTPObject *ob;
+
+		if ((ptp_find_object_in_cache (params, *pchild, &ob) == PTP_RC_OK) &&
+		    !(ob->flags & PTPOBJECT_OBJECTINFO_LOADED))
+			missing++;
+	}
+
+	if (missing > 1)
+		ptp_object_prefetch_bulk (params, parent);
+	if (missing) {
+		for_each (uint32_t*, pchild, children) {
+			PTPObject *ob;
+
+			/* errors are fine, the object might have been deleted meanwhile */
+			ptp_object_want (params, *pchild, PTPOBJECT_OBJECTINFO_LOADED, &ob);
+		}
+	}
+	free_array (&children);
+	return PTP_RC_OK;
+}
+
 
 /*
  * Local Variables:
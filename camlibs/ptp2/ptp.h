@@ -27,6 +27,7 @@
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include <pthread.h>
 #if defined(HAVE_ICONV) && defined(HAVE_LANGINFO_H)
 #include <iconv.h>
 #endif
@@ -185,6 +186,14 @@ struct _PTPIPHeader {
 };
 typedef struct _PTPIPHeader PTPIPHeader;
 
+/* receive buffer of a PTP/IP socket, unconsumed data is data[start..end) */
+struct _PTPIPBuffer {
+	unsigned char	*data;
+	unsigned int	size;
+	unsigned int	start, end;
+};
+typedef struct _PTPIPBuffer PTPIPBuffer;
+
 /* Vendor IDs */
 /* List is linked from here: http://www.imaging.org/site/IST/Standards/PTP_Standards.aspx */
 #define PTP_VENDOR_EASTMAN_KODAK		0x00000001
@@ -4142,10 +4151,18 @@ typedef uint16_t (* PTPDataGetFunc)	(PTPParams* params, void*priv,
 typedef uint16_t (* PTPDataPutFunc)	(PTPParams* params, void*priv,
 					unsigned long sendlen,
 					unsigned char *data);
+
+/* Optional: returns memory to receive the next wantlen bytes in place.
+ * Data read there is passed to putfunc as usual, which then needs
+ * not copy it. */
+typedef uint16_t (* PTPDataBufferFunc)	(PTPParams* params, void*priv,
+					unsigned long wantlen,
+					unsigned char **data);
 typedef struct _PTPDataHandler {
 	PTPDataGetFunc		getfunc;
 	PTPDataPutFunc		putfunc;
 	void			*priv;
+	PTPDataBufferFunc	getbuffer;
 } PTPDataHandler;
 
 /*
@@ -4192,6 +4209,15 @@ struct _PTPObject {
 };
 typedef struct _PTPObject PTPObject;
 
+/* One entry of the parent -> children index over the object cache.
+ * Only handles are kept, as PTPObject entries move whenever the sorted
+ * objects array changes. */
+struct _PTPObjectChildren {
+	uint32_t	parent;
+	ArrayU32	children;	/* sorted by handle */
+};
+typedef struct _PTPObjectChildren PTPObjectChildren;
+
 struct _MTPPropertyDesc {
 	uint16_t	opc;
 	PTPObjectPropDesc	opd;
@@ -4223,10 +4249,41 @@ typedef struct _PanasonicLiveViewSize PanasonicLiveViewSize;
 #define PTP_DP_DATA_MASK        0x00ff  /* data phase mask */
 
 typedef ARRAY_OF(PTPObject) PTPObjects;
+typedef ARRAY_OF(PTPObjectChildren) PTPObjectTree;
 typedef ARRAY_OF(PTPContainer) PTPEvents;
 typedef ARRAY_OF(PTPCanonEOSEvent) PTPCanonEOSEvents;
 typedef ARRAY_OF(PTPDevicePropDesc) PTPDevicePropDescs;
 
+/* The codes of one DeviceInfo list (Operations, Events, DeviceProps) as a
+ * bitset over the whole 16 bit code space. It remembers which array it was
+ * built from and is rebuilt when that array was replaced or resized. */
+typedef struct _PTPCodeSet {
+	uint32_t	bits[0x10000 / 32];
+	const uint16_t	*codes;
+	uint32_t	codes_len;
+	int		valid;
+} PTPCodeSet;
+
+/* Open addressing hash index over a PTPDevicePropDescs array, keyed by
+ * DevicePropCode. The array only ever grows, entries appended since the
+ * last lookup are picked up by the next one. */
+typedef struct _PTPPropIndex {
+	uint32_t	*slots;		/* array position + 1, 0 is a free slot */
+	uint32_t	size;		/* number of slots, a power of 2 */
+	uint32_t	len;		/* number of array entries indexed */
+} PTPPropIndex;
+
+/* How cached device property descriptors stay fresh, see ptp_dpd_cache_mode() */
+#define PTP_DPD_CACHE_TIMER	0	/* no change events, refetch after cachetime */
+#define PTP_DPD_CACHE_EVENTS	1	/* valid until a change event arrives */
+#define PTP_DPD_CACHE_POLL	2	/* change events are polled, at most once per cachetime */
+#define PTP_DPD_CACHE_EVENTS_TIMER	3	/* change events are announced, refetch after cachetime anyway */
+
+/* ObjectInfo prefetch modes, see ptp_object_prefetch_children() */
+#define PTP_PREFETCH_OFF	0
+#define PTP_PREFETCH_FOLDER	1
+#define PTP_PREFETCH_ALL	2
+
 struct _PTPParams {
 	/* device flags */
 	uint32_t	device_flags;
@@ -4234,6 +4291,9 @@ struct _PTPParams {
 	/* data layer byteorder */
 	uint8_t		byteorder;
 	uint16_t	maxpacketsize;
+	/* USB data phase streaming: bulk transfers kept in flight and their size */
+	int		usb_stream_depth;
+	int		usb_stream_chunksize;
 
 	/* PTP IO: Custom IO functions */
 	PTPIOSendReq	sendreq_func;
@@ -4273,11 +4333,26 @@ struct _PTPParams {
 
 	/* PTP: internal structures used by ptp driver */
 	PTPObjects	objects;
+	/* PTP: number of objects at the end of objects, added out of order and not merged in yet */
+	unsigned int	objects_unsorted;
+	/* PTP: parent -> children index into objects, sorted by parent */
+	PTPObjectTree	objecttree;
 
 	PTPDeviceInfo	deviceinfo;
+	/* PTP: the DeviceInfo lists as bitsets, see ptp_operation_issupported() */
+	PTPCodeSet	operations_set;
+	PTPCodeSet	events_set;
+	PTPCodeSet	deviceprops_set;
 
 	/* PTP: the current event queue */
 	PTPEvents	events;
+	/* PTP: events read by the event pump of the core while another thread
+	 * owned the camera, moved to events by the next event check. Only
+	 * pump_events is shared, guarded by pump_mutex. */
+	PTPEvents	pump_events;
+	pthread_mutex_t	pump_mutex;
+	/* whether the event pump may wait on the interrupt endpoint */
+	int		pump_interrupts;
 
 	/* Capture count for SDRAM capture style images */
 	unsigned int		capcnt;
@@ -4285,8 +4360,20 @@ struct _PTPParams {
 	/* live view enabled */
 	int			inliveview;
 
-	/* PTP: caching time for properties, default 2 */
+	/* PTP: caching time for properties, default 2. Only used for devices
+	 * not telling about property changes, or if dpd_cache_timer is set. */
 	int			cachetime;
+	int			dpd_cache_timer;
+	time_t			dpd_cache_polled;
+
+	/* PTP: ObjectInfo prefetch with MTP GetObjPropList, one of PTP_PREFETCH_*,
+	 * whether the device got it right so far (1) or not (-1), and whether
+	 * the whole device was already asked for */
+	int			prefetch_mode;
+	int			prefetch_state;
+	int			prefetch_all_done;
+	/* PTP: object cache kept across sessions, see objectcache.c */
+	int			objectcache;
 
 	/* PTP: Storage Caching */
 	PTPStorageIDs		storageids;
@@ -4294,9 +4381,11 @@ struct _PTPParams {
 
 	/* PTP: Device Property Caching */
 	PTPDevicePropDescs	dpd_cache;
+	PTPPropIndex		dpd_cache_index;
 
 	/* PTP: Canon specific flags list */
 	PTPDevicePropDescs	canon_props;
+	PTPPropIndex		canon_props_index;
 	int			canon_viewfinder_on;
 	int			canon_event_mode;
 
@@ -4326,6 +4415,7 @@ struct _PTPParams {
 
 	/* IO: PTP/IP related data */
 	int		cmdfd, evtfd, jpgfd;
+	PTPIPBuffer	cmdbuf, evtbuf;
 	uint8_t		cameraguid[16];
 	uint32_t	eventpipeid;
 	char		*cameraname;
@@ -4349,7 +4439,7 @@ struct _PTPParams {
 	uint16_t	response_packet_size;
 };
 
-/* Asynchronous event callback */
+/* Asynchronous event callback, see ptp_usb_event_async() */
 typedef void (*PTPEventCbFn)(PTPParams *params, uint16_t code, PTPContainer *event, void *user_data);
 
 /* last, but not least - ptp functions */
@@ -5167,6 +5257,7 @@ uint16_t ptp_sony_9281 (PTPParams* params, uint32_t param1);
  **/
 #define ptp_nikon_start_liveview(params) ptp_generic_no_data(params,PTP_OC_NIKON_StartLiveView,0)
 uint16_t ptp_nikon_get_liveview_image (PTPParams* params, unsigned char**,unsigned int*);
+uint16_t ptp_nikon_get_liveview_image_handler (PTPParams* params, PTPDataHandler*);
 uint16_t ptp_nikon_get_preview_image (PTPParams* params, unsigned char**, unsigned int*, uint32_t*);
 /**
  * ptp_nikon_end_liveview:
@@ -5219,25 +5310,42 @@ uint16_t ptp_olympus_omd_move_focus (PTPParams* params, uint32_t direction, uint
 
 
 /* Non PTP protocol functions */
+void ptp_codeset_build		(PTPCodeSet *set, const uint16_t *codes, uint32_t codes_len);
+void ptp_deviceinfo_changed	(PTPParams *params);
+
 static inline int
-ptp_operation_issupported(PTPParams* params, uint16_t operation)
+ptp_codeset_contains (PTPCodeSet *set, const uint16_t *codes, uint32_t codes_len, uint16_t code)
 {
-	uint32_t i=0;
+	if (!set->valid || (set->codes != codes) || (set->codes_len != codes_len))
+		ptp_codeset_build (set, codes, codes_len);
+	return (set->bits[code >> 5] >> (code & 31)) & 1;
+}
 
+static inline int
+ptp_operation_issupported(PTPParams* params, uint16_t operation)
+{
 	/* The R5m2 fails to send a PTP response packet after the data packet of the GetDeviceInfoEx.
 	 * This seems to be firmware bug present in version 1.0.0 and 1.0.1. See #1028. */
 	if (operation == PTP_OC_CANON_EOS_GetDeviceInfoEx && params->deviceinfo.Model && !strcmp(params->deviceinfo.Model,"Canon EOS R5m2"))
 		return 0;
 
-	for (;i<params->deviceinfo.Operations_len;i++) {
-		if (params->deviceinfo.Operations[i]==operation)
-			return 1;
-	}
-	return 0;
+	return ptp_codeset_contains (&params->operations_set,
+		params->deviceinfo.Operations, params->deviceinfo.Operations_len, operation);
+}
+
+static inline int
+ptp_event_issupported(PTPParams* params, uint16_t event)
+{
+	return ptp_codeset_contains (&params->events_set,
+		params->deviceinfo.Events, params->deviceinfo.Events_len, event);
 }
 
-int ptp_event_issupported	(PTPParams* params, uint16_t event);
-int ptp_property_issupported	(PTPParams* params, uint16_t property);
+static inline int
+ptp_property_issupported(PTPParams* params, uint16_t property)
+{
+	return ptp_codeset_contains (&params->deviceprops_set,
+		params->deviceinfo.DeviceProps, params->deviceinfo.DeviceProps_len, property);
+}
 
 void ptp_free_params		(PTPParams *params);
 void ptp_free_objectpropdesc	(PTPObjectPropDesc*);
@@ -5290,9 +5398,20 @@ uint16_t ptp_object_want (PTPParams *, uint32_t handle, unsigned int want, PTPOb
 void ptp_objects_sort (PTPParams *);
 uint16_t ptp_find_object_in_cache (PTPParams *params, uint32_t handle, PTPObject **retob);
 uint16_t ptp_find_or_insert_object_in_cache (PTPParams *params, uint32_t handle, PTPObject **retob);
+uint16_t ptp_insert_objects_in_cache (PTPParams *params, const PTPObjectHandles *handles, PTPObjectHandles *newhandles);
+int ptp_handles_contain (const PTPObjectHandles *handles, uint32_t handle);
 uint16_t ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle, PTPObjectHandles *children);
+uint16_t ptp_object_prefetch_children (PTPParams *params, uint32_t parent);
+PTPObjectChildren* ptp_find_object_children (PTPParams *params, uint32_t parent);
+uint16_t ptp_object_set_parent (PTPParams *params, PTPObject *ob, uint32_t parent);
+void ptp_free_objects (PTPParams *params);
+uint16_t ptp_objecttree_rebuild (PTPParams *params);
 
 PTPDevicePropDesc* ptp_find_dpd_in_cache(PTPParams *params, uint32_t dpc);
+PTPDevicePropDesc* ptp_propindex_find (PTPPropIndex *index, PTPDevicePropDescs *dpds, uint32_t dpc);
+void ptp_free_propindex (PTPPropIndex *index);
+int ptp_dpd_cache_mode (PTPParams *params);
+void ptp_dpd_cache_invalidate (PTPParams *params, uint32_t dpc);
 
 /* ptpip.c */
 void ptp_nikon_getptpipguid (unsigned char* guid);
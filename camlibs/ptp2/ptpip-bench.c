@@ -0,0 +1,316 @@
+/** \file camlibs/ptp2/ptpip-bench.c
+ * \brief PTP/IP receive path against a local stand-in camera
+ *
+ * Forks a minimal PTP/IP responder on a loopback TCP socket which answers
+ * the init handshake and serves GetObject with a generated pattern, split
+ * into data packets of a given size. The client side is the regular ptp2
+ * PTP/IP code. Every frame is downloaded once into memory (handler with
+ * direct buffer support) and once through a plain checking handler, the
+ * contents are verified and the throughput is reported.
+ *
+ * \copyright GNU Lesser General Public License 2 or later
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ *
+ * Usage (meson runs it as the ptp2-ptpip test and benchmark):
+ *   $ ./ptpip-bench [FRAMES [FRAMESIZE [PACKETSIZE]]]
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <gphoto2/gphoto2-result.h>
+
+#include "ptp.h"
+#include "ptp-private.h"
+
+
+/* normally provided by library.c */
+int
+translate_ptp_result (uint16_t result)
+{
+	return (result == PTP_RC_OK) ? GP_OK : GP_ERROR;
+}
+
+static void
+quiet_debug (void *data, const char *format, va_list args)
+{
+}
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static unsigned char
+pattern (uint32_t handle, unsigned long offset)
+{
+	return (unsigned char)(handle * 7 + offset * 13 + (offset >> 8));
+}
+
+
+/* stand-in camera */
+
+static int
+srv_read (int fd, unsigned char *buf, unsigned int len)
+{
+	while (len) {
+		ssize_t ret = read (fd, buf, len);
+
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int
+srv_write (int fd, const unsigned char *buf, unsigned int len)
+{
+	while (len) {
+		ssize_t ret = write (fd, buf, len);
+
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/* reads one packet into buf (of size 512), returns its type */
+static int
+srv_packet (int fd, unsigned char *buf)
+{
+	uint32_t len;
+
+	if (srv_read (fd, buf, 8) < 0)
+		return -1;
+	len = dtoh32a (buf);
+	if ((len < 8) || (len > 512) || (srv_read (fd, buf + 8, len - 8) < 0))
+		return -1;
+	return dtoh32a (buf + 4);
+}
+
+static void
+srv_header (unsigned char *buf, uint32_t len, uint32_t type)
+{
+	htod32a (buf, len);
+	htod32a (buf + 4, type);
+}
+
+static int
+srv_getobject (int fd, uint32_t transid, uint32_t handle, unsigned long size, unsigned int packetsize)
+{
+	unsigned char	*buf = malloc (20 + packetsize);
+	unsigned long	off = 0;
+	int		ret = 0;
+
+	if (!buf)
+		return -1;
+	srv_header (buf, 20, PTPIP_START_DATA_PACKET);
+	htod32a (buf + 8, transid);
+	htod32a (buf + 12, size);
+	htod32a (buf + 16, 0);
+	ret = srv_write (fd, buf, 20);
+	while (!ret && (off < size)) {
+		unsigned int n = (size - off > packetsize) ? packetsize : size - off;
+
+		srv_header (buf, 12 + n, (off + n < size) ? PTPIP_DATA_PACKET : PTPIP_END_DATA_PACKET);
+		htod32a (buf + 8, transid);
+		for (unsigned int i = 0; i < n; i++)
+			buf[12 + i] = pattern (handle, off + i);
+		ret = srv_write (fd, buf, 12 + n);
+		off += n;
+	}
+	free (buf);
+	return ret;
+}
+
+static void
+stand_in_camera (int listenfd, unsigned long size, unsigned int packetsize)
+{
+	unsigned char	buf[512];
+	int		cmdfd, evtfd, one = 1;
+
+	/* command connection and its init handshake */
+	cmdfd = accept (listenfd, NULL, NULL);
+	if ((cmdfd < 0) || (srv_packet (cmdfd, buf) != PTPIP_INIT_COMMAND_REQUEST))
+		_exit (1);
+	/* a camera sends each packet at once, do not let Nagle hold them back */
+	setsockopt (cmdfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	memset (buf, 0, sizeof(buf));
+	srv_header (buf, 8 + 4 + 16 + 2 + 4, PTPIP_INIT_COMMAND_ACK);
+	htod32a (buf + 8, 1);			/* event pipe id */
+	htod32a (buf + 8 + 4 + 16 + 2, 0x00010000);	/* empty name, version */
+	if (srv_write (cmdfd, buf, 8 + 4 + 16 + 2 + 4) < 0)
+		_exit (1);
+
+	/* event connection */
+	evtfd = accept (listenfd, NULL, NULL);
+	if ((evtfd < 0) || (srv_packet (evtfd, buf) != PTPIP_INIT_EVENT_REQUEST))
+		_exit (1);
+	srv_header (buf, 8, PTPIP_INIT_EVENT_ACK);
+	if (srv_write (evtfd, buf, 8) < 0)
+		_exit (1);
+
+	while (srv_packet (cmdfd, buf) == PTPIP_CMD_REQUEST) {
+		uint16_t code    = dtoh16a (buf + 12);
+		uint32_t transid = dtoh32a (buf + 14);
+		uint16_t rc      = PTP_RC_OK;
+
+		if (code == PTP_OC_GetObject) {
+			if (srv_getobject (cmdfd, transid, dtoh32a (buf + 18), size, packetsize) < 0)
+				_exit (1);
+		} else
+			rc = PTP_RC_OperationNotSupported;
+		srv_header (buf, 14, PTPIP_CMD_RESPONSE);
+		htod16a (buf + 8, rc);
+		htod32a (buf + 10, transid);
+		if (srv_write (cmdfd, buf, 14) < 0)
+			_exit (1);
+	}
+	_exit (0);
+}
+
+
+/* client side */
+
+struct check {
+	uint32_t	handle;
+	unsigned long	offset;
+	int		bad;
+};
+
+static uint16_t
+check_putfunc (PTPParams *params, void *priv, unsigned long sendlen, unsigned char *data)
+{
+	struct check *check = priv;
+
+	for (unsigned long i = 0; i < sendlen; i++)
+		if (data[i] != pattern (check->handle, check->offset + i))
+			check->bad = 1;
+	check->offset += sendlen;
+	return PTP_RC_OK;
+}
+
+static int
+run (PTPParams *params, const char *name, unsigned int frames, unsigned long size, int direct)
+{
+	double	start = now ();
+
+	for (uint32_t handle = 1; handle <= frames; handle++) {
+		struct check	check = { handle, 0, 0 };
+		uint16_t	ret;
+
+		if (direct) {
+			unsigned char	*data = NULL;
+
+			ret = ptp_getobject (params, handle, &data);
+			if (ret == PTP_RC_OK)
+				check_putfunc (params, &check, size, data);
+			free (data);
+		} else {
+			PTPDataHandler handler = { NULL, check_putfunc, &check, NULL };
+
+			ret = ptp_getobject_to_handler (params, handle, &handler);
+		}
+		if ((ret != PTP_RC_OK) || check.bad || (check.offset != size)) {
+			printf ("ERROR: frame %u: ret 0x%04x, %lu bytes, %s\n", handle, ret,
+				check.offset, check.bad ? "corrupted" : "intact");
+			return 1;
+		}
+	}
+	printf ("%-8s %u frames of %lu bytes in %.3f s, %.1f MB/s\n", name, frames, size,
+		now () - start, frames * (double)size / (now () - start) / 1000000.0);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	unsigned int		frames     = argc > 1 ? strtoul (argv[1], NULL, 0) : 2000;
+	unsigned long		size       = argc > 2 ? strtoul (argv[2], NULL, 0) : 300000;
+	unsigned int		packetsize = argc > 3 ? strtoul (argv[3], NULL, 0) : 32768;
+	struct sockaddr_in	saddr;
+	socklen_t		slen = sizeof(saddr);
+	PTPParams		params;
+	char			address[64];
+	int			listenfd, status, ret = 0;
+	pid_t			pid;
+
+	listenfd = socket (PF_INET, SOCK_STREAM, 0);
+	memset (&saddr, 0, sizeof(saddr));
+	saddr.sin_family      = AF_INET;
+	saddr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	if (	(listenfd < 0) ||
+		bind (listenfd, (struct sockaddr*)&saddr, sizeof(saddr)) ||
+		listen (listenfd, 2) ||
+		getsockname (listenfd, (struct sockaddr*)&saddr, &slen)
+	) {
+		perror ("stand-in camera socket");
+		return 1;
+	}
+	pid = fork ();
+	if (pid < 0)
+		return 1;
+	if (!pid)
+		stand_in_camera (listenfd, size, packetsize);
+	close (listenfd);
+
+	memset (&params, 0, sizeof(params));
+	params.debug_func	= quiet_debug;
+	params.error_func	= quiet_debug;
+	params.byteorder	= PTP_DL_LE;
+	params.sendreq_func	= ptp_ptpip_sendreq;
+	params.senddata_func	= ptp_ptpip_senddata;
+	params.getresp_func	= ptp_ptpip_getresp;
+	params.getdata_func	= ptp_ptpip_getdata;
+	params.event_wait	= ptp_ptpip_event_wait;
+	params.event_check	= ptp_ptpip_event_check;
+	params.event_check_queue= ptp_ptpip_event_check_queue;
+	params.cmdfd = params.evtfd = params.jpgfd = -1;
+
+	snprintf (address, sizeof(address), "ptpip:127.0.0.1:%d:%d", ntohs (saddr.sin_port), ntohs (saddr.sin_port));
+	if (ptp_ptpip_connect (&params, address) != GP_OK) {
+		printf ("ERROR: could not connect to the stand-in camera\n");
+		kill (pid, SIGTERM);
+		return 1;
+	}
+	ret |= run (&params, "memory", frames, size, 1);
+	ret |= run (&params, "handler", frames, size, 0);
+
+	ptp_ptpip_disconnect (&params);
+	ptp_free_params (&params);
+	if ((waitpid (pid, &status, 0) != pid) || !WIFEXITED (status) || WEXITSTATUS (status))
+		ret = 1;
+	return ret;
+}
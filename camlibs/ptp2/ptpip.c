@@ -143,57 +143,143 @@ ptp_ptpip_sendreq (PTPParams* params, PTPContainer* req, int dataphase)
 	return PTP_RC_OK;
 }
 
+#define PTPIP_RECVBUF_SIZE	(256*1024)
+
+/* Makes sure at least want unconsumed bytes are in the receive buffer.
+ * Each read takes as much as the socket has ready and fits, so small
+ * packets following each other arrive with one syscall. */
 static uint16_t
-ptp_ptpip_generic_read (PTPParams *params, int fd, PTPIPHeader *hdr, unsigned char**data) {
-	int	ret, len, curread;
-	unsigned char *xhdr;
+ptpip_recv_fill (int fd, PTPIPBuffer *buf, unsigned int want)
+{
+	while (buf->end - buf->start < want) {
+		ssize_t	ret;
+
+		if (buf->start + want > buf->size) {
+			if (buf->start) {
+				memmove (buf->data, buf->data + buf->start, buf->end - buf->start);
+				buf->end -= buf->start;
+				buf->start = 0;
+			}
+			if (want > buf->size) {
+				unsigned int	size = (want > PTPIP_RECVBUF_SIZE) ? want : PTPIP_RECVBUF_SIZE;
+				unsigned char	*data = realloc (buf->data, size);
 
-	xhdr = (unsigned char*)hdr; curread = 0; len = sizeof (PTPIPHeader);
-	while (curread < len) {
-		ret = ptpip_read_with_timeout (fd, xhdr + curread, len - curread, PTPIP_DEFAULT_TIMEOUT_S, PTPIP_DEFAULT_TIMEOUT_MS);
+				if (!data) {
+					GP_LOG_E ("realloc of %d bytes failed.", size);
+					return PTP_RC_GeneralError;
+				}
+				buf->data = data;
+				buf->size = size;
+			}
+		}
+		ret = ptpip_read_with_timeout (fd, buf->data + buf->end, buf->size - buf->end, PTPIP_DEFAULT_TIMEOUT_S, PTPIP_DEFAULT_TIMEOUT_MS);
 		if (ret == PTPSOCK_ERR) {
-			ptpip_perror ("read PTPIPHeader");
+			GP_LOG_E ("error %d in reading PTPIP data", ptpip_get_socket_error());
 			if (ptpip_get_socket_error() == ETIMEDOUT)
 				return PTP_ERROR_TIMEOUT;
 			return PTP_ERROR_IO;
 		}
-		GP_LOG_DATA ((char*)xhdr+curread, ret, "ptpip/generic_read header:");
-		curread += ret;
 		if (ret == 0) {
-			GP_LOG_E ("End of stream after reading %d bytes of ptpipheader", ret);
+			GP_LOG_E ("End of stream with %d of %d bytes read", buf->end - buf->start, want);
 			return PTP_RC_GeneralError;
 		}
+		GP_LOG_DATA ((char*)buf->data + buf->end, ret, "ptpip/recv:");
+		buf->end += ret;
 	}
-	len = dtoh32 (hdr->length) - sizeof (PTPIPHeader);
-	if (len < 0) {
-		GP_LOG_E ("len < 0, %d?", len);
-		return PTP_RC_GeneralError;
-	}
-	*data = malloc (len);
-	if (!*data) {
-		GP_LOG_E ("malloc failed.");
+	return PTP_RC_OK;
+}
+
+static void
+ptpip_recv_consume (PTPIPBuffer *buf, unsigned int len)
+{
+	buf->start += len;
+	if (buf->start == buf->end) /* empty, read into the whole buffer next time */
+		buf->start = buf->end = 0;
+}
+
+static uint16_t
+ptp_ptpip_read_header (PTPParams *params, int fd, PTPIPBuffer *buf, PTPIPHeader *hdr) {
+	uint16_t	ret;
+
+	ret = ptpip_recv_fill (fd, buf, sizeof (PTPIPHeader));
+	if (ret != PTP_RC_OK)
+		return ret;
+	memcpy (hdr, buf->data + buf->start, sizeof (PTPIPHeader));
+	ptpip_recv_consume (buf, sizeof (PTPIPHeader));
+	if (dtoh32 (hdr->length) < sizeof (PTPIPHeader)) {
+		GP_LOG_E ("len < 0, %d?", dtoh32 (hdr->length) - (int)sizeof (PTPIPHeader));
 		return PTP_RC_GeneralError;
 	}
-	curread = 0;
-	while (curread < len) {
-		ret = ptpip_read_with_timeout (fd, (*data)+curread, len-curread, PTPIP_DEFAULT_TIMEOUT_S, PTPIP_DEFAULT_TIMEOUT_MS);
-		if (ret == PTPSOCK_ERR) {
-			GP_LOG_E ("error %d in reading PTPIP data", ptpip_get_socket_error());
-			free (*data);*data = NULL;
-			if (ptpip_get_socket_error() == ETIMEDOUT)
-				return PTP_ERROR_TIMEOUT;
-			return PTP_ERROR_IO;
-		} else {
-			GP_LOG_DATA ((char*)((*data)+curread), ret, "ptpip/generic_read data:");
+	return PTP_RC_OK;
+}
+
+/* Reads a complete packet. *data points into the receive buffer and
+ * stays valid until the next read from the same socket. */
+static uint16_t
+ptp_ptpip_generic_read (PTPParams *params, int fd, PTPIPBuffer *buf, PTPIPHeader *hdr, unsigned char**data) {
+	unsigned int	len;
+	uint16_t	ret;
+
+	ret = ptp_ptpip_read_header (params, fd, buf, hdr);
+	if (ret != PTP_RC_OK)
+		return ret;
+	len = dtoh32 (hdr->length) - sizeof (PTPIPHeader);
+	ret = ptpip_recv_fill (fd, buf, len);
+	if (ret != PTP_RC_OK)
+		return ret;
+	*data = buf->data + buf->start;
+	ptpip_recv_consume (buf, len);
+	return PTP_RC_OK;
+}
+
+/* Passes len bytes of packet payload to the handler. Buffered data goes
+ * over as slices of the receive buffer, the rest is read straight into
+ * handler memory where the handler offers it. */
+static uint16_t
+ptp_ptpip_read_to_handler (PTPParams *params, int fd, PTPIPBuffer *buf,
+	unsigned long len, PTPDataHandler *handler
+) {
+	unsigned char	*dest;
+	uint16_t	ret;
+
+	while (len) {
+		unsigned long	n = buf->end - buf->start;
+
+		if (!n && handler->getbuffer &&
+		    (handler->getbuffer (params, handler->priv, len, &dest) == PTP_RC_OK)
+		) {
+			ssize_t	got = ptpip_read_with_timeout (fd, dest, len, PTPIP_DEFAULT_TIMEOUT_S, PTPIP_DEFAULT_TIMEOUT_MS);
+
+			if (got == PTPSOCK_ERR) {
+				GP_LOG_E ("error %d in reading PTPIP data", ptpip_get_socket_error());
+				if (ptpip_get_socket_error() == ETIMEDOUT)
+					return PTP_ERROR_TIMEOUT;
+				return PTP_ERROR_IO;
+			}
+			if (got == 0) {
+				GP_LOG_E ("End of stream with %ld bytes of data left", len);
+				return PTP_RC_GeneralError;
+			}
+			GP_LOG_DATA ((char*)dest, got, "ptpip/recv:");
+			ret = handler->putfunc (params, handler->priv, got, dest);
+			if (ret != PTP_RC_OK)
+				return ret;
+			len -= got;
+			continue;
 		}
-		if (ret == 0)
-			break;
-		curread += ret;
-	}
-	if (curread != len) {
-		GP_LOG_E ("read PTPIP data, ret %d vs len %d", ret, len);
-		free (*data);*data = NULL;
-		return PTP_RC_GeneralError;
+		if (!n) {
+			ret = ptpip_recv_fill (fd, buf, 1);
+			if (ret != PTP_RC_OK)
+				return ret;
+			n = buf->end - buf->start;
+		}
+		if (n > len)
+			n = len;
+		ret = handler->putfunc (params, handler->priv, n, buf->data + buf->start);
+		if (ret != PTP_RC_OK)
+			return ret;
+		ptpip_recv_consume (buf, n);
+		len -= n;
 	}
 	return PTP_RC_OK;
 }
@@ -201,12 +287,12 @@ ptp_ptpip_generic_read (PTPParams *params, int fd, PTPIPHeader *hdr, unsigned ch
 static uint16_t
 ptp_ptpip_cmd_read (PTPParams* params, PTPIPHeader *hdr, unsigned char** data) {
 	ptp_ptpip_check_event (params);
-	return ptp_ptpip_generic_read (params, params->cmdfd, hdr, data);
+	return ptp_ptpip_generic_read (params, params->cmdfd, &params->cmdbuf, hdr, data);
 }
 
 static uint16_t
 ptp_ptpip_evt_read (PTPParams* params, PTPIPHeader *hdr, unsigned char** data) {
-	return ptp_ptpip_generic_read (params, params->evtfd, hdr, data);
+	return ptp_ptpip_generic_read (params, params->evtfd, &params->evtbuf, hdr, data);
 }
 
 static uint16_t
@@ -307,7 +393,6 @@ ptp_ptpip_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler
 	unsigned char		*xdata = NULL;
 	uint16_t 		ret;
 	unsigned long		toread, curread;
-	int			xret;
 
 	GP_LOG_D ("Reading PTP_OC 0x%0x (%s) data...", ptp->Code, ptp_get_opcode_name(params, ptp->Code));
 	ret = ptp_ptpip_cmd_read (params, &hdr, &xdata);
@@ -323,52 +408,47 @@ ptp_ptpip_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler
 		return PTP_RC_GeneralError;
 	}
 	toread = dtoh32a(&xdata[ptpip_data_payload]);
-	free (xdata); xdata = NULL;
 	curread = 0;
 	while (curread < toread) {
-		ret = ptp_ptpip_cmd_read (params, &hdr, &xdata);
+		unsigned long datalen;
+
+		/* the payload is not fetched as a whole, but passed on as it arrives.
+		 * Look for events only when going back to the socket, not for every
+		 * packet that already sits in the receive buffer. */
+		if (params->cmdbuf.end == params->cmdbuf.start)
+			ptp_ptpip_check_event (params);
+		ret = ptp_ptpip_read_header (params, params->cmdfd, &params->cmdbuf, &hdr);
 		if (ret != PTP_RC_OK)
 			return ret;
-		if (dtoh32(hdr.type) == PTPIP_END_DATA_PACKET) {
-			unsigned long datalen = dtoh32(hdr.length)-8-ptpip_data_payload;
-			if (datalen > (toread-curread)) {
-				GP_LOG_E ("returned data is too much, expected %ld, got %ld",
-					  (toread-curread), datalen
-				);
-				break;
-			}
-			xret = handler->putfunc (params, handler->priv,
-				datalen, xdata+ptpip_data_payload
-			);
-			if (xret != PTP_RC_OK) {
-				GP_LOG_E ("failed to putfunc of returned data");
-				break;
-			}
-			curread += datalen;
-			free (xdata); xdata = NULL;
-			continue;
+		if (	(dtoh32(hdr.type) != PTPIP_DATA_PACKET) &&
+			(dtoh32(hdr.type) != PTPIP_END_DATA_PACKET)
+		) {
+			GP_LOG_E ("ret type %d", hdr.type);
+			if (ptpip_recv_fill (params->cmdfd, &params->cmdbuf, dtoh32(hdr.length) - sizeof(hdr)) == PTP_RC_OK)
+				ptpip_recv_consume (&params->cmdbuf, dtoh32(hdr.length) - sizeof(hdr));
+			break;
 		}
-		if (dtoh32(hdr.type) == PTPIP_DATA_PACKET) {
-			unsigned long datalen = dtoh32(hdr.length)-8-ptpip_data_payload;
-			if (datalen > (toread-curread)) {
-				GP_LOG_E ("returned data is too much, expected %ld, got %ld",
-					  (toread-curread), datalen
-				);
-				break;
-			}
-			xret = handler->putfunc (params, handler->priv,
-				datalen, xdata+ptpip_data_payload
+		if (dtoh32(hdr.length) < sizeof(hdr) + ptpip_data_payload) {
+			GP_LOG_E ("data packet of %d bytes too short", dtoh32(hdr.length));
+			break;
+		}
+		ret = ptpip_recv_fill (params->cmdfd, &params->cmdbuf, ptpip_data_payload);
+		if (ret != PTP_RC_OK)
+			return ret;
+		ptpip_recv_consume (&params->cmdbuf, ptpip_data_payload);
+		datalen = dtoh32(hdr.length)-8-ptpip_data_payload;
+		if (datalen > (toread-curread)) {
+			GP_LOG_E ("returned data is too much, expected %ld, got %ld",
+				  (toread-curread), datalen
 			);
-			if (xret != PTP_RC_OK) {
-				GP_LOG_E ("failed to putfunc of returned data");
-				break;
-			}
-			curread += datalen;
-			free (xdata); xdata = NULL;
-			continue;
+			break;
 		}
-		GP_LOG_E ("ret type %d", hdr.type);
-		break;
+		ret = ptp_ptpip_read_to_handler (params, params->cmdfd, &params->cmdbuf, datalen, handler);
+		if (ret != PTP_RC_OK) {
+			GP_LOG_E ("failed to putfunc of returned data");
+			break;
+		}
+		curread += datalen;
 	}
 	if (curread < toread)
 		return PTP_RC_GeneralError;
@@ -401,8 +481,6 @@ retry:
 	case PTPIP_END_DATA_PACKET:
 		resp->Transaction_ID	= dtoh32a(&data[0]);
 		GP_LOG_D("PTPIP_END_DATA_PACKET (tid = 0x%08x)", resp->Transaction_ID);
-		free (data);
-		data = NULL;
 		goto retry;
 	case PTPIP_CMD_RESPONSE:
 		resp->Code		= dtoh16a(&data[ptpip_resp_code]);
@@ -425,7 +503,6 @@ retry:
 		GP_LOG_E ("response type %d packet?", dtoh32(hdr.type));
 		break;
 	}
-	free (data);
 	return PTP_RC_OK;
 }
 
@@ -495,12 +572,11 @@ ptp_ptpip_init_command_ack (PTPParams* params)
 	int		i;
 	unsigned short	*name;
 
-	ret = ptp_ptpip_generic_read (params, params->cmdfd, &hdr, &data);
+	ret = ptp_ptpip_generic_read (params, params->cmdfd, &params->cmdbuf, &hdr, &data);
 	if (ret != PTP_RC_OK)
 		return ret;
 	if (hdr.type != dtoh32(PTPIP_INIT_COMMAND_ACK)) {
 		GP_LOG_E ("bad type returned %d", htod32(hdr.type));
-		free (data);
 		if (hdr.type == PTPIP_INIT_FAIL) /* likely reason is permission denied */
 			return PTP_RC_AccessDenied;
 		return PTP_RC_GeneralError;
@@ -512,7 +588,6 @@ ptp_ptpip_init_command_ack (PTPParams* params)
 	params->cameraname = calloc((i+1),sizeof(uint16_t));
 	for (i=0;name[i];i++)
 		params->cameraname[i] = name[i];
-	free (data);
 	return PTP_RC_OK;
 }
 
@@ -553,7 +628,6 @@ ptp_ptpip_init_event_ack (PTPParams* params)
 	ret = ptp_ptpip_evt_read (params, &hdr, &data);
 	if (ret != PTP_RC_OK)
 		return ret;
-	free (data);
 	if (hdr.type != dtoh32(PTPIP_INIT_EVENT_ACK)) {
 		GP_LOG_E ("bad type returned %d\n", htod32(hdr.type));
 		return PTP_RC_GeneralError;
@@ -591,7 +665,11 @@ ptp_ptpip_event (PTPParams* params, PTPContainer* event, int wait)
 		else
 			timeout.tv_usec = 1000; /* 1/1000 second  .. perhaps wait longer? */
 
-		ret = select (params->evtfd+1, &infds, NULL, NULL, &timeout);
+		/* an event might already wait in the receive buffer */
+		if (params->evtbuf.end > params->evtbuf.start)
+			ret = 1;
+		else
+			ret = select (params->evtfd+1, &infds, NULL, NULL, &timeout);
 		if (1 != ret) {
 			if (-1 == ret) {
 				GP_LOG_D ("select returned error, errno is %d", ptpip_get_socket_error());
@@ -629,7 +707,6 @@ ptp_ptpip_event (PTPParams* params, PTPContainer* event, int wait)
 		GP_LOG_E ("response got %d parameters?", n);
 		break;
 	}
-	free (data);
 	return PTP_RC_OK;
 }
 
@@ -847,6 +924,10 @@ ptp_ptpip_disconnect (PTPParams* params) {
 		PTPSOCK_CLOSE (params->jpgfd);
 		params->jpgfd = PTPSOCK_INVALID;
 	}
+	free (params->cmdbuf.data);
+	memset (&params->cmdbuf, 0, sizeof (params->cmdbuf));
+	free (params->evtbuf.data);
+	memset (&params->evtbuf, 0, sizeof (params->evtbuf));
 	GP_LOG_D ("ptpip disconnected!");
 	return GP_OK;
 }
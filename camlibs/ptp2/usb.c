@@ -238,13 +238,43 @@ retry:
 
 #define READLEN 512*1024 /* read blob size, mostly to avoid reading all of it at once. */
 
+struct ptp_usb_stream {
+	PTPParams	*params;
+	PTPDataHandler	*handler;
+	GPContext	*context;
+	uint16_t	ret;
+	uint32_t	*bytes_read;
+	int		report_progress, progress_id;
+};
+
+/* consumes the chunks of gp_port_usb_read_stream() */
+static int
+ptp_usb_stream_func (GPPort *port, const char *bytes, int size, void *data)
+{
+	struct ptp_usb_stream	*stream = data;
+	uint32_t		bytes_read;
+
+	stream->ret = stream->handler->putfunc (stream->params, stream->handler->priv, size, (unsigned char*)bytes);
+	if (stream->ret != PTP_RC_OK)
+		return GP_ERROR;
+	bytes_read = (*stream->bytes_read += size);
+	if (stream->report_progress && ((bytes_read-size)/CONTEXT_BLOCK_SIZE < bytes_read/CONTEXT_BLOCK_SIZE))
+		gp_context_progress_update (stream->context, stream->progress_id, bytes_read/CONTEXT_BLOCK_SIZE);
+	/* same cancel rule as in the read loop of ptp_usb_getdata */
+	if ((bytes_read >= 1024*1024) && gp_context_cancel(stream->context) == GP_CONTEXT_FEEDBACK_CANCEL) {
+		stream->ret = PTP_ERROR_CANCEL;
+		return GP_ERROR_CANCEL;
+	}
+	return GP_OK;
+}
+
 uint16_t
 ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 {
 	uint16_t ret;
 	PTPUSBBulkContainer usbdata;
-	unsigned char	*data = NULL;
-	uint32_t	bytes_to_read = 0, bytes_read = 0;
+	unsigned char	*data = NULL, *direct = NULL;
+	uint32_t	bytes_to_read = 0, bytes_read = 0, direct_start;
 	Camera		*camera = ((PTPData *)params->data)->camera;
 	int		report_progress, progress_id = 0, do_retry = TRUE, res = GP_OK;
 	GPContext *context = ((PTPData *)params->data)->context;
@@ -384,8 +414,18 @@ ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 	/* Make bytes_read contain the number of payload-bytes already read. */
 	bytes_read -= PTP_USB_BULK_HDR_LEN;
 
-	data = malloc(READLEN);
-	if (!data) return PTP_RC_GeneralError;
+	/* With the length known, let the handler provide the memory for the rest,
+	 * so it is read straight into its destination. Otherwise go via a bounce buffer. */
+	if (	(dtoh32(usbdata.length) != 0xffffffffU)	&&
+		handler->getbuffer			&&
+		(handler->getbuffer (params, handler->priv, bytes_to_read, &direct) != PTP_RC_OK)
+	)
+		direct = NULL;
+	direct_start = bytes_read;
+	if (!direct) {
+		data = malloc(READLEN);
+		if (!data) return PTP_RC_GeneralError;
+	}
 
 	report_progress = (bytes_to_read > 2*CONTEXT_BLOCK_SIZE) && (dtoh32(usbdata.length) != 0xffffffffU);
 
@@ -406,8 +446,45 @@ ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 
 	if (report_progress)
 		progress_id = gp_context_progress_start (context, (bytes_to_read/CONTEXT_BLOCK_SIZE), _("Downloading..."));
+
+	/* Stream the full packets of large data phases with several transfers in flight,
+	 * the trailing short packet is read below as before. */
+	if (	(dtoh32(usbdata.length) != 0xffffffffU)			&&
+		(params->usb_stream_depth > 1)				&&
+		(params->usb_stream_chunksize >= params->maxpacketsize)	&&
+		(bytes_to_read > (uint32_t)params->usb_stream_chunksize)
+	) {
+		struct ptp_usb_stream	stream;
+		uint32_t		streamlen = bytes_to_read - (bytes_to_read % params->maxpacketsize);
+		int			chunksize = params->usb_stream_chunksize - (params->usb_stream_chunksize % params->maxpacketsize);
+		uint32_t		streamstart = bytes_read;
+
+		stream.params		= params;
+		stream.handler		= handler;
+		stream.context		= context;
+		stream.ret		= PTP_RC_OK;
+		stream.bytes_read	= &bytes_read;
+		stream.report_progress	= report_progress;
+		stream.progress_id	= progress_id;
+		res = gp_port_usb_read_stream (camera->port, (char*)direct, streamlen, chunksize,
+					       params->usb_stream_depth, ptp_usb_stream_func, &stream);
+		if (stream.ret != PTP_RC_OK) {
+			ret = stream.ret;
+			goto done;
+		}
+		if ((res == GP_ERROR_IO_READ) && (bytes_read == streamstart)) {
+			/* nothing read yet, the loop below clears the halt and retries */
+		} else if (res < 0) {
+			ret = translate_gp_result_to_ptp(res);
+			goto done;
+		} else {
+			bytes_to_read -= res;
+			do_retry = FALSE;
+		}
+	}
 	while (bytes_to_read > 0) {
 		unsigned long chunk_to_read = bytes_to_read;
+		unsigned char *dest = direct ? direct + (bytes_read - direct_start) : data;
 
 		/* if in read-until-short-packet mode, read one packet at a time */
 		/* else read in large blobs */
@@ -418,7 +495,7 @@ ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 			chunk_to_read = READLEN;
 		else if (chunk_to_read > params->maxpacketsize)
 			chunk_to_read = chunk_to_read - (chunk_to_read % params->maxpacketsize);
-		res = gp_port_read (camera->port, (char*)data, chunk_to_read);
+		res = gp_port_read (camera->port, (char*)dest, chunk_to_read);
 		if (res == GP_ERROR_IO_READ && do_retry) {
 			GP_LOG_D ("Clearing halt on IN EP and retrying once.");
 			gp_port_usb_clear_halt (camera->port, GP_PORT_USB_ENDPOINT_IN);
@@ -430,7 +507,7 @@ ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 			break;
 		} else
 			do_retry = FALSE; /* once we have successfully read any data, don't try again */
-		ret = handler->putfunc (params, handler->priv, res, data);
+		ret = handler->putfunc (params, handler->priv, res, dest);
 		if (ret != PTP_RC_OK)
 			break;
 		if (dtoh32(usbdata.length) == 0xffffffffU) {
@@ -450,6 +527,7 @@ ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 			break;
 		}
 	}
+done:
 	if (report_progress)
 		gp_context_progress_stop (context, progress_id);
 
@@ -523,6 +601,7 @@ ptp_usb_getresp (PTPParams* params, PTPContainer* resp)
 #define PTP_EVENT_CHECK			0x0000	/* waits for */
 #define PTP_EVENT_CHECK_FAST		0x0001	/* checks */
 #define PTP_EVENT_CHECK_QUEUE		0x0002	/* just looks in the queue */
+#define PTP_EVENT_CHECK_ASYNC		0x0003	/* checks, from another thread */
 
 static inline uint16_t
 ptp_usb_event (PTPParams* params, PTPContainer* event, int wait)
@@ -560,11 +639,15 @@ ptp_usb_event (PTPParams* params, PTPContainer* event, int wait)
 		result = gp_port_check_int (camera->port, (char*)&usbevent, sizeof(usbevent));
 		gp_port_set_timeout (camera->port, timeout);
 		break;
+	case PTP_EVENT_CHECK_ASYNC:
+		/* other transfers may be running, leave the port timeout alone */
+		result = gp_port_check_int_fast (camera->port, (char*)&usbevent, sizeof(usbevent));
+		break;
 	default:
 		return PTP_ERROR_BADPARAM;
 	}
 	if (result < 0) {
-		if ((result != GP_ERROR_TIMEOUT) || (wait != PTP_EVENT_CHECK_FAST))
+		if ((result != GP_ERROR_TIMEOUT) || ((wait != PTP_EVENT_CHECK_FAST) && (wait != PTP_EVENT_CHECK_ASYNC)))
 			GP_LOG_E ("Reading PTP event failed: %s (%d)", gp_port_result_as_string(result), result);
 		return translate_gp_result_to_ptp(result);
 	}
@@ -585,15 +668,21 @@ ptp_usb_event (PTPParams* params, PTPContainer* event, int wait)
 		(dtoh32(usbevent.length) > rlen)
 	) {
 		GP_LOG_D ("Canon incremental read (done: %ld, todo: %d)", rlen, dtoh32(usbevent.length));
-		gp_port_get_timeout (camera->port, &timeout);
-		gp_port_set_timeout (camera->port, PTP2_FAST_TIMEOUT);
+		if (wait != PTP_EVENT_CHECK_ASYNC) {
+			gp_port_get_timeout (camera->port, &timeout);
+			gp_port_set_timeout (camera->port, PTP2_FAST_TIMEOUT);
+		}
 		while (dtoh32(usbevent.length) > rlen) {
-			result = gp_port_check_int (camera->port, ((char*)&usbevent)+rlen, sizeof(usbevent)-rlen);
+			if (wait == PTP_EVENT_CHECK_ASYNC)
+				result = gp_port_check_int_fast (camera->port, ((char*)&usbevent)+rlen, sizeof(usbevent)-rlen);
+			else
+				result = gp_port_check_int (camera->port, ((char*)&usbevent)+rlen, sizeof(usbevent)-rlen);
 			if (result <= 0)
 				break;
 			rlen += result;
 		}
-		gp_port_set_timeout (camera->port, timeout);
+		if (wait != PTP_EVENT_CHECK_ASYNC)
+			gp_port_set_timeout (camera->port, timeout);
 	}
 	/* if we read anything over interrupt endpoint it must be an event */
 	/* build an appropriate PTPContainer */
@@ -625,6 +714,21 @@ ptp_usb_event_wait (PTPParams* params, PTPContainer* event) {
 	return ptp_usb_event (params, event, PTP_EVENT_CHECK);
 }
 
+/* Checks the interrupt endpoint for one event and hands it to cb. Does not
+ * touch the port settings, so it may run in a thread next to the transfers
+ * of another one, but cb must not use params beyond the event. */
+uint16_t
+ptp_usb_event_async (PTPParams* params, PTPEventCbFn cb, void *user_data) {
+	PTPContainer	event;
+	uint16_t	ret;
+
+	memset (&event, 0, sizeof(event));
+	ret = ptp_usb_event (params, &event, PTP_EVENT_CHECK_ASYNC);
+	if (ret == PTP_RC_OK)
+		cb (params, event.Code, &event, user_data);
+	return ret;
+}
+
 uint16_t
 ptp_usb_control_get_extended_event_data (PTPParams *params, char *buffer, int *size) {
 	Camera		*camera = ((PTPData *)params->data)->camera;
@@ -109,6 +109,16 @@ typedef enum {
 	GP_EVENT_FILE_CHANGED	/**< CameraFilePath* = file path on camfs */
 } CameraEventType;
 
+/**
+ * \brief Pixel layouts of decoded live view frames
+ *
+ * Used by gp_camera_get_preview_image().
+ */
+typedef enum {
+	GP_PREVIEW_FORMAT_RGB24,	/**< \brief Packed R, G, B bytes, width * height * 3 bytes. */
+	GP_PREVIEW_FORMAT_YUV420P	/**< \brief Planar Y, then U and V at half width and height (I420). */
+} CameraPreviewFormat;
+
 /**
  * \name Camera object member functions
  *
@@ -236,12 +246,56 @@ typedef int (*CameraSetConfigFunc) (Camera *camera, CameraWidget  *widget,
  */
 typedef int (*CameraSetSingleConfigFunc) (Camera *camera, const char *name, CameraWidget  *widget,
 				    GPContext *context);
+/**
+ * \brief Set several configuration variables in the camera at once
+ *
+ * \param camera the current camera
+ * \param values the widget names with their new values in text form
+ * \param context the active #GPContext
+ *
+ * All names and values have to be checked before the first one is set.
+ * The driver sends them with as few transactions as the camera protocol
+ * allows.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraSetMultiConfigFunc) (Camera *camera, CameraList *values,
+				    GPContext *context);
 
 typedef int (*CameraCaptureFunc)   (Camera *camera, CameraCaptureType type,
 				    CameraFilePath *path, GPContext *context);
 typedef int (*CameraTriggerCaptureFunc)   (Camera *camera, GPContext *context);
 typedef int (*CameraCapturePreviewFunc) (Camera *camera, CameraFile *file,
 					 GPContext *context);
+/**
+ * \brief Start or stop continuous live view
+ *
+ * \param camera the current camera
+ * \param enable 1 to start, 0 to stop
+ * \param context the active #GPContext
+ *
+ * Starting does the setup capture_preview would do for every frame
+ * once, so preview_frame can skip it afterwards.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraPreviewStreamFunc) (Camera *camera, int enable,
+					GPContext *context);
+/**
+ * \brief Read the next frame of a running live view
+ *
+ * \param camera the current camera
+ * \param frame an empty memory #CameraFile, reused from frame to frame
+ * \param context the active #GPContext
+ *
+ * The frame file keeps its memory between frames. Drivers should receive
+ * the data into it with gp_file_get_append_buffer(), so no frame needs an
+ * allocation once the buffer is large enough.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraPreviewFrameFunc) (Camera *camera, CameraFile *frame,
+				       GPContext *context);
 typedef int (*CameraSummaryFunc)   (Camera *camera, CameraText *text,
 				    GPContext *context);
 typedef int (*CameraManualFunc)    (Camera *camera, CameraText *text,
@@ -251,6 +305,25 @@ typedef int (*CameraAboutFunc)     (Camera *camera, CameraText *text,
 typedef int (*CameraWaitForEvent)  (Camera *camera, int timeout,
 				    CameraEventType *eventtype, void **eventdata,
 				    GPContext *context);
+/**
+ * \brief Wait until wait_for_event has something to report
+ *
+ * \param camera the current camera
+ * \param timeout the longest time to wait in milliseconds, drivers may
+ *        return earlier
+ * \param context the active #GPContext
+ *
+ * Used by the event pump, see gp_camera_start_event_pump(). It is called
+ * without the camera lock while another thread may run camera operations,
+ * so it may only wait on the device (e.g. on the interrupt endpoint) and
+ * keep what it read for the next wait_for_event.
+ *
+ * \returns #GP_OK if wait_for_event should be called, #GP_ERROR_TIMEOUT if
+ * nothing happened, or #GP_ERROR_NOT_SUPPORTED if the camera has to be
+ * polled with wait_for_event instead.
+ */
+typedef int (*CameraEventReadyFunc) (Camera *camera, int timeout,
+				     GPContext *context);
 /**@}*/
 
 
@@ -308,11 +381,13 @@ typedef struct _CameraFunctions {
 
 	/* Event Interface */
 	CameraWaitForEvent wait_for_event;	/**< \brief Wait for a specific event from the camera */
+	CameraSetMultiConfigFunc set_multi_config;	/**< \brief Called for setting several configuration widgets at once. */
+
+	CameraPreviewStreamFunc preview_stream;	/**< \brief Start or stop continuous live view. */
+	CameraPreviewFrameFunc  preview_frame;	/**< \brief Read the next live view frame. */
+	CameraEventReadyFunc    event_ready;	/**< \brief Wait for events without the camera lock. */
+
 	/* Reserved space to use in the future without changing the struct size */
-	void *reserved1;			/**< \brief reserved for future use */
-	void *reserved2;			/**< \brief reserved for future use */
-	void *reserved3;			/**< \brief reserved for future use */
-	void *reserved4;			/**< \brief reserved for future use */
 	void *reserved5;			/**< \brief reserved for future use */
 	void *reserved6;			/**< \brief reserved for future use */
 	void *reserved7;			/**< \brief reserved for future use */
@@ -393,6 +468,9 @@ int gp_camera_set_config	 (Camera *camera, CameraWidget  *window,
 				  GPContext *context);
 int gp_camera_set_single_config	 (Camera *camera, const char *name, CameraWidget  *widget,
 				  GPContext *context);
+int gp_camera_set_multi_config	 (Camera *camera, CameraList *values,
+				  GPContext *context);
+int gp_camera_defer_config_widget (Camera *camera, CameraWidget *widget);
 int gp_camera_get_summary	 (Camera *camera, CameraText *summary,
 				  GPContext *context);
 int gp_camera_get_manual	 (Camera *camera, CameraText *manual,
@@ -404,10 +482,37 @@ int gp_camera_capture 		 (Camera *camera, CameraCaptureType type,
 int gp_camera_trigger_capture 	 (Camera *camera, GPContext *context);
 int gp_camera_capture_preview 	 (Camera *camera, CameraFile *file,
 				  GPContext *context);
+int gp_camera_start_preview_stream (Camera *camera, unsigned int frames,
+				  GPContext *context);
+int gp_camera_get_preview_frame	 (Camera *camera, CameraFile **frame,
+				  GPContext *context);
+int gp_camera_stop_preview_stream (Camera *camera, GPContext *context);
+int gp_camera_get_preview_image	 (Camera *camera, CameraPreviewFormat format,
+				  unsigned int scale, unsigned char *buffer,
+				  unsigned long size, unsigned int *width,
+				  unsigned int *height, GPContext *context);
 int gp_camera_wait_for_event     (Camera *camera, int timeout,
 				  CameraEventType *eventtype, void **eventdata,
 				  GPContext *context);
 
+/**
+ * \brief Receives the events of a running event pump
+ *
+ * \param camera the camera
+ * \param type the type of the event, never #GP_EVENT_TIMEOUT
+ * \param data the event specific data as with gp_camera_wait_for_event(),
+ *        only valid during the call
+ * \param user_data the data given to gp_camera_start_event_pump()
+ *
+ * Called in the thread of the event pump, without the camera lock, so
+ * the camera can be used from here.
+ */
+typedef void (*CameraEventFunc)  (Camera *camera, CameraEventType type,
+				  void *data, void *user_data);
+int gp_camera_start_event_pump   (Camera *camera, CameraEventFunc func,
+				  void *data, GPContext *context);
+int gp_camera_stop_event_pump    (Camera *camera, GPContext *context);
+
 int gp_camera_get_storageinfo    (Camera *camera, CameraStorageInformation**,
 				   int *, GPContext *context);
 
@@ -446,6 +551,12 @@ int gp_camera_file_set_info	(Camera *camera, const char *folder,
 int gp_camera_file_get		(Camera *camera, const char *folder,
 				 const char *file, CameraFileType type,
 				 CameraFile *camera_file, GPContext *context);
+int gp_camera_files_get		(Camera *camera, int count,
+				 const char *folders[], const char *files[],
+				 CameraFileType type,
+				 CameraFileBatchOpenFunc open_func,
+				 CameraFileBatchDoneFunc done_func,
+				 void *data, GPContext *context);
 int gp_camera_file_read		(Camera *camera, const char *folder, const char *file,
 				 CameraFileType type,
 				 uint64_t offset, char *buf, uint64_t *size,
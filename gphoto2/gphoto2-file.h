@@ -118,6 +118,7 @@ typedef struct _CameraFile CameraFile;
 int gp_file_new            (CameraFile **file);
 int gp_file_new_from_fd    (CameraFile **file, int fd);
 int gp_file_new_from_handler (CameraFile **file, CameraFileHandler *handler, void*priv);
+int gp_file_new_from_buffer (CameraFile **file, char *buffer, unsigned long int size);
 int gp_file_ref            (CameraFile *file);
 int gp_file_unref          (CameraFile *file);
 int gp_file_free           (CameraFile *file);
@@ -174,6 +175,13 @@ int gp_file_append            (CameraFile*, const char *data,
 			       unsigned long int size);
 int gp_file_slurp             (CameraFile*, char *data,
 			       size_t size, size_t *readlen);
+int gp_file_get_append_buffer (CameraFile*, unsigned long int size,
+			       char **buffer);
+int gp_file_reserve           (CameraFile*, unsigned long int size);
+
+#ifdef _GPHOTO2_INTERNAL_CODE
+int gp_file_reset             (CameraFile*);
+#endif /* _GPHOTO2_INTERNAL_CODE */
 
 #ifdef __cplusplus
 }
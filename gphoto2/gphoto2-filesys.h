@@ -321,6 +321,44 @@ int gp_filesystem_read_file	(CameraFilesystem *fs, const char *folder,
 int gp_filesystem_delete_file    (CameraFilesystem *fs, const char *folder,
 				  const char *filename, GPContext *context);
 
+/* Batch downloads */
+/**
+ * \brief Supplies the #CameraFile a file of a batch download goes into.
+ *
+ * Called right before the download of each file starts. Return a new
+ * reference in \a file, the batch drops it after the done callback.
+ */
+typedef int (*CameraFileBatchOpenFunc) (const char *folder,
+					const char *filename,
+					CameraFileType type,
+					CameraFile **file, void *data);
+/**
+ * \brief Reports a file of a batch download as finished.
+ *
+ * \a result is the gphoto2 error code of this file. Take a reference to
+ * \a file to keep it beyond the call. Returning an error stops the batch.
+ */
+typedef int (*CameraFileBatchDoneFunc) (const char *folder,
+					const char *filename,
+					CameraFileType type,
+					CameraFile *file, int result,
+					void *data);
+typedef int (*CameraFilesystemGetFilesFunc)   (CameraFilesystem *fs,
+					       int count,
+					       const char *folders[],
+					       const char *filenames[],
+					       CameraFileType type,
+					       CameraFileBatchOpenFunc open_func,
+					       CameraFileBatchDoneFunc done_func,
+					       void *batchdata, void *data,
+					       GPContext *context);
+int gp_filesystem_get_files      (CameraFilesystem *fs, int count,
+				  const char *folders[], const char *filenames[],
+				  CameraFileType type,
+				  CameraFileBatchOpenFunc open_func,
+				  CameraFileBatchDoneFunc done_func,
+				  void *data, GPContext *context);
+
 /* Folders */
 typedef int (*CameraFilesystemPutFileFunc)   (CameraFilesystem *fs,
 					      const char *folder,
@@ -361,9 +399,10 @@ struct _CameraFilesystemFuncs {
 	CameraFilesystemReadFileFunc	read_file_func;
 	CameraFilesystemDeleteFileFunc	del_file_func;
 	CameraFilesystemStorageInfoFunc	storage_info_func;
+	CameraFilesystemGetFilesFunc	get_files_func;
 
 	/* for later use. Remove one if you add a new function */
-	void				*unused[31];
+	void				*unused[30];
 };
 int gp_filesystem_set_funcs	(CameraFilesystem *fs,
 				 CameraFilesystemFuncs *funcs,
@@ -98,6 +98,7 @@ int	gp_widget_get_parent         (CameraWidget *widget,
 				      CameraWidget **parent);
 
 int	gp_widget_set_value	(CameraWidget *widget, const void *value);
+int	gp_widget_set_value_from_string (CameraWidget *widget, const char *value);
 int	gp_widget_get_value	(CameraWidget *widget, void *value);
 
 int	gp_widget_set_name	(CameraWidget *widget, const char  *name);
@@ -126,6 +127,18 @@ int	gp_widget_set_changed	(CameraWidget *widget, int changed);
 int	gp_widget_set_readonly	(CameraWidget *widget, int readonly);
 int	gp_widget_get_readonly	(CameraWidget *widget, int *readonly);
 
+#ifdef _GPHOTO2_INTERNAL_CODE
+/* Loader for widgets whose contents are fetched on first access, it returns
+ * in loaded a complete widget whose contents are taken over. The functions
+ * have to stay valid while the widget exists, so they can not live in a
+ * camera driver. See gp_camera_defer_config_widget(). */
+typedef int (* CameraWidgetLoadFunc) (CameraWidget *widget, void *data,
+				      CameraWidget **loaded);
+
+int	gp_widget_set_load_func	(CameraWidget *widget, CameraWidgetLoadFunc func,
+				 void *data, void (*free_data) (void *data));
+#endif /* _GPHOTO2_INTERNAL_CODE */
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -30,6 +30,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include <ltdl.h>
 
@@ -37,6 +49,8 @@
 #include <gphoto2/gphoto2-port-log.h>
 #include <gphoto2/gphoto2-library.h>
 #include <gphoto2/gphoto2-port-locking.h>
+#include <gphoto2/gphoto2-port-portability.h>
+#include <gphoto2/gphoto2-setting.h>
 
 #include "libgphoto2/i18n.h"
 
@@ -49,12 +63,31 @@ struct _CameraAbilitiesList {
 	int count;
 	int maxcount;
 	CameraAbilities *abilities;
+
+	/* abilities mapped read only from the cache, copied on change */
+	void *map;
+	size_t mapsize;
+
+	/*
+	 * Hash indices (open addressing, linear probing) built on the first
+	 * lookup or detection after the list changed. The slots hold entry
+	 * numbers + 1, 0 is a free slot or the end of a chain. The sizes are
+	 * powers of 2, or 0 if not built.
+	 */
+	unsigned int model_size;
+	int *model_slots;		/* model -> first entry */
+	unsigned int usb_size;
+	int *usb_slots;			/* vendor:product -> first entry */
+	int *usb_next;			/* per entry, the next one with its ids */
+	int *class_entries;		/* entries with an interface class, -1 ends */
 };
 
 /** \internal */
 static int gp_abilities_list_lookup_id (CameraAbilitiesList *, const char *);
 /** \internal */
 static int gp_abilities_list_sort      (CameraAbilitiesList *);
+/** \internal */
+static int cmp_abilities               (const void *, const void *);
 
 /**
  * \brief Set the current character codeset libgphoto2 is operating in.
@@ -192,7 +225,7 @@ foreach_func (const char *filename, lt_ptr data)
 }
 
 static int
-unlocked_gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
+unlocked_gp_abilities_list_scan_dir (CameraAbilitiesList *list, const char *dir,
 			    GPContext *context)
 {
 	CameraLibraryIdFunc id;
@@ -325,6 +358,296 @@ unlocked_gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
 	return GP_OK;
 }
 
+#ifdef HAVE_SYS_MMAN_H
+
+/*
+ * The abilities cache spares opening every camlib on each load. It is
+ * the file named by GP_ABILITIES_CACHE (none if empty), else
+ * "abilities-cache" in the settings directory, written on the first load
+ * of a camlib directory and replaced whenever that changes. It holds a
+ * key naming the libgphoto2 version, the camlib directories and the
+ * name, size and mtime of every file in them, followed by the sorted
+ * abilities, which are mapped as they are.
+ */
+#define ABILITIES_CACHE_MAGIC	"gp2abcch"
+#define ABILITIES_CACHE_VERSION	1
+
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	abilities_size;		/* sizeof (CameraAbilities) */
+	uint32_t	count;
+	uint32_t	key_size;		/* the key follows the header */
+	uint64_t	abilities_offset;
+} AbilitiesCacheHeader;
+
+static int
+abilities_cache_path (char *path, size_t size)
+{
+	const char *env = getenv ("GP_ABILITIES_CACHE");
+	char dir[1024];
+
+	if (env) {
+		if (!env[0] || (strlen (env) >= size))
+			return GP_ERROR_NOT_SUPPORTED;
+		strcpy (path, env);
+		return GP_OK;
+	}
+	CHECK_RESULT (gp_setting_get_dir (dir, sizeof (dir)));
+	if ((size_t)snprintf (path, size, "%s/abilities-cache", dir) >= size)
+		return GP_ERROR_FIXED_LIMIT_EXCEEDED;
+	return GP_OK;
+}
+
+static int
+cmp_names (const void *a, const void *b)
+{
+	return strcmp (*(char * const *)a, *(char * const *)b);
+}
+
+static int
+key_printf (char **key, size_t *size, size_t *len, const char *fmt, ...)
+{
+	va_list	args;
+	int	n;
+
+	while (1) {
+		va_start (args, fmt);
+		n = vsnprintf (*key + *len, *size - *len, fmt, args);
+		va_end (args);
+		if (n < 0)
+			return GP_ERROR;
+		if (*len + n < *size)
+			break;
+		*size = (*len + n + 1) * 2;
+		C_MEM (*key = realloc (*key, *size));
+	}
+	*len += n;
+	return GP_OK;
+}
+
+/* Everything the abilities loaded from dir, a list of camlib directories,
+ * depend on: the library and the files in the directories. */
+static int
+abilities_cache_key (const char *dir, char **key, size_t *keysize)
+{
+	const char	*prefix = getenv (CAMLIBDIR_PREFIX_ENV), *end;
+	char		path[1024], **names = NULL;
+	size_t		size = 4096, len = 0;
+	int		i, nr, ret = GP_OK;
+	gp_system_dir	d;
+	gp_system_dirent de;
+	struct stat	st;
+
+	C_MEM (*key = malloc (size));
+	ret = key_printf (key, &size, &len, "libgphoto2 %s, %d byte abilities, prefix %s\n",
+			  PACKAGE_VERSION, (int)sizeof (CameraAbilities), prefix ? prefix : "");
+	for (; (ret == GP_OK) && *dir; dir = *end ? end + 1 : end) {
+		end = strchr (dir, ':');
+		if (!end)
+			end = dir + strlen (dir);
+		if ((size_t)(end - dir) >= sizeof (path)) {
+			ret = GP_ERROR_FIXED_LIMIT_EXCEEDED;
+			break;
+		}
+		ret = key_printf (key, &size, &len, "%.*s:\n", (int)(end - dir), dir);
+
+		/* the directory order is arbitrary */
+		nr = 0;
+		snprintf (path, sizeof (path), "%.*s", (int)(end - dir), dir);
+		d = gp_system_opendir (path);
+		while (d && (ret == GP_OK) && (de = gp_system_readdir (d))) {
+			char **xnames = realloc (names, (nr + 1) * sizeof (char *));
+
+			if (!xnames || !(xnames[nr] = strdup (gp_system_filename (de)))) {
+				names = xnames ? xnames : names;
+				ret = GP_ERROR_NO_MEMORY;
+				break;
+			}
+			names = xnames;
+			nr++;
+		}
+		if (d)
+			gp_system_closedir (d);
+		if (nr)
+			qsort (names, nr, sizeof (char *), cmp_names);
+		for (i = 0; i < nr; i++) {
+			if ((ret == GP_OK) &&
+			    strcmp (names[i], ".") && strcmp (names[i], "..")) {
+				snprintf (path, sizeof (path), "%.*s/%s", (int)(end - dir), dir, names[i]);
+				if (!stat (path, &st))
+					ret = key_printf (key, &size, &len, "%s %lld %lld\n", names[i],
+							  (long long)st.st_size, (long long)st.st_mtime);
+			}
+			free (names[i]);
+		}
+	}
+	free (names);
+	if (ret < GP_OK) {
+		free (*key);
+		*key = NULL;
+		return ret;
+	}
+	*keysize = len;
+	return GP_OK;
+}
+
+static int
+abilities_cache_load (CameraAbilitiesList *list, const char *path,
+		      const char *key, size_t keysize)
+{
+	const AbilitiesCacheHeader	*h;
+	struct stat			st;
+	void				*map;
+	int				fd;
+
+	fd = open (path, O_RDONLY);
+	if (fd < 0)
+		return GP_ERROR_FILE_NOT_FOUND;
+	if (fstat (fd, &st) || ((size_t)st.st_size < sizeof (*h) + keysize)) {
+		close (fd);
+		return GP_ERROR_CORRUPTED_DATA;
+	}
+	map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED)
+		return GP_ERROR_IO;
+
+	h = map;
+	if (memcmp (h->magic, ABILITIES_CACHE_MAGIC, sizeof (h->magic)) ||
+	    (h->version != ABILITIES_CACHE_VERSION) ||
+	    (h->abilities_size != sizeof (CameraAbilities)) ||
+	    (h->key_size != keysize) ||
+	    memcmp ((const char *)map + sizeof (*h), key, keysize) ||
+	    (h->abilities_offset % 8) || (h->count > INT32_MAX / sizeof (CameraAbilities)) ||
+	    (h->abilities_offset + (uint64_t)h->count * sizeof (CameraAbilities) > (uint64_t)st.st_size)) {
+		GP_LOG_D ("Abilities cache '%s' is out of date.", path);
+		munmap (map, st.st_size);
+		return GP_ERROR_CORRUPTED_DATA;
+	}
+	list->abilities = (CameraAbilities *)((char *)map + h->abilities_offset);
+	list->count = list->maxcount = h->count;
+	list->map = map;
+	list->mapsize = st.st_size;
+	GP_LOG_D ("Loaded %d abilities from cache '%s'.", list->count, path);
+	return GP_OK;
+}
+
+static void
+abilities_cache_save (CameraAbilitiesList *list, const char *path,
+		      const char *key, size_t keysize)
+{
+	static const char	padding[8];
+	AbilitiesCacheHeader	h;
+	CameraAbilities		*sorted;
+	char			tmp[1100];
+	FILE			*f;
+	int			fd, ok;
+
+	/* written aside and renamed, so a reader never sees a partial cache */
+	if ((size_t)snprintf (tmp, sizeof (tmp), "%s.XXXXXX", path) >= sizeof (tmp))
+		return;
+	sorted = malloc (list->count * sizeof (CameraAbilities));
+	if (!sorted)
+		return;
+	memcpy (sorted, list->abilities, list->count * sizeof (CameraAbilities));
+	qsort (sorted, list->count, sizeof (CameraAbilities), cmp_abilities);
+
+	/* readable by all, as a cache written at install time is shared */
+	fd = mkstemp (tmp);
+	if (fd >= 0)
+		fchmod (fd, 0644);
+	if ((fd < 0) || !(f = fdopen (fd, "wb"))) {
+		GP_LOG_D ("Could not create abilities cache '%s'.", path);
+		if (fd >= 0) {
+			close (fd);
+			unlink (tmp);
+		}
+		free (sorted);
+		return;
+	}
+	memset (&h, 0, sizeof (h));
+	memcpy (h.magic, ABILITIES_CACHE_MAGIC, sizeof (h.magic));
+	h.version		= ABILITIES_CACHE_VERSION;
+	h.abilities_size	= sizeof (CameraAbilities);
+	h.count			= list->count;
+	h.key_size		= keysize;
+	h.abilities_offset	= (sizeof (h) + keysize + 7) & ~7;
+	ok = (fwrite (&h, sizeof (h), 1, f) == 1) &&
+	     (fwrite (key, 1, keysize, f) == keysize) &&
+	     (fwrite (padding, 1, h.abilities_offset - sizeof (h) - keysize, f) ==
+	      h.abilities_offset - sizeof (h) - keysize) &&
+	     (fwrite (sorted, sizeof (CameraAbilities), list->count, f) == (size_t)list->count);
+	ok = !fclose (f) && ok;
+	free (sorted);
+	if (!ok || rename (tmp, path)) {
+		GP_LOG_D ("Could not write abilities cache '%s'.", path);
+		unlink (tmp);
+		return;
+	}
+	GP_LOG_D ("Wrote %d abilities to cache '%s'.", list->count, path);
+}
+
+/* A list taking abilities from the cache gets its own copy before changing. */
+static int
+abilities_list_unmap (CameraAbilitiesList *list)
+{
+	CameraAbilities *abilities;
+
+	if (!list->map)
+		return GP_OK;
+	C_MEM (abilities = malloc ((list->count + 1) * sizeof (CameraAbilities)));
+	memcpy (abilities, list->abilities, list->count * sizeof (CameraAbilities));
+	munmap (list->map, list->mapsize);
+	list->map = NULL;
+	list->abilities = abilities;
+	list->maxcount = list->count + 1;
+	return GP_OK;
+}
+
+static int
+unlocked_gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
+			    GPContext *context)
+{
+	char	path[1024], *key;
+	size_t	keysize;
+	int	ret;
+
+	C_PARAMS (list && dir);
+
+	/* the cache holds what a complete scan of dir loads */
+	if (list->count || (abilities_cache_path (path, sizeof (path)) < GP_OK) ||
+	    (abilities_cache_key (dir, &key, &keysize) < GP_OK))
+		return unlocked_gp_abilities_list_scan_dir (list, dir, context);
+
+	if (abilities_cache_load (list, path, key, keysize) == GP_OK) {
+		free (key);
+		return GP_OK;
+	}
+	ret = unlocked_gp_abilities_list_scan_dir (list, dir, context);
+	if (ret == GP_OK)
+		abilities_cache_save (list, path, key, keysize);
+	free (key);
+	return ret;
+}
+
+#else /* HAVE_SYS_MMAN_H */
+
+static int
+abilities_list_unmap (CameraAbilitiesList *list)
+{
+	return GP_OK;
+}
+
+static int
+unlocked_gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
+			    GPContext *context)
+{
+	return unlocked_gp_abilities_list_scan_dir (list, dir, context);
+}
+
+#endif /* HAVE_SYS_MMAN_H */
+
 int
 gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
 			    GPContext *context)
@@ -348,6 +671,12 @@ gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
  *
  * All supported camera models will then be added to the list.
  *
+ * Loading the abilities of all camera drivers needs to open every one of
+ * them, so the result is cached in the file named by the environment
+ * variable GP_ABILITIES_CACHE (set it empty to disable the cache) or in
+ * the gphoto settings directory. The cache is used as long as no camera
+ * driver changed, a camera driver is then only opened when a camera is
+ * initialized.
  */
 int
 gp_abilities_list_load (CameraAbilitiesList *list, GPContext *context)
@@ -363,70 +692,247 @@ gp_abilities_list_load (CameraAbilitiesList *list, GPContext *context)
 }
 
 
+/* FNV-1a, case insensitive like the model comparisons */
+static unsigned int
+model_hash (const char *model)
+{
+	unsigned int h = 2166136261U;
+
+	while (*model) {
+		h ^= (unsigned char)tolower ((unsigned char)*model++);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static unsigned int
+usb_hash (int vendor, int product)
+{
+	return (((unsigned int)vendor << 16) ^ (unsigned int)product) * 2654435761U;
+}
+
+static void
+abilities_list_drop_index (CameraAbilitiesList *list)
+{
+	free (list->model_slots);
+	free (list->usb_slots);
+	free (list->usb_next);
+	free (list->class_entries);
+	list->model_slots = list->usb_slots = list->usb_next = list->class_entries = NULL;
+	list->model_size = list->usb_size = 0;
+}
+
+static unsigned int
+index_size (int count)
+{
+	unsigned int size;
+
+	for (size = 16; size < 2 * (unsigned int)count; size <<= 1)
+		;
+	return size;
+}
+
+static int
+abilities_list_build_model_index (CameraAbilitiesList *list)
+{
+	unsigned int size, mask, h;
+	int x;
+
+	if (list->model_size)
+		return GP_OK;
+
+	size = index_size (list->count);
+	mask = size - 1;
+	C_MEM (list->model_slots = calloc (size, sizeof (int)));
+	list->model_size = size;
+
+	/* backwards, so the first of equal models wins */
+	for (x = list->count - 1; x >= 0; x--) {
+		const char *model = list->abilities[x].model;
+
+		for (h = model_hash (model) & mask; list->model_slots[h]; h = (h + 1) & mask)
+			if (!strcasecmp (list->abilities[list->model_slots[h] - 1].model, model))
+				break;
+		list->model_slots[h] = x + 1;
+	}
+	return GP_OK;
+}
+
+static int
+abilities_list_build_usb_index (CameraAbilitiesList *list)
+{
+	unsigned int size, mask, h;
+	int x, nclass = 0;
+
+	if (list->usb_size)
+		return GP_OK;
+
+	size = index_size (list->count);
+	mask = size - 1;
+	list->usb_slots = calloc (size, sizeof (int));
+	list->usb_next = calloc (list->count + 1, sizeof (int));
+	list->class_entries = malloc ((list->count + 1) * sizeof (int));
+	if (!list->usb_slots || !list->usb_next || !list->class_entries) {
+		abilities_list_drop_index (list);
+		return GP_ERROR_NO_MEMORY;
+	}
+	list->usb_size = size;
+
+	/* backwards, so the chains of equal ids ascend */
+	for (x = list->count - 1; x >= 0; x--) {
+		const CameraAbilities *a = &list->abilities[x];
+
+		if (!a->usb_vendor)
+			continue;
+		for (h = usb_hash (a->usb_vendor, a->usb_product) & mask; list->usb_slots[h]; h = (h + 1) & mask) {
+			const CameraAbilities *b = &list->abilities[list->usb_slots[h] - 1];
+
+			if ((b->usb_vendor == a->usb_vendor) && (b->usb_product == a->usb_product))
+				break;
+		}
+		list->usb_next[x] = list->usb_slots[h];
+		list->usb_slots[h] = x + 1;
+	}
+	for (x = 0; x < list->count; x++)
+		if (list->abilities[x].usb_class)
+			list->class_entries[nclass++] = x;
+	list->class_entries[nclass] = -1;
+	return GP_OK;
+}
+
+/* The first entry with the ids + 1, or 0 */
+static int
+abilities_list_lookup_usb (CameraAbilitiesList *list, int vendor, int product)
+{
+	unsigned int h, mask = list->usb_size - 1;
+
+	for (h = usb_hash (vendor, product) & mask; list->usb_slots[h]; h = (h + 1) & mask) {
+		const CameraAbilities *a = &list->abilities[list->usb_slots[h] - 1];
+
+		if ((a->usb_vendor == vendor) && (a->usb_product == product))
+			return list->usb_slots[h];
+	}
+	return 0;
+}
+
+static int
+gp_abilities_list_detect_usb_id (CameraAbilitiesList *list, int i,
+				 int *ability, GPPort *port)
+{
+	int res, v, p;
+
+	v = list->abilities[i].usb_vendor;
+	p = list->abilities[i].usb_product;
+	res = gp_port_usb_find_device(port, v, p);
+	if (res == GP_OK) {
+		GP_LOG_D ("Found '%s' (0x%x,0x%x)",
+			list->abilities[i].model, v, p);
+		*ability = i;
+	} else if (res < 0 && res != GP_ERROR_IO_USB_FIND) {
+		/* another error occurred.
+		 * perhaps we should better
+		 * report this to the calling
+		 * method?
+		 */
+		GP_LOG_D (
+			"gp_port_usb_find_device(vendor=0x%x, "
+			"product=0x%x) returned %i, clearing "
+			"error message on port", v, p, res);
+	}
+	return res;
+}
+
+static int
+gp_abilities_list_detect_usb_class (CameraAbilitiesList *list, int i,
+				    int *ability, GPPort *port)
+{
+	int res, c, s, p;
+
+	c = list->abilities[i].usb_class;
+	s = list->abilities[i].usb_subclass;
+	p = list->abilities[i].usb_protocol;
+	res = gp_port_usb_find_device_by_class(port, c, s, p);
+	if (res == GP_OK) {
+		GP_LOG_D ("Found '%s' (0x%x,0x%x,0x%x)",
+			list->abilities[i].model, c, s, p);
+		*ability = i;
+	} else if (res < 0 && res != GP_ERROR_IO_USB_FIND) {
+		/* another error occurred.
+		 * perhaps we should better
+		 * report this to the calling
+		 * method?
+		 */
+		GP_LOG_D (
+			"gp_port_usb_find_device_by_class("
+			"class=0x%x, subclass=0x%x, "
+			"protocol=0x%x) returned %i, "
+			"clearing error message on port",
+			c, s, p, res);
+	}
+	return res;
+}
+
 static int
 gp_abilities_list_detect_usb (CameraAbilitiesList *list,
 			      int *ability, GPPort *port)
 {
 	int i, count, res = GP_ERROR_IO_USB_FIND;
+	int v, p, next, *class;
 
 	CHECK_RESULT (count = gp_abilities_list_count (list));
 
 	/* Detect USB cameras */
 	GP_LOG_D ("Auto-detecting USB cameras...");
 	*ability = -1;
-	for (i = 0; i < count; i++) {
-		int v, p, c, s;
 
-		if (!(list->abilities[i].port & port->type))
-			continue;
+	if (gp_port_usb_get_device_id (port, &v, &p) < GP_OK) {
+		for (i = 0; i < count; i++) {
+			if (!(list->abilities[i].port & port->type))
+				continue;
 
-		v = list->abilities[i].usb_vendor;
-		p = list->abilities[i].usb_product;
-		if (v) {
-			res = gp_port_usb_find_device(port, v, p);
-			if (res == GP_OK) {
-				GP_LOG_D ("Found '%s' (0x%x,0x%x)",
-					list->abilities[i].model, v, p);
-				*ability = i;
-			} else if (res < 0 && res != GP_ERROR_IO_USB_FIND) {
-				/* another error occurred.
-				 * perhaps we should better
-				 * report this to the calling
-				 * method?
-				 */
-				GP_LOG_D (
-					"gp_port_usb_find_device(vendor=0x%x, "
-					"product=0x%x) returned %i, clearing "
-					"error message on port", v, p, res);
+			if (list->abilities[i].usb_vendor) {
+				res = gp_abilities_list_detect_usb_id (list, i, ability, port);
+				if (res != GP_ERROR_IO_USB_FIND)
+					return res;
+			}
+			if (list->abilities[i].usb_class) {
+				res = gp_abilities_list_detect_usb_class (list, i, ability, port);
+				if (res != GP_ERROR_IO_USB_FIND)
+					return res;
 			}
+		}
+		return res;
+	}
 
+	/*
+	 * Knowing the ids of the device, only the entries with these ids
+	 * and those with an interface class can match. They are tried in
+	 * list order as above, so the same entry is found.
+	 */
+	CHECK_RESULT (abilities_list_build_usb_index (list));
+	next = abilities_list_lookup_usb (list, v, p);
+	class = list->class_entries;
+	while (1) {
+		int iid = next ? next - 1 : count;
+		int iclass = (*class >= 0) ? *class : count;
+
+		i = (iid < iclass) ? iid : iclass;
+		if (i >= count)
+			break;
+		if (i == iid)
+			next = list->usb_next[i];
+		if (i == iclass)
+			class++;
+		if (!(list->abilities[i].port & port->type))
+			continue;
+
+		if (i == iid) {
+			res = gp_abilities_list_detect_usb_id (list, i, ability, port);
 			if (res != GP_ERROR_IO_USB_FIND)
 				return res;
 		}
-
-		c = list->abilities[i].usb_class;
-		s = list->abilities[i].usb_subclass;
-		p = list->abilities[i].usb_protocol;
-		if (c) {
-			res = gp_port_usb_find_device_by_class(port, c, s, p);
-			if (res == GP_OK) {
-				GP_LOG_D ("Found '%s' (0x%x,0x%x,0x%x)",
-					list->abilities[i].model, c, s, p);
-				*ability = i;
-			} else if (res < 0 && res != GP_ERROR_IO_USB_FIND) {
-				/* another error occurred.
-				 * perhaps we should better
-				 * report this to the calling
-				 * method?
-				 */
-				GP_LOG_D (
-					"gp_port_usb_find_device_by_class("
-					"class=0x%x, subclass=0x%x, "
-					"protocol=0x%x) returned %i, "
-					"clearing error message on port",
-					c, s, p, res);
-			}
-
+		if (i == iclass) {
+			res = gp_abilities_list_detect_usb_class (list, i, ability, port);
 			if (res != GP_ERROR_IO_USB_FIND)
 				return res;
 		}
@@ -561,6 +1067,8 @@ int
 gp_abilities_list_append (CameraAbilitiesList *list, CameraAbilities abilities)
 {
 	C_PARAMS (list);
+	CHECK_RESULT (abilities_list_unmap (list));
+	abilities_list_drop_index (list);
 
 	if (list->count == list->maxcount) {
 		C_MEM (list->abilities = realloc (list->abilities,
@@ -593,8 +1101,15 @@ gp_abilities_list_reset (CameraAbilitiesList *list)
 {
 	C_PARAMS (list);
 
-	free (list->abilities);
+#ifdef HAVE_SYS_MMAN_H
+	if (list->map) {
+		munmap (list->map, list->mapsize);
+		list->map = NULL;
+	} else
+#endif
+		free (list->abilities);
 	list->abilities = NULL;
+	abilities_list_drop_index (list);
 	list->count = 0;
 	list->maxcount = 0;
 
@@ -628,6 +1143,10 @@ gp_abilities_list_sort (CameraAbilitiesList *list)
 {
 	C_PARAMS (list);
 
+	/* the cache is sorted already, and read only */
+	if (list->map)
+		return (GP_OK);
+	abilities_list_drop_index (list);
 	qsort (list->abilities, list->count, sizeof(CameraAbilities), cmp_abilities);
 	return (GP_OK);
 }
@@ -657,11 +1176,15 @@ gp_abilities_list_lookup_id (CameraAbilitiesList *list, const char *id)
 int
 gp_abilities_list_lookup_model (CameraAbilitiesList *list, const char *model)
 {
-	int x;
+	unsigned int h, mask;
 
 	C_PARAMS (list && model);
+	CHECK_RESULT (abilities_list_build_model_index (list));
+
+	mask = list->model_size - 1;
+	for (h = model_hash (model) & mask; list->model_slots[h]; h = (h + 1) & mask) {
+		int x = list->model_slots[h] - 1;
 
-	for (x = 0; x < list->count; x++) {
 		if (!strcasecmp (list->abilities[x].model, model))
 			return (x);
 	}
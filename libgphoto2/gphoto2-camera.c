@@ -31,6 +31,9 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #include <ltdl.h>
 
@@ -40,12 +43,12 @@
 #include <gphoto2/gphoto2-port-locking.h>
 
 #include "libgphoto2/i18n.h"
+#include "libgphoto2/jpeg-decode.h"
 
 
 #define CAMERA_UNUSED(c,ctx)						\
 {									\
-	(c)->pc->used--;						\
-	if (!(c)->pc->used) {						\
+	if (!camera_unlock (c)) {					\
 		if ((c)->pc->exit_requested)				\
 			gp_camera_exit ((c), (ctx));			\
 		if (!(c)->pc->ref_count)				\
@@ -194,13 +197,24 @@
 
 #define CHECK_INIT(c,ctx)						\
 {									\
-	if ((c)->pc->used)						\
+	if (camera_lock (c) < 0)					\
 		return (GP_ERROR_CAMERA_BUSY);				\
-	(c)->pc->used++;						\
 	if (!(c)->pc->lh)						\
 		CR((c), gp_camera_init (c, ctx), ctx);			\
 }
 
+/* The event pump of a camera, see gp_camera_start_event_pump() */
+typedef struct {
+	Camera          *camera;
+	pthread_t        thread;
+	int              stop;		/* guarded by the camera lock */
+	int              detached;	/* stopped by the pump thread itself */
+	CameraEventFunc  func;
+	void            *data;
+	GPContext       *context;
+	struct timeval   last_event;
+} CameraEventPump;
+
 struct _CameraPrivateCore {
 
 	/* Some information about the port */
@@ -226,8 +240,136 @@ struct _CameraPrivateCore {
 	void                  *timeout_data;
 	unsigned int          *timeout_ids;
 	unsigned int           timeout_ids_len;
+
+	/* Frame ring of a running preview stream */
+	CameraFile           **preview_ring;
+	unsigned int           preview_ring_len;
+	unsigned int           preview_next;
+	GPJpegDecoder         *preview_decoder;
+
+	/* The camera lock: used, owner and waiting, handing the camera over
+	 * between the application and the event pump */
+	pthread_mutex_t        lock;
+	pthread_cond_t         lock_cond;
+	pthread_t              owner;
+	unsigned int           waiting;
+	/* counted and stamped whenever the application releases the camera */
+	unsigned long          activity;
+	struct timeval         activity_time;
+	CameraEventPump       *pump;
 };
 
+static int
+camera_is_pump (CameraPrivateCore *pc)
+{
+	return pc->pump && pthread_equal (pc->pump->thread, pthread_self ());
+}
+
+/*
+ * Takes the camera for an operation, see CHECK_INIT. Without an event pump
+ * a camera in use is just busy, as it always was. With one, threads wait
+ * for each other, and the pump steps back as long as the application
+ * waits for the camera.
+ */
+static int
+camera_lock (Camera *camera)
+{
+	CameraPrivateCore *pc = camera->pc;
+	int result = GP_OK;
+
+	pthread_mutex_lock (&pc->lock);
+	if (pc->used && (!pc->pump || pthread_equal (pc->owner, pthread_self ()))) {
+		result = GP_ERROR_CAMERA_BUSY;
+	} else if (camera_is_pump (pc)) {
+		/* a stopping pump is no longer pc->pump, but stays around */
+		CameraEventPump *pump = pc->pump;
+
+		while ((pc->used || pc->waiting) && !pump->stop)
+			pthread_cond_wait (&pc->lock_cond, &pc->lock);
+		if (pump->stop)
+			result = GP_ERROR_CAMERA_BUSY;
+	} else {
+		pc->waiting++;
+		while (pc->used)
+			pthread_cond_wait (&pc->lock_cond, &pc->lock);
+		pc->waiting--;
+	}
+	if (result == GP_OK) {
+		pc->used++;
+		pc->owner = pthread_self ();
+	}
+	pthread_mutex_unlock (&pc->lock);
+	return result;
+}
+
+/* Releases the camera again, returns whether it is still in use */
+static int
+camera_unlock (Camera *camera)
+{
+	CameraPrivateCore *pc = camera->pc;
+	int used;
+
+	pthread_mutex_lock (&pc->lock);
+	used = --pc->used;
+	if (!used) {
+		if (!camera_is_pump (pc)) {
+			pc->activity++;
+			gettimeofday (&pc->activity_time, NULL);
+		}
+		pthread_cond_broadcast (&pc->lock_cond);
+	}
+	pthread_mutex_unlock (&pc->lock);
+	return used;
+}
+
+static void
+preview_ring_free (Camera *camera)
+{
+	unsigned int i;
+
+	for (i = 0; i < camera->pc->preview_ring_len; i++)
+		gp_file_unref (camera->pc->preview_ring[i]);
+	free (camera->pc->preview_ring);
+	camera->pc->preview_ring = NULL;
+	camera->pc->preview_ring_len = 0;
+	camera->pc->preview_next = 0;
+	gpi_jpeg_decoder_free (camera->pc->preview_decoder);
+	camera->pc->preview_decoder = NULL;
+}
+
+/* Stops the event pump and waits for it, unless called from the pump
+ * thread itself, which then ends after the current event. The reference
+ * of the pump is dropped once it ended, which may free the camera. */
+static void
+event_pump_stop (Camera *camera)
+{
+	CameraPrivateCore *pc = camera->pc;
+	CameraEventPump *pump;
+
+	pthread_mutex_lock (&pc->lock);
+	pump = pc->pump;
+	if (!pump) {
+		pthread_mutex_unlock (&pc->lock);
+		return;
+	}
+	pc->pump = NULL;
+	pump->stop = 1;
+	if (pthread_equal (pump->thread, pthread_self ())) {
+		pump->detached = 1;
+		pthread_detach (pump->thread);
+		pthread_mutex_unlock (&pc->lock);
+		return;
+	}
+	pthread_cond_broadcast (&pc->lock_cond);
+	pthread_mutex_unlock (&pc->lock);
+
+	pthread_join (pump->thread, NULL);
+	if (pump->context)
+		gp_context_unref (pump->context);
+	free (pump);
+	gp_camera_unref (camera);
+}
+
 
 /**
  * Close connection to camera.
@@ -253,15 +395,20 @@ gp_camera_exit (Camera *camera, GPContext *context)
 
 	GP_LOG_D ("Exiting camera ('%s')...", camera->pc->a.model);
 
+	event_pump_stop (camera);
+
 	/*
 	 * We have to postpone this operation if the camera is currently
 	 * in use. gp_camera_exit will be called again if the
 	 * camera->pc->used will drop to zero.
 	 */
+	pthread_mutex_lock (&camera->pc->lock);
 	if (camera->pc->used) {
 		camera->pc->exit_requested = 1;
+		pthread_mutex_unlock (&camera->pc->lock);
 		return (GP_OK);
 	}
+	pthread_mutex_unlock (&camera->pc->lock);
 
 	/* Remove every timeout that is still pending */
 	while (camera->pc->timeout_ids_len)
@@ -269,6 +416,9 @@ gp_camera_exit (Camera *camera, GPContext *context)
 	free (camera->pc->timeout_ids);
 	camera->pc->timeout_ids = NULL;
 
+	/* the driver ends its live view on exit anyway */
+	preview_ring_free (camera);
+
 	if (camera->functions->exit) {
 #ifdef HAVE_MULTI
 		gp_port_open (camera->port);
@@ -312,6 +462,10 @@ gp_camera_new (Camera **camera)
 
 	(*camera)->functions = calloc (1, sizeof (CameraFunctions));
 	(*camera)->pc        = calloc (1, sizeof (CameraPrivateCore));
+	if ((*camera)->pc) {
+		pthread_mutex_init (&(*camera)->pc->lock, NULL);
+		pthread_cond_init (&(*camera)->pc->lock_cond, NULL);
+	}
 	if (!(*camera)->functions || !(*camera)->pc) {
 		result = GP_ERROR_NO_MEMORY;
 		goto error;
@@ -496,7 +650,9 @@ gp_camera_ref (Camera *camera)
 {
 	C_PARAMS (camera);
 
+	pthread_mutex_lock (&camera->pc->lock);
 	camera->pc->ref_count += 1;
+	pthread_mutex_unlock (&camera->pc->lock);
 
 	return (GP_OK);
 }
@@ -515,20 +671,37 @@ gp_camera_ref (Camera *camera)
 int
 gp_camera_unref (Camera *camera)
 {
+	unsigned int ref_count;
+	int pumped;
+
 	C_PARAMS (camera);
 
+	pthread_mutex_lock (&camera->pc->lock);
 	if (!camera->pc->ref_count) {
+		pthread_mutex_unlock (&camera->pc->lock);
 		GP_LOG_E ("gp_camera_unref on a camera with ref_count == 0 "
 			"should not happen at all");
 		return (GP_ERROR);
 	}
+	ref_count = --camera->pc->ref_count;
+	pumped = camera->pc->pump && !camera_is_pump (camera->pc);
+	pthread_mutex_unlock (&camera->pc->lock);
+
+	/* Only the reference of the event pump is left. Stopping the pump
+	 * drops it, which frees the camera. */
+	if ((ref_count == 1) && pumped) {
+		event_pump_stop (camera);
+		return (GP_OK);
+	}
 
-	camera->pc->ref_count -= 1;
-
-	if (!camera->pc->ref_count) {
+	if (!ref_count) {
+		int used;
 
 		/* We cannot free a camera that is currently in use */
-		if (!camera->pc->used)
+		pthread_mutex_lock (&camera->pc->lock);
+		used = camera->pc->used;
+		pthread_mutex_unlock (&camera->pc->lock);
+		if (!used)
 			gp_camera_free (camera);
 	}
 
@@ -567,6 +740,9 @@ gp_camera_free (Camera *camera)
 	}
 
 	if (camera->pc) {
+		event_pump_stop (camera);
+		pthread_mutex_destroy (&camera->pc->lock);
+		pthread_cond_destroy (&camera->pc->lock_cond);
 		free (camera->pc->timeout_ids);
 		free (camera->pc);
 		camera->pc = NULL;
@@ -992,6 +1168,54 @@ out:
 }
 
 
+static int
+_load_config_widget (CameraWidget *widget, void *data, CameraWidget **loaded)
+{
+	const char *name;
+
+	gp_widget_get_name (widget, &name);
+	return gp_camera_get_single_config ((Camera *)data, name, loaded, NULL);
+}
+
+static void
+_unref_config_widget_camera (void *data)
+{
+	gp_camera_unref ((Camera *)data);
+}
+
+/**
+ * Lets a configuration widget be filled in when it is first looked at.
+ *
+ * @param camera a #Camera
+ * @param widget a #CameraWidget with its label and name set
+ * @return a gphoto2 error code
+ *
+ * Camera drivers providing get_single_config can call this in get_config
+ * for widgets which are expensive to fill in, for instance because the
+ * camera has to be asked about them. The first time an application asks
+ * for the type, value, choices, range or readonly state of the \c widget,
+ * it is loaded with #gp_camera_get_single_config under its name. Until
+ * then, it counts as unchanged.
+ *
+ * The \c widget holds a reference to the \c camera until it is freed.
+ *
+ **/
+int
+gp_camera_defer_config_widget (Camera *camera, CameraWidget *widget)
+{
+	int ret;
+
+	C_PARAMS (camera && widget);
+
+	gp_camera_ref (camera);
+	ret = gp_widget_set_load_func (widget, _load_config_widget, camera,
+				       _unref_config_widget_camera);
+	if (ret < GP_OK)
+		gp_camera_unref (camera);
+	return ret;
+}
+
+
 /**
  * Retrieve a configuration \c list for the \c camera.
  *
@@ -1212,6 +1436,84 @@ gp_camera_set_single_config (Camera *camera, const char *name, CameraWidget *wid
 }
 
 
+/**
+ * Sets several configuration values at once.
+ *
+ * @param camera a #Camera
+ * @param values a #CameraList of widget names and their new values
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * The values are given in text form, see gp_widget_set_value_from_string().
+ * All names are looked up and all values parsed before anything is set on
+ * the camera, so a misspelled name, a read-only widget or a value of the
+ * wrong type does not leave a preset half applied. Whether a menu or radio
+ * value is acceptable is left to the driver, as for #gp_camera_set_config,
+ * since drivers may take values not listed as choices. Drivers supporting it
+ * send the values with as few transactions as their protocol allows,
+ * otherwise they are set with one #gp_camera_set_config.
+ *
+ * If the camera refuses a value, the ones before it stay set.
+ *
+ **/
+int
+gp_camera_set_multi_config (Camera *camera, CameraList *values, GPContext *context)
+{
+	CameraWidget	*rootwidget, *child;
+	const char	*name, *value;
+	int		i, n, ro, ret;
+
+	C_PARAMS (camera && values);
+	CHECK_INIT (camera, context);
+
+	if (camera->functions->set_multi_config) {
+		CHECK_RESULT_OPEN_CLOSE (camera, camera->functions->set_multi_config (
+						camera, values, context), context);
+
+		CAMERA_UNUSED (camera, context);
+		return GP_OK;
+	}
+
+	if (!camera->functions->get_config || !camera->functions->set_config) {
+		gp_context_error (context, _("This camera does not provide any configuration options."));
+		CAMERA_UNUSED (camera, context);
+		return GP_ERROR_NOT_SUPPORTED;
+	}
+	/* emulate it with the full tree */
+	CHECK_OPEN (camera, context);
+
+	ret = camera->functions->get_config (camera, &rootwidget, context);
+	if (ret != GP_OK) {
+		CHECK_CLOSE (camera, context);
+		CAMERA_UNUSED (camera, context);
+		return ret;
+	}
+	n = gp_list_count (values);
+	for (i = 0; (ret == GP_OK) && (i < n); i++) {
+		gp_list_get_name (values, i, &name);
+		gp_list_get_value (values, i, &value);
+		ret = gp_widget_get_child_by_name (rootwidget, name, &child);
+		if (ret == GP_OK) {
+			ret = gp_widget_get_readonly (child, &ro);
+			if ((ret == GP_OK) && ro)
+				ret = GP_ERROR_NOT_SUPPORTED;
+		}
+		if (ret == GP_OK)
+			ret = gp_widget_set_value_from_string (child, value ? value : "");
+		if (ret == GP_OK)
+			gp_widget_set_changed (child, 1);
+		else
+			gp_context_error (context, _("Could not set '%s' to '%s'."), name, value ? value : "");
+	}
+	if (ret == GP_OK)
+		ret = camera->functions->set_config (camera, rootwidget, context);
+	gp_widget_free (rootwidget);
+	CHECK_CLOSE (camera, context);
+	CAMERA_UNUSED (camera, context);
+	return ret;
+}
+
+
 /**
  * Retrieves a camera summary.
  *
@@ -1408,6 +1710,214 @@ gp_camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 	return (GP_OK);
 }
 
+/**
+ * Starts continuous live view.
+ *
+ * @param camera a #Camera
+ * @param frames number of frames in the ring, at least 1
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Allocates a ring of frame files and lets the driver set up live view
+ * once. gp_camera_get_preview_frame() then reads frame after frame into
+ * the ring, skipping the setup gp_camera_capture_preview() does each
+ * time, and without allocating memory once the frame buffers have grown
+ * to the frame size.
+ *
+ * Drivers without streaming support get their frames through
+ * gp_camera_capture_preview() as before, still into the ring.
+ *
+ * Stop it with gp_camera_stop_preview_stream(), gp_camera_exit() does so
+ * too.
+ **/
+int
+gp_camera_start_preview_stream (Camera *camera, unsigned int frames,
+				GPContext *context)
+{
+	CameraFile	**ring;
+	unsigned int	i;
+	int		ret;
+
+	C_PARAMS (camera && frames);
+	if (camera->pc->preview_ring)
+		return (GP_ERROR_CAMERA_BUSY);
+	CHECK_INIT (camera, context);
+
+	if (!camera->functions->preview_frame && !camera->functions->capture_preview) {
+		gp_context_error (context, _("This camera can "
+			"not capture previews."));
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NOT_SUPPORTED);
+	}
+
+	ring = calloc (frames, sizeof (CameraFile*));
+	if (!ring) {
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NO_MEMORY);
+	}
+	for (i = 0; i < frames; i++) {
+		ret = gp_file_new (&ring[i]);
+		if (ret < GP_OK) {
+			while (i--)
+				gp_file_unref (ring[i]);
+			free (ring);
+			CAMERA_UNUSED (camera, context);
+			return (ret);
+		}
+	}
+	camera->pc->preview_ring = ring;
+	camera->pc->preview_ring_len = frames;
+	camera->pc->preview_next = 0;
+
+	if (camera->functions->preview_stream) {
+		CHECK_OPEN (camera, context);
+		ret = camera->functions->preview_stream (camera, 1, context);
+		if (ret < GP_OK) {
+			GP_LOG_E ("'%s' failed: %d", "preview_stream", ret);
+			preview_ring_free (camera);
+			CHECK_CLOSE (camera, context);
+			CAMERA_UNUSED (camera, context);
+			return (ret);
+		}
+		CHECK_CLOSE (camera, context);
+	}
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
+/**
+ * Reads the next live view frame.
+ *
+ * @param camera a #Camera
+ * @param frame pointer receiving the frame
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * The frame belongs to the ring of the preview stream started with
+ * gp_camera_start_preview_stream(), do not free it. It stays valid
+ * until the ring comes around to it again, i.e. for as many more
+ * calls as the ring has frames minus one, or until the stream stops.
+ **/
+int
+gp_camera_get_preview_frame (Camera *camera, CameraFile **frame,
+			     GPContext *context)
+{
+	CameraFile *file;
+
+	C_PARAMS (camera && frame);
+	C_PARAMS (camera->pc->preview_ring);
+	CHECK_INIT (camera, context);
+
+	file = camera->pc->preview_ring[camera->pc->preview_next];
+	CR (camera, gp_file_reset (file), context);
+
+	if (camera->functions->preview_frame) {
+		CHECK_RESULT_OPEN_CLOSE (camera, camera->functions->preview_frame (
+						camera, file, context), context);
+	} else {
+		CHECK_RESULT_OPEN_CLOSE (camera, camera->functions->capture_preview (
+						camera, file, context), context);
+	}
+	camera->pc->preview_next = (camera->pc->preview_next + 1) % camera->pc->preview_ring_len;
+	*frame = file;
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
+/**
+ * Reads the next live view frame, decoded.
+ *
+ * @param camera a #Camera
+ * @param format the #CameraPreviewFormat to decode into
+ * @param scale 1, 2, 4 or 8 to divide width and height by
+ * @param buffer the buffer receiving the pixels
+ * @param size size of buffer
+ * @param width receives the width of the frame
+ * @param height receives the height of the frame
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Like gp_camera_get_preview_frame(), but decodes the JPEG frame into
+ * the caller's buffer. The scale is applied while decoding, the frame is
+ * never decoded at full size. A #GP_PREVIEW_FORMAT_RGB24 frame needs
+ * width * height * 3 bytes, a #GP_PREVIEW_FORMAT_YUV420P one
+ * width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2).
+ *
+ * If the buffer is too small, width and height are still set and
+ * #GP_ERROR_FIXED_LIMIT_EXCEEDED is returned, the frame is lost. Frames
+ * that are no JPEG give #GP_ERROR_NOT_SUPPORTED, as does a libgphoto2
+ * built without libjpeg.
+ **/
+int
+gp_camera_get_preview_image (Camera *camera, CameraPreviewFormat format,
+			     unsigned int scale, unsigned char *buffer,
+			     unsigned long size, unsigned int *width,
+			     unsigned int *height, GPContext *context)
+{
+	CameraFile	*frame;
+	const char	*data;
+	unsigned long	datasize;
+	int		ret;
+
+	C_PARAMS (camera && buffer && width && height);
+	C_PARAMS ((scale == 1) || (scale == 2) || (scale == 4) || (scale == 8));
+	C_PARAMS ((format == GP_PREVIEW_FORMAT_RGB24) || (format == GP_PREVIEW_FORMAT_YUV420P));
+	C_PARAMS (camera->pc->preview_ring);
+
+	if (!camera->pc->preview_decoder) {
+		ret = gpi_jpeg_decoder_new (&camera->pc->preview_decoder);
+		if (ret == GP_ERROR_NOT_SUPPORTED)
+			gp_context_error (context, _("Decoding live view "
+				"frames needs libgphoto2 built with libjpeg."));
+		if (ret < GP_OK)
+			return (ret);
+	}
+
+	ret = gp_camera_get_preview_frame (camera, &frame, context);
+	if (ret < GP_OK)
+		return (ret);
+	ret = gp_file_get_data_and_size (frame, &data, &datasize);
+	if (ret < GP_OK)
+		return (ret);
+	ret = gpi_jpeg_decode (camera->pc->preview_decoder,
+			       (const unsigned char *)data, datasize, format,
+			       scale, buffer, size, width, height);
+	if (ret < GP_OK)
+		GP_LOG_D ("Could not decode the %lu byte live view frame: %d",
+			  datasize, ret);
+	return (ret);
+}
+
+/**
+ * Stops continuous live view.
+ *
+ * @param camera a #Camera
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Frees the frame ring, frames handed out before are gone afterwards.
+ * Stopping a camera without a running preview stream does nothing.
+ **/
+int
+gp_camera_stop_preview_stream (Camera *camera, GPContext *context)
+{
+	C_PARAMS (camera);
+
+	if (!camera->pc->preview_ring)
+		return (GP_OK);
+	CHECK_INIT (camera, context);
+
+	preview_ring_free (camera);
+	if (camera->functions->preview_stream)
+		CHECK_RESULT_OPEN_CLOSE (camera, camera->functions->preview_stream (
+						camera, 0, context), context);
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
 
 /**
  * Wait and retrieve an event from the camera.
@@ -1430,13 +1940,23 @@ gp_camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
  * Note that this function will return one event after each other, you need
  * to be able to call it multiple times, e.g. in a loop, when waiting for specific
  * events.
+ *
+ * While an event pump runs, the events go to its callback and this function
+ * gives #GP_ERROR_CAMERA_BUSY.
  */
 int
 gp_camera_wait_for_event (Camera *camera, int timeout,
 			  CameraEventType *eventtype, void **eventdata,
 			  GPContext *context)
 {
+	int pumped;
+
 	C_PARAMS (camera);
+	pthread_mutex_lock (&camera->pc->lock);
+	pumped = camera->pc->pump && !camera_is_pump (camera->pc);
+	pthread_mutex_unlock (&camera->pc->lock);
+	if (pumped)
+		return (GP_ERROR_CAMERA_BUSY);
 	CHECK_INIT (camera, context);
 
 	if (!camera->functions->wait_for_event) {
@@ -1450,6 +1970,272 @@ gp_camera_wait_for_event (Camera *camera, int timeout,
 	return (GP_OK);
 }
 
+/*
+ * Cameras without event_ready get polled by the event pump. Right after an
+ * event or a camera operation (e.g. a capture) new events are likely, so
+ * the pump polls every few milliseconds for a while, then backs off.
+ */
+#define PUMP_POLL_MIN		2
+#define PUMP_POLL_MAX		100
+#define PUMP_HOT_PERIOD		3000
+
+static long
+timeval_ms_since (const struct timeval *tv)
+{
+	struct timeval now;
+
+	gettimeofday (&now, NULL);
+	return (now.tv_sec - tv->tv_sec) * 1000 + (now.tv_usec - tv->tv_usec) / 1000;
+}
+
+static int
+event_pump_interval (CameraEventPump *pump)
+{
+	CameraPrivateCore *pc = pump->camera->pc;
+	long idle, since_event;
+
+	pthread_mutex_lock (&pc->lock);
+	idle = timeval_ms_since (&pc->activity_time);
+	pthread_mutex_unlock (&pc->lock);
+	since_event = timeval_ms_since (&pump->last_event);
+	if (since_event < idle)
+		idle = since_event;
+
+	if (idle < PUMP_HOT_PERIOD)
+		return PUMP_POLL_MIN;
+	idle = PUMP_POLL_MIN + (idle - PUMP_HOT_PERIOD) / 16;
+	return (idle < PUMP_POLL_MAX) ? idle : PUMP_POLL_MAX;
+}
+
+/* Sleeps, but wakes up as soon as the application is done with the camera
+ * or the pump gets stopped. Returns whether the pump got stopped. */
+static int
+event_pump_sleep (CameraEventPump *pump, unsigned long *activity, int ms)
+{
+	CameraPrivateCore *pc = pump->camera->pc;
+	struct timeval now;
+	struct timespec until;
+	int stop;
+
+	gettimeofday (&now, NULL);
+	until.tv_sec  = now.tv_sec + ms / 1000;
+	until.tv_nsec = (now.tv_usec + (ms % 1000) * 1000) * 1000L;
+	if (until.tv_nsec >= 1000000000L) {
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock (&pc->lock);
+	while (!pump->stop && (pc->activity == *activity))
+		if (pthread_cond_timedwait (&pc->lock_cond, &pc->lock, &until) == ETIMEDOUT)
+			break;
+	stop = pump->stop;
+	pthread_mutex_unlock (&pc->lock);
+	return stop;
+}
+
+/* Whether the pump got stopped, and whether the application did something
+ * with the camera since *activity */
+static int
+event_pump_check (CameraEventPump *pump, unsigned long *activity, int *active)
+{
+	CameraPrivateCore *pc;
+	int stop;
+
+	if (pump->detached)
+		return 1;
+	pc = pump->camera->pc;
+	pthread_mutex_lock (&pc->lock);
+	stop = pump->stop;
+	*active = (pc->activity != *activity);
+	*activity = pc->activity;
+	pthread_mutex_unlock (&pc->lock);
+	return stop;
+}
+
+static void *
+event_pump_thread (void *arg)
+{
+	CameraEventPump *pump = arg;
+	Camera *camera = pump->camera;
+	CameraEventType type;
+	unsigned long activity = 0;
+	struct timeval start;
+	void *data;
+	int ready = 1, active, r;
+
+	while (!event_pump_check (pump, &activity, &active)) {
+		/* an operation might have left events behind in the driver */
+		if (active)
+			ready = 1;
+
+		if (!ready) {
+			gettimeofday (&start, NULL);
+			if (camera->functions->event_ready)
+				r = camera->functions->event_ready (camera,
+						PUMP_POLL_MAX, pump->context);
+			else
+				r = GP_ERROR_NOT_SUPPORTED;
+			switch (r) {
+			case GP_OK:
+				ready = 1;
+				break;
+			case GP_ERROR_TIMEOUT:
+				/* some ports cannot wait, poll them as if the camera
+				 * had no event_ready */
+				if (timeval_ms_since (&start) < PUMP_POLL_MIN)
+					event_pump_sleep (pump, &activity, event_pump_interval (pump));
+				break;
+			case GP_ERROR_NOT_SUPPORTED:
+				event_pump_sleep (pump, &activity, event_pump_interval (pump));
+				ready = 1;
+				break;
+			default:
+				GP_LOG_E ("Waiting for camera events failed: %d", r);
+				event_pump_sleep (pump, &activity, PUMP_POLL_MAX);
+				break;
+			}
+			continue;
+		}
+
+		data = NULL;
+		r = gp_camera_wait_for_event (camera, 0, &type, &data, pump->context);
+		if (pump->detached) {
+			/* exited when the pump released the camera */
+			free (data);
+			break;
+		}
+		if (r == GP_ERROR_CAMERA_BUSY)
+			continue;
+		if (r < GP_OK) {
+			GP_LOG_E ("Polling camera events failed: %d", r);
+			event_pump_sleep (pump, &activity, PUMP_POLL_MAX);
+			ready = 0;
+			continue;
+		}
+		if (type == GP_EVENT_TIMEOUT) {
+			ready = 0;
+			continue;
+		}
+		gettimeofday (&pump->last_event, NULL);
+		pump->func (camera, type, data, pump->data);
+		free (data);
+	}
+
+	/* stopped from the pump thread, nobody joins it */
+	if (pump->detached) {
+		if (pump->context)
+			gp_context_unref (pump->context);
+		free (pump);
+		gp_camera_unref (camera);
+	}
+	return NULL;
+}
+
+/**
+ * Starts an event pump for the camera.
+ *
+ * @param camera a #Camera
+ * @param func called for every event
+ * @param data passed to func
+ * @param context a #GPContext, used by the pump thread
+ * @return a gphoto2 error code
+ *
+ * The event pump is a thread that waits for the events of the camera and
+ * hands each one to func the moment it arrives, instead of the application
+ * polling gp_camera_wait_for_event(). Cameras sending their events over
+ * USB interrupts are waited for while other camera operations run, cameras
+ * which have to be asked for events (e.g. Canon EOS) get polled, every few
+ * milliseconds after an event or operation and less often when idle.
+ *
+ * The camera stays usable from other threads, they wait for the pump
+ * instead of failing with #GP_ERROR_CAMERA_BUSY. func runs in the pump
+ * thread and may use the camera, but must not free it. The pump keeps a
+ * reference to the camera, dropping the last other one stops the pump.
+ */
+int
+gp_camera_start_event_pump (Camera *camera, CameraEventFunc func,
+			    void *data, GPContext *context)
+{
+	CameraEventPump *pump;
+	int ret;
+
+	C_PARAMS (camera && func);
+	pthread_mutex_lock (&camera->pc->lock);
+	ret = camera->pc->pump ? GP_ERROR_CAMERA_BUSY : GP_OK;
+	pthread_mutex_unlock (&camera->pc->lock);
+	if (ret < GP_OK)
+		return ret;
+	CHECK_INIT (camera, context);
+
+	if (!camera->functions->wait_for_event) {
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NOT_SUPPORTED);
+	}
+
+	pump = calloc (1, sizeof (CameraEventPump));
+	if (!pump) {
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NO_MEMORY);
+	}
+	pump->camera  = camera;
+	pump->func    = func;
+	pump->data    = data;
+	pump->context = context;
+	if (context)
+		gp_context_ref (context);
+
+	/* the pump looks for itself in pc->pump, and keeps the camera
+	 * referenced until it ended */
+	pthread_mutex_lock (&camera->pc->lock);
+	if (camera->pc->pump) {
+		/* started by another thread meanwhile */
+		pthread_mutex_unlock (&camera->pc->lock);
+		if (context)
+			gp_context_unref (context);
+		free (pump);
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_CAMERA_BUSY);
+	}
+	ret = pthread_create (&pump->thread, NULL, event_pump_thread, pump);
+	if (!ret) {
+		camera->pc->pump = pump;
+		camera->pc->ref_count++;
+	}
+	pthread_mutex_unlock (&camera->pc->lock);
+	if (ret) {
+		GP_LOG_E ("Could not start the event pump: %s", strerror (ret));
+		if (context)
+			gp_context_unref (context);
+		free (pump);
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_OS_FAILURE);
+	}
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
+/**
+ * Stops the event pump of the camera.
+ *
+ * @param camera a #Camera
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Waits for an event being delivered, so it must not be called from a
+ * thread func waits for. Called from func itself, the pump ends after it.
+ * gp_camera_exit() stops the pump as well.
+ */
+int
+gp_camera_stop_event_pump (Camera *camera, GPContext *context)
+{
+	C_PARAMS (camera);
+
+	event_pump_stop (camera);
+	return (GP_OK);
+}
+
 /**
  * Lists the files in supplied \c folder.
  *
@@ -1693,6 +2479,45 @@ gp_camera_file_get (Camera *camera, const char *folder, const char *file,
 	return (GP_OK);
 }
 
+/**
+ * Retrieves several files from the #Camera.
+ *
+ * @param camera a #Camera
+ * @param count the number of files
+ * @param folders the folder of each file
+ * @param files the name of each file
+ * @param type the #CameraFileType
+ * @param open_func supplies the #CameraFile of each download, or NULL for memory files
+ * @param done_func called with each finished file and its result, may be NULL
+ * @param data passed to open_func and done_func
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Drivers that support it prepare the whole batch at once and fetch the
+ * files back to back, see gp_filesystem_get_files() for the details.
+ *
+ **/
+int
+gp_camera_files_get (Camera *camera, int count,
+		     const char *folders[], const char *files[],
+		     CameraFileType type,
+		     CameraFileBatchOpenFunc open_func,
+		     CameraFileBatchDoneFunc done_func,
+		     void *data, GPContext *context)
+{
+	GP_LOG_D ("Getting %i files...", count);
+
+	C_PARAMS (camera && (count >= 0) && (!count || (folders && files)));
+	CHECK_INIT (camera, context);
+
+	CHECK_RESULT_OPEN_CLOSE (camera, gp_filesystem_get_files (camera->fs,
+			count, folders, files, type, open_func, done_func,
+			data, context), context);
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
 /**
  * Reads a file partially from the #Camera.
  *
@@ -67,6 +67,8 @@ struct _CameraFile {
 	unsigned long	size;
 	unsigned char	*data;
 	unsigned long	offset;	/* read pointer */
+	unsigned long	capacity;	/* bytes available at data */
+	int		foreign;	/* data is a caller supplied buffer, never freed or grown */
 
 	/* for GP_FILE_ACCESSTYPE_FD files */
 	int		fd;
@@ -140,6 +142,87 @@ gp_file_new_from_handler (CameraFile **file, CameraFileHandler* handler, void*pr
 	return (GP_OK);
 }
 
+/*! Create new #CameraFile object storing its data in a caller supplied buffer.
+ *
+ * Downloads go straight into the buffer, which can be malloc()ed, static or
+ * a mmap()ed region of a file. The buffer stays owned by the caller and must
+ * outlive the CameraFile. Data not fitting into size bytes fails with
+ * #GP_ERROR_NO_MEMORY. gp_file_get_data_and_size() returns a pointer into
+ * the buffer.
+ *
+ * \param file a pointer to a #CameraFile
+ * \param buffer the memory to receive the file data
+ * \param size the size of buffer in bytes
+ * \return a gphoto2 error code.
+ */
+int
+gp_file_new_from_buffer (CameraFile **file, char *buffer, unsigned long int size)
+{
+	C_PARAMS (file && (buffer || !size));
+
+	C_MEM (*file = calloc (1, sizeof (CameraFile)));
+
+	strcpy ((*file)->mime_type, "unknown/unknown");
+	(*file)->ref_count = 1;
+	(*file)->accesstype = GP_FILE_ACCESSTYPE_MEMORY;
+	(*file)->data = (unsigned char*)buffer;
+	(*file)->capacity = size;
+	(*file)->foreign = 1;
+	return (GP_OK);
+}
+
+/* empties a memory file, a caller supplied buffer is kept */
+static void
+memory_clear (CameraFile *file)
+{
+	if (!file->foreign) {
+		free (file->data);
+		file->data = NULL;
+		file->capacity = 0;
+	}
+	file->size = 0;
+}
+
+/* resizes the data of a memory file we own */
+static int
+memory_realloc (CameraFile *file, unsigned long int capacity)
+{
+	unsigned char	*data;
+
+	C_MEM (data = realloc (file->data, sizeof (char) * capacity));
+	file->data = data;
+	file->capacity = capacity;
+	return GP_OK;
+}
+
+/* makes room for size more bytes behind the data of a memory file */
+static int
+memory_reserve (CameraFile *file, unsigned long int size)
+{
+	unsigned long int	capacity;
+
+	if (size <= file->capacity - file->size)
+		return GP_OK;
+	if (file->foreign) {
+		GP_LOG_E ("%lu bytes do not fit into the %lu bytes buffer (%lu used).",
+			  size, file->capacity, file->size);
+		return GP_ERROR_NO_MEMORY;
+	}
+	/* grow geometrically, so appending many small chunks stays linear */
+	capacity = file->capacity * 2;
+	if (capacity < file->size + size)
+		capacity = file->size + size;
+	return memory_realloc (file, capacity);
+}
+
+/* empties a memory file and makes room for size bytes */
+static int
+memory_replace (CameraFile *file, unsigned long int size)
+{
+	memory_clear (file);
+	return memory_reserve (file, size);
+}
+
 
 
 /*! \brief descruct a #CameraFile object.
@@ -212,8 +295,10 @@ gp_file_append (CameraFile *file, const char *data,
 
 	switch (file->accesstype) {
 	case GP_FILE_ACCESSTYPE_MEMORY:
-		C_MEM (file->data = realloc (file->data, sizeof (char) * (file->size + size)));
-		memcpy (&file->data[file->size], data, size);
+		CHECK_RESULT (memory_reserve (file, size));
+		/* data received into gp_file_get_append_buffer() memory is already in place */
+		if (data != (char*)&file->data[file->size])
+			memmove (&file->data[file->size], data, size);
 		file->size += size;
 		break;
 	case GP_FILE_ACCESSTYPE_FD: {
@@ -245,6 +330,60 @@ gp_file_append (CameraFile *file, const char *data,
 	return (GP_OK);
 }
 
+/**
+ * @param file a #CameraFile
+ * @param size the expected total size of the file in bytes
+ * @return a gphoto2 error code.
+ *
+ * Size hint for drivers knowing the file size before downloading it.
+ * Memory based files allocate room for size bytes at once, so the
+ * following gp_file_append() calls do not need to grow the data.
+ * Other files ignore the hint.
+ *
+ * Public API for camera drivers, exported from the library.
+ **/
+int
+gp_file_reserve (CameraFile *file, unsigned long int size)
+{
+	C_PARAMS (file);
+
+	if ((file->accesstype != GP_FILE_ACCESSTYPE_MEMORY) || (size <= file->capacity))
+		return (GP_OK);
+	if (file->foreign) {
+		GP_LOG_E ("%lu bytes do not fit into the %lu bytes buffer.", size, file->capacity);
+		return GP_ERROR_NO_MEMORY;
+	}
+	return memory_realloc (file, size);
+}
+
+/**
+ * @param file a #CameraFile
+ * @param size the number of bytes about to be appended
+ * @param buffer pointer receiving where to put them
+ * @return a gphoto2 error code.
+ *
+ * Makes room for size more bytes in a memory based #CameraFile and
+ * returns the place where they go, so a driver can receive data there
+ * directly. Passing (part of) that memory on to gp_file_append()
+ * afterwards only adjusts the file size, no data is copied.
+ *
+ * Files not kept in memory return #GP_ERROR_NOT_SUPPORTED. The buffer
+ * stays valid until the next call that changes the file.
+ *
+ * Public API for camera drivers, exported from the library.
+ **/
+int
+gp_file_get_append_buffer (CameraFile *file, unsigned long int size, char **buffer)
+{
+	C_PARAMS (file && buffer);
+
+	if (file->accesstype != GP_FILE_ACCESSTYPE_MEMORY)
+		return GP_ERROR_NOT_SUPPORTED;
+	CHECK_RESULT (memory_reserve (file, size));
+	*buffer = (char*)&file->data[file->size];
+	return (GP_OK);
+}
+
 /**
  * @param file a #CameraFile
  * @param data
@@ -320,9 +459,23 @@ gp_file_set_data_and_size (CameraFile *file, char *data,
 
 	switch (file->accesstype) {
 	case GP_FILE_ACCESSTYPE_MEMORY:
+		if (file->foreign) {
+			if (size > file->capacity) {
+				GP_LOG_E ("%lu bytes do not fit into the %lu bytes buffer.", size, file->capacity);
+				free (data);
+				return GP_ERROR_NO_MEMORY;
+			}
+			if (data != (char*)file->data) {
+				memcpy (file->data, data, size);
+				free (data);
+			}
+			file->size = size;
+			break;
+		}
 		free (file->data);
 		file->data = (unsigned char*)data;
 		file->size = size;
+		file->capacity = size;
 		break;
 	case GP_FILE_ACCESSTYPE_FD: {
 		unsigned int curwritten = 0;
@@ -612,7 +765,8 @@ gp_file_open (CameraFile *file, const char *filename)
 {
 	FILE *fp;
 	const char *name, *dot;
-	long size, size_read;
+	long size;
+	unsigned long size_read;
 	int  i;
 	struct stat s;
 
@@ -629,11 +783,12 @@ gp_file_open (CameraFile *file, const char *filename)
 	rewind (fp);
 
 	switch (file->accesstype) {
-	case GP_FILE_ACCESSTYPE_MEMORY:
-		file->data = malloc (sizeof(char)*(size + 1));
-		if (!file->data) {
+	case GP_FILE_ACCESSTYPE_MEMORY: {
+		int ret = memory_replace (file, file->foreign ? size : size + 1);
+
+		if (ret < GP_OK) {
 			fclose (fp);
-			return (GP_ERROR_NO_MEMORY);
+			return ret;
 		}
 		size_read = fread (file->data, (size_t)sizeof(char), (size_t)size, fp);
 		if (ferror(fp)) {
@@ -643,8 +798,10 @@ gp_file_open (CameraFile *file, const char *filename)
 		}
 		fclose(fp);
 		file->size = size_read;
-		file->data[size_read] = 0;
+		if (size_read < file->capacity)
+			file->data[size_read] = 0;
 		break;
+	}
 	case GP_FILE_ACCESSTYPE_FD: {
 		if (file->fd == -1) {
 			file->fd = dup(fileno(fp));
@@ -716,9 +873,7 @@ gp_file_clean (CameraFile *file)
 
 	switch (file->accesstype) {
 	case GP_FILE_ACCESSTYPE_MEMORY:
-		free (file->data);
-		file->data = NULL;
-		file->size = 0;
+		memory_clear (file);
 		break;
 	case GP_FILE_ACCESSTYPE_FD:
 		break;
@@ -728,6 +883,23 @@ gp_file_clean (CameraFile *file)
 	return (GP_OK);
 }
 
+/*
+ * Empties a file like gp_file_clean(), but a memory file keeps its
+ * memory for the next data. Used for the frames of preview streams.
+ */
+int
+gp_file_reset (CameraFile *file)
+{
+	C_PARAMS (file);
+
+	if (file->accesstype == GP_FILE_ACCESSTYPE_MEMORY) {
+		file->size = 0;
+		file->offset = 0;
+	}
+	strcpy (file->name, "");
+	return (GP_OK);
+}
+
 /**
  * @param destination a #CameraFile
  * @param source a #CameraFile
@@ -748,11 +920,9 @@ gp_file_copy (CameraFile *destination, CameraFile *source)
 
 	if ((destination->accesstype == GP_FILE_ACCESSTYPE_MEMORY) &&
 	    (source->accesstype == GP_FILE_ACCESSTYPE_MEMORY)) {
-		free (destination->data);
-		destination->data = NULL;
-		destination->size = source->size;
-		C_MEM (destination->data = malloc (sizeof (char) * source->size));
+		CHECK_RESULT (memory_replace (destination, source->size));
 		memcpy (destination->data, source->data, source->size);
+		destination->size = source->size;
 		return (GP_OK);
 	}
 	if (	(destination->accesstype == GP_FILE_ACCESSTYPE_MEMORY) &&
@@ -761,8 +931,7 @@ gp_file_copy (CameraFile *destination, CameraFile *source)
 		off_t	offset;
 		off_t	curread = 0;
 
-		free (destination->data);
-		destination->data = NULL;
+		memory_clear (destination);
 
 		if (-1 == lseek (source->fd, 0, SEEK_END)) {
 			if (errno == EBADF) return GP_ERROR_IO;
@@ -779,22 +948,22 @@ gp_file_copy (CameraFile *destination, CameraFile *source)
 			GP_LOG_E ("Encountered error %d lseekin to CUR.", errno);
 			return GP_ERROR_IO_READ;
 		}
-		destination->size = offset;
-		C_MEM (destination->data = malloc (offset));
+		CHECK_RESULT (memory_reserve (destination, offset));
 		while (curread < offset) {
 			ssize_t res = read (source->fd, destination->data+curread, offset-curread);
 			if (res == -1) {
-				free (destination->data);
+				memory_clear (destination);
 				GP_LOG_E ("Encountered error %d reading.", errno);
 				return GP_ERROR_IO_READ;
 			}
 			if (res == 0) {
-				free (destination->data);
+				memory_clear (destination);
 				GP_LOG_E ("No progress during reading.");
 				return GP_ERROR_IO_READ;
 			}
 			curread += res;
 		}
+		destination->size = offset;
 		return GP_OK;
 	}
 	if (	(destination->accesstype == GP_FILE_ACCESSTYPE_FD) &&
@@ -65,9 +65,26 @@ typedef struct _CameraFilesystemFile {
 	CameraFile *exif;
 	CameraFile *metadata;
 
-	struct _CameraFilesystemFile *next; /* in folder */
+	unsigned int pos; /* in folder->files */
 } CameraFilesystemFile;
 
+/*
+ * Name -> entry hash table (open addressing, linear probing), so that
+ * path lookups do not scan folders with thousands of files.
+ * The names are owned by the entries.
+ */
+typedef struct {
+	unsigned int hash;
+	const char *name;
+	void *entry;
+} CameraFilesystemIndexSlot;
+
+typedef struct {
+	CameraFilesystemIndexSlot *slots;
+	unsigned int size; /* power of 2, or 0 if nothing allocated yet */
+	unsigned int count;
+} CameraFilesystemIndex;
+
 typedef struct _CameraFilesystemFolder {
 	char *name;
 
@@ -76,7 +93,13 @@ typedef struct _CameraFilesystemFolder {
 
 	struct _CameraFilesystemFolder *next; /* chain in same folder */
 	struct _CameraFilesystemFolder *folders; /* childchain of this folder */
-	struct _CameraFilesystemFile *files; /* of this folder */
+	CameraFilesystemIndex folders_index; /* of the childchain */
+
+	/* files of this folder in listing order, the array index is the file number */
+	struct _CameraFilesystemFile **files;
+	unsigned int nfiles;
+	unsigned int maxfiles;
+	CameraFilesystemIndex files_index;
 } CameraFilesystemFolder;
 
 /**
@@ -242,6 +265,7 @@ struct _CameraFilesystem {
 	CameraFilesystemDirFunc make_dir_func;
 	CameraFilesystemDirFunc remove_dir_func;
 	CameraFilesystemStorageInfoFunc	storage_info_func;
+	CameraFilesystemGetFilesFunc get_files_func;
 
 	void *data;
 };
@@ -286,49 +310,181 @@ struct _CameraFilesystem {
 	}								\
 }
 
-static int
-delete_all_files (CameraFilesystem *fs, CameraFilesystemFolder *folder)
+/* FNV-1a over the first len bytes of name */
+static unsigned int
+index_hash (const char *name, size_t len)
 {
-	CameraFilesystemFile	*file;
+	unsigned int h = 2166136261U;
 
-	C_PARAMS (folder);
-	GP_LOG_D ("Delete all files in folder %p/%s", folder, folder->name);
+	while (len--) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h;
+}
 
-	file = folder->files;
-	while (file) {
-		CameraFilesystemFile	*next;
-		/* Get rid of cached files */
-		gp_filesystem_lru_remove_one (fs, file);
-		if (file->preview) {
-			gp_file_unref (file->preview);
-			file->preview = NULL;
-		}
-		if (file->normal) {
-			gp_file_unref (file->normal);
-			file->normal = NULL;
-		}
-		if (file->raw) {
-			gp_file_unref (file->raw);
-			file->raw = NULL;
-		}
-		if (file->audio) {
-			gp_file_unref (file->audio);
-			file->audio = NULL;
-		}
-		if (file->exif) {
-			gp_file_unref (file->exif);
-			file->exif = NULL;
-		}
-		if (file->metadata) {
-			gp_file_unref (file->metadata);
-			file->metadata = NULL;
+static void*
+index_lookup (CameraFilesystemIndex *idx, const char *name, size_t len)
+{
+	unsigned int hash, i;
+
+	if (!idx->count)
+		return NULL;
+	hash = index_hash (name, len);
+	for (i = hash & (idx->size - 1); idx->slots[i].name; i = (i + 1) & (idx->size - 1)) {
+		if (	(idx->slots[i].hash == hash) &&
+			!strncmp (idx->slots[i].name, name, len) &&
+			!idx->slots[i].name[len]
+		)
+			return idx->slots[i].entry;
+	}
+	return NULL;
+}
+
+static void
+index_put (CameraFilesystemIndex *idx, unsigned int hash, const char *name, void *entry)
+{
+	unsigned int i;
+
+	for (i = hash & (idx->size - 1); idx->slots[i].name; i = (i + 1) & (idx->size - 1))
+		;
+	idx->slots[i].hash  = hash;
+	idx->slots[i].name  = name;
+	idx->slots[i].entry = entry;
+	idx->count++;
+}
+
+static int
+index_insert (CameraFilesystemIndex *idx, const char *name, void *entry)
+{
+	/* keep the load factor below 1/2 */
+	if (2 * (idx->count + 1) > idx->size) {
+		CameraFilesystemIndex	old = *idx;
+		unsigned int		i;
+
+		idx->size = old.size ? old.size * 2 : 16;
+		idx->count = 0;
+		idx->slots = calloc (idx->size, sizeof (CameraFilesystemIndexSlot));
+		if (!idx->slots) {
+			*idx = old;
+			return GP_ERROR_NO_MEMORY;
 		}
-		next = file->next;
+		for (i = 0; i < old.size; i++)
+			if (old.slots[i].name)
+				index_put (idx, old.slots[i].hash, old.slots[i].name, old.slots[i].entry);
+		free (old.slots);
+	}
+	index_put (idx, index_hash (name, strlen (name)), name, entry);
+	return GP_OK;
+}
+
+static void
+index_remove (CameraFilesystemIndex *idx, void *entry, const char *name)
+{
+	unsigned int i, j, k;
+
+	if (!idx->count)
+		return;
+	i = index_hash (name, strlen (name)) & (idx->size - 1);
+	while (idx->slots[i].name && (idx->slots[i].entry != entry))
+		i = (i + 1) & (idx->size - 1);
+	if (!idx->slots[i].name)
+		return;
+	idx->slots[i].name = NULL;
+	idx->count--;
+
+	/* move following entries of the probe sequence up into the hole */
+	for (j = (i + 1) & (idx->size - 1); idx->slots[j].name; j = (j + 1) & (idx->size - 1)) {
+		k = idx->slots[j].hash & (idx->size - 1);
+		/* skip entries whose home slot lies cyclically in (i, j] */
+		if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+			continue;
+		idx->slots[i] = idx->slots[j];
+		idx->slots[j].name = NULL;
+		i = j;
+	}
+}
+
+static void
+index_clear (CameraFilesystemIndex *idx)
+{
+	free (idx->slots);
+	idx->slots = NULL;
+	idx->size = 0;
+	idx->count = 0;
+}
+
+/* create and append 1 new file entry to the folder */
+static int
+append_file_one (
+	CameraFilesystemFolder *folder,
+	const char *name,
+	CameraFilesystemFile **newfile
+) {
+	CameraFilesystemFile *file;
+
+	if (folder->nfiles == folder->maxfiles) {
+		unsigned int		max = folder->maxfiles ? folder->maxfiles * 2 : 16;
+		CameraFilesystemFile	**files;
+
+		C_MEM (files = realloc (folder->files, max * sizeof (CameraFilesystemFile*)));
+		folder->files = files;
+		folder->maxfiles = max;
+	}
+	C_MEM (file = calloc (1, sizeof (CameraFilesystemFile)));
+	file->name = strdup (name);
+	if (!file->name) {
+		free (file);
+		return GP_ERROR_NO_MEMORY;
+	}
+	if (index_insert (&folder->files_index, file->name, file) < GP_OK) {
 		free (file->name);
 		free (file);
-		file = next;
+		return GP_ERROR_NO_MEMORY;
 	}
+	file->info_dirty = 1;
+	file->pos = folder->nfiles;
+	folder->files[folder->nfiles++] = file;
+	if (newfile) *newfile = file;
+	return GP_OK;
+}
+
+static void
+free_file (CameraFilesystem *fs, CameraFilesystemFile *file)
+{
+	/* Get rid of cached files */
+	gp_filesystem_lru_remove_one (fs, file);
+	if (file->preview)
+		gp_file_unref (file->preview);
+	if (file->normal)
+		gp_file_unref (file->normal);
+	if (file->raw)
+		gp_file_unref (file->raw);
+	if (file->audio)
+		gp_file_unref (file->audio);
+	if (file->exif)
+		gp_file_unref (file->exif);
+	if (file->metadata)
+		gp_file_unref (file->metadata);
+	free (file->name);
+	free (file);
+}
+
+static int
+delete_all_files (CameraFilesystem *fs, CameraFilesystemFolder *folder)
+{
+	unsigned int i;
+
+	C_PARAMS (folder);
+	GP_LOG_D ("Delete all files in folder %p/%s", folder, folder->name);
+
+	for (i = 0; i < folder->nfiles; i++)
+		free_file (fs, folder->files[i]);
+	free (folder->files);
 	folder->files = NULL;
+	folder->nfiles = 0;
+	folder->maxfiles = 0;
+	index_clear (&folder->files_index);
 	return (GP_OK);
 }
 
@@ -341,6 +497,7 @@ delete_folder (CameraFilesystem *fs, CameraFilesystemFolder **folder)
 	GP_LOG_D ("Delete one folder %p/%s", *folder, (*folder)->name);
 	next = (*folder)->next;
 	delete_all_files (fs, *folder);
+	index_clear (&(*folder)->folders_index);
 	free ((*folder)->name);
 	free (*folder);
 	*folder = next;
@@ -391,23 +548,12 @@ lookup_folder (
 			}
 			free (copy);
 		}
-		f = folder->folders;
-		while (f) {
-			if (s) {
-				if (!strncmp(f->name,curpt, (s-curpt)) &&
-				    ((ssize_t)strlen(f->name) == (s-curpt))
-				) {
-					folder = f;
-					curpt = s;
-					break;
-				}
-			} else {
-				if (!strcmp(f->name,curpt))
-					return f;
-			}
-			f = f->next;
-		}
+		f = index_lookup (&folder->folders_index, curpt,
+				  s ? (size_t)(s-curpt) : strlen(curpt));
+		if (f && !s)
+			return f;
 		folder = f;
+		curpt = s;
 	}
 	return NULL;
 }
@@ -444,16 +590,12 @@ lookup_folder_file (
 			GP_LOG_D ("Making folder %s clean failed: %d", folder, ret);
 	}
 
-	f = xf->files;
-	while (f) {
-		if (!strcmp (f->name, filename)) {
-			*xfile = f;
-			*xfolder = xf;
-			return GP_OK;
-		}
-		f = f->next;
-	}
-	return GP_ERROR_FILE_NOT_FOUND;
+	f = index_lookup (&xf->files_index, filename, strlen (filename));
+	if (!f)
+		return GP_ERROR_FILE_NOT_FOUND;
+	*xfile = f;
+	*xfolder = xf;
+	return GP_OK;
 }
 
 /* delete all folder content */
@@ -467,6 +609,7 @@ recurse_delete_folder (CameraFilesystem *fs, CameraFilesystemFolder *folder) {
 		recurse_delete_folder (fs, *f);
 		delete_folder (fs, f); /* will also advance to next */
 	}
+	index_clear (&folder->folders_index);
 	return GP_OK;
 }
 
@@ -506,6 +649,11 @@ append_folder_one (
 	}
 	f->files_dirty = 1;
 	f->folders_dirty = 1;
+	if (index_insert (&folder->folders_index, f->name, f) < GP_OK) {
+		free (f->name);
+		free (f);
+		return GP_ERROR_NO_MEMORY;
+	}
 
 	/* Link into the current chain...  perhaps later alphabetically? */
 	f->next = folder->folders;
@@ -533,20 +681,13 @@ append_to_folder (CameraFilesystemFolder *folder,
 	}
 
 	s = strchr(foldername,'/');
-	f = folder->folders;
-	while (f) {
-		if (s) {
-			if (!strncmp(f->name,foldername, (s-foldername)) &&
-			    ((ssize_t)strlen(f->name) == (s-foldername))
-			)
-				return append_to_folder (f, s+1, newfolder);
-		} else {
-			if (!strcmp(f->name,foldername)) {
-				if (newfolder) *newfolder = f;
-				return (GP_OK);
-			}
-		}
-		f = f->next;
+	f = index_lookup (&folder->folders_index, foldername,
+			  s ? (size_t)(s-foldername) : strlen(foldername));
+	if (f) {
+		if (s)
+			return append_to_folder (f, s+1, newfolder);
+		if (newfolder) *newfolder = f;
+		return (GP_OK);
 	}
 	/* Not found ... create new folder */
 	if (s) {
@@ -579,25 +720,17 @@ append_folder (CameraFilesystem *fs,
 static int
 append_file (CameraFilesystem *fs, CameraFilesystemFolder *folder, const char *name, CameraFile *file, GPContext *context)
 {
-	CameraFilesystemFile **new;
+	CameraFilesystemFile *new;
 
 	C_PARAMS (fs && file);
 	GP_LOG_D ("Appending file %s...", name);
 
-	new = &folder->files;
-	while (*new) {
-		if (!strcmp((*new)->name, name)) {
-			GP_LOG_E ("File %s already exists!", name);
-			return (GP_ERROR);
-		}
-		new = &((*new)->next);
-	}
-	/* new now points to the location of the last ->next pointer,
-	 * if we write to it, we set last->next */
-	C_MEM ((*new) = calloc (1, sizeof (CameraFilesystemFile)));
-	C_MEM ((*new)->name = strdup (name));
-	(*new)->info_dirty = 1;
-	(*new)->normal = file;
+	if (index_lookup (&folder->files_index, name, strlen (name))) {
+		GP_LOG_E ("File %s already exists!", name);
+		return (GP_ERROR);
+	}
+	CR (append_file_one (folder, name, &new));
+	new->normal = file;
 	gp_file_ref (file);
 	return (GP_OK);
 }
@@ -678,6 +811,7 @@ gp_filesystem_free (CameraFilesystem *fs)
 
 	/* Now, we've only got left over the root folder. Free that and
 	 * the filesystem. */
+	index_clear (&fs->rootfolder->folders_index);
 	free (fs->rootfolder->name);
 	free (fs->rootfolder);
 	free (fs);
@@ -702,29 +836,13 @@ static int
 internal_append (CameraFilesystem *fs, CameraFilesystemFolder *f,
 		      const char *filename, GPContext *context)
 {
-	CameraFilesystemFile **new;
-
 	C_PARAMS (fs && f);
 
 	GP_LOG_D ("Internal append %s to folder %s", filename, f->name);
 	/* Check folder for existence, if not, create it. */
-	new = &f->files;
-	while (*new) {
-		if (!strcmp((*new)->name, filename)) break;
-		new = &((*new)->next);
-	}
-	if (*new)
+	if (index_lookup (&f->files_index, filename, strlen (filename)))
 		return (GP_ERROR_FILE_EXISTS);
-
-	C_MEM ((*new) = calloc (1, sizeof (CameraFilesystemFile)));
-	(*new)->name = strdup (filename);
-	if (!(*new)->name) {
-		free (*new);
-		*new = NULL;
-		return (GP_ERROR_NO_MEMORY);
-	}
-	(*new)->info_dirty = 1;
-	return (GP_OK);
+	return append_file_one (f, filename, NULL);
 }
 
 int
@@ -762,15 +880,12 @@ gp_filesystem_append (CameraFilesystem *fs, const char *folder,
 static void
 recursive_fs_dump (CameraFilesystemFolder *folder, int depth) {
 	CameraFilesystemFolder	*f;
-	CameraFilesystemFile	*xfile;
+	unsigned int		i;
 
 	GP_LOG_D ("%*sFolder %s", depth, " ", folder->name);
 
-	xfile = folder->files;
-	while (xfile) {
-		GP_LOG_D ("%*s    %s", depth, " ", xfile->name);
-		xfile = xfile->next;
-	}
+	for (i = 0; i < folder->nfiles; i++)
+		GP_LOG_D ("%*s    %s", depth, " ", folder->files[i]->name);
 
 	f = folder->folders;
 	while (f) {
@@ -796,44 +911,17 @@ gp_filesystem_dump (CameraFilesystem *fs)
 static int
 delete_file (CameraFilesystem *fs, CameraFilesystemFolder *folder, CameraFilesystemFile *file)
 {
-	CameraFilesystemFile **prev;
-
-	gp_filesystem_lru_remove_one (fs, file);
-	/* Get rid of cached files */
-	if (file->preview) {
-		gp_file_unref (file->preview);
-		file->preview = NULL;
-	}
-	if (file->normal) {
-		gp_file_unref (file->normal);
-		file->normal = NULL;
-	}
-	if (file->raw) {
-		gp_file_unref (file->raw);
-		file->raw = NULL;
-	}
-	if (file->audio) {
-		gp_file_unref (file->audio);
-		file->audio = NULL;
-	}
-	if (file->exif) {
-		gp_file_unref (file->exif);
-		file->exif = NULL;
-	}
-	if (file->metadata) {
-		gp_file_unref (file->metadata);
-		file->metadata = NULL;
-	}
+	unsigned int i;
 
-	prev = &(folder->files);
-	while ((*prev) && ((*prev) != file))
-		prev = &((*prev)->next);
-	if (!*prev)
+	if ((file->pos >= folder->nfiles) || (folder->files[file->pos] != file))
 		return GP_ERROR;
-	*prev = file->next;
-	file->next = NULL;
-	free (file->name);
-	free (file);
+	index_remove (&folder->files_index, file, file->name);
+	folder->nfiles--;
+	for (i = file->pos; i < folder->nfiles; i++) {
+		folder->files[i] = folder->files[i + 1];
+		folder->files[i]->pos = i;
+	}
+	free_file (fs, file);
 	return (GP_OK);
 }
 
@@ -937,9 +1025,9 @@ gp_filesystem_list_files (CameraFilesystem *fs, const char *folder,
 			  CameraList *list, GPContext *context)
 {
 	int count, y;
+	unsigned int i;
 	const char *name;
 	CameraFilesystemFolder	*f;
-	CameraFilesystemFile	*file;
 
 	GP_LOG_D ("Listing files in %s", folder);
 
@@ -973,11 +1061,9 @@ gp_filesystem_list_files (CameraFilesystem *fs, const char *folder,
 	/* The folder is clean now */
 	f->files_dirty = 0;
 
-	file = f->files;
-	while (file) {
-		/* GP_LOG_D ("Listed '%s'", file->name); */
-		CR (gp_list_append (list, file->name, NULL));
-		file = file->next;
+	for (i = 0; i < f->nfiles; i++) {
+		/* GP_LOG_D ("Listed '%s'", f->files[i]->name); */
+		CR (gp_list_append (list, f->files[i]->name, NULL));
 	}
 	return (GP_OK);
 }
@@ -1058,9 +1144,7 @@ int
 gp_filesystem_count (CameraFilesystem *fs, const char *folder,
 		     GPContext *context)
 {
-	int x;
 	CameraFilesystemFolder	*f;
-	CameraFilesystemFile	*file;
 
 	C_PARAMS (fs && folder);
 	CC (context);
@@ -1069,13 +1153,7 @@ gp_filesystem_count (CameraFilesystem *fs, const char *folder,
 	f = lookup_folder (fs, fs->rootfolder, folder, context);
 	if (!f) return (GP_ERROR_DIRECTORY_NOT_FOUND);
 
-	x = 0;
-	file = f->files;
-	while (file) {
-		x++;
-		file = file->next;
-	}
-	return x;
+	return f->nfiles;
 }
 
 /**
@@ -1232,20 +1310,18 @@ gp_filesystem_remove_dir (CameraFilesystem *fs, const char *folder,
 			GP_LOG_D ("Done making folder %s clean...", folder);
 		}
 	}
+	if (!index_lookup (&f->folders_index, name, strlen (name)))
+		return (GP_ERROR_DIRECTORY_NOT_FOUND);
 	prev = &(f->folders);
-	while (*prev) {
-		if (!strcmp (name, (*prev)->name))
-			break;
+	while (strcmp (name, (*prev)->name))
 		prev = &((*prev)->next);
-	}
-	if (!*prev) return (GP_ERROR_DIRECTORY_NOT_FOUND);
 
 	if ((*prev)->folders) {
 		gp_context_error (context, _("There are still subfolders in "
 			"folder '%s/%s' that you are trying to remove."), folder, name);
 		return (GP_ERROR_DIRECTORY_EXISTS);
 	}
-	if ((*prev)->files) {
+	if ((*prev)->nfiles) {
 		gp_context_error (context, _("There are still files in "
 			"folder '%s/%s' that you are trying to remove."), folder,name);
 		return (GP_ERROR_FILE_EXISTS);
@@ -1253,6 +1329,7 @@ gp_filesystem_remove_dir (CameraFilesystem *fs, const char *folder,
 
 	/* Remove the directory */
 	CR (fs->remove_dir_func (fs, folder, name, fs->data, context));
+	index_remove (&f->folders_index, *prev, (*prev)->name);
 	CR (delete_folder (fs, prev));
 	return (GP_OK);
 }
@@ -1321,8 +1398,6 @@ gp_filesystem_name (CameraFilesystem *fs, const char *folder, int filenumber,
 		    const char **filename, GPContext *context)
 {
 	CameraFilesystemFolder	*f;
-	CameraFilesystemFile	*file;
-	int count;
 	C_PARAMS (fs && folder);
 	CC (context);
 	CA (folder, context);
@@ -1330,23 +1405,13 @@ gp_filesystem_name (CameraFilesystem *fs, const char *folder, int filenumber,
 	f = lookup_folder (fs, fs->rootfolder, folder, context);
 	if (!f) return (GP_ERROR_DIRECTORY_NOT_FOUND);
 
-	file = f->files;
-	count = 0;
-	while (file) {
-		if (filenumber == 0)
-			break;
-		filenumber--;
-		count++;
-		file = file->next;
-	}
-
-	if (!file) {
+	if ((filenumber < 0) || ((unsigned int)filenumber >= f->nfiles)) {
 		gp_context_error (context, _("Folder '%s' only contains "
 			"%i files, but you requested a file with number %i."),
-			folder, count, filenumber);
+			folder, f->nfiles, filenumber);
 		return (GP_ERROR_FILE_NOT_FOUND);
 	}
-	*filename = file->name;
+	*filename = f->files[filenumber]->name;
 	return (GP_OK);
 }
 
@@ -1369,7 +1434,6 @@ gp_filesystem_number (CameraFilesystem *fs, const char *folder,
 	CameraFilesystemFolder	*f;
 	CameraFilesystemFile	*file;
 	CameraList *list;
-	int num;
 
 	C_PARAMS (fs && folder && filename);
 	CC (context);
@@ -1378,14 +1442,9 @@ gp_filesystem_number (CameraFilesystem *fs, const char *folder,
 	f = lookup_folder (fs, fs->rootfolder, folder, context);
 	if (!f) return (GP_ERROR_DIRECTORY_NOT_FOUND);
 
-	file = f->files;
-	num = 0;
-	while (file) {
-		if (!strcmp (file->name, filename))
-			return num;
-		num++;
-		file = file->next;
-	}
+	file = index_lookup (&f->files_index, filename, strlen (filename));
+	if (file)
+		return file->pos;
 
 	/* Ok, we didn't find the file. Is the folder dirty? */
 	if (!f->files_dirty) {
@@ -1445,17 +1504,12 @@ recursive_folder_scan (
 	CameraFilesystemFolder *folder, const char *lookforfile,
 	char **foldername
 ) {
-	CameraFilesystemFile	*file;
 	CameraFilesystemFolder	*f;
 	int ret;
 
-	file = folder->files;
-	while (file) {
-		if (!strcmp(file->name, lookforfile)) {
-			*foldername = strdup (folder->name);
-			return GP_OK;
-		}
-		file = file->next;
+	if (index_lookup (&folder->files_index, lookforfile, strlen (lookforfile))) {
+		*foldername = strdup (folder->name);
+		return GP_OK;
 	}
 	f = folder->folders;
 	while (f) {
@@ -1720,6 +1774,152 @@ gp_filesystem_get_file (CameraFilesystem *fs, const char *folder,
 	return (GP_OK);
 }
 
+/* a batch download while the camera driver works on it */
+typedef struct {
+	CameraFileBatchOpenFunc	open_func;
+	CameraFileBatchDoneFunc	done_func;
+	void			*data;
+} CameraFilesystemBatch;
+
+static int
+batch_open (const char *folder, const char *filename, CameraFileType type,
+	    CameraFile **file, void *data)
+{
+	CameraFilesystemBatch *batch = data;
+
+	*file = NULL;
+	if (batch->open_func) {
+		CR (batch->open_func (folder, filename, type, file, batch->data));
+	} else {
+		CR (gp_file_new (file));
+	}
+	C_PARAMS (*file);
+	return gp_file_set_name (*file, filename);
+}
+
+static int
+batch_finish (CameraFilesystemBatch *batch, const char *folder,
+	      const char *filename, CameraFileType type, CameraFile *file,
+	      int result)
+{
+	int ret = GP_OK;
+
+	if (batch->done_func)
+		ret = batch->done_func (folder, filename, type, file, result, batch->data);
+	if (file)
+		gp_file_unref (file);
+	return ret;
+}
+
+/* done callback handed to the driver, does what gp_filesystem_get_file()
+ * does after get_file_func */
+static int
+batch_done (const char *folder, const char *filename, CameraFileType type,
+	    CameraFile *file, int result, void *data)
+{
+	/* We don't trust the camera drivers */
+	if (result >= GP_OK)
+		result = gp_file_set_name (file, filename);
+	if ((result >= GP_OK) && (type != GP_FILE_TYPE_NORMAL))
+		result = gp_file_adjust_name_for_mime_type (file);
+	if (result < GP_OK)
+		GP_LOG_D ("Download of '%s' from '%s' (type %i) failed. "
+			"Reason: '%s'", filename, folder, type,
+			gp_result_as_string (result));
+	return batch_finish (data, folder, filename, type, file, result);
+}
+
+/**
+ * \brief Get the data of several files from the filesystem
+ * \param fs a #CameraFilesystem
+ * \param count the number of files
+ * \param folders the folder of each file
+ * \param filenames the name of each file
+ * \param type the type of the files
+ * \param open_func supplies the file each download goes into, or NULL for memory files
+ * \param done_func called with the result of each file, may be NULL
+ * \param data passed to open_func and done_func
+ * \param context a #GPContext
+ *
+ * Downloads all given files in one go. Camera drivers with a
+ * get_files_func can prepare the whole batch up front and fetch the
+ * files back to back, otherwise they are downloaded one by one via
+ * gp_filesystem_get_file().
+ *
+ * Failing files do not stop the batch, their error is passed to
+ * done_func. Files that could not be looked up at all might be reported
+ * to it without a #CameraFile (NULL). The batch stops if open_func or
+ * done_func return an error or the download gets cancelled.
+ *
+ * \return a gphoto2 error code.
+ **/
+int
+gp_filesystem_get_files (CameraFilesystem *fs, int count,
+			 const char *folders[], const char *filenames[],
+			 CameraFileType type,
+			 CameraFileBatchOpenFunc open_func,
+			 CameraFileBatchDoneFunc done_func,
+			 void *data, GPContext *context)
+{
+	CameraFilesystemBatch	batch = { open_func, done_func, data };
+	const char		**xfolders, **xfilenames;
+	int			i, n, r, ret = GP_OK;
+
+	C_PARAMS (fs && (count >= 0));
+	C_PARAMS (!count || (folders && filenames));
+	CC (context);
+
+	/* the EXIF and preview fallbacks of gp_filesystem_get_file() work per file */
+	if (!fs->get_files_func ||
+	    (type == GP_FILE_TYPE_PREVIEW) || (type == GP_FILE_TYPE_EXIF)) {
+		for (i = 0; i < count; i++) {
+			CameraFile *file;
+
+			CR (batch_open (folders[i], filenames[i], type, &file, &batch));
+			r = gp_filesystem_get_file (fs, folders[i], filenames[i],
+						    type, file, context);
+			CR (batch_finish (&batch, folders[i], filenames[i], type, file, r));
+			if (r == GP_ERROR_CANCEL)
+				return r;
+		}
+		return GP_OK;
+	}
+
+	C_MEM (xfolders = calloc (count + 1, sizeof (char*)));
+	xfilenames = calloc (count + 1, sizeof (char*));
+	if (!xfilenames) {
+		free (xfolders);
+		return GP_ERROR_NO_MEMORY;
+	}
+	for (i = n = 0; i < count; i++) {
+		CameraFilesystemFolder	*xfolder;
+		CameraFilesystemFile	*xfile;
+
+		if (!folders[i] || !filenames[i])
+			r = GP_ERROR_BAD_PARAMETERS;
+		else if (folders[i][0] != '/')
+			r = GP_ERROR_PATH_NOT_ABSOLUTE;
+		else
+			r = lookup_folder_file (fs, folders[i], filenames[i], &xfolder, &xfile, context);
+		if (r < GP_OK) {
+			ret = batch_finish (&batch, folders[i], filenames[i], type, NULL, r);
+			if (ret < GP_OK)
+				goto out;
+			continue;
+		}
+		xfolders[n] = folders[i];
+		xfilenames[n++] = filenames[i];
+	}
+
+	GP_LOG_D ("Downloading %i files in one batch...", n);
+	ret = fs->get_files_func (fs, n, xfolders, xfilenames, type,
+				  batch_open, batch_done, &batch, fs->data, context);
+out:
+	free (xfolders);
+	free (xfilenames);
+	return ret;
+}
+
 /**
  * \brief Get partial file data from the filesystem
  * \param fs a #CameraFilesystem
@@ -1822,6 +2022,7 @@ gp_filesystem_set_funcs	(CameraFilesystem *fs,
 	fs->get_file_func	= funcs->get_file_func;
 	fs->read_file_func	= funcs->read_file_func;
 	fs->storage_info_func	= funcs->storage_info_func;
+	fs->get_files_func	= funcs->get_files_func;
 	fs->data = data;
 	return (GP_OK);
 }
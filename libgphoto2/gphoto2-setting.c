@@ -172,18 +172,19 @@ gp_setting_set (char *id, char *key, char *value)
 
 #define GP_PATH_MAX 1024
 
+/* the directory holding the settings file, and the file itself */
 static int
-gp_settings_path (char (*out)[GP_PATH_MAX])
+gp_settings_locate (char (*outdir)[GP_PATH_MAX], char (*out)[GP_PATH_MAX])
 {
 #ifdef WIN32
 
 	/* TODO: improve robustness */
 	/* TODO: respect system-defined folders of Windows as well (AppData etc.) */
-	SHGetFolderPath (NULL, CSIDL_PROFILE, NULL, 0, *out);
-	strcat (*out, "\\.gphoto");
-	GP_LOG_D ("Creating gphoto config directory ('%s')", *out);
-	(void)gp_system_mkdir (*out);
-	strcat (*out, "\\settings");
+	SHGetFolderPath (NULL, CSIDL_PROFILE, NULL, 0, *outdir);
+	strcat (*outdir, "\\.gphoto");
+	GP_LOG_D ("Creating gphoto config directory ('%s')", *outdir);
+	(void)gp_system_mkdir (*outdir);
+	snprintf (*out, GP_PATH_MAX, "%s\\settings", *outdir);
 
 #else
 
@@ -228,6 +229,7 @@ gp_settings_path (char (*out)[GP_PATH_MAX])
 	GP_LOG_D ("Creating gphoto config directory ('%s')", dir);
 	(void)gp_system_mkdir (dir);
 
+	snprintf (*outdir, GP_PATH_MAX, "%s", dir);
 	snprintf (*out, GP_PATH_MAX, "%s", path);
 
 #endif
@@ -235,6 +237,39 @@ gp_settings_path (char (*out)[GP_PATH_MAX])
 	return (GP_OK);
 }
 
+static int
+gp_settings_path (char (*out)[GP_PATH_MAX])
+{
+	char dir[GP_PATH_MAX];
+
+	return gp_settings_locate (&dir, out);
+}
+
+/**
+ * \brief Retrieve the gphoto settings directory.
+ *
+ * \param dir buffer for the directory name
+ * \param size size of the buffer
+ * \return GPhoto error code
+ *
+ * Copies the name of the directory holding the settings file into dir,
+ * creating the directory if needed. Camera drivers can keep other
+ * persistent per user data, like caches, next to the settings there.
+ */
+int
+gp_setting_get_dir (char *dir, int size)
+{
+	char path[GP_PATH_MAX], xdir[GP_PATH_MAX];
+
+	C_PARAMS (dir && (size > 0));
+
+	gp_settings_locate (&xdir, &path);
+	if ((int)strlen (xdir) >= size)
+		return GP_ERROR_FIXED_LIMIT_EXCEEDED;
+	strcpy (dir, xdir);
+	return (GP_OK);
+}
+
 static int
 verify_settings (char *settings_file)
 {
@@ -76,8 +76,65 @@ struct _CameraWidget {
 
 	/* Callback */
 	CameraWidgetCallback callback;
+
+	/* Contents still to be fetched, see gp_widget_set_load_func() */
+	CameraWidgetLoadFunc load;
+	void	*load_data;
+	void	(*load_data_free) (void *data);
 };
 
+/* Fetches the contents of a lazily created widget on first access */
+static int
+gp_widget_load (CameraWidget *widget)
+{
+	CameraWidgetLoadFunc	load = widget->load;
+	CameraWidget		*loaded = NULL;
+	int			ret;
+
+	if (!load)
+		return (GP_OK);
+	/* once only, also if it fails */
+	widget->load = NULL;
+	ret = load (widget, widget->load_data, &loaded);
+	if (widget->load_data_free)
+		widget->load_data_free (widget->load_data);
+	widget->load_data = NULL;
+	if (ret < GP_OK) {
+		GP_LOG_E ("Could not load widget '%s': %s", widget->name,
+			  gp_result_as_string (ret));
+		return (ret);
+	}
+	if ((loaded->type == GP_WIDGET_WINDOW) ||
+	    (loaded->type == GP_WIDGET_SECTION)) {
+		gp_widget_free (loaded);
+		return (GP_ERROR_BAD_PARAMETERS);
+	}
+
+	widget->type = loaded->type;
+	strcpy (widget->info, loaded->info);
+	free (widget->value_string);
+	widget->value_string = loaded->value_string;
+	widget->value_int    = loaded->value_int;
+	widget->value_float  = loaded->value_float;
+	widget->choice       = loaded->choice;
+	widget->choice_count = loaded->choice_count;
+	widget->min          = loaded->min;
+	widget->max          = loaded->max;
+	widget->increment    = loaded->increment;
+	widget->readonly     = loaded->readonly;
+	widget->callback     = loaded->callback;
+	loaded->value_string = NULL;
+	loaded->choice       = NULL;
+	loaded->choice_count = 0;
+	gp_widget_free (loaded);
+	return (GP_OK);
+}
+
+#define C_LOAD(widget) do {						\
+	int _ret = gp_widget_load (widget);				\
+	if (_ret < GP_OK) return _ret;					\
+} while (0)
+
 /**
  * \brief Create a new widget.
  *
@@ -146,6 +203,8 @@ gp_widget_free (CameraWidget *widget)
 		free (widget->choice[x]);
 	free (widget->choice);
 	free (widget->value_string);
+	if (widget->load && widget->load_data_free)
+		widget->load_data_free (widget->load_data);
 	free (widget);
 	return (GP_OK);
 }
@@ -199,6 +258,7 @@ int
 gp_widget_get_info (CameraWidget *widget, const char **info)
 {
 	C_PARAMS (widget && info);
+	C_LOAD (widget);
 
 	*info = widget->info;
 	return (GP_OK);
@@ -328,11 +388,42 @@ int
 gp_widget_get_readonly (CameraWidget *widget, int *readonly)
 {
 	C_PARAMS (widget && readonly);
+	C_LOAD (widget);
 
 	*readonly = widget->readonly;
 	return (GP_OK);
 }
 
+/**
+ * \brief Lets the contents of the #CameraWidget be fetched on first access
+ *
+ * @param widget a #CameraWidget, with its label and name already set
+ * @param func the function fetching the contents
+ * @param data passed to func
+ * @param free_data frees data once it is no longer needed, or NULL
+ * @return a gphoto2 error code
+ *
+ * The first call asking for the type, info, value, choices, range or
+ * readonly state of the widget calls func once, and takes over the
+ * contents of the widget it returns. If that fails, the accessor
+ * returns the error.
+ *
+ * \internal Internal use only, see gp_camera_defer_config_widget().
+ **/
+int
+gp_widget_set_load_func (CameraWidget *widget, CameraWidgetLoadFunc func,
+			 void *data, void (*free_data) (void *data))
+{
+	C_PARAMS (widget && func);
+
+	if (widget->load && widget->load_data_free)
+		widget->load_data_free (widget->load_data);
+	widget->load = func;
+	widget->load_data = data;
+	widget->load_data_free = free_data;
+	return (GP_OK);
+}
+
 /**
  * \brief Retrieves the type of the #CameraWidget
  *
@@ -345,6 +436,7 @@ int
 gp_widget_get_type (CameraWidget *widget, CameraWidgetType *type)
 {
 	C_PARAMS (widget && type);
+	C_LOAD (widget);
 
 	*type = widget->type;
 	return (GP_OK);
@@ -385,6 +477,7 @@ int
 gp_widget_set_value (CameraWidget *widget, const void *value)
 {
 	C_PARAMS (widget && value);
+	C_LOAD (widget);
 
 	switch (widget->type) {
 	case GP_WIDGET_BUTTON:
@@ -423,6 +516,62 @@ gp_widget_set_value (CameraWidget *widget, const void *value)
 	}
 }
 
+/**
+ * \brief Sets the value of the widget from its text form
+ *
+ * @param widget a #CameraWidget
+ * @param value the value as text
+ * @return a gphoto2 error code.
+ *
+ * Text, menu and radio widgets take the text as it is, range widgets a
+ * number within their range, toggle and date widgets an integer (dates
+ * in seconds since the epoch).
+ *
+ **/
+int
+gp_widget_set_value_from_string (CameraWidget *widget, const char *value)
+{
+	char	*end;
+	float	f;
+	long	l;
+	int	i;
+
+	C_PARAMS (widget && value);
+	C_LOAD (widget);
+
+	switch (widget->type) {
+	case GP_WIDGET_MENU:
+	case GP_WIDGET_RADIO:
+	case GP_WIDGET_TEXT:
+		return gp_widget_set_value (widget, value);
+	case GP_WIDGET_RANGE:
+		f = strtof (value, &end);
+		if ((end == value) || *end) {
+			GP_LOG_E ("'%s' is not a number", value);
+			return (GP_ERROR_BAD_PARAMETERS);
+		}
+		if ((f < widget->min) || (f > widget->max)) {
+			GP_LOG_E ("%g is not within %g and %g", f, widget->min, widget->max);
+			return (GP_ERROR_BAD_PARAMETERS);
+		}
+		return gp_widget_set_value (widget, &f);
+	case GP_WIDGET_TOGGLE:
+	case GP_WIDGET_DATE:
+		l = strtol (value, &end, 0);
+		if ((end == value) || *end) {
+			GP_LOG_E ("'%s' is not an integer", value);
+			return (GP_ERROR_BAD_PARAMETERS);
+		}
+		i = l;
+		return gp_widget_set_value (widget, &i);
+	case GP_WIDGET_BUTTON:
+	case GP_WIDGET_WINDOW:
+	case GP_WIDGET_SECTION:
+	default:
+		return (GP_ERROR_BAD_PARAMETERS);
+	}
+}
+
 /**
  * \brief Retrieves the value of the #CameraWidget
  *
@@ -435,6 +584,7 @@ int
 gp_widget_get_value (CameraWidget *widget, void *value)
 {
 	C_PARAMS (widget && value);
+	C_LOAD (widget);
 
 	switch (widget->type) {
 	case GP_WIDGET_BUTTON:
@@ -740,6 +890,7 @@ gp_widget_get_range (CameraWidget *range, float *min, float *max,
 		     float *increment)
 {
 	C_PARAMS (range && min && max && increment);
+	C_LOAD (range);
 	C_PARAMS (range->type == GP_WIDGET_RANGE);
 
 	*min = range->min;
@@ -787,6 +938,7 @@ int
 gp_widget_count_choices (CameraWidget *widget)
 {
 	C_PARAMS (widget);
+	C_LOAD (widget);
 	C_PARAMS ((widget->type == GP_WIDGET_RADIO) ||
 		  (widget->type == GP_WIDGET_MENU));
 
@@ -807,6 +959,7 @@ gp_widget_get_choice (CameraWidget *widget, int choice_number,
 		      const char **choice)
 {
 	C_PARAMS (widget && choice);
+	C_LOAD (widget);
 	C_PARAMS ((widget->type == GP_WIDGET_RADIO) ||
 		  (widget->type == GP_WIDGET_MENU));
 	C_PARAMS (choice_number < widget->choice_count);
@@ -0,0 +1,253 @@
+/** \file jpeg-decode.c
+ *
+ * \brief Decoding of live view frames into caller buffers with libjpeg
+ *
+ * The decompressor is kept across frames, so after the first frame
+ * decoding a frame of the same size needs no memory allocation. A scale
+ * of 2, 4 or 8 is applied in the DCT domain by libjpeg, the full size
+ * frame is never reconstructed.
+ *
+ * \author Copyright 2026 The gPhoto project
+ *
+ * \note
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \note
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \note
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+#include "jpeg-decode.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <gphoto2/gphoto2-result.h>
+#include <gphoto2/gphoto2-port-log.h>
+
+#ifdef HAVE_LIBJPEG
+
+#include <setjmp.h>
+#include <jpeglib.h>
+#include "jpeg_memsrcdest.h"
+
+struct _GPJpegDecoder {
+	struct jpeg_decompress_struct	cinfo;
+	struct jpeg_error_mgr		jerr;
+	jmp_buf				env;
+
+	/* one decoded row that still needs repacking */
+	unsigned char			*row;
+	unsigned long			row_size;
+};
+
+/* libjpeg would exit() on errors, return to gpi_jpeg_decode() instead */
+static void
+decoder_error_exit (j_common_ptr cinfo)
+{
+	GPJpegDecoder *decoder = cinfo->client_data;
+
+	(*cinfo->err->output_message) (cinfo);
+	longjmp (decoder->env, 1);
+}
+
+static void
+decoder_output_message (j_common_ptr cinfo)
+{
+	char buffer[JMSG_LENGTH_MAX];
+
+	(*cinfo->err->format_message) (cinfo, buffer);
+	GP_LOG_D ("libjpeg: %s", buffer);
+}
+
+int
+gpi_jpeg_decoder_new (GPJpegDecoder **decoder)
+{
+	GPJpegDecoder *d;
+
+	C_PARAMS (decoder);
+	C_MEM (d = calloc (1, sizeof (GPJpegDecoder)));
+
+	d->cinfo.err = jpeg_std_error (&d->jerr);
+	d->jerr.error_exit = decoder_error_exit;
+	d->jerr.output_message = decoder_output_message;
+	d->cinfo.client_data = d;
+	if (setjmp (d->env)) {
+		free (d);
+		return GP_ERROR_NO_MEMORY;
+	}
+	jpeg_create_decompress (&d->cinfo);
+
+	*decoder = d;
+	return GP_OK;
+}
+
+void
+gpi_jpeg_decoder_free (GPJpegDecoder *decoder)
+{
+	if (!decoder)
+		return;
+	jpeg_destroy_decompress (&decoder->cinfo);
+	free (decoder->row);
+	free (decoder);
+}
+
+/**
+ * Decodes a JPEG frame into a caller buffer.
+ *
+ * @param decoder a #GPJpegDecoder
+ * @param data the JPEG data
+ * @param size size of data
+ * @param format pixel layout to decode into
+ * @param scale 1, 2, 4 or 8 to divide width and height by
+ * @param buffer the destination
+ * @param buffersize size of buffer
+ * @param width receives the width of the decoded frame
+ * @param height receives the height of the decoded frame
+ * @return a gphoto2 error code
+ *
+ * Width and height are set even if the buffer turns out too small, which
+ * gives #GP_ERROR_FIXED_LIMIT_EXCEEDED. Data which is no JPEG at all gives
+ * #GP_ERROR_NOT_SUPPORTED, a broken JPEG #GP_ERROR_CORRUPTED_DATA.
+ */
+int
+gpi_jpeg_decode (GPJpegDecoder *decoder, const unsigned char *data, unsigned long size,
+		 CameraPreviewFormat format, unsigned int scale,
+		 unsigned char *buffer, unsigned long buffersize,
+		 unsigned int *width, unsigned int *height)
+{
+	struct jpeg_decompress_struct	*cinfo;
+	unsigned char			*u, *v;
+	unsigned long			need;
+	unsigned int			w, h, cw, ch, x;
+	int				gray;
+
+	C_PARAMS (decoder && data && buffer && width && height);
+	C_PARAMS ((scale == 1) || (scale == 2) || (scale == 4) || (scale == 8));
+	C_PARAMS ((format == GP_PREVIEW_FORMAT_RGB24) || (format == GP_PREVIEW_FORMAT_YUV420P));
+	cinfo = &decoder->cinfo;
+
+	/* some drivers deliver raw or PPM previews */
+	if ((size < 2) || (data[0] != 0xff) || (data[1] != 0xd8))
+		return GP_ERROR_NOT_SUPPORTED;
+
+	if (setjmp (decoder->env)) {
+		jpeg_abort_decompress (cinfo);
+		return GP_ERROR_CORRUPTED_DATA;
+	}
+	jpeg_mem_src (cinfo, (unsigned char *)data, size);
+	jpeg_read_header (cinfo, TRUE);
+
+	/* grayscale stays grayscale, libjpeg cannot expand it everywhere */
+	gray = (cinfo->num_components == 1);
+	if (gray)
+		cinfo->out_color_space = JCS_GRAYSCALE;
+	else if (format == GP_PREVIEW_FORMAT_RGB24)
+		cinfo->out_color_space = JCS_RGB;
+	else {
+		cinfo->out_color_space = JCS_YCbCr;
+		/* the chroma gets subsampled again below anyway */
+		cinfo->do_fancy_upsampling = FALSE;
+	}
+	cinfo->scale_num = 1;
+	cinfo->scale_denom = scale;
+	jpeg_calc_output_dimensions (cinfo);
+
+	*width  = w = cinfo->output_width;
+	*height = h = cinfo->output_height;
+	cw = (w + 1) / 2;
+	ch = (h + 1) / 2;
+	if (format == GP_PREVIEW_FORMAT_RGB24)
+		need = (unsigned long)w * h * 3;
+	else
+		need = (unsigned long)w * h + 2UL * cw * ch;
+	if (buffersize < need) {
+		jpeg_abort_decompress (cinfo);
+		return GP_ERROR_FIXED_LIMIT_EXCEEDED;
+	}
+	if (decoder->row_size < (unsigned long)w * 3) {
+		unsigned char *row = realloc (decoder->row, (unsigned long)w * 3);
+
+		if (!row) {
+			jpeg_abort_decompress (cinfo);
+			return GP_ERROR_NO_MEMORY;
+		}
+		decoder->row = row;
+		decoder->row_size = (unsigned long)w * 3;
+	}
+
+	jpeg_start_decompress (cinfo);
+	u = buffer + (unsigned long)w * h;
+	v = u + (unsigned long)cw * ch;
+	while (cinfo->output_scanline < h) {
+		unsigned int	y = cinfo->output_scanline;
+		unsigned char	*dst;
+		JSAMPROW	row;
+
+		if (format == GP_PREVIEW_FORMAT_RGB24) {
+			dst = buffer + (unsigned long)y * w * 3;
+			row = gray ? decoder->row : dst;
+			jpeg_read_scanlines (cinfo, &row, 1);
+			if (gray)
+				for (x = 0; x < w; x++)
+					dst[3*x] = dst[3*x+1] = dst[3*x+2] = row[x];
+			continue;
+		}
+
+		dst = buffer + (unsigned long)y * w;
+		row = gray ? dst : decoder->row;
+		jpeg_read_scanlines (cinfo, &row, 1);
+		if (gray)
+			continue;
+		for (x = 0; x < w; x++)
+			dst[x] = row[3*x];
+		/* chroma of the top left pixel of each 2x2 block */
+		if (!(y & 1))
+			for (x = 0; x < cw; x++) {
+				u[(y/2)*cw + x] = row[6*x+1];
+				v[(y/2)*cw + x] = row[6*x+2];
+			}
+	}
+	jpeg_finish_decompress (cinfo);
+
+	if ((format == GP_PREVIEW_FORMAT_YUV420P) && gray)
+		memset (u, 128, 2UL * cw * ch);
+	return GP_OK;
+}
+
+#else /* !HAVE_LIBJPEG */
+
+int
+gpi_jpeg_decoder_new (GPJpegDecoder **decoder)
+{
+	return GP_ERROR_NOT_SUPPORTED;
+}
+
+void
+gpi_jpeg_decoder_free (GPJpegDecoder *decoder)
+{
+}
+
+int
+gpi_jpeg_decode (GPJpegDecoder *decoder, const unsigned char *data, unsigned long size,
+		 CameraPreviewFormat format, unsigned int scale,
+		 unsigned char *buffer, unsigned long buffersize,
+		 unsigned int *width, unsigned int *height)
+{
+	return GP_ERROR_NOT_SUPPORTED;
+}
+
+#endif /* HAVE_LIBJPEG */
@@ -0,0 +1,40 @@
+/** \file
+ *
+ * \author Copyright 2026 The gPhoto project
+ *
+ * \note
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \note
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \note
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef LIBGPHOTO2_JPEG_DECODE_H
+#define LIBGPHOTO2_JPEG_DECODE_H
+
+#include <gphoto2/gphoto2-camera.h>
+
+/* A libjpeg decompressor kept across frames */
+typedef struct _GPJpegDecoder GPJpegDecoder;
+
+int  gpi_jpeg_decoder_new  (GPJpegDecoder **decoder);
+void gpi_jpeg_decoder_free (GPJpegDecoder *decoder);
+int  gpi_jpeg_decode       (GPJpegDecoder *decoder,
+			    const unsigned char *data, unsigned long size,
+			    CameraPreviewFormat format, unsigned int scale,
+			    unsigned char *buffer, unsigned long buffersize,
+			    unsigned int *width, unsigned int *height);
+
+#endif /* !defined(LIBGPHOTO2_JPEG_DECODE_H) */
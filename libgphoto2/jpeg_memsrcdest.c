@@ -25,8 +25,9 @@
 #include "jpeg_memsrcdest.h"
 
 /* libjpeg8 and later come with their own (API compatible) memory source
-   and dest, and older versions may have it backported */
-#if JPEG_LIB_VERSION < 80 && !defined(MEM_SRCDST_SUPPORTED)
+   and dest, and older versions may have it backported. These are always
+   built, jpeg_memsrcdest.h only maps jpeg_mem_src and jpeg_mem_dest to
+   them for the libjpeg versions without. */
 
 /* Expanded data source object for memory input */
 
@@ -143,7 +144,7 @@ term_source (j_decompress_ptr cinfo)
 */
 
 GLOBAL(void)
-jpeg_mem_src (j_decompress_ptr cinfo, unsigned char * buffer,
+gpi_jpeg_mem_src (j_decompress_ptr cinfo, unsigned char * buffer,
 	unsigned long bufsize)
 {
 	my_src_ptr src;
@@ -268,7 +269,7 @@ term_destination (j_compress_ptr cinfo)
 }
 
 GLOBAL(void)
-jpeg_mem_dest (j_compress_ptr cinfo, unsigned char ** outbuffer,
+gpi_jpeg_mem_dest (j_compress_ptr cinfo, unsigned char ** outbuffer,
 	unsigned long * outsize)
 {
 	my_dest_ptr dest;
@@ -309,5 +310,21 @@ jpeg_mem_dest (j_compress_ptr cinfo, unsigned char ** outbuffer,
 	dest->pub.free_in_buffer = dest->buf_size;
 }
 
-#endif
-#endif
+#else /* !HAVE_LIBJPEG */
+
+/* Only there for the list of exported symbols, nothing calls them
+ * without libjpeg */
+void gpi_jpeg_mem_src (void *cinfo, unsigned char *buffer, unsigned long bufsize);
+void gpi_jpeg_mem_dest (void *cinfo, unsigned char **outbuffer, unsigned long *outsize);
+
+void
+gpi_jpeg_mem_src (void *cinfo, unsigned char *buffer, unsigned long bufsize)
+{
+}
+
+void
+gpi_jpeg_mem_dest (void *cinfo, unsigned char **outbuffer, unsigned long *outsize)
+{
+}
+
+#endif /* HAVE_LIBJPEG */
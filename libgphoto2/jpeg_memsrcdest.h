@@ -0,0 +1,25 @@
+#ifndef LIBGPHOTO2_JPEG_MEMSRCDEST_H
+#define LIBGPHOTO2_JPEG_MEMSRCDEST_H
+
+#include <jpeglib.h>
+
+/* The memory source and destination of libjpeg 8, built once in
+ * libgphoto2 for itself and the camlibs */
+void
+gpi_jpeg_mem_src (j_decompress_ptr cinfo, unsigned char * buffer,
+	unsigned long bufsize);
+
+void
+gpi_jpeg_mem_dest (j_compress_ptr cinfo, unsigned char ** outbuffer,
+	unsigned long * outsize);
+
+#if JPEG_LIB_VERSION < 80 && !defined(MEM_SRCDST_SUPPORTED)
+
+#define JPEG_SIZE unsigned long
+
+#define jpeg_mem_src	gpi_jpeg_mem_src
+#define jpeg_mem_dest	gpi_jpeg_mem_dest
+
+#endif
+
+#endif /* !defined(LIBGPHOTO2_JPEG_MEMSRCDEST_H) */
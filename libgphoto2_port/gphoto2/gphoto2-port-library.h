@@ -83,6 +83,13 @@ typedef struct _GPPortOperations {
 
 	int (*reset)     (GPPort *);
 
+	/* For USB bulk reads with several transfers in flight */
+	int (*read_stream) (GPPort *port, char *buffer, int size, int chunksize,
+				int depth, GPPortStreamFunc func, void *data);
+
+	/* For USB devices, the ids of the device at the port path */
+	int (*get_device_id) (GPPort *port, int *idvendor, int *idproduct);
+
 } GPPortOperations;
 
 typedef GPPortType (* GPPortLibraryType) (void);
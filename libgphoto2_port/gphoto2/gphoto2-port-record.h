@@ -0,0 +1,89 @@
+/** \file gphoto2-port-record.h
+ *
+ * \brief Recordings of USB sessions, for the replay port driver
+ *
+ * With the environment variable GP_PORT_RECORD set to a file name, the
+ * first USB port opened by a process records all its transactions with
+ * their complete data into that file, until the port is freed. The
+ * replay port driver plays such a recording back to the camera driver,
+ * so host side code paths can be run and measured without the camera.
+ *
+ * A recording is a #GPPortRecordHeader followed by one #GPPortTraceRecord
+ * per transaction, each followed by its len data bytes, padded to a
+ * multiple of 8. The records are the same as in a binary trace, with
+ * all the data kept.
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef LIBGPHOTO2_GPHOTO2_PORT_RECORD_H
+#define LIBGPHOTO2_GPHOTO2_PORT_RECORD_H
+
+#include <stdint.h>
+
+#include <gphoto2/gphoto2-port.h>
+#include <gphoto2/gphoto2-port-trace.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define GP_PORT_RECORD_MAGIC	"gp2usbrc"
+#define GP_PORT_RECORD_VERSION	1
+
+#define GP_PORT_RECORD_FOUND_ID		(1 << 0) /**< \brief found by vendor and product id */
+#define GP_PORT_RECORD_FOUND_CLASS	(1 << 1) /**< \brief found by interface class */
+
+/**
+ * \brief Start of a recording
+ *
+ * Tells how the device was found and the USB settings it got then, so
+ * the replay port driver finds the same device in the same way. All
+ * fields are in the byte order of the recording machine.
+ */
+typedef struct {
+	char		magic[8];	/**< \brief #GP_PORT_RECORD_MAGIC, without the '\\0' */
+	uint32_t	version;	/**< \brief #GP_PORT_RECORD_VERSION */
+	uint32_t	byteorder;	/**< \brief #GP_PORT_TRACE_BYTEORDER */
+	uint32_t	header_size;	/**< \brief The first record starts here */
+	uint32_t	found;		/**< \brief GP_PORT_RECORD_FOUND_* flags */
+	uint16_t	vendor, product;
+	uint8_t		class, subclass, protocol, reserved;
+	int32_t		config, interface, altsetting;
+	int32_t		inep, outep, intep;
+	int32_t		maxpacketsize;
+	uint32_t	reserved2;
+	uint64_t	start_realtime;	/**< \brief Wall clock time when the recording started, in ns since the epoch */
+	char		path[64];	/**< \brief Path of the recorded port */
+} GPPortRecordHeader;
+
+#ifdef _GPHOTO2_INTERNAL_CODE
+
+int  gpi_port_record_start (const char *path, const GPPortSettingsUSB *usb, int found,
+			    int vendor, int product, int class, int subclass, int protocol);
+void gpi_port_record       (GPPortTraceOp op, uint64_t start, int size, int result,
+			    uint32_t arg0, uint32_t arg1, const char *data, int len);
+void gpi_port_record_stop  (void);
+
+#endif /* _GPHOTO2_INTERNAL_CODE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBGPHOTO2_GPHOTO2_PORT_RECORD_H) */
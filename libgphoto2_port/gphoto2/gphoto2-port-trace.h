@@ -0,0 +1,120 @@
+/** \file gphoto2-port-trace.h
+ *
+ * \brief Binary trace of port transactions
+ *
+ * Instead of hexdumps formatted while the data goes through, the trace
+ * records a fixed size record per transaction (timestamps, sizes, result
+ * and the first bytes of the data) into a ring in a memory mapped file.
+ * Formatting happens afterwards, with the port-trace-dump tool or any
+ * reader of the structures below. The file stays usable if the process
+ * dies while tracing.
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef LIBGPHOTO2_GPHOTO2_PORT_TRACE_H
+#define LIBGPHOTO2_GPHOTO2_PORT_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define GP_PORT_TRACE_MAGIC	"gp2trace"
+#define GP_PORT_TRACE_VERSION	1
+/* as written by the tracing machine, tells its byte order */
+#define GP_PORT_TRACE_BYTEORDER	0x01020304
+
+/**
+ * \brief Traced operations
+ */
+typedef enum {
+	GP_PORT_TRACE_OPEN = 1,		/**< \brief gp_port_open(), data is the port path, arg[0] the port type */
+	GP_PORT_TRACE_CLOSE,		/**< \brief gp_port_close() */
+	GP_PORT_TRACE_WRITE,		/**< \brief gp_port_write() */
+	GP_PORT_TRACE_READ,		/**< \brief gp_port_read() */
+	GP_PORT_TRACE_CHECK_INT,	/**< \brief gp_port_check_int(), arg[0] is the timeout */
+	GP_PORT_TRACE_READ_STREAM,	/**< \brief a chunk of gp_port_usb_read_stream() */
+	GP_PORT_TRACE_MSG_WRITE,	/**< \brief USB vendor control message, arg[0] is the request, arg[1] value << 16 | index */
+	GP_PORT_TRACE_MSG_READ,
+	GP_PORT_TRACE_MSG_INTERFACE_WRITE,
+	GP_PORT_TRACE_MSG_INTERFACE_READ,
+	GP_PORT_TRACE_MSG_CLASS_WRITE,
+	GP_PORT_TRACE_MSG_CLASS_READ
+} GPPortTraceOp;
+
+/**
+ * \brief Start of a trace file
+ *
+ * Followed by #GPPortTraceHeader.records records of record_size bytes
+ * each, starting at offset header_size. All fields are in the byte order
+ * of the tracing machine.
+ */
+typedef struct {
+	char		magic[8];	/**< \brief #GP_PORT_TRACE_MAGIC, without the '\\0' */
+	uint32_t	version;	/**< \brief #GP_PORT_TRACE_VERSION */
+	uint32_t	byteorder;	/**< \brief #GP_PORT_TRACE_BYTEORDER */
+	uint32_t	header_size;
+	uint32_t	record_size;
+	uint32_t	records;	/**< \brief Size of the ring */
+	uint32_t	prefix;		/**< \brief Data bytes kept per record */
+	uint64_t	next;		/**< \brief Records written so far, the next one goes to next % records */
+	uint64_t	start_realtime;	/**< \brief Wall clock time when the trace started, in ns since the epoch */
+	uint64_t	start_time;	/**< \brief Record time when the trace started, in ns */
+} GPPortTraceHeader;
+
+/**
+ * \brief A traced transaction
+ *
+ * Followed by len bytes of data: what was written, or what was read.
+ */
+typedef struct {
+	uint64_t	seq;		/**< \brief Record number + 1, 0 while the record is written */
+	uint64_t	time;		/**< \brief Start of the operation, monotonic, in ns */
+	uint32_t	duration;	/**< \brief Duration of the operation, in us */
+	uint16_t	port;		/**< \brief Number of the #GPPort in this process */
+	uint16_t	op;		/**< \brief #GPPortTraceOp */
+	int32_t		size;		/**< \brief Size asked for */
+	int32_t		result;		/**< \brief Bytes transferred or a gphoto2 error code */
+	uint32_t	arg[2];		/**< \brief Depending on op */
+	uint32_t	len;		/**< \brief Data bytes kept */
+	uint32_t	reserved;
+} GPPortTraceRecord;
+
+int gp_port_trace_start (const char *filename, unsigned int records, unsigned int prefix);
+int gp_port_trace_stop  (void);
+
+#ifdef _GPHOTO2_INTERNAL_CODE
+
+/* set while a trace is being written, checked before every transaction */
+extern int gpi_port_trace_on;
+
+uint64_t gpi_port_trace_time (void);
+void     gpi_port_trace      (unsigned int port, GPPortTraceOp op, uint64_t start,
+			      int size, int result, uint32_t arg0, uint32_t arg1,
+			      const char *data, int len);
+void     gpi_port_trace_env  (void);
+
+#endif /* _GPHOTO2_INTERNAL_CODE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBGPHOTO2_GPHOTO2_PORT_TRACE_H) */
@@ -219,7 +219,22 @@ int gp_port_usb_get_sys_device(void);
 
 int gp_port_usb_find_device (GPPort *port, int idvendor, int idproduct);
 int gp_port_usb_find_device_by_class (GPPort *port, int mainclass, int subclass, int protocol);
+int gp_port_usb_get_device_id (GPPort *port, int *idvendor, int *idproduct);
 int gp_port_usb_clear_halt  (GPPort *port, int ep);
+
+/**
+ * \brief Consumer of gp_port_usb_read_stream() data
+ * \param port the #GPPort
+ * \param bytes the data of one completed transfer
+ * \param size the number of bytes in this chunk
+ * \param data the user data passed to gp_port_usb_read_stream()
+ * \return a gphoto2 error code, anything below #GP_OK stops the stream
+ */
+typedef int (*GPPortStreamFunc) (GPPort *port, const char *bytes, int size,
+				 void *data);
+int gp_port_usb_read_stream (GPPort *port, char *buffer, int size,
+			     int chunksize, int depth,
+			     GPPortStreamFunc func, void *data);
 int gp_port_usb_msg_write   (GPPort *port, int request, int value,
 			     int index, char *bytes, int size);
 int gp_port_usb_msg_read    (GPPort *port, int request, int value,
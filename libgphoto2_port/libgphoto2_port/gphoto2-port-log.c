@@ -139,6 +139,9 @@ gp_log_remove_func (int id)
 			memmove (log_funcs + i, log_funcs + i + 1, sizeof(LogFunc) * (log_funcs_count - i - 1));
 			log_funcs_count--;
 			status = GP_OK;
+			/* it was the last one, nothing moved up in its place */
+			if (i == log_funcs_count)
+				break;
 		}
 		if (new_max_log_level < log_funcs[i].level)
 			new_max_log_level = log_funcs[i].level;
@@ -211,7 +214,7 @@ gp_log_data (const char *domain, const char *data, unsigned int size, const char
 	unsigned char value;
 
 	/* No logger currently at the data log level */
-	if (log_max_level < GP_LOG_DATA)
+	if (!log_funcs_count || log_max_level < GP_LOG_DATA)
 		return;
 
 	va_start (args, format);
@@ -0,0 +1,154 @@
+/** \file gphoto2-port-record.c
+ *
+ * \brief Recording of a USB session for the replay port driver
+ *
+ * Unlike the trace, a recording keeps all the data, so it is written
+ * sequentially through a large stdio buffer. Only one port per process
+ * records, the port core calls in here for it only.
+ *
+ * \author Copyright 2026 The gPhoto project
+ *
+ * \par License
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \par
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \par
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <gphoto2/gphoto2-port-result.h>
+#include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-port-record.h>
+
+#define RECORD_BUFFER_SIZE	(1024 * 1024)
+
+static FILE		*record_file = NULL;
+static char		*record_buffer = NULL;
+static uint64_t		record_start, record_count;
+/* the interrupt polling of an event pump records from another thread */
+static pthread_mutex_t	record_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Starts recording into the file named by GP_PORT_RECORD, if set and not
+ * recording already. Returns 1 if the port calling is recorded now. */
+int
+gpi_port_record_start (const char *path, const GPPortSettingsUSB *usb, int found,
+		       int vendor, int product, int class, int subclass, int protocol)
+{
+	const char		*filename = getenv ("GP_PORT_RECORD");
+	GPPortRecordHeader	h;
+	struct timespec		ts;
+
+	if (!filename || !filename[0])
+		return 0;
+
+	pthread_mutex_lock (&record_lock);
+	if (record_file) {
+		pthread_mutex_unlock (&record_lock);
+		GP_LOG_D ("Already recording another port, not recording '%s'.", path);
+		return 0;
+	}
+	record_file = fopen (filename, "wb");
+	if (!record_file) {
+		pthread_mutex_unlock (&record_lock);
+		GP_LOG_E ("Could not create recording '%s'.", filename);
+		return 0;
+	}
+	record_buffer = malloc (RECORD_BUFFER_SIZE);
+	if (record_buffer)
+		setvbuf (record_file, record_buffer, _IOFBF, RECORD_BUFFER_SIZE);
+
+	memset (&h, 0, sizeof (h));
+	memcpy (h.magic, GP_PORT_RECORD_MAGIC, sizeof (h.magic));
+	h.version	= GP_PORT_RECORD_VERSION;
+	h.byteorder	= GP_PORT_TRACE_BYTEORDER;
+	h.header_size	= sizeof (h);
+	h.found		= found;
+	h.vendor	= vendor;
+	h.product	= product;
+	h.class		= class;
+	h.subclass	= subclass;
+	h.protocol	= protocol;
+	h.config	= usb->config;
+	h.interface	= usb->interface;
+	h.altsetting	= usb->altsetting;
+	h.inep		= usb->inep;
+	h.outep		= usb->outep;
+	h.intep		= usb->intep;
+	h.maxpacketsize	= usb->maxpacketsize;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	h.start_realtime = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	if (path)
+		strncpy (h.path, path, sizeof (h.path) - 1);
+	fwrite (&h, sizeof (h), 1, record_file);
+
+	record_start = gpi_port_trace_time ();
+	record_count = 0;
+	pthread_mutex_unlock (&record_lock);
+
+	GP_LOG_D ("Recording the USB session of '%s' into '%s'.", path, filename);
+	return 1;
+}
+
+void
+gpi_port_record (GPPortTraceOp op, uint64_t start, int size, int result,
+		 uint32_t arg0, uint32_t arg1, const char *data, int len)
+{
+	static const char	padding[8];
+	GPPortTraceRecord	r;
+
+	memset (&r, 0, sizeof (r));
+	r.time		= start - record_start;
+	r.duration	= (gpi_port_trace_time () - start) / 1000;
+	r.op		= op;
+	r.size		= size;
+	r.result	= result;
+	r.arg[0]	= arg0;
+	r.arg[1]	= arg1;
+	r.len		= (data && (len > 0)) ? len : 0;
+
+	pthread_mutex_lock (&record_lock);
+	if (record_file) {
+		r.seq = ++record_count;
+		fwrite (&r, sizeof (r), 1, record_file);
+		if (r.len) {
+			fwrite (data, 1, r.len, record_file);
+			fwrite (padding, 1, -r.len & 7, record_file);
+		}
+	}
+	pthread_mutex_unlock (&record_lock);
+}
+
+void
+gpi_port_record_stop (void)
+{
+	pthread_mutex_lock (&record_lock);
+	if (record_file) {
+		if (fclose (record_file))
+			GP_LOG_E ("Could not write the recording.");
+		else
+			GP_LOG_D ("Recorded %llu USB transactions.", (unsigned long long)record_count);
+		record_file = NULL;
+		free (record_buffer);
+		record_buffer = NULL;
+	}
+	pthread_mutex_unlock (&record_lock);
+}
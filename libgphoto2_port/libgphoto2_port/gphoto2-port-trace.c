@@ -0,0 +1,251 @@
+/** \file gphoto2-port-trace.c
+ *
+ * \brief Binary trace of port transactions into a memory mapped ring
+ *
+ * Recording a transaction takes two clock reads, one atomic increment
+ * and a copy of the first few data bytes. Several threads may record at
+ * the same time, each claims its record with the increment. A record
+ * only counts once its seq field is set, so the reader can tell records
+ * that were being written when the trace stopped (or the process died).
+ *
+ * \author Copyright 2026 The gPhoto project
+ *
+ * \par License
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \par
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \par
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#include <gphoto2/gphoto2-port-result.h>
+#include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-port-trace.h>
+
+/* defaults, also used by GP_PORT_TRACE */
+#define TRACE_RECORDS	65536
+#define TRACE_PREFIX	64
+#define TRACE_HEADER_SIZE	64
+
+/* no page faults while recording */
+#ifdef MAP_POPULATE
+# define TRACE_MAP_FLAGS	MAP_POPULATE
+#else
+# define TRACE_MAP_FLAGS	0
+#endif
+
+int gpi_port_trace_on = 0;
+
+static GPPortTraceHeader	*trace = NULL;
+static size_t			trace_size;
+/* recorders still looking at trace, it is not unmapped before they are done */
+static int			trace_users = 0;
+static pthread_mutex_t		trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t
+gpi_port_trace_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+gpi_port_trace (unsigned int port, GPPortTraceOp op, uint64_t start,
+		int size, int result, uint32_t arg0, uint32_t arg1,
+		const char *data, int len)
+{
+	GPPortTraceHeader	*t;
+	GPPortTraceRecord	*r;
+	uint64_t		index, end = gpi_port_trace_time ();
+
+	__atomic_add_fetch (&trace_users, 1, __ATOMIC_SEQ_CST);
+	t = __atomic_load_n (&trace, __ATOMIC_SEQ_CST);
+	if (!t)
+		goto out;
+
+	index = __atomic_fetch_add (&t->next, 1, __ATOMIC_RELAXED);
+	r = (GPPortTraceRecord *)((char *)t + t->header_size + (index % t->records) * t->record_size);
+	__atomic_store_n (&r->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+
+	r->time		= start;
+	r->duration	= (end - start) / 1000;
+	r->port		= port;
+	r->op		= op;
+	r->size		= size;
+	r->result	= result;
+	r->arg[0]	= arg0;
+	r->arg[1]	= arg1;
+	if (!data || (len < 0))
+		len = 0;
+	if ((unsigned int)len > t->prefix)
+		len = t->prefix;
+	r->len		= len;
+	memcpy (r + 1, data, len);
+
+	__atomic_store_n (&r->seq, index + 1, __ATOMIC_RELEASE);
+out:
+	__atomic_sub_fetch (&trace_users, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * \brief Start a binary trace of all port transactions
+ *
+ * \param filename the trace file to create
+ * \param records number of records in the ring, 0 for the default of 65536
+ * \param prefix number of data bytes kept per transaction, 0 for the default of 64
+ *
+ * Every transaction of every port of this process is recorded into a
+ * ring in filename, which is created or truncated and mapped into memory.
+ * Once records transactions were traced, the oldest are overwritten.
+ * The file is readable at any time, e.g. with the port-trace-dump tool.
+ *
+ * The trace does not depend on the log functions, data hexdumps need
+ * not be enabled. A running trace is stopped first. Setting the
+ * environment variable GP_PORT_TRACE to a file name starts a trace with
+ * the defaults when the first port is created.
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_port_trace_start (const char *filename, unsigned int records, unsigned int prefix)
+{
+#ifdef HAVE_SYS_MMAN_H
+	GPPortTraceHeader	*t;
+	struct timespec		ts;
+	unsigned int		record_size;
+	size_t			size;
+	int			fd;
+
+	C_PARAMS (filename);
+	if (!records)
+		records = TRACE_RECORDS;
+	if (!prefix)
+		prefix = TRACE_PREFIX;
+	C_PARAMS (prefix <= 65536);
+	record_size = sizeof (GPPortTraceRecord) + ((prefix + 7) & ~7);
+	size = TRACE_HEADER_SIZE + (size_t)records * record_size;
+
+	gp_port_trace_stop ();
+
+	pthread_mutex_lock (&trace_lock);
+	fd = open (filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		pthread_mutex_unlock (&trace_lock);
+		GP_LOG_E ("Could not create trace file '%s'.", filename);
+		return GP_ERROR;
+	}
+	if (ftruncate (fd, size) < 0) {
+		close (fd);
+		pthread_mutex_unlock (&trace_lock);
+		GP_LOG_E ("Could not make trace file '%s' %lu bytes large.", filename, (unsigned long)size);
+		return GP_ERROR;
+	}
+	t = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | TRACE_MAP_FLAGS, fd, 0);
+	close (fd);
+	if (t == MAP_FAILED) {
+		pthread_mutex_unlock (&trace_lock);
+		GP_LOG_E ("Could not map trace file '%s'.", filename);
+		return GP_ERROR_NO_MEMORY;
+	}
+
+	memcpy (t->magic, GP_PORT_TRACE_MAGIC, sizeof (t->magic));
+	t->version	= GP_PORT_TRACE_VERSION;
+	t->byteorder	= GP_PORT_TRACE_BYTEORDER;
+	t->header_size	= TRACE_HEADER_SIZE;
+	t->record_size	= record_size;
+	t->records	= records;
+	t->prefix	= prefix;
+	t->next		= 0;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	t->start_realtime = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	t->start_time	= gpi_port_trace_time ();
+
+	trace_size = size;
+	__atomic_store_n (&trace, t, __ATOMIC_SEQ_CST);
+	__atomic_store_n (&gpi_port_trace_on, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock (&trace_lock);
+
+	GP_LOG_D ("Tracing port transactions into '%s' (%u records, %u bytes of data each).",
+		  filename, records, prefix);
+	return GP_OK;
+#else
+	return GP_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * \brief Stop the binary trace of port transactions
+ *
+ * Waits for transactions being recorded right now and unmaps the
+ * trace file, which keeps the records.
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_port_trace_stop (void)
+{
+#ifdef HAVE_SYS_MMAN_H
+	GPPortTraceHeader *t;
+
+	pthread_mutex_lock (&trace_lock);
+	__atomic_store_n (&gpi_port_trace_on, 0, __ATOMIC_SEQ_CST);
+	t = __atomic_exchange_n (&trace, NULL, __ATOMIC_SEQ_CST);
+	if (t) {
+		while (__atomic_load_n (&trace_users, __ATOMIC_SEQ_CST))
+			sched_yield ();
+		GP_LOG_D ("Traced %llu port transactions.", (unsigned long long)t->next);
+		munmap (t, trace_size);
+	}
+	pthread_mutex_unlock (&trace_lock);
+#endif
+	return GP_OK;
+}
+
+static void
+trace_env (void)
+{
+	const char *filename = getenv ("GP_PORT_TRACE");
+
+	if (filename && filename[0])
+		gp_port_trace_start (filename, 0, 0);
+}
+
+/* Starts the trace asked for with GP_PORT_TRACE, once per process */
+void
+gpi_port_trace_env (void)
+{
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	pthread_once (&once, trace_env);
+}
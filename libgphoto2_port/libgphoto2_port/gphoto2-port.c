@@ -39,6 +39,8 @@
 #include <gphoto2/gphoto2-port-log.h>
 #include <gphoto2/gphoto2-port-locking.h>
 #include <gphoto2/gphoto2-port.h>
+#include <gphoto2/gphoto2-port-trace.h>
+#include <gphoto2/gphoto2-port-record.h>
 
 #include "libgphoto2_port/gphoto2-port-info.h"
 
@@ -54,6 +56,21 @@
 	else \
 		GP_LOG_DATA (DATA, SIZE, MSG_PRE " %i = 0x%x bytes " MSG_POST, SIZE, SIZE, ##__VA_ARGS__)
 
+/* Binary trace of the transactions, see gp_port_trace_start(), and the
+ * recording of a USB session, see gphoto2-port-record.h. TRACE_START
+ * goes right before the operation, TRACE right after it. */
+#define TRACE_TIME(port) \
+	((__atomic_load_n (&gpi_port_trace_on, __ATOMIC_RELAXED) || (port)->pc->recording) ? gpi_port_trace_time () : 0)
+#define TRACE_START() \
+	uint64_t trace_start = TRACE_TIME (port)
+#define TRACE(OP, SIZE, RESULT, ARG0, ARG1, DATA, LEN) \
+	if (trace_start) { \
+		if (__atomic_load_n (&gpi_port_trace_on, __ATOMIC_RELAXED)) \
+			gpi_port_trace (port->pc->trace_id, OP, trace_start, SIZE, RESULT, ARG0, ARG1, DATA, LEN); \
+		if (port->pc->recording) \
+			gpi_port_record (OP, trace_start, SIZE, RESULT, ARG0, ARG1, DATA, LEN); \
+	}
+
 
 /**
  * \brief Internal private libgphoto2_port data.
@@ -65,6 +82,11 @@ struct _GPPortPrivateCore {
 	struct _GPPortInfo info;	/**< Internal port information of this port. */
 	GPPortOperations *ops;	/**< Internal port operations. */
 	lt_dlhandle lh;		/**< Internal libtool library handle. */
+	unsigned int trace_id;	/**< Internal number of the port in traces. */
+	int recording;		/**< Internal flag, the port records its USB session. */
+	int found;		/**< Internal GP_PORT_RECORD_FOUND_* flags, how the USB device was found. */
+	int vendor, product;	/**< Internal USB ids the device was found by. */
+	int class, subclass, protocol;	/**< Internal USB interface class the device was found by. */
 };
 
 /**
@@ -82,6 +104,8 @@ struct _GPPortPrivateCore {
 int
 gp_port_new (GPPort **port)
 {
+	static unsigned int trace_ids = 0;
+
 	C_PARAMS (port);
 
 	GP_LOG_D ("Creating new device...");
@@ -93,6 +117,8 @@ gp_port_new (GPPort **port)
 		gp_port_free (*port);
 		return (GP_ERROR_NO_MEMORY);
 	}
+	(*port)->pc->trace_id = __atomic_add_fetch (&trace_ids, 1, __ATOMIC_RELAXED);
+	gpi_port_trace_env ();
 
 	return (GP_OK);
 }
@@ -159,6 +185,10 @@ gp_port_set_info (GPPort *port, GPPortInfo info)
 		free (port->pc->ops);
 		port->pc->ops = NULL;
 	}
+	if (port->pc->recording)
+		gpi_port_record_stop ();
+	port->pc->recording = 0;
+	port->pc->found = 0;
 	if (port->pc->lh) {
 #if !defined(VALGRIND)
 		gpi_libltdl_lock();
@@ -271,6 +301,8 @@ gp_port_get_info (GPPort *port, GPPortInfo *info)
 int
 gp_port_open (GPPort *port)
 {
+	int retval;
+
 	C_PARAMS (port);
 	CHECK_INIT (port);
 
@@ -278,7 +310,15 @@ gp_port_open (GPPort *port)
 		  port->type == GP_PORT_SERIAL ? "SERIAL" : (port->type == GP_PORT_USB ? "USB" : ""));
 
 	CHECK_SUPP (port, "open", port->pc->ops->open);
-	CHECK_RESULT (port->pc->ops->open (port));
+	TRACE_START ();
+	retval = port->pc->ops->open (port);
+	if ((retval >= GP_OK) && (port->type == GP_PORT_USB) && !port->pc->recording)
+		port->pc->recording = gpi_port_record_start (port->pc->info.path, &port->settings.usb,
+			port->pc->found, port->pc->vendor, port->pc->product,
+			port->pc->class, port->pc->subclass, port->pc->protocol);
+	TRACE (GP_PORT_TRACE_OPEN, 0, retval, port->type, 0,
+	       port->pc->info.path, port->pc->info.path ? strlen (port->pc->info.path) : 0);
+	CHECK_RESULT (retval);
 
 	return GP_OK;
 }
@@ -295,13 +335,18 @@ gp_port_open (GPPort *port)
 int
 gp_port_close (GPPort *port)
 {
+	int retval;
+
 	GP_LOG_D ("Closing port...");
 
 	C_PARAMS (port);
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "close", port->pc->ops->close);
-	CHECK_RESULT (port->pc->ops->close(port));
+	TRACE_START ();
+	retval = port->pc->ops->close(port);
+	TRACE (GP_PORT_TRACE_CLOSE, 0, retval, 0, 0, NULL, 0);
+	CHECK_RESULT (retval);
 
 	return (GP_OK);
 }
@@ -353,6 +398,8 @@ gp_port_free (GPPort *port)
 			free (port->pc->ops);
 			port->pc->ops = NULL;
 		}
+		if (port->pc->recording)
+			gpi_port_record_stop ();
 
 		if (port->pc->lh) {
 #if !defined(VALGRIND)
@@ -401,7 +448,9 @@ gp_port_write (GPPort *port, const char *data, int size)
 
 	/* Check if we wrote all bytes */
 	CHECK_SUPP (port, "write", port->pc->ops->write);
+	TRACE_START ();
 	retval = port->pc->ops->write (port, data, size);
+	TRACE (GP_PORT_TRACE_WRITE, size, retval, 0, 0, data, size);
 	if (retval < 0) {
 		GP_LOG_E ("Writing %i = 0x%x bytes to port failed: %s (%d)",
 			  size, size, gp_port_result_as_string(retval), retval);
@@ -436,7 +485,9 @@ gp_port_read (GPPort *port, char *data, int size)
 
 	/* Check if we read as many bytes as expected */
 	CHECK_SUPP (port, "read", port->pc->ops->read);
+	TRACE_START ();
 	retval = port->pc->ops->read (port, data, size);
+	TRACE (GP_PORT_TRACE_READ, size, retval, 0, 0, data, retval);
 	if (retval < 0) {
 		GP_LOG_E ("Reading %i = 0x%x bytes from port failed: %s (%d)",
 			  size, size, gp_port_result_as_string(retval), retval);
@@ -472,7 +523,9 @@ gp_port_check_int (GPPort *port, char *data, int size)
 
 	/* Check if we read as many bytes as expected */
 	CHECK_SUPP (port, "check_int", port->pc->ops->check_int);
+	TRACE_START ();
 	retval = port->pc->ops->check_int (port, data, size, port->timeout);
+	TRACE (GP_PORT_TRACE_CHECK_INT, size, retval, port->timeout, 0, data, retval);
 	CHECK_RESULT (retval);
 	LOG_DATA (data, retval, size, "Read   ", "from interrupt endpoint:");
 
@@ -505,7 +558,9 @@ gp_port_check_int_fast (GPPort *port, char *data, int size)
 
 	/* Check if we read as many bytes as expected */
 	CHECK_SUPP (port, "check_int", port->pc->ops->check_int);
+	TRACE_START ();
 	retval = port->pc->ops->check_int (port, data, size, FAST_TIMEOUT);
+	TRACE (GP_PORT_TRACE_CHECK_INT, size, retval, FAST_TIMEOUT, 0, data, retval);
 	CHECK_RESULT (retval);
 
 #ifdef IGNORE_EMPTY_INTR_READS
@@ -796,6 +851,11 @@ gp_port_usb_find_device (GPPort *port, int idvendor, int idproduct)
 	CHECK_SUPP (port, "find_device", port->pc->ops->find_device);
 	CHECK_RESULT (port->pc->ops->find_device (port, idvendor, idproduct));
 
+	/* remembered for a recording of the session */
+	port->pc->found |= GP_PORT_RECORD_FOUND_ID;
+	port->pc->vendor = idvendor;
+	port->pc->product = idproduct;
+
 	return (GP_OK);
 }
 
@@ -820,9 +880,40 @@ gp_port_usb_find_device_by_class (GPPort *port, int mainclass, int subclass, int
 	CHECK_SUPP (port, "find_device_by_class", port->pc->ops->find_device_by_class);
 	CHECK_RESULT (port->pc->ops->find_device_by_class (port, mainclass, subclass, protocol));
 
+	port->pc->found |= GP_PORT_RECORD_FOUND_CLASS;
+	port->pc->class = mainclass;
+	port->pc->subclass = subclass;
+	port->pc->protocol = protocol;
+
 	return (GP_OK);
 }
 
+/**
+ * \brief Get the vendor and product id of a USB device
+ *
+ * \param port a GPPort
+ * \param idvendor the USB vendor id
+ * \param idproduct the USB product id
+ *
+ * Reads the ids of the single USB device named by the port path, e.g.
+ * "usb:001,005", without setting up the port for it as
+ * gp_port_usb_find_device() does. Camera detection uses them to look up
+ * the matching camera models instead of trying every model on the port.
+ *
+ * \return a gphoto2 error code, #GP_ERROR_NOT_SUPPORTED if the port driver
+ *         or the path does not tell
+ */
+int
+gp_port_usb_get_device_id (GPPort *port, int *idvendor, int *idproduct)
+{
+	C_PARAMS (port && idvendor && idproduct);
+	CHECK_INIT (port);
+
+	if (!port->pc->ops->get_device_id)
+		return GP_ERROR_NOT_SUPPORTED;
+	return port->pc->ops->get_device_id (port, idvendor, idproduct);
+}
+
 /**
  * \brief Clear USB endpoint HALT condition
  *
@@ -847,6 +938,117 @@ gp_port_usb_clear_halt (GPPort *port, int ep)
 	return (GP_OK);
 }
 
+/* The chunks streamed by a port driver are traced on their way to func */
+struct trace_stream {
+	GPPortStreamFunc	func;
+	void			*data;
+	uint64_t		start;
+};
+
+static int
+trace_stream_func (GPPort *port, const char *bytes, int size, void *data)
+{
+	struct trace_stream *ts = data;
+	uint64_t trace_start = ts->start;
+	int ret;
+
+	TRACE (GP_PORT_TRACE_READ_STREAM, size, size, 0, 0, bytes, size);
+	ret = ts->func (port, bytes, size, ts->data);
+	/* with transfers in flight, a chunk takes from the previous one on */
+	ts->start = TRACE_TIME (port);
+	return ret;
+}
+
+/**
+ * \brief Read a stream of data from the USB bulk IN endpoint
+ *
+ * \param port a GPPort
+ * \param buffer memory for size bytes to read into, or NULL
+ * \param size the number of bytes to read
+ * \param chunksize the size of a single transfer
+ * \param depth the number of transfers to keep queued
+ * \param func the function receiving the data
+ * \param data user data for func
+ *
+ * Reads size bytes in chunks of chunksize bytes. Port drivers supporting
+ * it keep up to depth bulk transfers in flight, so the bus does not idle
+ * between the chunks. Completed chunks are handed to func in order.
+ * chunksize should be a multiple of the endpoint packet size.
+ *
+ * If buffer is given, every chunk is read straight into its place in
+ * buffer and func gets a pointer there, so no data is copied. Otherwise
+ * the chunks live in temporary memory only valid during the func call.
+ *
+ * A short transfer ends the stream early, the number of bytes delivered
+ * is returned in that case. If func returns an error, the stream is
+ * stopped and that error is returned.
+ *
+ * Port drivers without streaming support fall back to gp_port_read().
+ *
+ * \return a gphoto2 error code or the amount of data read
+ */
+int
+gp_port_usb_read_stream (GPPort *port, char *buffer, int size, int chunksize,
+			 int depth, GPPortStreamFunc func, void *data)
+{
+	int retval = 0, done = 0;
+	char *buf = buffer;
+
+	gp_log (GP_LOG_DATA, __func__, "Streaming %i = 0x%x bytes from port (%i x %i)...",
+		size, size, depth, chunksize);
+
+	C_PARAMS (port && func && size >= 0 && chunksize > 0 && depth > 0);
+	CHECK_INIT (port);
+
+	if (port->pc->ops->read_stream) {
+		struct trace_stream ts = { func, data, 0 };
+
+		ts.start = TRACE_TIME (port);
+		if (ts.start)
+			retval = port->pc->ops->read_stream (port, buffer, size, chunksize, depth, trace_stream_func, &ts);
+		else
+			retval = port->pc->ops->read_stream (port, buffer, size, chunksize, depth, func, data);
+		if (retval < 0)
+			GP_LOG_E ("Streaming %i = 0x%x bytes from port failed: %s (%d)",
+				  size, size, gp_port_result_as_string(retval), retval);
+		return retval;
+	}
+
+	CHECK_SUPP (port, "read", port->pc->ops->read);
+	if (!size)
+		return 0;
+	if (!buffer)
+		C_MEM (buf = malloc (chunksize));
+	while (done < size) {
+		int chunk = (size - done < chunksize) ? size - done : chunksize;
+
+		if (buffer)
+			buf = buffer + done;
+
+		TRACE_START ();
+		retval = port->pc->ops->read (port, buf, chunk);
+		TRACE (GP_PORT_TRACE_READ_STREAM, chunk, retval, 0, 0, buf, retval);
+		if (retval < 0) {
+			GP_LOG_E ("Reading %i = 0x%x bytes from port failed: %s (%d)",
+				  chunk, chunk, gp_port_result_as_string(retval), retval);
+			break;
+		}
+		LOG_DATA (buf, retval, chunk, "Read   ", "from port:");
+		done += retval;
+		if (retval < chunk) {
+			if (retval)
+				retval = func (port, buf, retval, data);
+			break;
+		}
+		retval = func (port, buf, retval, data);
+		if (retval < 0)
+			break;
+	}
+	if (!buffer)
+		free (buf);
+	return (retval < 0) ? retval : done;
+}
+
 /**
  * \brief Send a USB control message with output data
  *
@@ -874,7 +1076,9 @@ gp_port_usb_msg_write (GPPort *port, int request, int value, int index,
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "msg_write", port->pc->ops->msg_write);
+	TRACE_START ();
 	retval = port->pc->ops->msg_write(port, request, value, index, bytes, size);
+	TRACE (GP_PORT_TRACE_MSG_WRITE, size, retval, request, (value << 16) | (index & 0xffff), bytes, size);
 	CHECK_RESULT (retval);
 
 	return (retval);
@@ -907,7 +1111,9 @@ gp_port_usb_msg_read (GPPort *port, int request, int value, int index,
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "msg_read", port->pc->ops->msg_read);
+	TRACE_START ();
 	retval = port->pc->ops->msg_read (port, request, value, index, bytes, size);
+	TRACE (GP_PORT_TRACE_MSG_READ, size, retval, request, (value << 16) | (index & 0xffff), bytes, retval);
 	CHECK_RESULT (retval);
 
 	LOG_DATA (bytes, retval, size, "Read", "USB message (request=0x%x value=0x%x index=0x%x size=%i=0x%x)",
@@ -947,8 +1153,10 @@ gp_port_usb_msg_interface_write (GPPort *port, int request,
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "msg_build", port->pc->ops->msg_interface_write);
+	TRACE_START ();
 	retval = port->pc->ops->msg_interface_write(port, request,
 			value, index, bytes, size);
+	TRACE (GP_PORT_TRACE_MSG_INTERFACE_WRITE, size, retval, request, (value << 16) | (index & 0xffff), bytes, size);
 	CHECK_RESULT (retval);
 
 	return (retval);
@@ -982,8 +1190,10 @@ gp_port_usb_msg_interface_read (GPPort *port, int request, int value, int index,
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "msg_read", port->pc->ops->msg_interface_read);
+	TRACE_START ();
 	retval = port->pc->ops->msg_interface_read (port, request,
 			value, index, bytes, size);
+	TRACE (GP_PORT_TRACE_MSG_INTERFACE_READ, size, retval, request, (value << 16) | (index & 0xffff), bytes, retval);
 	CHECK_RESULT (retval);
 
 	LOG_DATA (bytes, retval, size, "Read", "USB message (request=0x%x value=0x%x index=0x%x size=%i=0x%x)",
@@ -1025,8 +1235,10 @@ gp_port_usb_msg_class_write (GPPort *port, int request,
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "msg_build", port->pc->ops->msg_class_write);
+	TRACE_START ();
 	retval = port->pc->ops->msg_class_write(port, request,
 			value, index, bytes, size);
+	TRACE (GP_PORT_TRACE_MSG_CLASS_WRITE, size, retval, request, (value << 16) | (index & 0xffff), bytes, size);
 	CHECK_RESULT (retval);
 
 	return (retval);
@@ -1060,8 +1272,10 @@ gp_port_usb_msg_class_read (GPPort *port, int request, int value, int index,
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "msg_read", port->pc->ops->msg_class_read);
+	TRACE_START ();
 	retval = port->pc->ops->msg_class_read (port, request,
 			value, index, bytes, size);
+	TRACE (GP_PORT_TRACE_MSG_CLASS_READ, size, retval, request, (value << 16) | (index & 0xffff), bytes, retval);
 	CHECK_RESULT (retval);
 
 	LOG_DATA (bytes, retval, size, "Read", "USB message (request=0x%x value=0x%x index=0x%x size=%i=0x%x)",
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <libusb.h>
 
@@ -105,16 +106,17 @@ static int translate_libusb_error( int error, int default_return )
 	}
 }
 
-struct _PrivateIrqCompleted {
-	struct _PrivateIrqCompleted	*next;
-	enum libusb_transfer_status	status;
-	int							data_len;
-	unsigned char				*data;
-};
-
 #define NB_INTERRUPT_TRANSFERS 10
 /* FIXME: safe size? */
 #define INTERRUPT_BUFFER_SIZE 256
+/* completed interrupts not yet read, a power of two */
+#define NB_INTERRUPT_SLOTS 64
+
+struct _PrivateIrqCompleted {
+	enum libusb_transfer_status	status;
+	int				data_len;
+	unsigned char			data[INTERRUPT_BUFFER_SIZE];
+};
 
 #ifdef HAVE_LIBUSB_WRAP_SYS_DEVICE
 static struct _GPPortExternalSysDevice {
@@ -166,10 +168,22 @@ struct _GPPortPrivateLibrary {
 	int				logfd;
 #endif
 
+	/* The interrupt transfers complete in whichever thread handles the
+	 * libusb events, e.g. a camera event pump next to a bulk transfer. */
+	pthread_mutex_t			irq_lock;
 	struct libusb_transfer		*transfers[NB_INTERRUPT_TRANSFERS];
 	int				nrofactiveinttransfers;
-	struct _PrivateIrqCompleted	*irqs_head;
-	struct _PrivateIrqCompleted	*irqs_tail;
+
+	/* Ring of completed interrupts, copied out of the transfer buffers
+	 * so both can be reused. irqs_read and irqs_write only ever count up. */
+	struct _PrivateIrqCompleted	irqs[NB_INTERRUPT_SLOTS];
+	unsigned int			irqs_read;
+	unsigned int			irqs_write;
+	/* for sizing the ring and the buffers, logged on close */
+	unsigned long			irqs_received;
+	unsigned long			irqs_dropped;		/* ring full */
+	unsigned long			irqs_overflowed;	/* more than INTERRUPT_BUFFER_SIZE */
+	unsigned int			irqs_maxqueued;
 };
 
 GPPortType
@@ -396,6 +410,7 @@ static int gp_libusb1_init (GPPort *port)
 	memset (port->pl, 0, sizeof (GPPortPrivateLibrary));
 
 	port->pl->config = port->pl->interface = port->pl->altsetting = -1;
+	pthread_mutex_init (&port->pl->irq_lock, NULL);
 
 #ifdef  HAVE_LIBUSB_WRAP_SYS_DEVICE
 	if (has_external_fd()) {
@@ -404,6 +419,7 @@ static int gp_libusb1_init (GPPort *port)
 #endif
 	{
 		if (LOG_ON_LIBUSB_E (libusb_init (&port->pl->ctx))) {
+			pthread_mutex_destroy (&port->pl->irq_lock);
 			free (port->pl);
 			port->pl = NULL;
 			return GP_ERROR_IO;
@@ -441,6 +457,7 @@ gp_libusb1_exit (GPPort *port)
 		{
 			libusb_exit (port->pl->ctx);
 		}
+		pthread_mutex_destroy (&port->pl->irq_lock);
 		free (port->pl);
 		port->pl = NULL;
 	}
@@ -553,6 +570,7 @@ _close_async_interrupts(GPPort *port)
 	LOG_ON_LIBUSB_E (libusb_handle_events_timeout(port->pl->ctx, &tv));
 	/* Now cancel and free the async transfers */
 	GP_LOG_D("canceling USB IRQ transfers");
+	pthread_mutex_lock (&port->pl->irq_lock);
 	for (i = 0; i < sizeof(port->pl->transfers)/sizeof(port->pl->transfers[0]); i++) {
 		if (port->pl->transfers[i]) {
 			/* this happens if the transfer is completed for instance, but not reaped. we cannot cancel it. */
@@ -562,17 +580,20 @@ _close_async_interrupts(GPPort *port)
 			}
 		}
 	}
+	pthread_mutex_unlock (&port->pl->irq_lock);
 	tv.tv_sec = 0;
 	tv.tv_usec = 0;
 	LOG_ON_LIBUSB_E (libusb_handle_events_timeout(port->pl->ctx, &tv));
 	/* Do just one round ... this should be sufficient and avoids endless loops. */
 	haveone = 0;
+	pthread_mutex_lock (&port->pl->irq_lock);
 	for (i = 0; i < sizeof(port->pl->transfers)/sizeof(port->pl->transfers[0]); i++) {
 		if (port->pl->transfers[i]) {
 			GP_LOG_D("checking: transfer %d:%p status %d",i, port->pl->transfers[i], port->pl->transfers[i]->status);
 			haveone = 1;
 		}
 	}
+	pthread_mutex_unlock (&port->pl->irq_lock);
 	if (haveone)
 		LOG_ON_LIBUSB_E (libusb_handle_events(port->pl->ctx));
 	return GP_OK;
@@ -625,18 +646,15 @@ gp_libusb1_close (GPPort *port)
 	}
 #endif
 
-	struct _PrivateIrqCompleted *irq_iter;
-	struct _PrivateIrqCompleted *irq_next;
-
-	irq_iter=port->pl->irqs_head;
-	while (irq_iter != NULL) {
-		free(irq_iter->data);
-		irq_next = irq_iter->next;
-		free(irq_iter);
-		irq_iter = irq_next;
-	}
-	port->pl->irqs_head = NULL;
-	port->pl->irqs_tail = NULL;
+	pthread_mutex_lock (&port->pl->irq_lock);
+	if (port->pl->irqs_received)
+		GP_LOG_D("interrupts: %lu received, %lu dropped with %d slots full, %lu overflowed, at most %u queued",
+			 port->pl->irqs_received, port->pl->irqs_dropped, NB_INTERRUPT_SLOTS,
+			 port->pl->irqs_overflowed, port->pl->irqs_maxqueued);
+	port->pl->irqs_read = port->pl->irqs_write = 0;
+	port->pl->irqs_received = port->pl->irqs_dropped = port->pl->irqs_overflowed = 0;
+	port->pl->irqs_maxqueued = 0;
+	pthread_mutex_unlock (&port->pl->irq_lock);
 	port->pl->dh = NULL;
 	return GP_OK;
 }
@@ -699,6 +717,139 @@ gp_libusb1_read(GPPort *port, char *bytes, int size)
 	return curread;
 }
 
+/* upper limit of bulk transfers kept in flight by gp_libusb1_read_stream */
+#define MAX_STREAM_TRANSFERS 32
+
+static void LIBUSB_CALL
+_cb_stream(struct libusb_transfer *transfer)
+{
+	*(int*)transfer->user_data = 1;
+}
+
+static int
+_stream_status_to_error (enum libusb_transfer_status status)
+{
+	switch (status) {
+	case LIBUSB_TRANSFER_COMPLETED:	return GP_OK;
+	case LIBUSB_TRANSFER_TIMED_OUT:	return GP_ERROR_TIMEOUT;
+	case LIBUSB_TRANSFER_NO_DEVICE:	return GP_ERROR_IO_USB_FIND;
+	default:			return GP_ERROR_IO_READ;
+	}
+}
+
+/*
+ * Keeps up to depth bulk IN transfers queued and hands the completed
+ * ones to func in submission order. A short transfer ends the stream,
+ * the transfers behind it are cancelled, but whatever data they already
+ * got is still delivered in order. An error, also from submitting a
+ * transfer, cancels the ones still queued before they are collected.
+ * With a caller buffer the transfers point straight into it, otherwise
+ * each has its own chunk.
+ */
+static int
+gp_libusb1_read_stream (GPPort *port, char *buffer, int size, int chunksize,
+			int depth, GPPortStreamFunc func, void *data)
+{
+	struct libusb_transfer	*transfers[MAX_STREAM_TRANSFERS];
+	int			completed[MAX_STREAM_TRANSFERS];
+	int			nrtransfers, queued = 0, done = 0, inflight = 0;
+	int			head = 0, i, ret = GP_OK, stop = 0, cancelled = 0;
+
+	C_PARAMS (port && port->pl->dh);
+
+	if (depth > MAX_STREAM_TRANSFERS)
+		depth = MAX_STREAM_TRANSFERS;
+	nrtransfers = (size + chunksize - 1) / chunksize;
+	if (nrtransfers > depth)
+		nrtransfers = depth;
+
+	memset (transfers, 0, sizeof(transfers));
+	for (i = 0; i < nrtransfers; i++) {
+		unsigned char *buf = NULL;
+
+		transfers[i] = libusb_alloc_transfer (0);
+		if (!buffer)
+			buf = malloc (chunksize);
+		if (!transfers[i] || (!buffer && !buf)) {
+			free (buf);
+			ret = GP_ERROR_NO_MEMORY;
+			goto out;
+		}
+		libusb_fill_bulk_transfer (transfers[i], port->pl->dh, port->settings.usb.inep,
+			buf, chunksize, _cb_stream, &completed[i], port->timeout
+		);
+		if (!buffer)
+			transfers[i]->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
+	}
+
+	while (1) {
+		struct libusb_transfer *t;
+
+		/* refill the queue behind the head */
+		while (!stop && (inflight < nrtransfers) && (queued < size)) {
+			i = (head + inflight) % nrtransfers;
+			transfers[i]->length = (size - queued < chunksize) ? size - queued : chunksize;
+			if (buffer)
+				transfers[i]->buffer = (unsigned char*)buffer + queued;
+			completed[i] = 0;
+			ret = LOG_ON_LIBUSB_E (libusb_submit_transfer (transfers[i]));
+			if (ret < LIBUSB_SUCCESS) {
+				ret = translate_libusb_error (ret, GP_ERROR_IO_READ);
+				stop = 2;
+				break;
+			}
+			ret = GP_OK;
+			queued += transfers[i]->length;
+			inflight++;
+		}
+		if (stop && !cancelled) {
+			/* cancel everything still in flight, then collect it */
+			for (i = 0; i < inflight; i++)
+				libusb_cancel_transfer (transfers[(head + i) % nrtransfers]);
+			cancelled = 1;
+		}
+		if (!inflight)
+			break;
+
+		while (!completed[head]) {
+			int r = libusb_handle_events_completed (port->pl->ctx, &completed[head]);
+
+			if ((r < LIBUSB_SUCCESS) && (r != LIBUSB_ERROR_INTERRUPTED))
+				GP_LOG_E ("libusb_handle_events_completed failed: %s", my_libusb_strerror (r));
+		}
+		t = transfers[head];
+		head = (head + 1) % nrtransfers;
+		inflight--;
+
+		if (stop == 2) /* drain only */
+			continue;
+		if ((t->status != LIBUSB_TRANSFER_COMPLETED) && (!stop || (t->status != LIBUSB_TRANSFER_CANCELLED))) {
+			GP_LOG_E ("bulk stream transfer %p failed with status %d", t, t->status);
+			ret = _stream_status_to_error (t->status);
+			stop = 2;
+		} else if (t->actual_length) {
+#ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+			write(port->pl->logfd, t->buffer, t->actual_length);
+#endif
+			ret = func (port, (char*)t->buffer, t->actual_length, data);
+			done += t->actual_length;
+			if (ret < GP_OK)
+				stop = 2;
+		}
+		if (!stop && (t->actual_length < t->length)) {
+			GP_LOG_D ("short bulk stream transfer, %d of %d bytes", t->actual_length, t->length);
+			stop = 1;
+		}
+	}
+out:
+	for (i = 0; i < nrtransfers; i++)
+		if (transfers[i])
+			libusb_free_transfer (transfers[i]);
+	if (ret < GP_OK)
+		return ret;
+	return done;
+}
+
 static int
 gp_libusb1_reset(GPPort *port)
 {
@@ -717,7 +868,7 @@ _cb_irq(struct libusb_transfer *transfer)
 {
 	struct _PrivateIrqCompleted *irq_new = NULL;
 	struct _GPPortPrivateLibrary *pl = transfer->user_data;
-	unsigned int i;
+	unsigned int i, queued;
 	int ret;
 
 	if (transfer->status != LIBUSB_TRANSFER_CANCELLED && transfer->status != LIBUSB_TRANSFER_COMPLETED) {
@@ -736,18 +887,26 @@ _cb_irq(struct libusb_transfer *transfer)
 		GP_LOG_D("IRQ transfer %p failed with %s", transfer, status_str);
 	}
 
+	pthread_mutex_lock (&pl->irq_lock);
 	if ((transfer->status != LIBUSB_TRANSFER_CANCELLED) &&
 		(transfer->status != LIBUSB_TRANSFER_TIMED_OUT)
 	) {
-		irq_new = (struct _PrivateIrqCompleted *) calloc(1, sizeof (struct _PrivateIrqCompleted));
-		irq_new->status = transfer->status;
-
-		/* Add the irq to the list */
-		if (pl->irqs_tail)
-			pl->irqs_tail->next = irq_new;
-		pl->irqs_tail = irq_new;
-		if (!pl->irqs_head)
-			pl->irqs_head = irq_new;
+		pl->irqs_received++;
+		if (transfer->status == LIBUSB_TRANSFER_OVERFLOW)
+			pl->irqs_overflowed++;
+		queued = pl->irqs_write - pl->irqs_read;
+		if (queued < NB_INTERRUPT_SLOTS) {
+			/* Add the irq to the ring */
+			irq_new = &pl->irqs[pl->irqs_write++ % NB_INTERRUPT_SLOTS];
+			irq_new->status = transfer->status;
+			irq_new->data_len = 0;
+			if (queued + 1 > pl->irqs_maxqueued)
+				pl->irqs_maxqueued = queued + 1;
+		} else {
+			/* keep the older ones, they are read first */
+			if (!pl->irqs_dropped++)
+				GP_LOG_E("All %d interrupt slots are full, dropping interrupts", NB_INTERRUPT_SLOTS);
+		}
 	}
 
 	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
@@ -757,20 +916,21 @@ _cb_irq(struct libusb_transfer *transfer)
 				libusb_free_transfer (transfer);
 				pl->transfers[i] = NULL;
 				pl->nrofactiveinttransfers--;
-				return;
+				break;
 			}
 		}
+		pthread_mutex_unlock (&pl->irq_lock);
 		return;
 	}
 
 	if (transfer->actual_length) {
 		GP_LOG_DATA ((char*)transfer->buffer, transfer->actual_length, "interrupt");
 
-		irq_new->data_len = transfer->actual_length;
-		// Steal the transfer buffer and replace it with a new one for reusing the transfer
-		irq_new->data = transfer->buffer;
-		transfer->buffer = malloc(INTERRUPT_BUFFER_SIZE);
-		transfer->length = INTERRUPT_BUFFER_SIZE;
+		/* copy it out, the transfer goes out again with the same buffer */
+		if (irq_new) {
+			irq_new->data_len = transfer->actual_length;
+			memcpy (irq_new->data, transfer->buffer, transfer->actual_length);
+		}
 	}
 
 	GP_LOG_D("Requeuing completed transfer %p", transfer);
@@ -778,6 +938,7 @@ _cb_irq(struct libusb_transfer *transfer)
 	if (ret < LIBUSB_SUCCESS) {
 		pl->nrofactiveinttransfers--;
 	}
+	pthread_mutex_unlock (&pl->irq_lock);
 	return;
 }
 
@@ -792,6 +953,7 @@ gp_libusb1_queue_interrupt_urbs (GPPort *port)
 		return GP_OK;
 
 
+	pthread_mutex_lock (&port->pl->irq_lock);
 	for (i = 0; i < sizeof(port->pl->transfers)/sizeof(port->pl->transfers[0]); i++) {
 		unsigned char *buf;
 		if (port->pl->transfers[i] != NULL)
@@ -806,53 +968,38 @@ gp_libusb1_queue_interrupt_urbs (GPPort *port)
 		if (ret < LIBUSB_SUCCESS) {
 			libusb_free_transfer (port->pl->transfers[i]);
 			port->pl->transfers[i] = NULL;
+			pthread_mutex_unlock (&port->pl->irq_lock);
 			return translate_libusb_error(ret, GP_ERROR_IO);
 		}
 		port->pl->nrofactiveinttransfers++;
 	}
+	pthread_mutex_unlock (&port->pl->irq_lock);
 	return GP_OK;
 }
 
+/* The completed interrupt after irq in the ring, NULL if there is none */
+static struct _PrivateIrqCompleted *
+gp_libusb1_next_irq (GPPortPrivateLibrary *pl, struct _PrivateIrqCompleted *irq)
+{
+	if (pl->irqs_write - pl->irqs_read < 2)
+		return NULL;
+	return &pl->irqs[(irq - pl->irqs + 1) % NB_INTERRUPT_SLOTS];
+}
+
+/* Takes the oldest completed interrupt off the ring, GP_ERROR_TIMEOUT if there is none */
 static int
-gp_libusb1_check_int (GPPort *port, char *bytes, int size, int timeout)
+gp_libusb1_pop_irq (GPPort *port, char *bytes, int size)
 {
+	GPPortPrivateLibrary	*pl = port->pl;
 	int 		ret;
-	struct timeval	tv;
-	struct _PrivateIrqCompleted *irq_cur = NULL;
+	struct _PrivateIrqCompleted *irq_cur, *irq_next;
 
-	C_PARAMS (port && port->pl->dh && timeout >= 0);
-
-	if (port->pl->irqs_head != NULL)
-		goto handleirq;
-
-	if (!timeout)
+	pthread_mutex_lock (&pl->irq_lock);
+	if (pl->irqs_read == pl->irqs_write) {
+		pthread_mutex_unlock (&pl->irq_lock);
 		return GP_ERROR_TIMEOUT;
-
-	/* If we have lost all the queued transfers, we should probably restart them
-	 * if there are long running error, like "no more device". That would be
-	 * reported upstream, so upstream can take care of that.
-	 */
-	if (port->pl->nrofactiveinttransfers < NB_INTERRUPT_TRANSFERS) {
-		ret = gp_libusb1_queue_interrupt_urbs(port);
-		if (ret != GP_OK)
-			return ret;
 	}
-
-	tv.tv_sec = timeout/1000;
-	tv.tv_usec = (timeout%1000)*1000;
-
-	ret = LOG_ON_LIBUSB_E (libusb_handle_events_timeout(port->pl->ctx, &tv));
-
-	if (port->pl->irqs_head != NULL)
-		goto handleirq;
-
-	if (ret < LIBUSB_SUCCESS)
-		return translate_libusb_error(ret, GP_ERROR_IO_READ);
-
-	return GP_ERROR_TIMEOUT;
-
-handleirq:
-	irq_cur = port->pl->irqs_head;
+	irq_cur = &pl->irqs[pl->irqs_read % NB_INTERRUPT_SLOTS];
 
 	switch (irq_cur->status) {
 	case LIBUSB_TRANSFER_COMPLETED:
@@ -861,41 +1008,32 @@ handleirq:
 	case LIBUSB_TRANSFER_NO_DEVICE:
 		ret = GP_ERROR_IO_USB_FIND;
 		/* Agglomerate similar errors to only report once. */
-		while ((irq_cur->next) &&
-			   (irq_cur->next->status == LIBUSB_TRANSFER_NO_DEVICE)
+		while ((irq_next = gp_libusb1_next_irq (pl, irq_cur)) &&
+			   (irq_next->status == LIBUSB_TRANSFER_NO_DEVICE)
 		) {
-			port->pl->irqs_head = irq_cur->next;
-			free(irq_cur->data);
-			free(irq_cur);
-			irq_cur = port->pl->irqs_head;
+			pl->irqs_read++;
+			irq_cur = irq_next;
 		}
 		break;
 	default:
 		ret = GP_ERROR_IO;
 		/* Agglomerate similar errors to only report once. */
-		while ((irq_cur->next) &&
-			   (irq_cur->next->status != LIBUSB_TRANSFER_COMPLETED) &&
-			   (irq_cur->next->status != LIBUSB_TRANSFER_NO_DEVICE)
-	) {
-			port->pl->irqs_head = irq_cur->next;
-			free(irq_cur->data);
-			free(irq_cur);
-			irq_cur = port->pl->irqs_head;
+		while ((irq_next = gp_libusb1_next_irq (pl, irq_cur)) &&
+			   (irq_next->status != LIBUSB_TRANSFER_COMPLETED) &&
+			   (irq_next->status != LIBUSB_TRANSFER_NO_DEVICE)
+		) {
+			pl->irqs_read++;
+			irq_cur = irq_next;
 		}
 		break;
 	}
 
 	if (size > irq_cur->data_len)
 		size = irq_cur->data_len;
-	if (irq_cur->data) {
-		if (size > 0)
-			memcpy(bytes, irq_cur->data, size);
-		free(irq_cur->data);
-	}
-	port->pl->irqs_head = irq_cur->next;
-	if (port->pl->irqs_head == NULL)
-		port->pl->irqs_tail = NULL;
-	free(irq_cur);
+	if (size > 0)
+		memcpy(bytes, irq_cur->data, size);
+	pl->irqs_read++;
+	pthread_mutex_unlock (&pl->irq_lock);
 
 	if (ret != GP_OK)
 		return ret;
@@ -903,6 +1041,57 @@ handleirq:
 	return size;
 }
 
+static int
+gp_libusb1_check_int (GPPort *port, char *bytes, int size, int timeout)
+{
+	int 		ret, active;
+	struct timeval	tv;
+
+	C_PARAMS (port && port->pl->dh && timeout >= 0);
+
+	ret = gp_libusb1_pop_irq (port, bytes, size);
+	if (ret != GP_ERROR_TIMEOUT)
+		return ret;
+
+	pthread_mutex_lock (&port->pl->irq_lock);
+	active = port->pl->nrofactiveinttransfers;
+	pthread_mutex_unlock (&port->pl->irq_lock);
+
+	if (!timeout) {
+		/* no waiting, but take in the interrupts completed meanwhile */
+		if (active) {
+			tv.tv_sec = tv.tv_usec = 0;
+			LOG_ON_LIBUSB_E (libusb_handle_events_timeout(port->pl->ctx, &tv));
+			return gp_libusb1_pop_irq (port, bytes, size);
+		}
+		return GP_ERROR_TIMEOUT;
+	}
+
+	/* If we have lost all the queued transfers, we should probably restart them
+	 * if there are long running error, like "no more device". That would be
+	 * reported upstream, so upstream can take care of that.
+	 */
+	if (active < NB_INTERRUPT_TRANSFERS) {
+		ret = gp_libusb1_queue_interrupt_urbs(port);
+		if (ret != GP_OK)
+			return ret;
+	}
+
+	tv.tv_sec = timeout/1000;
+	tv.tv_usec = (timeout%1000)*1000;
+
+	ret = LOG_ON_LIBUSB_E (libusb_handle_events_timeout(port->pl->ctx, &tv));
+
+	size = gp_libusb1_pop_irq (port, bytes, size);
+	if (size != GP_ERROR_TIMEOUT)
+		return size;
+
+	if (ret < LIBUSB_SUCCESS)
+		return translate_libusb_error(ret, GP_ERROR_IO_READ);
+
+	return GP_ERROR_TIMEOUT;
+}
+
 static int
 gp_libusb1_msg(GPPort *port, int request, int value, int index, char *bytes, int size, int flags, int default_error)
 {
@@ -1223,6 +1412,35 @@ gp_libusb1_find_path_lib(GPPort *port)
 #endif
 	return GP_ERROR_IO_USB_FIND;
 }
+static int
+gp_libusb1_get_device_id_lib(GPPort *port, int *idvendor, int *idproduct)
+{
+	char *s;
+	int d, busnr = 0, devnr = 0;
+	GPPortPrivateLibrary *pl;
+
+	C_PARAMS (port);
+
+	pl = port->pl;
+
+	/* only a path naming a single device tells */
+	s = strchr (port->settings.usb.port,':');
+	if (!s || (sscanf (s+1, "%d,%d", &busnr, &devnr) != 2))
+		return GP_ERROR_NOT_SUPPORTED;
+
+	pl->nrofdevs = load_devicelist (port->pl);
+
+	for (d = 0; d < pl->nrofdevs; d++) {
+		if ((busnr != libusb_get_bus_number (pl->devs[d])) ||
+		    (devnr != libusb_get_device_address (pl->devs[d])))
+			continue;
+		*idvendor  = pl->descs[d].idVendor;
+		*idproduct = pl->descs[d].idProduct;
+		return GP_OK;
+	}
+	return GP_ERROR_IO_USB_FIND;
+}
+
 static int
 gp_libusb1_find_device_lib(GPPort *port, int idvendor, int idproduct)
 {
@@ -1620,6 +1838,7 @@ gp_port_library_operations (void)
 	ops->close  = gp_libusb1_close;
 	ops->read   = gp_libusb1_read;
 	ops->reset  = gp_libusb1_reset;
+	ops->read_stream = gp_libusb1_read_stream;
 	ops->write  = gp_libusb1_write;
 	ops->check_int = gp_libusb1_check_int;
 	ops->update = gp_libusb1_update;
@@ -1632,6 +1851,7 @@ gp_port_library_operations (void)
 	ops->msg_class_read   = gp_libusb1_msg_class_read_lib;
 	ops->find_device = gp_libusb1_find_device_lib;
 	ops->find_device_by_class = gp_libusb1_find_device_by_class_lib;
+	ops->get_device_id = gp_libusb1_get_device_id_lib;
 
 	return (ops);
 }
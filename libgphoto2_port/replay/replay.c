@@ -0,0 +1,542 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/* replay.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Plays a USB session recorded with GP_PORT_RECORD back to the camera
+ * driver, see gphoto2-port-record.h.
+ *
+ * GP_PORT_REPLAY names the recording, the port "usb:replay" is only
+ * listed while it is set. The device is found by the vendor and product
+ * id or the interface class it was found by when recording.
+ *
+ * The bulk and control transactions have to come in the recorded order,
+ * what the camera driver writes is compared with the recording and the
+ * recorded answers are handed back. Interrupts are handed out once the
+ * transactions recorded before them have been replayed.
+ *
+ * GP_PORT_REPLAY_SCALE scales the time the device took for each
+ * transaction: 1 (the default) replays it as recorded, 0 not at all,
+ * leaving only the time spent on the host.
+ */
+#include "config.h"
+#include <gphoto2/gphoto2-port-library.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gphoto2/gphoto2-port.h>
+#include <gphoto2/gphoto2-port-result.h>
+#include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-port-record.h>
+
+#include "libgphoto2_port/i18n.h"
+
+
+#define CHECK(result) {int r=(result); if (r<0) return (r);}
+
+struct _GPPortPrivateLibrary {
+	int			isopen;
+
+	char			*recording;	/* the whole file */
+	GPPortRecordHeader	*header;
+	/* bulk and control transactions, and the interrupt polls */
+	GPPortTraceRecord	**bulk, **ints;
+	unsigned int		nbulk, nints;
+	/* next ones to replay */
+	unsigned int		bulk_next, ints_next;
+	unsigned int		differed;
+	double			scale;
+
+	/* check_int may be called from an event pump thread */
+	pthread_mutex_t		lock;
+};
+
+static const char *op_names[] = {
+	"?", "open", "close", "write", "read", "check_int", "read_stream",
+	"msg_write", "msg_read", "msg_interface_write", "msg_interface_read",
+	"msg_class_write", "msg_class_read"
+};
+#define OP_NAME(op) (((op) < sizeof(op_names)/sizeof(op_names[0])) ? op_names[op] : "?")
+
+GPPortType
+gp_port_library_type (void)
+{
+	return GP_PORT_USB;
+}
+
+int
+gp_port_library_list (GPPortInfoList *list)
+{
+	GPPortInfo info;
+	const char *recording = getenv ("GP_PORT_REPLAY");
+
+	if (!recording || !recording[0])
+		return GP_OK;
+
+	CHECK (gp_port_info_new (&info));
+	gp_port_info_set_type (info, GP_PORT_USB);
+	gp_port_info_set_name (info, "");
+	gp_port_info_set_path (info, "^usb:");
+	gp_port_info_list_append (list, info); /* do not check, might be -1 */
+
+	CHECK (gp_port_info_new (&info));
+	gp_port_info_set_type (info, GP_PORT_USB);
+	gp_port_info_set_name (info, "Replayed USB session");
+	gp_port_info_set_path (info, "usb:replay");
+	CHECK (gp_port_info_list_append (list, info));
+	return GP_OK;
+}
+
+/* Reads the recording and sorts its transactions */
+static int
+gp_port_replay_load (GPPort *port, const char *filename)
+{
+	GPPortPrivateLibrary	*pl = port->pl;
+	GPPortRecordHeader	*h;
+	size_t			size, off, max;
+	long			len;
+	FILE			*f;
+
+	f = fopen (filename, "rb");
+	if (!f) {
+		gp_port_set_error (port, _("Could not open recording '%s'"), filename);
+		return GP_ERROR_IO;
+	}
+	if (fseek (f, 0, SEEK_END) || ((len = ftell (f)) < 0) || fseek (f, 0, SEEK_SET)) {
+		fclose (f);
+		gp_port_set_error (port, _("Could not read recording '%s'"), filename);
+		return GP_ERROR_IO;
+	}
+	size = len;
+	pl->recording = malloc (size + 1);
+	if (!pl->recording || (fread (pl->recording, 1, size, f) != size)) {
+		fclose (f);
+		gp_port_set_error (port, _("Could not read recording '%s'"), filename);
+		return pl->recording ? GP_ERROR_IO : GP_ERROR_NO_MEMORY;
+	}
+	fclose (f);
+
+	h = (GPPortRecordHeader *)pl->recording;
+	if ((size < sizeof (*h)) || memcmp (h->magic, GP_PORT_RECORD_MAGIC, sizeof (h->magic)) ||
+	    (h->byteorder != GP_PORT_TRACE_BYTEORDER) || (h->version != GP_PORT_RECORD_VERSION) ||
+	    (h->header_size < sizeof (*h)) || (h->header_size > size) || (h->header_size & 7)) {
+		gp_port_set_error (port, _("'%s' is not a recording of a USB session"), filename);
+		return GP_ERROR_IO;
+	}
+	pl->header = h;
+
+	/* more than enough */
+	max = (size - h->header_size) / sizeof (GPPortTraceRecord);
+	C_MEM (pl->bulk = calloc (max + 1, sizeof (*pl->bulk)));
+	C_MEM (pl->ints = calloc (max + 1, sizeof (*pl->ints)));
+
+	for (off = h->header_size; off + sizeof (GPPortTraceRecord) <= size; ) {
+		GPPortTraceRecord *r = (GPPortTraceRecord *)(pl->recording + off);
+
+		if (r->len > size - off - sizeof (*r)) {
+			GP_LOG_E ("Recording '%s' is truncated after %u transactions.",
+				  filename, pl->nbulk + pl->nints);
+			break;
+		}
+		off += sizeof (*r) + ((r->len + 7) & ~7);
+
+		switch (r->op) {
+		case GP_PORT_TRACE_CHECK_INT:
+			pl->ints[pl->nints++] = r;
+			break;
+		case GP_PORT_TRACE_OPEN:
+		case GP_PORT_TRACE_CLOSE:
+			break;
+		default:
+			pl->bulk[pl->nbulk++] = r;
+			break;
+		}
+	}
+	GP_LOG_D ("Replaying %u transactions and %u interrupt polls of '%s' recorded from '%.*s', time scaled by %g.",
+		  pl->nbulk, pl->nints, filename, (int)sizeof (h->path), h->path, pl->scale);
+	return GP_OK;
+}
+
+static int gp_port_replay_exit (GPPort *port);
+
+static int
+gp_port_replay_init (GPPort *port)
+{
+	const char *filename = getenv ("GP_PORT_REPLAY");
+	const char *scale = getenv ("GP_PORT_REPLAY_SCALE");
+	int ret;
+
+	C_MEM (port->pl = calloc (1, sizeof (GPPortPrivateLibrary)));
+	pthread_mutex_init (&port->pl->lock, NULL);
+
+	port->pl->scale = scale ? atof (scale) : 1.0;
+	if (port->pl->scale < 0)
+		port->pl->scale = 0;
+
+	if (!filename || !filename[0]) {
+		gp_port_set_error (port, _("GP_PORT_REPLAY does not name a recording"));
+		ret = GP_ERROR_BAD_PARAMETERS;
+	} else
+		ret = gp_port_replay_load (port, filename);
+	if (ret < GP_OK)
+		gp_port_replay_exit (port);
+	return ret;
+}
+
+static int
+gp_port_replay_exit (GPPort *port)
+{
+	GPPortPrivateLibrary *pl = port->pl;
+
+	if (!pl)
+		return GP_OK;
+	if (pl->header)
+		GP_LOG_D ("Replayed %u of %u transactions and %u of %u interrupt polls, %u differed from the recording.",
+			  pl->bulk_next, pl->nbulk, pl->ints_next, pl->nints, pl->differed);
+	pthread_mutex_destroy (&pl->lock);
+	free (pl->bulk);
+	free (pl->ints);
+	free (pl->recording);
+	free (pl);
+	port->pl = NULL;
+	return GP_OK;
+}
+
+static int
+gp_port_replay_open (GPPort *port)
+{
+	if (port->pl->isopen)
+		return GP_ERROR;
+	port->pl->isopen = 1;
+	return GP_OK;
+}
+
+static int
+gp_port_replay_close (GPPort *port)
+{
+	if (!port->pl->isopen)
+		return GP_ERROR;
+	port->pl->isopen = 0;
+	return GP_OK;
+}
+
+/* Waits as long as the device took, scaled. Sleeping is not precise
+ * enough for transactions of a few us, the last ms is spun away. */
+static void
+gp_port_replay_wait (GPPort *port, unsigned int us)
+{
+	struct timespec ts;
+	double scaled = us * port->pl->scale, end;
+
+	if (scaled < 1)
+		return;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	end = ts.tv_sec * 1e6 + ts.tv_nsec / 1e3 + scaled;
+	if (scaled > 2000)
+		usleep (scaled - 1000);
+	do
+		clock_gettime (CLOCK_MONOTONIC, &ts);
+	while (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3 < end);
+}
+
+/* Takes the next bulk or control transaction off the recording, which has
+ * to be the one the camera driver does. Anything else it did differently
+ * is counted and logged. */
+static int
+gp_port_replay_next (GPPort *port, GPPortTraceOp op, int size, uint32_t arg0, uint32_t arg1,
+		     const char *data, GPPortTraceRecord **record)
+{
+	GPPortPrivateLibrary	*pl = port->pl;
+	GPPortTraceRecord	*r;
+	int			differs;
+
+	C_PARAMS (pl && pl->isopen);
+
+	pthread_mutex_lock (&pl->lock);
+	if (pl->bulk_next == pl->nbulk) {
+		pthread_mutex_unlock (&pl->lock);
+		gp_port_set_error (port, _("Replayed all of the recording already, no %s recorded"), OP_NAME(op));
+		return GP_ERROR_IO;
+	}
+	r = pl->bulk[pl->bulk_next];
+	/* streamed chunks are read one by one when replaying */
+	if ((r->op != op) && !((op == GP_PORT_TRACE_READ) && (r->op == GP_PORT_TRACE_READ_STREAM))) {
+		pthread_mutex_unlock (&pl->lock);
+		gp_port_set_error (port, _("Replay diverged, %s done where %s was recorded (transaction %llu)"),
+				   OP_NAME(op), OP_NAME(r->op), (unsigned long long)r->seq);
+		return GP_ERROR_IO;
+	}
+	pl->bulk_next++;
+
+	/* streamed chunks are recorded with the size delivered, not asked for */
+	differs = ((r->size != size) && (r->op != GP_PORT_TRACE_READ_STREAM)) ||
+		  (r->arg[0] != arg0) || (r->arg[1] != arg1);
+	if (data && !differs && (size < 0 || r->len != (unsigned int)size || memcmp (r + 1, data, size)))
+		differs = 1;
+	if (differs) {
+		pl->differed++;
+		GP_LOG_D ("%s of %d bytes differs from transaction %llu of the recording (%d bytes).",
+			  OP_NAME(op), size, (unsigned long long)r->seq, r->size);
+	}
+	pthread_mutex_unlock (&pl->lock);
+
+	gp_port_replay_wait (port, r->duration);
+	*record = r;
+	return GP_OK;
+}
+
+static int
+gp_port_replay_write (GPPort *port, GPPortTraceOp op, int request, int value, int index,
+		      const char *bytes, int size)
+{
+	GPPortTraceRecord *rec;
+
+	CHECK (gp_port_replay_next (port, op, size, request, (value << 16) | (index & 0xffff), bytes, &rec));
+	return rec->result;
+}
+
+static int
+gp_port_replay_read (GPPort *port, GPPortTraceOp op, int request, int value, int index,
+		     char *bytes, int size)
+{
+	GPPortTraceRecord *rec;
+
+	CHECK (gp_port_replay_next (port, op, size, request, (value << 16) | (index & 0xffff), NULL, &rec));
+	if (rec->result < 0)
+		return rec->result;
+	if (rec->len > (unsigned int)size) {
+		GP_LOG_E ("Transaction %llu of the recording read %u bytes, only %d asked for now.",
+			  (unsigned long long)rec->seq, rec->len, size);
+		memcpy (bytes, rec + 1, size);
+		return size;
+	}
+	memcpy (bytes, rec + 1, rec->len);
+	return rec->len;
+}
+
+static int
+gp_port_replay_write_lib (GPPort *port, const char *bytes, int size)
+{
+	return gp_port_replay_write (port, GP_PORT_TRACE_WRITE, 0, 0, 0, bytes, size);
+}
+
+static int
+gp_port_replay_read_lib (GPPort *port, char *bytes, int size)
+{
+	return gp_port_replay_read (port, GP_PORT_TRACE_READ, 0, 0, 0, bytes, size);
+}
+
+static int
+gp_port_replay_check_int (GPPort *port, char *bytes, int size, int timeout)
+{
+	GPPortPrivateLibrary	*pl = port->pl;
+	GPPortTraceRecord	*r = NULL;
+	unsigned int		i;
+
+	C_PARAMS (pl && pl->isopen && timeout >= 0);
+
+	/* Due once everything recorded before it has been replayed. An
+	 * interrupt due is handed out even if the camera driver polled less
+	 * often than when recording, otherwise the next poll that ended
+	 * without one is replayed. */
+	pthread_mutex_lock (&pl->lock);
+	for (i = pl->ints_next; i < pl->nints; i++) {
+		if ((pl->bulk_next < pl->nbulk) && (pl->ints[i]->seq > pl->bulk[pl->bulk_next]->seq))
+			break;
+		if (pl->ints[i]->result > 0) {
+			r = pl->ints[i];
+			pl->ints_next = i + 1;
+			break;
+		}
+	}
+	if (!r && (i > pl->ints_next))
+		r = pl->ints[pl->ints_next++];
+	pthread_mutex_unlock (&pl->lock);
+
+	/* nothing recorded, the device had nothing to say */
+	if (!r) {
+		gp_port_replay_wait (port, timeout * 1000);
+		return GP_ERROR_TIMEOUT;
+	}
+	gp_port_replay_wait (port, r->duration);
+	if (r->result <= 0)
+		return r->result;
+	if (r->len > (unsigned int)size) {
+		GP_LOG_E ("Interrupt %llu of the recording has %u bytes, only %d asked for now.",
+			  (unsigned long long)r->seq, r->len, size);
+		memcpy (bytes, r + 1, size);
+		return size;
+	}
+	memcpy (bytes, r + 1, r->len);
+	return r->len;
+}
+
+static int
+gp_port_replay_update (GPPort *port)
+{
+	return GP_OK;
+}
+
+static int
+gp_port_replay_reset (GPPort *port)
+{
+	return GP_OK;
+}
+
+static int
+gp_port_replay_clear_halt_lib (GPPort *port, int ep)
+{
+	return GP_OK;
+}
+
+static int
+gp_port_replay_msg_write_lib (GPPort *port, int request, int value, int index,
+	char *bytes, int size)
+{
+	return gp_port_replay_write (port, GP_PORT_TRACE_MSG_WRITE, request, value, index, bytes, size);
+}
+
+static int
+gp_port_replay_msg_read_lib (GPPort *port, int request, int value, int index,
+	char *bytes, int size)
+{
+	return gp_port_replay_read (port, GP_PORT_TRACE_MSG_READ, request, value, index, bytes, size);
+}
+
+static int
+gp_port_replay_msg_interface_write_lib (GPPort *port, int request, int value, int index,
+	char *bytes, int size)
+{
+	return gp_port_replay_write (port, GP_PORT_TRACE_MSG_INTERFACE_WRITE, request, value, index, bytes, size);
+}
+
+static int
+gp_port_replay_msg_interface_read_lib (GPPort *port, int request, int value, int index,
+	char *bytes, int size)
+{
+	return gp_port_replay_read (port, GP_PORT_TRACE_MSG_INTERFACE_READ, request, value, index, bytes, size);
+}
+
+static int
+gp_port_replay_msg_class_write_lib (GPPort *port, int request, int value, int index,
+	char *bytes, int size)
+{
+	return gp_port_replay_write (port, GP_PORT_TRACE_MSG_CLASS_WRITE, request, value, index, bytes, size);
+}
+
+static int
+gp_port_replay_msg_class_read_lib (GPPort *port, int request, int value, int index,
+	char *bytes, int size)
+{
+	return gp_port_replay_read (port, GP_PORT_TRACE_MSG_CLASS_READ, request, value, index, bytes, size);
+}
+
+/* The recorded settings of the device */
+static void
+gp_port_replay_settings (GPPort *port)
+{
+	GPPortRecordHeader *h = port->pl->header;
+
+	port->settings.usb.config	= h->config;
+	port->settings.usb.interface	= h->interface;
+	port->settings.usb.altsetting	= h->altsetting;
+	port->settings.usb.inep		= h->inep;
+	port->settings.usb.outep	= h->outep;
+	port->settings.usb.intep	= h->intep;
+	port->settings.usb.maxpacketsize = h->maxpacketsize;
+}
+
+static int
+gp_port_replay_find_device_lib (GPPort *port, int idvendor, int idproduct)
+{
+	GPPortRecordHeader *h = port->pl->header;
+
+	if (!(h->found & GP_PORT_RECORD_FOUND_ID) || (idvendor != h->vendor) || (idproduct != h->product))
+		return GP_ERROR_IO_USB_FIND;
+	gp_port_replay_settings (port);
+	return GP_OK;
+}
+
+static int
+gp_port_replay_get_device_id_lib (GPPort *port, int *idvendor, int *idproduct)
+{
+	GPPortRecordHeader *h = port->pl->header;
+
+	/* recorded only if the device was found by its ids */
+	if (!(h->found & GP_PORT_RECORD_FOUND_ID))
+		return GP_ERROR_NOT_SUPPORTED;
+	*idvendor = h->vendor;
+	*idproduct = h->product;
+	return GP_OK;
+}
+
+static int
+gp_port_replay_find_device_by_class_lib (GPPort *port, int class, int subclass, int protocol)
+{
+	GPPortRecordHeader *h = port->pl->header;
+
+	if (!(h->found & GP_PORT_RECORD_FOUND_CLASS) || (class != h->class) ||
+	    ((subclass != -1) && (subclass != h->subclass)) ||
+	    ((protocol != -1) && (protocol != h->protocol)))
+		return GP_ERROR_IO_USB_FIND;
+	gp_port_replay_settings (port);
+	return GP_OK;
+}
+
+GPPortOperations *
+gp_port_library_operations (void)
+{
+	GPPortOperations *ops;
+
+	ops = calloc (1, sizeof (GPPortOperations));
+	if (!ops)
+		return NULL;
+
+	ops->init	= gp_port_replay_init;
+	ops->exit	= gp_port_replay_exit;
+	ops->open	= gp_port_replay_open;
+	ops->close	= gp_port_replay_close;
+	ops->read	= gp_port_replay_read_lib;
+	ops->write	= gp_port_replay_write_lib;
+	ops->reset	= gp_port_replay_reset;
+
+	ops->check_int	= gp_port_replay_check_int;
+	ops->update	= gp_port_replay_update;
+	ops->clear_halt	= gp_port_replay_clear_halt_lib;
+	ops->msg_write	= gp_port_replay_msg_write_lib;
+	ops->msg_read	= gp_port_replay_msg_read_lib;
+
+	ops->msg_interface_write	= gp_port_replay_msg_interface_write_lib;
+	ops->msg_interface_read		= gp_port_replay_msg_interface_read_lib;
+	ops->msg_class_write		= gp_port_replay_msg_class_write_lib;
+	ops->msg_class_read		= gp_port_replay_msg_class_read_lib;
+
+	ops->find_device		= gp_port_replay_find_device_lib;
+	ops->find_device_by_class	= gp_port_replay_find_device_by_class_lib;
+	ops->get_device_id		= gp_port_replay_get_device_id_lib;
+	return ops;
+}
@@ -0,0 +1,234 @@
+/* port-trace-dump.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Prints a binary trace of port transactions, as written by
+ * gp_port_trace_start() or with GP_PORT_TRACE set, one line per
+ * transaction. The trace may still be written meanwhile. Recordings of
+ * USB sessions written with GP_PORT_RECORD set are printed the same way.
+ *
+ * Usage: port-trace-dump [-x] FILE
+ *   -x  hexdump all data kept, not just the first 16 bytes
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-port-result.h>
+#include <gphoto2/gphoto2-port-trace.h>
+#include <gphoto2/gphoto2-port-record.h>
+
+static const char *op_names[] = {
+	"?", "open", "close", "write", "read", "check_int", "read_stream",
+	"msg_write", "msg_read", "msg_interface_write", "msg_interface_read",
+	"msg_class_write", "msg_class_read"
+};
+
+static void
+dump_data (const unsigned char *data, unsigned int len, int full)
+{
+	unsigned int i, n = (full || len <= 16) ? len : 16;
+
+	if (!full)
+		printf (" ");
+	for (i = 0; i < n; i++) {
+		if (full && !(i % 16))
+			printf ("\n    %04x ", i);
+		printf (" %02x", data[i]);
+	}
+	if (n < len)
+		printf (" ...");
+	printf ("\n");
+}
+
+static void
+dump_record (const GPPortTraceHeader *t, const GPPortTraceRecord *r, int full)
+{
+	const char *name = (r->op < sizeof(op_names)/sizeof(op_names[0])) ? op_names[r->op] : "?";
+
+	printf ("%12.6f port %-2u %-19s %8d ", (double)(r->time - t->start_time) / 1e9,
+		r->port, name, r->size);
+	if (r->result < 0)
+		printf ("%-8s ", "failed");
+	else
+		printf ("= %-6d ", r->result);
+	printf ("%7u us", r->duration);
+
+	switch (r->op) {
+	case GP_PORT_TRACE_OPEN:
+		printf ("  %.*s", (int)r->len, (const char *)(r + 1));
+		break;
+	case GP_PORT_TRACE_CHECK_INT:
+		printf ("  timeout %u ms", r->arg[0]);
+		break;
+	case GP_PORT_TRACE_MSG_WRITE:
+	case GP_PORT_TRACE_MSG_READ:
+	case GP_PORT_TRACE_MSG_INTERFACE_WRITE:
+	case GP_PORT_TRACE_MSG_INTERFACE_READ:
+	case GP_PORT_TRACE_MSG_CLASS_WRITE:
+	case GP_PORT_TRACE_MSG_CLASS_READ:
+		printf ("  request 0x%02x value 0x%04x index 0x%04x",
+			r->arg[0], r->arg[1] >> 16, r->arg[1] & 0xffff);
+		break;
+	}
+	if (r->result < 0)
+		printf ("  %s (%d)", gp_port_result_as_string (r->result), r->result);
+	if (r->len && (r->op != GP_PORT_TRACE_OPEN))
+		dump_data ((const unsigned char *)(r + 1), r->len, full);
+	else
+		printf ("\n");
+}
+
+static int
+dump_recording (const char *filename, FILE *f, int full)
+{
+	GPPortRecordHeader	h;
+	GPPortTraceHeader	t;
+	GPPortTraceRecord	*r;
+	char			started[64];
+	time_t			secs;
+	size_t			size = 0;
+
+	if ((fread (&h, sizeof(h), 1, f) != 1) || (h.byteorder != GP_PORT_TRACE_BYTEORDER) ||
+	    (h.version != GP_PORT_RECORD_VERSION) || (h.header_size < sizeof(h)) ||
+	    fseek (f, h.header_size, SEEK_SET)) {
+		fprintf (stderr, "%s: recording version %u is not supported\n", filename, h.version);
+		return 1;
+	}
+	secs = h.start_realtime / 1000000000;
+	strftime (started, sizeof(started), "%Y-%m-%d %H:%M:%S", localtime (&secs));
+	printf ("recording of %.*s started %s.%06u", (int)sizeof(h.path), h.path,
+		started, (unsigned int)(h.start_realtime % 1000000000 / 1000));
+	if (h.found & GP_PORT_RECORD_FOUND_ID)
+		printf (", device %04x:%04x", h.vendor, h.product);
+	if (h.found & GP_PORT_RECORD_FOUND_CLASS)
+		printf (", interface class %02x/%02x/%02x", h.class, h.subclass, h.protocol);
+	printf ("\n");
+
+	/* record times are relative to the start */
+	memset (&t, 0, sizeof(t));
+	r = NULL;
+	while (1) {
+		GPPortTraceRecord hdr;
+
+		if (fread (&hdr, sizeof(hdr), 1, f) != 1)
+			break;
+		if (sizeof(hdr) + ((hdr.len + 7) & ~7) > size) {
+			size = sizeof(hdr) + ((hdr.len + 7) & ~7);
+			free (r);
+			if (!(r = malloc (size))) {
+				fprintf (stderr, "%s: out of memory\n", filename);
+				return 1;
+			}
+		}
+		*r = hdr;
+		if (fread (r + 1, 1, (hdr.len + 7) & ~7, f) < hdr.len) {
+			printf ("the recording is truncated\n");
+			break;
+		}
+		dump_record (&t, r, full);
+	}
+	free (r);
+	return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+	GPPortTraceHeader	t;
+	unsigned char		*records;
+	unsigned long long	first, i, lost = 0;
+	char			started[64];
+	time_t			secs;
+	FILE			*f;
+	int			opt, full = 0;
+
+	while ((opt = getopt (argc, argv, "x")) != -1) {
+		switch (opt) {
+		case 'x': full = 1; break;
+		default:
+			fprintf (stderr, "Usage: %s [-x] FILE\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind + 1 != argc) {
+		fprintf (stderr, "Usage: %s [-x] FILE\n", argv[0]);
+		return 1;
+	}
+
+	f = fopen (argv[optind], "rb");
+	if (!f) {
+		perror (argv[optind]);
+		return 1;
+	}
+	if (fread (t.magic, sizeof(t.magic), 1, f) && !memcmp (t.magic, GP_PORT_RECORD_MAGIC, sizeof(t.magic))) {
+		rewind (f);
+		return dump_recording (argv[optind], f, full);
+	}
+	rewind (f);
+	if ((fread (&t, sizeof(t), 1, f) != 1) || memcmp (t.magic, GP_PORT_TRACE_MAGIC, sizeof(t.magic))) {
+		fprintf (stderr, "%s: not a port trace\n", argv[optind]);
+		return 1;
+	}
+	if (t.byteorder != GP_PORT_TRACE_BYTEORDER) {
+		fprintf (stderr, "%s: written on a machine of another byte order\n", argv[optind]);
+		return 1;
+	}
+	if ((t.version != GP_PORT_TRACE_VERSION) || (t.header_size < sizeof(t)) ||
+	    (t.record_size < sizeof(GPPortTraceRecord) + t.prefix) || !t.records) {
+		fprintf (stderr, "%s: trace version %u is not supported\n", argv[optind], t.version);
+		return 1;
+	}
+	records = malloc ((size_t)t.records * t.record_size);
+	if (!records || fseek (f, t.header_size, SEEK_SET) ||
+	    (fread (records, t.record_size, t.records, f) != t.records)) {
+		fprintf (stderr, "%s: trace is truncated\n", argv[optind]);
+		return 1;
+	}
+	fclose (f);
+
+	secs = t.start_realtime / 1000000000;
+	strftime (started, sizeof(started), "%Y-%m-%d %H:%M:%S", localtime (&secs));
+	first = (t.next > t.records) ? t.next - t.records : 0;
+	printf ("trace started %s.%06u, %llu transactions, %u records of up to %u data bytes\n",
+		started, (unsigned int)(t.start_realtime % 1000000000 / 1000),
+		(unsigned long long)t.next, t.records, t.prefix);
+	if (first)
+		printf ("the first %llu transactions were overwritten\n", first);
+
+	for (i = first; i < t.next; i++) {
+		const GPPortTraceRecord *r = (const GPPortTraceRecord *)(records + (i % t.records) * t.record_size);
+
+		/* still being written, or already overwritten again */
+		if ((r->seq != i + 1) || (r->len > t.prefix)) {
+			lost++;
+			continue;
+		}
+		dump_record (&t, r, full);
+	}
+	if (lost)
+		printf ("%llu transactions were being written while reading\n", lost);
+	free (records);
+	return 0;
+}
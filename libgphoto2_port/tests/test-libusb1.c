@@ -0,0 +1,318 @@
+/* test-libusb1.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Runs the asynchronous transfer handling of the libusb1 iolib against
+ * a simulated device: the asynchronous libusb calls below take the place
+ * of the ones in libusb, everything else still comes from libusb but is
+ * not called. The device answers bulk reads with a running byte count.
+ * Interrupts are completed by hand, to fill the ring they are kept in.
+ */
+#include "../libusb1/libusb1.c"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf ("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			return (1); \
+		} \
+	} while (0)
+
+/* transfers submitted and not completed yet, in submission order */
+static struct libusb_transfer *queue[64];
+static int queued;
+
+static int allocated;		/* transfers not freed */
+static int submitted;		/* submissions in this run */
+static int fail_submit = -1;	/* submission to refuse */
+static int fail_transfer = -1;	/* submission to fail with a stall */
+
+static long device_pos;		/* bytes read from the device */
+static long device_short = -1;	/* short packet ending there */
+static int device_ended;	/* nothing more after the short packet */
+
+#define PENDING ((enum libusb_transfer_status)-1)
+
+struct libusb_transfer * LIBUSB_CALL
+libusb_alloc_transfer (int iso_packets)
+{
+	allocated++;
+	return calloc (1, sizeof(struct libusb_transfer));
+}
+
+void LIBUSB_CALL
+libusb_free_transfer (struct libusb_transfer *transfer)
+{
+	if (!transfer)
+		return;
+	allocated--;
+	if (transfer->flags & LIBUSB_TRANSFER_FREE_BUFFER)
+		free (transfer->buffer);
+	free (transfer);
+}
+
+int LIBUSB_CALL
+libusb_submit_transfer (struct libusb_transfer *transfer)
+{
+	if (submitted++ == fail_submit)
+		return LIBUSB_ERROR_IO;
+	transfer->status = PENDING;
+	transfer->actual_length = 0;
+	queue[queued++] = transfer;
+	return LIBUSB_SUCCESS;
+}
+
+int LIBUSB_CALL
+libusb_cancel_transfer (struct libusb_transfer *transfer)
+{
+	int i;
+
+	for (i = 0; i < queued; i++)
+		if ((queue[i] == transfer) && (transfer->status == PENDING)) {
+			transfer->status = LIBUSB_TRANSFER_CANCELLED;
+			return LIBUSB_SUCCESS;
+		}
+	return LIBUSB_ERROR_NOT_FOUND;
+}
+
+/* Completes the oldest transfer, with what the device sends for it */
+int LIBUSB_CALL
+libusb_handle_events_completed (libusb_context *ctx, int *completed)
+{
+	struct libusb_transfer *transfer;
+	long i, len;
+
+	if (!queued) {
+		printf ("ERROR: waiting for a transfer which was never submitted\n");
+		exit (1);
+	}
+	transfer = queue[0];
+	memmove (queue, queue + 1, --queued * sizeof(queue[0]));
+
+	if (transfer->status == PENDING) {
+		/* count the submissions still queued behind it back */
+		if (submitted - queued - 1 == fail_transfer) {
+			transfer->status = LIBUSB_TRANSFER_STALL;
+		} else if (device_ended) {
+			transfer->status = LIBUSB_TRANSFER_TIMED_OUT;
+		} else {
+			len = transfer->length;
+			if ((device_short >= device_pos) && (device_short < device_pos + len)) {
+				len = device_short - device_pos;
+				device_ended = 1;
+			}
+			for (i = 0; i < len; i++)
+				transfer->buffer[i] = (device_pos + i) & 0xff;
+			device_pos += len;
+			transfer->actual_length = len;
+			transfer->status = LIBUSB_TRANSFER_COMPLETED;
+		}
+	}
+	transfer->callback (transfer);
+	return LIBUSB_SUCCESS;
+}
+
+static long received;
+static int received_bad;
+static long stop_after = -1;
+static const char *received_buffer;
+
+/* checks the running byte count, and that the data is in the caller buffer */
+static int
+receive (GPPort *port, const char *data, int size, void *user)
+{
+	int i;
+
+	if (received_buffer && (data != received_buffer + received))
+		received_bad = 1;
+	for (i = 0; i < size; i++)
+		if ((unsigned char)data[i] != ((received + i) & 0xff))
+			received_bad = 1;
+	received += size;
+	if ((stop_after >= 0) && (received >= stop_after))
+		return GP_ERROR;
+	return GP_OK;
+}
+
+static int
+read_stream (GPPort *port, char *buffer, int size)
+{
+	queued = submitted = 0;
+	device_pos = received = received_bad = device_ended = 0;
+	received_buffer = buffer;
+	return gp_libusb1_read_stream (port, buffer, size, 4096, 8, receive, NULL);
+}
+
+static int
+test_stream (GPPort *port)
+{
+	static char buffer[100000];
+	int ret;
+
+	/* all of it, the last transfer is a partial chunk */
+	ret = read_stream (port, NULL, 100000);
+	CHECK (ret == 100000);
+	CHECK ((received == 100000) && !received_bad);
+	ret = read_stream (port, buffer, 100000);
+	CHECK (ret == 100000);
+	CHECK ((received == 100000) && !received_bad);
+
+	/* less than one chunk */
+	ret = read_stream (port, NULL, 10);
+	CHECK ((ret == 10) && (received == 10) && !received_bad);
+
+	/* a short packet ends the stream, the transfers behind it are cancelled */
+	device_short = 50000;
+	ret = read_stream (port, NULL, 100000);
+	CHECK (ret == 50000);
+	CHECK ((received == 50000) && !received_bad);
+	CHECK ((device_pos == 50000) && !queued);
+	ret = read_stream (port, buffer, 100000);
+	CHECK ((ret == 50000) && (received == 50000) && !received_bad);
+	CHECK (!queued);
+	/* at a chunk boundary, a zero length packet */
+	device_short = 8192;
+	ret = read_stream (port, NULL, 100000);
+	CHECK ((ret == 8192) && (received == 8192) && !received_bad);
+	CHECK (!queued);
+	device_short = -1;
+
+	/* a failing transfer, what came before it is delivered */
+	fail_transfer = 5;
+	ret = read_stream (port, NULL, 100000);
+	CHECK (ret == GP_ERROR_IO_READ);
+	CHECK ((received == 5 * 4096) && !received_bad);
+	CHECK ((device_pos == received) && !queued);
+	fail_transfer = -1;
+
+	/* a failing submission, the transfers before it are cancelled */
+	fail_submit = 3;
+	ret = read_stream (port, NULL, 100000);
+	CHECK (ret == GP_ERROR_IO_READ);
+	CHECK (!device_pos && !queued);
+	fail_submit = 12;
+	ret = read_stream (port, buffer, 100000);
+	CHECK (ret == GP_ERROR_IO_READ);
+	CHECK ((received == 5 * 4096) && !received_bad);
+	CHECK ((device_pos == received) && !queued);
+	fail_submit = -1;
+
+	/* the callback stops the stream */
+	stop_after = 30000;
+	ret = read_stream (port, NULL, 100000);
+	CHECK (ret == GP_ERROR);
+	CHECK (!queued && !received_bad);
+	stop_after = -1;
+
+	CHECK (!allocated);
+	return 0;
+}
+
+/* An interrupt transfer completing with status, carrying the byte nr */
+static void
+complete_irq (struct libusb_transfer *transfer, enum libusb_transfer_status status, unsigned char nr)
+{
+	transfer->status = status;
+	transfer->buffer[0] = nr;
+	transfer->actual_length = (status == LIBUSB_TRANSFER_COMPLETED) ? 4 : 0;
+	transfer->callback (transfer);
+	/* requeued, nothing to do for the device */
+	queued = 0;
+}
+
+static int
+test_irq_ring (GPPort *port)
+{
+	GPPortPrivateLibrary *pl = port->pl;
+	struct libusb_transfer *transfer;
+	unsigned char buffer[INTERRUPT_BUFFER_SIZE] = "0irq";
+	char data[INTERRUPT_BUFFER_SIZE];
+	int i, ret;
+
+	transfer = libusb_alloc_transfer (0);
+	CHECK (transfer);
+	libusb_fill_interrupt_transfer (transfer, pl->dh, 0x82, buffer, sizeof(buffer),
+		_cb_irq, pl, 0);
+
+	/* more than fit, the oldest ones are kept */
+	for (i = 0; i < NB_INTERRUPT_SLOTS + 10; i++)
+		complete_irq (transfer, LIBUSB_TRANSFER_COMPLETED, i);
+	CHECK (pl->irqs_received == NB_INTERRUPT_SLOTS + 10);
+	CHECK (pl->irqs_dropped == 10);
+	CHECK (pl->irqs_maxqueued == NB_INTERRUPT_SLOTS);
+	for (i = 0; i < NB_INTERRUPT_SLOTS; i++) {
+		ret = gp_libusb1_check_int (port, data, sizeof(data), 0);
+		CHECK (ret == 4);
+		CHECK (((unsigned char)data[0] == i) && !memcmp (data + 1, "irq", 3));
+	}
+	CHECK (gp_libusb1_check_int (port, data, sizeof(data), 0) == GP_ERROR_TIMEOUT);
+
+	/* around the ring, until it is full again */
+	for (i = 0; i < 2 * NB_INTERRUPT_SLOTS - 1; i++) {
+		complete_irq (transfer, LIBUSB_TRANSFER_COMPLETED, i);
+		if (i % 2) {
+			CHECK (gp_libusb1_check_int (port, data, sizeof(data), 0) == 4);
+			CHECK ((unsigned char)data[0] == i / 2);
+		}
+	}
+	CHECK (pl->irqs_write - pl->irqs_read == NB_INTERRUPT_SLOTS);
+	for (i = NB_INTERRUPT_SLOTS - 1; i < 2 * NB_INTERRUPT_SLOTS - 1; i++) {
+		CHECK (gp_libusb1_check_int (port, data, sizeof(data), 0) == 4);
+		CHECK ((unsigned char)data[0] == i);
+	}
+	CHECK (gp_libusb1_check_int (port, data, sizeof(data), 0) == GP_ERROR_TIMEOUT);
+	CHECK (pl->irqs_dropped == 10);
+
+	/* errors in a row are reported once, data is cut to the buffer */
+	complete_irq (transfer, LIBUSB_TRANSFER_STALL, 0);
+	complete_irq (transfer, LIBUSB_TRANSFER_ERROR, 0);
+	complete_irq (transfer, LIBUSB_TRANSFER_COMPLETED, 42);
+	CHECK (gp_libusb1_check_int (port, data, sizeof(data), 0) == GP_ERROR_IO);
+	CHECK (gp_libusb1_check_int (port, data, 2, 0) == 2);
+	CHECK (((unsigned char)data[0] == 42) && (data[1] == 'i'));
+	CHECK (gp_libusb1_check_int (port, data, sizeof(data), 0) == GP_ERROR_TIMEOUT);
+
+	libusb_free_transfer (transfer);
+	CHECK (!allocated);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPPort port;
+
+	memset (&port, 0, sizeof(port));
+	port.pl = calloc (1, sizeof(GPPortPrivateLibrary));
+	if (!port.pl)
+		return 1;
+	pthread_mutex_init (&port.pl->irq_lock, NULL);
+	/* never used, the transfers do not reach libusb */
+	port.pl->dh = (libusb_device_handle *)&port;
+	port.settings.usb.inep = 0x81;
+	port.timeout = 5000;
+
+	if (test_stream (&port) || test_irq_ring (&port))
+		return 1;
+
+	pthread_mutex_destroy (&port.pl->irq_lock);
+	free (port.pl);
+	return 0;
+}
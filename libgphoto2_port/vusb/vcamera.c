@@ -37,6 +37,7 @@
 #endif
 #include <string.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include "vcamera.h"
 
@@ -169,6 +170,14 @@ ptp_senddata(vcamera *cam, uint16_t code, unsigned char *data, int bytes) {
 	memcpy(offset+12,data,bytes);
 }
 
+static void
+vcam_stream_end(vcamera *cam) {
+	if (cam->streamf)
+		fclose (cam->streamf);
+	cam->streamf = NULL;
+	cam->streaming = 0;
+}
+
 static void
 ptp_response(vcamera *cam, uint16_t code, int nparams, ...) {
 	unsigned char	*offset;
@@ -214,6 +223,7 @@ ptp_response(vcamera *cam, uint16_t code, int nparams, ...) {
 #define PTP_RC_InvalidDevicePropFormat			0x201B
 #define PTP_RC_InvalidParameter				0x201D
 #define PTP_RC_SessionAlreadyOpened			0x201E
+#define PTP_RC_NIKON_NotLiveView			0xA00B
 
 #define CHECK_PARAM_COUNT(x)											\
 	if (ptp->nparams != x) {										\
@@ -255,6 +265,9 @@ static int ptp_setdevicepropvalue_write_data(vcamera *cam, ptpcontainer *ptp, un
 static int ptp_initiatecapture_write(vcamera *cam, ptpcontainer *ptp);
 static int ptp_vusb_write(vcamera *cam, ptpcontainer *ptp);
 static int ptp_nikon_setcontrolmode_write(vcamera *cam, ptpcontainer *ptp);
+static int ptp_nikon_startliveview_write(vcamera *cam, ptpcontainer *ptp);
+static int ptp_nikon_endliveview_write(vcamera *cam, ptpcontainer *ptp);
+static int ptp_nikon_getliveviewimg_write(vcamera *cam, ptpcontainer *ptp);
 
 static struct ptp_function {
 	int	code;
@@ -281,6 +294,9 @@ static struct ptp_function {
 
 static struct ptp_function ptp_functions_nikon_dslr[] = {
 	{0x90c2,	ptp_nikon_setcontrolmode_write, NULL			},
+	{0x9201,	ptp_nikon_startliveview_write,	NULL			},
+	{0x9202,	ptp_nikon_endliveview_write,	NULL			},
+	{0x9203,	ptp_nikon_getliveviewimg_write,	NULL			},
 };
 
 static struct ptp_map_functions {
@@ -391,6 +407,12 @@ static int ptp_fnumber_setvalue(vcamera*,PTPPropValue*);
 static int ptp_exposurebias_getdesc(vcamera*,PTPDevicePropDesc*);
 static int ptp_exposurebias_getvalue(vcamera*,PTPPropValue*);
 static int ptp_exposurebias_setvalue(vcamera*,PTPPropValue*);
+static int ptp_liveviewstatus_getdesc(vcamera*,PTPDevicePropDesc*);
+static int ptp_liveviewstatus_getvalue(vcamera*,PTPPropValue*);
+static int ptp_liveviewprohibit_getdesc(vcamera*,PTPDevicePropDesc*);
+static int ptp_liveviewprohibit_getvalue(vcamera*,PTPPropValue*);
+static int ptp_focusmetering_getdesc(vcamera*,PTPDevicePropDesc*);
+static int ptp_focusmetering_getvalue(vcamera*,PTPPropValue*);
 
 static struct ptp_property {
 	int	code;
@@ -404,21 +426,92 @@ static struct ptp_property {
 	{0x5010,	ptp_exposurebias_getdesc, ptp_exposurebias_getvalue, ptp_exposurebias_setvalue },
 	{0x500d,	ptp_shutterspeed_getdesc, ptp_shutterspeed_getvalue, ptp_shutterspeed_setvalue },
 	{0x5011,	ptp_datetime_getdesc, ptp_datetime_getvalue, ptp_datetime_setvalue },
+	{0xd1a2,	ptp_liveviewstatus_getdesc, ptp_liveviewstatus_getvalue, NULL },
+	{0xd1a4,	ptp_liveviewprohibit_getdesc, ptp_liveviewprohibit_getvalue, NULL },
+	{0x501c,	ptp_focusmetering_getdesc, ptp_focusmetering_getvalue, NULL },
 };
 
 struct ptp_dirent {
 	uint32_t		id;
 	char 			*name;
-	char 			*fsname;
+	char 			*fsname;	/* NULL for generated objects */
 	struct stat		stbuf;
 	struct ptp_dirent 	*parent;
-	struct ptp_dirent 	*next;
+	struct ptp_dirent 	*next, *prev;
+	struct ptp_dirent 	*children;	/* newest first, like the list of all */
+	struct ptp_dirent 	*sibling, *prevsibling;
 };
 
 static struct ptp_dirent *first_dirent = NULL;
 static uint32_t	ptp_objectid = 0;
+/* object handles are indices into this, for a store of 100000s of objects */
+static struct ptp_dirent **dirents = NULL;
+static uint32_t	nrdirents = 0;
+static struct ptp_dirent *dcim_dirent = NULL;
+
+static struct ptp_dirent *
+find_dirent(uint32_t id) {
+	return (id < nrdirents) ? dirents[id] : NULL;
+}
+
+static int
+add_dirent(struct ptp_dirent *cur, struct ptp_dirent *parent) {
+	if (cur->id >= nrdirents) {
+		uint32_t		nr = nrdirents ? nrdirents : 1024;
+		struct ptp_dirent	**xdirents;
+
+		while (nr <= cur->id)
+			nr *= 2;
+		xdirents = realloc(dirents, nr * sizeof(dirents[0]));
+		if (!xdirents)
+			return 0;
+		memset(xdirents + nrdirents, 0, (nr - nrdirents) * sizeof(dirents[0]));
+		dirents = xdirents;
+		nrdirents = nr;
+	}
+	dirents[cur->id] = cur;
+
+	cur->parent = parent;
+	cur->children = NULL;
+	cur->prev = NULL;
+	cur->next = first_dirent;
+	if (first_dirent)
+		first_dirent->prev = cur;
+	first_dirent = cur;
+
+	cur->prevsibling = NULL;
+	cur->sibling = NULL;
+	if (parent) {
+		cur->sibling = parent->children;
+		if (parent->children)
+			parent->children->prevsibling = cur;
+		parent->children = cur;
+	}
+	return 1;
+}
+
+static void
+remove_dirent(struct ptp_dirent *cur) {
+	dirents[cur->id] = NULL;
+	if (cur->prev)
+		cur->prev->next = cur->next;
+	else
+		first_dirent = cur->next;
+	if (cur->next)
+		cur->next->prev = cur->prev;
+	if (cur->prevsibling)
+		cur->prevsibling->sibling = cur->sibling;
+	else if (cur->parent)
+		cur->parent->children = cur->sibling;
+	if (cur->sibling)
+		cur->sibling->prevsibling = cur->prevsibling;
+}
 
 static void *read_file(struct ptp_dirent *cur) {
+	if (!cur->fsname) {
+		gp_log (GP_LOG_ERROR,__FUNCTION__, "%s is generated, not read from a file", cur->name);
+		return NULL;
+	}
 	FILE *file = fopen(cur->fsname, "rb");
 	if (!file) {
 		gp_log (GP_LOG_ERROR,__FUNCTION__, "could not open %s", cur->fsname);
@@ -438,6 +531,61 @@ static void *read_file(struct ptp_dirent *cur) {
 	return data;
 }
 
+/* Content of a generated object of size bytes, framed like a JPEG (SOI ...
+ * EOI) with a pattern depending on the handle in between, so downloads can
+ * be checked. Their thumbnails are generated the same way. */
+#define GENERATED_THUMB_SIZE	8192
+#define GENERATED_THUMB_WIDTH	160
+#define GENERATED_THUMB_HEIGHT	120
+
+static void
+generate_data(uint32_t id, unsigned int size, unsigned int offset, unsigned char *data, unsigned int bytes) {
+	unsigned int i;
+
+	for (i = 0; i < bytes; i++, offset++) {
+		if (offset == 0 || offset == size - 2)
+			data[i] = 0xff;
+		else if (offset == 1)
+			data[i] = 0xd8;
+		else if (offset == size - 1)
+			data[i] = 0xd9;
+		else
+			data[i] = (offset + id) * 31;
+	}
+}
+
+/* Like ptp_senddata(), but the object data is read from its file or
+ * generated while the host reads it, instead of being preloaded. */
+static int
+ptp_senddata_stream(vcamera *cam, uint16_t code, struct ptp_dirent *cur) {
+	unsigned char	*offset;
+
+	if (cam->streaming)
+		vcam_stream_end(cam);
+	if (cur->fsname) {
+		cam->streamf = fopen(cur->fsname, "rb");
+		if (!cam->streamf) {
+			gp_log (GP_LOG_ERROR,__FUNCTION__, "could not open %s", cur->fsname);
+			return 0;
+		}
+	}
+	cam->inbulk = realloc(cam->inbulk,cam->nrinbulk+12);
+	offset = cam->inbulk + cam->nrinbulk;
+	cam->nrinbulk += 12;
+
+	put_32bit_le(offset,cur->stbuf.st_size + 12);
+	put_16bit_le(offset+4,0x2);
+	put_16bit_le(offset+6,code);
+	put_32bit_le(offset+8,cam->seqnr);
+
+	cam->streaming	= 1;
+	cam->streamat	= cam->nrinbulk;
+	cam->streamid	= cur->id;
+	cam->streamoff	= 0;
+	cam->streamsize	= cur->stbuf.st_size;
+	return 1;
+}
+
 static void
 read_directories(const char *path, struct ptp_dirent *parent) {
 	struct ptp_dirent	*cur;
@@ -455,9 +603,7 @@ read_directories(const char *path, struct ptp_dirent *parent) {
 		cur->name = strdup(gp_system_filename(de));
 		cur->fsname = aprintf("%s/%s", path, gp_system_filename(de));
 		cur->id = ptp_objectid++;
-		cur->next = first_dirent;
-		cur->parent = parent;
-		first_dirent = cur;
+		add_dirent(cur, parent);
 		if (-1 == stat(cur->fsname, &cur->stbuf))
 			continue;
 		if (S_ISDIR(cur->stbuf.st_mode))
@@ -473,6 +619,69 @@ free_dirent(struct ptp_dirent *ent) {
 	free (ent);
 }
 
+static struct ptp_dirent *
+new_generated_dirent(struct ptp_dirent *parent, char *name, int isdir, unsigned int size, time_t mtime) {
+	struct ptp_dirent *cur = calloc(1, sizeof(struct ptp_dirent));
+
+	if (!cur) {
+		free (name);
+		return NULL;
+	}
+	cur->name = name;
+	cur->id = ptp_objectid++;
+	cur->stbuf.st_mode = isdir ? (S_IFDIR | 0755) : (S_IFREG | 0644);
+	cur->stbuf.st_size = size;
+	cur->stbuf.st_ctime = cur->stbuf.st_mtime = mtime;
+	if (!name || !add_dirent(cur, parent)) {
+		free_dirent(cur);
+		return NULL;
+	}
+	return cur;
+}
+
+/* VCAMERA_OBJECTS=FOLDERSxFILES adds a generated store of FOLDERS folders
+ * below DCIM with FILES JPEGs each, without any files on disk. The sizes
+ * are VCAMERA_OBJECTSIZE=MIN[-MAX] bytes, spread evenly by handle. Their
+ * content is produced while the host reads it. */
+static void
+generate_tree(struct ptp_dirent *dcim) {
+	const char		*objects = getenv("VCAMERA_OBJECTS");
+	const char		*objectsize = getenv("VCAMERA_OBJECTSIZE");
+	unsigned int		folders, files, minsize = 65536, maxsize, i, j;
+	struct ptp_dirent	*dir, *cur;
+	time_t			now = time(NULL);
+
+	if (!objects)
+		return;
+	if ((sscanf(objects, "%ux%u", &folders, &files) != 2) || !folders) {
+		gp_log (GP_LOG_ERROR, __FUNCTION__, "VCAMERA_OBJECTS '%s' is not FOLDERSxFILES", objects);
+		return;
+	}
+	if (objectsize)
+		sscanf(objectsize, "%u", &minsize);
+	if (minsize < 4)
+		minsize = 4;
+	maxsize = minsize;
+	if (objectsize && strchr(objectsize, '-'))
+		sscanf(strchr(objectsize, '-') + 1, "%u", &maxsize);
+	if (maxsize < minsize)
+		maxsize = minsize;
+
+	for (i = 0; i < folders; i++) {
+		dir = new_generated_dirent(dcim, aprintf("%03dGPGEN", 100 + i), 1, 0, now);
+		if (!dir)
+			break;
+		for (j = 0; j < files; j++) {
+			unsigned int size = minsize + (maxsize > minsize ? (ptp_objectid * 2654435761U) % (maxsize - minsize + 1) : 0);
+
+			cur = new_generated_dirent(dir, aprintf("GEN_%05d.JPG", j), 0, size, now);
+			if (!cur)
+				break;
+		}
+	}
+	gp_log (GP_LOG_DEBUG, __FUNCTION__, "generated %u folders of %u files, %u-%u bytes each", i, files, minsize, maxsize);
+}
+
 static void
 read_tree(const char *path) {
 	struct	ptp_dirent *root = NULL, *dir, *dcim = NULL;
@@ -480,32 +689,28 @@ read_tree(const char *path) {
 	if (first_dirent)
 		return;
 
-	first_dirent = malloc(sizeof(struct ptp_dirent));
-	first_dirent->name = strdup("");
-	first_dirent->fsname = strdup(path);
-	first_dirent->id = ptp_objectid++;
-	first_dirent->next = NULL;
-	stat(first_dirent->fsname, &first_dirent->stbuf); /* assuming it works */
-	root = first_dirent;
-	read_directories(path,first_dirent);
+	root = malloc(sizeof(struct ptp_dirent));
+	root->name = strdup("");
+	root->fsname = strdup(path);
+	root->id = ptp_objectid++;
+	add_dirent(root, NULL);
+	stat(root->fsname, &root->stbuf); /* assuming it works */
+	read_directories(path,root);
 
 	/* See if we have a DCIM directory, if not, create one. */
-	dir = first_dirent;
-	while (dir) {
-		if (!strcmp(dir->name,"DCIM") && dir->parent && !dir->parent->id)
+	for (dir = root->children; dir; dir = dir->sibling)
+		if (!strcmp(dir->name,"DCIM"))
 			dcim = dir;
-		dir = dir->next;
-	}
 	if (!dcim) {
 		dcim = malloc(sizeof(struct ptp_dirent));
 		dcim->name = strdup("DCIM");
 		dcim->fsname = strdup(path);
 		dcim->id = ptp_objectid++;
-		dcim->next = first_dirent;
-		dcim->parent = root;
+		add_dirent(dcim, root);
 		stat(dcim->fsname, &dcim->stbuf); /* assuming it works */
-		first_dirent = dcim;
 	}
+	dcim_dirent = dcim;
+	generate_tree(dcim);
 }
 
 static int
@@ -521,6 +726,91 @@ ptp_nikon_setcontrolmode_write(vcamera *cam, ptpcontainer *ptp) {
 	return 1;
 }
 
+/* Nikon live view header in front of the JPEG, as on the D750 */
+#define LIVEVIEW_HEADER_SIZE	384
+
+/* The live view frame is the JPEG file named by VCAMERA_LIVEVIEW, or a
+ * 64 KiB placeholder framed like a JPEG (SOI ... EOI) */
+static int
+load_liveview(vcamera *cam) {
+	const char	*fn = getenv("VCAMERA_LIVEVIEW");
+	struct stat	stbuf;
+	int		size = 65536, i;
+	FILE		*f = NULL;
+
+	if (fn) {
+		f = fopen(fn, "rb");
+		if (!f || fstat(fileno(f), &stbuf) || (stbuf.st_size < 4)) {
+			gp_log (GP_LOG_ERROR, __FUNCTION__, "could not read live view frame '%s'", fn);
+			if (f) fclose(f);
+			return 0;
+		}
+		size = stbuf.st_size;
+	}
+	cam->liveview = calloc(1, LIVEVIEW_HEADER_SIZE + size);
+	if (!cam->liveview) {
+		if (f) fclose(f);
+		return 0;
+	}
+	cam->nrliveview = LIVEVIEW_HEADER_SIZE + size;
+	if (f) {
+		i = fread(cam->liveview + LIVEVIEW_HEADER_SIZE, size, 1, f);
+		fclose(f);
+		if (i != 1) {
+			free (cam->liveview);
+			cam->liveview = NULL;
+			return 0;
+		}
+		return 1;
+	}
+	for (i = 0; i < size; i++)
+		cam->liveview[LIVEVIEW_HEADER_SIZE + i] = i % 255;
+	put_16bit_le(cam->liveview + LIVEVIEW_HEADER_SIZE, 0xd8ff);
+	put_16bit_le(cam->liveview + LIVEVIEW_HEADER_SIZE + size - 2, 0xd9ff);
+	return 1;
+}
+
+static int
+ptp_nikon_startliveview_write(vcamera *cam, ptpcontainer *ptp) {
+	CHECK_SEQUENCE_NUMBER();
+	CHECK_SESSION();
+	CHECK_PARAM_COUNT(0);
+
+	if (!cam->liveview && !load_liveview(cam)) {
+		ptp_response (cam, PTP_RC_GeneralError, 0);
+		return 1;
+	}
+	cam->inliveview = 1;
+	ptp_response (cam, PTP_RC_OK, 0);
+	return 1;
+}
+
+static int
+ptp_nikon_endliveview_write(vcamera *cam, ptpcontainer *ptp) {
+	CHECK_SEQUENCE_NUMBER();
+	CHECK_SESSION();
+	CHECK_PARAM_COUNT(0);
+
+	cam->inliveview = 0;
+	ptp_response (cam, PTP_RC_OK, 0);
+	return 1;
+}
+
+static int
+ptp_nikon_getliveviewimg_write(vcamera *cam, ptpcontainer *ptp) {
+	CHECK_SEQUENCE_NUMBER();
+	CHECK_SESSION();
+	CHECK_PARAM_COUNT(0);
+
+	if (!cam->inliveview) {
+		ptp_response (cam, PTP_RC_NIKON_NotLiveView, 0);
+		return 1;
+	}
+	ptp_senddata (cam, 0x9203, cam->liveview, cam->nrliveview);
+	ptp_response (cam, PTP_RC_OK, 0);
+	return 1;
+}
+
 static int
 ptp_opensession_write(vcamera *cam, ptpcontainer *ptp) {
 	CHECK_PARAM_COUNT(1);
@@ -645,10 +935,30 @@ ptp_deviceinfo_write(vcamera *cam, ptpcontainer *ptp) {
 	return 1;
 }
 
+/* The objects listed for a GetObjectHandles mode: for 0 all objects
+ * recursive on the device, for 0xffffffff only the root dir, else the
+ * single level directory below this handle. */
+static struct ptp_dirent *
+listed_dir(uint32_t mode) {
+	if (mode == 0)
+		return NULL;
+	return find_dirent((mode == 0xffffffff) ? 0 : mode);
+}
+
+static struct ptp_dirent *
+list_first(struct ptp_dirent *dir) {
+	return dir ? dir->children : first_dirent;
+}
+
+static struct ptp_dirent *
+list_next(struct ptp_dirent *dir, struct ptp_dirent *cur) {
+	return dir ? cur->sibling : cur->next;
+}
+
 static int
 ptp_getnumobjects_write(vcamera *cam, ptpcontainer *ptp) {
 	int			cnt;
-	struct ptp_dirent	*cur;
+	struct ptp_dirent	*cur, *dir;
 	uint32_t		mode = 0;
 
 	CHECK_SEQUENCE_NUMBER();
@@ -674,11 +984,7 @@ ptp_getnumobjects_write(vcamera *cam, ptpcontainer *ptp) {
 	if (ptp->nparams >= 3) {
 		mode = ptp->params[2];
 		if ((mode != 0) && (mode != 0xffffffff)) {
-			cur = first_dirent;
-			while (cur) {
-				if (cur->id == mode) break;
-				cur = cur->next;
-			}
+			cur = find_dirent(mode);
 			if (!cur) {
 				gp_log (GP_LOG_ERROR,__FUNCTION__, "requested subtree of (0x%08x), but no such handle", mode);
 				ptp_response (cam, PTP_RC_InvalidObjectHandle, 0);
@@ -692,25 +998,11 @@ ptp_getnumobjects_write(vcamera *cam, ptpcontainer *ptp) {
 		}
 	}
 
-	cnt = 0; cur = first_dirent;
-	while (cur) {
-		if (cur->id) { /* do not include 0 entry */
-			switch (mode) {
-			case 0:	/* all objects recursive on device */
-				cnt++;
-				break;
-			case 0xffffffff: /* only root dir */
-				if (cur->parent->id == 0)
-					cnt++;
-				break;
-			default: /* single level directory below this handle */
-				if (cur->parent->id == mode)
-					cnt++;
-				break;
-			}
-		}
-		cur = cur->next;
-	}
+	dir = listed_dir(mode);
+	cnt = 0;
+	for (cur = list_first(dir); cur; cur = list_next(dir, cur))
+		if (cur->id) /* do not include 0 entry */
+			cnt++;
 
 	ptp_response (cam, PTP_RC_OK, 1, cnt);
 	return 1;
@@ -720,7 +1012,7 @@ static int
 ptp_getobjecthandles_write(vcamera *cam, ptpcontainer *ptp) {
 	unsigned char 		*data;
 	int			x = 0, cnt;
-	struct ptp_dirent	*cur;
+	struct ptp_dirent	*cur, *dir;
 	uint32_t		mode = 0;
 
 	CHECK_SEQUENCE_NUMBER();
@@ -746,11 +1038,7 @@ ptp_getobjecthandles_write(vcamera *cam, ptpcontainer *ptp) {
 	if (ptp->nparams >= 3) {
 		mode = ptp->params[2];
 		if ((mode != 0) && (mode != 0xffffffff)) {
-			cur = first_dirent;
-			while (cur) {
-				if (cur->id == mode) break;
-				cur = cur->next;
-			}
+			cur = find_dirent(mode);
 			if (!cur) {
 				gp_log (GP_LOG_ERROR,__FUNCTION__, "requested subtree of (0x%08x), but no such handle", mode);
 				ptp_response (cam, PTP_RC_InvalidObjectHandle, 0);
@@ -764,47 +1052,17 @@ ptp_getobjecthandles_write(vcamera *cam, ptpcontainer *ptp) {
 		}
 	}
 
-	cnt = 0; cur = first_dirent;
-	while (cur) {
-		if (cur->id) { /* do not include 0 entry */
-			switch (mode) {
-			case 0:	/* all objects recursive on device */
-				cnt++;
-				break;
-			case 0xffffffff: /* only root dir */
-				if (cur->parent->id == 0)
-					cnt++;
-				break;
-			default: /* single level directory below this handle */
-				if (cur->parent->id == mode)
-					cnt++;
-				break;
-			}
-		}
-		cur = cur->next;
-	}
+	dir = listed_dir(mode);
+	cnt = 0;
+	for (cur = list_first(dir); cur; cur = list_next(dir, cur))
+		if (cur->id) /* do not include 0 entry */
+			cnt++;
 
 	data = malloc(4+4*cnt);
 	x = put_32bit_le(data + x,cnt);
-	cur = first_dirent;
-	while (cur) {
-		if (cur->id) { /* do not include 0 entry */
-			switch (mode) {
-			case 0:	/* all objects recursive on device */
-				x += put_32bit_le(data+x, cur->id);
-				break;
-			case 0xffffffff: /* only root dir */
-				if (cur->parent->id == 0)
-					x += put_32bit_le(data+x, cur->id);
-				break;
-			default: /* single level directory below this handle */
-				if (cur->parent->id == mode)
-					x += put_32bit_le(data+x, cur->id);
-				break;
-			}
-		}
-		cur = cur->next;
-	}
+	for (cur = list_first(dir); cur; cur = list_next(dir, cur))
+		if (cur->id) /* do not include 0 entry */
+			x += put_32bit_le(data+x, cur->id);
 	ptp_senddata(cam,0x1007,data,x);
 	free (data);
 	ptp_response(cam,PTP_RC_OK,0);
@@ -879,12 +1137,7 @@ ptp_getobjectinfo_write(vcamera *cam, ptpcontainer *ptp) {
 	CHECK_SESSION();
 	CHECK_PARAM_COUNT(1);
 
-	cur = first_dirent;
-	while (cur) {
-		if (cur->id == ptp->params[0])
-			break;
-		cur = cur->next;
-	}
+	cur = find_dirent(ptp->params[0]);
 	if (!cur) {
 		gp_log (GP_LOG_ERROR,__FUNCTION__, "invalid object handle 0x%08x", ptp->params[0]);
 		ptp_response(cam,PTP_RC_InvalidObjectHandle,0);
@@ -920,7 +1173,7 @@ ptp_getobjectinfo_write(vcamera *cam, ptpcontainer *ptp) {
 	}
 
 #ifdef HAVE_LIBEXIF
-	if (ofc == 0x3801) {			/* We are jpeg ... look into the exif data */
+	if ((ofc == 0x3801) && cur->fsname) {	/* We are jpeg ... look into the exif data */
 		ExifData	*ed;
 		ExifEntry	*e;
 		unsigned char	*filedata;
@@ -958,6 +1211,12 @@ ptp_getobjectinfo_write(vcamera *cam, ptpcontainer *ptp) {
 		free (filedata);
 	}
 #endif
+	if ((ofc == 0x3801) && !cur->fsname) {
+		thumbofc	= 0x3808;
+		thumbsize	= GENERATED_THUMB_SIZE;
+		thumbwidth	= GENERATED_THUMB_WIDTH;
+		thumbheight	= GENERATED_THUMB_HEIGHT;
+	}
 	x += put_16bit_le (data+x, ofc);
 	x += put_16bit_le (data+x, 0); 			/* ProtectionStatus, no protection */
 	x += put_32bit_le (data+x, cur->stbuf.st_size); /* ObjectSize */
@@ -999,31 +1258,22 @@ ptp_getobjectinfo_write(vcamera *cam, ptpcontainer *ptp) {
 
 static int
 ptp_getobject_write(vcamera *cam, ptpcontainer *ptp) {
-	unsigned char 		*data;
 	struct ptp_dirent	*cur;
 
 	CHECK_SEQUENCE_NUMBER();
 	CHECK_SESSION();
 	CHECK_PARAM_COUNT(1);
 
-	cur = first_dirent;
-	while (cur) {
-		if (cur->id == ptp->params[0]) break;
-		cur = cur->next;
-	}
+	cur = find_dirent(ptp->params[0]);
 	if (!cur) {
 		gp_log (GP_LOG_ERROR,__FUNCTION__, "invalid object handle 0x%08x", ptp->params[0]);
 		ptp_response(cam,PTP_RC_InvalidObjectHandle,0);
 		return 1;
 	}
-	data = read_file(cur);
-	if (!data) {
+	if (!ptp_senddata_stream (cam, 0x1009, cur)) {
 		ptp_response(cam,PTP_RC_GeneralError,0);
 		return 1;
 	}
-
-	ptp_senddata (cam, 0x1009, data, cur->stbuf.st_size);
-	free (data);
 	ptp_response (cam, PTP_RC_OK, 0);
 	return 1;
 }
@@ -1040,16 +1290,28 @@ ptp_getthumb_write(vcamera *cam, ptpcontainer *ptp) {
 	CHECK_SESSION();
 	CHECK_PARAM_COUNT(1);
 
-	cur = first_dirent;
-	while (cur) {
-		if (cur->id == ptp->params[0]) break;
-		cur = cur->next;
-	}
+	cur = find_dirent(ptp->params[0]);
 	if (!cur) {
 		gp_log (GP_LOG_ERROR,__FUNCTION__, "invalid object handle 0x%08x", ptp->params[0]);
 		ptp_response(cam,PTP_RC_InvalidObjectHandle,0);
 		return 1;
 	}
+	if (!cur->fsname) {
+		if (S_ISDIR(cur->stbuf.st_mode)) {
+			ptp_response(cam,PTP_RC_NoThumbnailPresent,0);
+			return 1;
+		}
+		data = malloc(GENERATED_THUMB_SIZE);
+		if (!data) {
+			ptp_response(cam,PTP_RC_GeneralError,0);
+			return 1;
+		}
+		generate_data(cur->id, GENERATED_THUMB_SIZE, 0, data, GENERATED_THUMB_SIZE);
+		ptp_senddata (cam, 0x100A, data, GENERATED_THUMB_SIZE);
+		free (data);
+		ptp_response (cam, PTP_RC_OK, 0);
+		return 1;
+	}
 	data = read_file(cur);
 	if (!data) {
 		ptp_response(cam,PTP_RC_GeneralError,0);
@@ -1126,30 +1388,23 @@ ptp_initiatecapture_write(vcamera *cam, ptpcontainer *ptp) {
 		return 1;
 	}
 	/* identify the DCIM dir, so we can attach a virtual xxxGPHOT directory to virtually store the new picture in */
-	dir = first_dirent;
-	while (dir) {
-		if (!strcmp(dir->name,"DCIM") && dir->parent && !dir->parent->id)
-			dcim = dir;
-		dir = dir->next;
-	}
+	dcim = dcim_dirent;
 	/* find the nnnGPHOT directories, where nnn is 100-999. (See DCIM standard.) */
 	sprintf(buf, "%03dGPHOT", 100 + ((capcnt / 100) % 900));
-	dir = first_dirent;
+	dir = dcim->children;
 	while (dir) {
-		if (!strcmp (dir->name, buf) && (dir->parent == dcim))
+		if (!strcmp (dir->name, buf))
 			break;
-		dir = dir->next;
+		dir = dir->sibling;
 	}
 	/* if not yet found, create the virtual /DCIM/xxxGPHOT/ directory. */
 	if (!dir) {
 		dir 		= malloc (sizeof(struct ptp_dirent));
 		dir->id		= ++ptp_objectid;
-		dir->fsname	= "virtual";
+		dir->fsname	= strdup ("virtual");
 		dir->stbuf	= dcim->stbuf; /* only the S_ISDIR flag is used */
-		dir->parent	= dcim;
-		dir->next	= first_dirent;
 		dir->name	= strdup (buf);
-		first_dirent	= dir;
+		add_dirent (dir, dcim);
 		/* Emit ObjectAdded event for the created folder */
 		ptp_inject_interrupt (cam, 80, 0x4002, 1, ptp_objectid, cam->seqnr);	/* objectadded */
 	}
@@ -1162,13 +1417,11 @@ ptp_initiatecapture_write(vcamera *cam, ptpcontainer *ptp) {
 
 	newcur 		= malloc (sizeof(struct ptp_dirent));
 	newcur->id	= ++ptp_objectid;
-	newcur->fsname	= strdup(cur->fsname);
+	newcur->fsname	= cur->fsname ? strdup(cur->fsname) : NULL;
 	newcur->stbuf	= cur->stbuf;
-	newcur->parent	= dir;
-	newcur->next	= first_dirent;
 	newcur->name	= malloc(8+3+1+1);
 	sprintf(newcur->name,"GPH_%04d.JPG", capcnt++);
-	first_dirent	= newcur;
+	add_dirent (newcur, dir);
 
 	ptp_inject_interrupt (cam, 100, 0x4002, 1, ptp_objectid, cam->seqnr);	/* objectadded */
 	ptp_inject_interrupt (cam, 120, 0x400d, 0, 0, cam->seqnr);		/* capturecomplete */
@@ -1198,6 +1451,8 @@ ptp_deleteobject_write(vcamera *cam, ptpcontainer *ptp) {
 			cur = xcur;
 		}
 		first_dirent = NULL;
+		memset(dirents, 0, nrdirents * sizeof(dirents[0]));
+		dcim_dirent = NULL;
 		ptp_response (cam, PTP_RC_OK, 0);
 		return 1;
 	}
@@ -1209,11 +1464,7 @@ ptp_deleteobject_write(vcamera *cam, ptpcontainer *ptp) {
 	}
 	/* for associations this even means recursive deletion */
 
-	cur = first_dirent;
-	while (cur) {
-		if (cur->id == ptp->params[0]) break;
-		cur = cur->next;
-	}
+	cur = find_dirent(ptp->params[0]);
 	if (!cur) {
 		gp_log (GP_LOG_ERROR,__FUNCTION__, "invalid object handle 0x%08x", ptp->params[0]);
 		ptp_response(cam,PTP_RC_InvalidObjectHandle,0);
@@ -1224,20 +1475,8 @@ ptp_deleteobject_write(vcamera *cam, ptpcontainer *ptp) {
 		ptp_response(cam,PTP_RC_ObjectWriteProtected,0);
 		return 1;
 	}
-	if (cur == first_dirent) {
-		first_dirent = cur->next;
-		free_dirent (cur);
-	} else {
-		xcur = first_dirent;
-		while (xcur) {
-			if (xcur->next == cur) {
-				xcur->next = xcur->next->next;
-				free_dirent (cur);
-				break;
-			}
-			xcur = xcur->next;
-		}
-	}
+	remove_dirent (cur);
+	free_dirent (cur);
 	ptp_response (cam, PTP_RC_OK, 0);
 	return 1;
 }
@@ -1430,12 +1669,7 @@ ptp_vusb_write(vcamera *cam, ptpcontainer *ptp) {
 			ptp_response (cam, PTP_RC_GeneralError, 0);
 			return 1;
 		}
-		dir = first_dirent;
-		while (dir) {
-			if (!strcmp(dir->name,"DCIM") && dir->parent && !dir->parent->id)
-				dcim = dir;
-			dir = dir->next;
-		}
+		dcim = dcim_dirent;
 
 		cur = first_dirent;
 		while (cur) {
@@ -1448,67 +1682,55 @@ ptp_vusb_write(vcamera *cam, ptpcontainer *ptp) {
 			ptp_response (cam, PTP_RC_GeneralError, 0);
 			return 1;
 		}
-		dir = first_dirent;
-		while (dir) {
-			if (!strcmp(dir->name,"DCIM") && dir->parent && !dir->parent->id)
-				dcim = dir;
-			dir = dir->next;
-		}
+		dcim = dcim_dirent;
 		/* nnnGPHOT directories, where nnn is 100-999. (See DCIM standard.) */
 		sprintf(buf, "%03dGPHOT", 100 + ((capcnt / 100) % 900));
-		dir = first_dirent;
+		dir = dcim->children;
 		while (dir) {
-			if (!strcmp (dir->name, buf) && (dir->parent == dcim))
+			if (!strcmp (dir->name, buf))
 				break;
-			dir = dir->next;
+			dir = dir->sibling;
 		}
 		if (!dir) {
 			dir 		= malloc (sizeof(struct ptp_dirent));
 			dir->id		= ++ptp_objectid;
-			dir->fsname	= "virtual";
+			dir->fsname	= strdup ("virtual");
 			dir->stbuf	= dcim->stbuf; /* only the S_ISDIR flag is used */
-			dir->parent	= dcim;
-			dir->next	= first_dirent;
 			dir->name	= strdup (buf);
-			first_dirent	= dir;
+			add_dirent (dir, dcim);
 			/* Emit ObjectAdded event for the created folder */
 			ptp_inject_interrupt (cam, 80, 0x4002, 1, ptp_objectid, cam->seqnr);	/* objectadded */
 		}
 
 		newcur 		= malloc (sizeof(struct ptp_dirent));
 		newcur->id	= ++ptp_objectid;
-		newcur->fsname	= strdup(cur->fsname);
+		newcur->fsname	= cur->fsname ? strdup(cur->fsname) : NULL;
 		newcur->stbuf	= cur->stbuf;
-		newcur->parent	= dir;
-		newcur->next	= first_dirent;
 		newcur->name	= malloc(8+3+1+1);
 		sprintf(newcur->name,"GPH_%04d.JPG", capcnt++);
-		first_dirent	= newcur;
+		add_dirent (newcur, dir);
 
 		ptp_inject_interrupt (cam, timeout, 0x4002, 1, ptp_objectid, cam->seqnr);	/* objectadded */
 		ptp_response (cam, PTP_RC_OK, 0);
 		break;
 	}
 	case 1:	{/* remove 1 image from directory */
-		struct ptp_dirent	**pcur, *cur;
+		struct ptp_dirent	*cur;
 
-		pcur = &first_dirent;
-		while (*pcur) {
-			if (strstr ((*pcur)->name, ".jpg") || strstr ((*pcur)->name, ".JPG"))
+		cur = first_dirent;
+		while (cur) {
+			if (strstr (cur->name, ".jpg") || strstr (cur->name, ".JPG"))
 				break;
-			pcur = &((*pcur)->next);
+			cur = cur->next;
 		}
-		if (!*pcur) {
+		if (!cur) {
 			gp_log (GP_LOG_ERROR,__FUNCTION__, "I do not have a JPG file in the store, can not proceed");
 			ptp_response (cam, PTP_RC_GeneralError, 0);
 			return 1;
 		}
-		ptp_inject_interrupt (cam, timeout, 0x4003, 1, (*pcur)->id, cam->seqnr);	/* objectremoved */
-		cur = *pcur;
-		*pcur = (*pcur)->next;
-		free (cur->name);
-		free (cur->fsname);
-		free (cur);
+		ptp_inject_interrupt (cam, timeout, 0x4003, 1, cur->id, cam->seqnr);	/* objectremoved */
+		remove_dirent (cur);
+		free_dirent (cur);
 		ptp_response (cam, PTP_RC_OK, 0);
 		break;
 	}
@@ -1516,6 +1738,11 @@ ptp_vusb_write(vcamera *cam, ptpcontainer *ptp) {
 		ptp_inject_interrupt (cam, timeout, 0x400d, 0, 0, cam->seqnr);	/* capturecomplete */
 		ptp_response (cam, PTP_RC_OK, 0);
 		break;
+	case 3:	/* aperture changed on the camera, between f/2.8 and f/3.5 */
+		cam->fnumber = (cam->fnumber == 350) ? 280 : 350;
+		ptp_inject_interrupt (cam, timeout, 0x4006, 1, 0x5007, cam->seqnr);	/* devicepropchanged */
+		ptp_response (cam, PTP_RC_OK, 0);
+		break;
 	default:
 		gp_log (GP_LOG_ERROR, __FUNCTION__, "unknown action %d", ptp->params[0]);
 		ptp_response (cam, PTP_RC_OK, 0);
@@ -1741,6 +1968,66 @@ ptp_exposurebias_setvalue (vcamera* cam, PTPPropValue *val) {
 	return 1;
 }
 
+static int
+ptp_liveviewstatus_getdesc (vcamera* cam, PTPDevicePropDesc *desc) {
+	desc->DevicePropCode		= 0xd1a2;
+	desc->DataType			= 2;	/* uint8 */
+	desc->GetSet			= 0;	/* Get only */
+	desc->DefaultValue.u8		= 0;
+	desc->CurrentValue.u8		= cam->inliveview;
+	desc->FormFlag			= 0x02; /* enum */
+	desc->FORM.Enum.NumberOfValues	= 2;
+	desc->FORM.Enum.SupportedValue	= malloc(2*sizeof(desc->FORM.Enum.SupportedValue[0]));
+	desc->FORM.Enum.SupportedValue[0].u8	= 0;
+	desc->FORM.Enum.SupportedValue[1].u8	= 1;
+	return 1;
+}
+
+static int
+ptp_liveviewstatus_getvalue (vcamera* cam, PTPPropValue *val) {
+	val->u8 = cam->inliveview;
+	return 1;
+}
+
+static int
+ptp_liveviewprohibit_getdesc (vcamera* cam, PTPDevicePropDesc *desc) {
+	desc->DevicePropCode		= 0xd1a4;
+	desc->DataType			= 6;	/* uint32 */
+	desc->GetSet			= 0;	/* Get only */
+	desc->DefaultValue.u32		= 0;
+	desc->CurrentValue.u32		= 0;	/* nothing prohibits live view */
+	desc->FormFlag			= 0;	/* none */
+	return 1;
+}
+
+static int
+ptp_liveviewprohibit_getvalue (vcamera* cam, PTPPropValue *val) {
+	val->u32 = 0;
+	return 1;
+}
+
+/* 8 bit wide, which the config tables of some models do not expect, and
+ * then have to fall back to another entry of this property code */
+static int
+ptp_focusmetering_getdesc (vcamera* cam, PTPDevicePropDesc *desc) {
+	desc->DevicePropCode		= 0x501c;
+	desc->DataType			= 2;	/* uint8 */
+	desc->GetSet			= 0;	/* Get only */
+	desc->DefaultValue.u8		= 2;	/* multi-spot */
+	desc->CurrentValue.u8		= 2;
+	desc->FormFlag			= 0x02; /* enum */
+	desc->FORM.Enum.NumberOfValues	= 2;
+	desc->FORM.Enum.SupportedValue	= malloc(2*sizeof(desc->FORM.Enum.SupportedValue[0]));
+	desc->FORM.Enum.SupportedValue[0].u8	= 1;
+	desc->FORM.Enum.SupportedValue[1].u8	= 2;
+	return 1;
+}
+
+static int
+ptp_focusmetering_getvalue (vcamera* cam, PTPPropValue *val) {
+	val->u8 = 2;
+	return 1;
+}
 
 static int
 ptp_datetime_getdesc (vcamera* cam, PTPDevicePropDesc *desc) {
@@ -1825,8 +2112,18 @@ static int vcam_close(vcamera* cam) {
 		cam->fuzzpending = 0;
 	}
 #endif
+	/* the port may be opened again */
+	vcam_stream_end (cam);
 	free (cam->inbulk);
+	cam->inbulk = NULL;
+	cam->nrinbulk = 0;
 	free (cam->outbulk);
+	cam->outbulk = NULL;
+	cam->nroutbulk = 0;
+	free (cam->liveview);
+	cam->liveview = NULL;
+	cam->nrliveview = 0;
+	cam->inliveview = 0;
 	return GP_OK;
 }
 
@@ -1928,6 +2225,39 @@ vcam_process_output(vcamera *cam) {
 #endif
 }
 
+/* A bulk transfer takes VCAMERA_LATENCY plus its bytes at VCAMERA_BYTERATE.
+ * Transfers are timed back to back from when the bus got free, so sleeping
+ * too long once does not lower the average rate. */
+static void
+vcam_bus_wait(vcamera *cam, unsigned int bytes) {
+	struct timespec	now, delay;
+	uint64_t	ns;
+
+	if (!cam->latency && !cam->byterate)
+		return;
+	ns = cam->latency * 1000ULL;
+	if (cam->byterate)
+		ns += bytes * 1000000000ULL / cam->byterate;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	if (	(cam->busyuntil.tv_sec < now.tv_sec) ||
+		((cam->busyuntil.tv_sec == now.tv_sec) && (cam->busyuntil.tv_nsec < now.tv_nsec)))
+		cam->busyuntil = now;
+	ns += cam->busyuntil.tv_nsec;
+	cam->busyuntil.tv_sec += ns / 1000000000;
+	cam->busyuntil.tv_nsec = ns % 1000000000;
+
+	delay.tv_sec = cam->busyuntil.tv_sec - now.tv_sec;
+	delay.tv_nsec = cam->busyuntil.tv_nsec - now.tv_nsec;
+	if (delay.tv_nsec < 0) {
+		delay.tv_nsec += 1000000000;
+		delay.tv_sec--;
+	}
+#ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+	nanosleep (&delay, NULL);
+#endif
+}
+
 static int
 vcam_read(vcamera*cam, int ep, unsigned char *data, int bytes) {
 	unsigned int	toread = bytes;
@@ -1988,12 +2318,43 @@ vcam_read(vcamera*cam, int ep, unsigned char *data, int bytes) {
 
 	/* Emulated PTP camera stuff */
 
-	if (toread > cam->nrinbulk)
-		toread = cam->nrinbulk;
-
-	memcpy (data, cam->inbulk, toread);
-	memmove (cam->inbulk, cam->inbulk + toread, (cam->nrinbulk - toread));
-	cam->nrinbulk -= toread;
+	toread = 0;
+	while (toread < bytes) {
+		unsigned int n;
+
+		if (cam->streaming && !cam->streamat) {
+			/* the streamed data phase is next */
+			n = cam->streamsize - cam->streamoff;
+			if (n > bytes - toread)
+				n = bytes - toread;
+			if (!n) {
+				vcam_stream_end (cam);
+				continue;
+			}
+			if (cam->streamf) {
+				if (fread (data + toread, 1, n, cam->streamf) != n) {
+					gp_log (GP_LOG_ERROR, __FUNCTION__, "could not read object 0x%08x", cam->streamid);
+					vcam_stream_end (cam);
+					return GP_ERROR_IO_READ;
+				}
+			} else
+				generate_data (cam->streamid, cam->streamsize, cam->streamoff, data + toread, n);
+			cam->streamoff += n;
+		} else {
+			n = cam->streaming ? cam->streamat : cam->nrinbulk;
+			if (n > bytes - toread)
+				n = bytes - toread;
+			if (!n)
+				break;
+			memcpy (data + toread, cam->inbulk, n);
+			memmove (cam->inbulk, cam->inbulk + n, (cam->nrinbulk - n));
+			cam->nrinbulk -= n;
+			if (cam->streaming)
+				cam->streamat -= n;
+		}
+		toread += n;
+	}
+	vcam_bus_wait (cam, toread);
 	return toread;
 }
 
@@ -2007,6 +2368,7 @@ static int vcam_write(vcamera*cam, int ep, const unsigned char *data, int bytes)
 	memcpy(cam->outbulk + cam->nroutbulk, data, bytes);
 	cam->nroutbulk += bytes;
 
+	vcam_bus_wait (cam, bytes);
 	vcam_process_output(cam);
 
 	return bytes;
@@ -2019,25 +2381,17 @@ struct ptp_interrupt {
 	struct ptp_interrupt	*next;
 };
 
-static struct ptp_interrupt *first_interrupt;
+static struct ptp_interrupt *first_interrupt, *last_interrupt;
+/* the interrupts are injected by the bulk transfers and can be read by an
+ * event thread at the same time */
+static pthread_mutex_t interrupt_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int
-ptp_inject_interrupt(vcamera*cam, int when, uint16_t code, int nparams, uint32_t param1, uint32_t transid) {
+ptp_inject_interrupt_at(vcamera*cam, const struct timeval *when, uint16_t code, int nparams, uint32_t param1, uint32_t transid) {
 	struct ptp_interrupt	*interrupt, **pint;
-	struct timeval		now;
 	unsigned char		*data;
 	int			x = 0;
 
-	gp_log (GP_LOG_DEBUG, __FUNCTION__, "generate interrupt 0x%04x, %d params, param1 0x%08x, timeout=%d", code, nparams, param1, when);
-
-	gettimeofday (&now, NULL);
-	now.tv_usec += (when % 1000)*1000;
-	now.tv_sec += when / 1000;
-	if (now.tv_usec > 1000000) {
-		now.tv_usec -= 1000000;
-		now.tv_sec++;
-	}
-
 	data = malloc (0x10);
 	x += put_32bit_le (data+x, 0x10);
 	x += put_16bit_le (data+x, 4);
@@ -2048,18 +2402,29 @@ ptp_inject_interrupt(vcamera*cam, int when, uint16_t code, int nparams, uint32_t
 	interrupt = malloc (sizeof(struct ptp_interrupt));
 	interrupt->data		= data;
 	interrupt->size		= x;
-	interrupt->triggertime	= now;
+	interrupt->triggertime	= *when;
 	interrupt->next		= NULL;
 
 	/* Insert into list, sorted by trigger time, next triggering one first */
+	pthread_mutex_lock (&interrupt_lock);
+	if (last_interrupt && (	(when->tv_sec > last_interrupt->triggertime.tv_sec) ||
+				(	(when->tv_sec == last_interrupt->triggertime.tv_sec) &&
+					(when->tv_usec >= last_interrupt->triggertime.tv_usec)))
+	) {
+		/* the common case of events generated in order */
+		last_interrupt->next = interrupt;
+		last_interrupt = interrupt;
+		pthread_mutex_unlock (&interrupt_lock);
+		return 1;
+	}
 	pint = &first_interrupt;
 	while (*pint) {
-		if (now.tv_sec > (*pint)->triggertime.tv_sec) {
+		if (when->tv_sec > (*pint)->triggertime.tv_sec) {
 			pint = &((*pint)->next);
 			continue;
 		}
-		if (	(now.tv_sec == (*pint)->triggertime.tv_sec) &&
-			(now.tv_usec > (*pint)->triggertime.tv_usec)) {
+		if (	(when->tv_sec == (*pint)->triggertime.tv_sec) &&
+			(when->tv_usec > (*pint)->triggertime.tv_usec)) {
 			pint = &((*pint)->next);
 			continue;
 		}
@@ -2068,17 +2433,60 @@ ptp_inject_interrupt(vcamera*cam, int when, uint16_t code, int nparams, uint32_t
 		break;
 	}
 	if (!*pint) /* single entry */
-		*pint = interrupt;
+		*pint = last_interrupt = interrupt;
+	pthread_mutex_unlock (&interrupt_lock);
 	return 1;
 }
 
+static int
+ptp_inject_interrupt(vcamera*cam, int when, uint16_t code, int nparams, uint32_t param1, uint32_t transid) {
+	struct timeval		now;
+
+	gp_log (GP_LOG_DEBUG, __FUNCTION__, "generate interrupt 0x%04x, %d params, param1 0x%08x, timeout=%d", code, nparams, param1, when);
+
+	gettimeofday (&now, NULL);
+	now.tv_usec += (when % 1000)*1000;
+	now.tv_sec += when / 1000;
+	if (now.tv_usec > 1000000) {
+		now.tv_usec -= 1000000;
+		now.tv_sec++;
+	}
+	return ptp_inject_interrupt_at (cam, &now, code, nparams, param1, transid);
+}
+
+/* VCAMERA_EVENTRATE injects that many DevicePropChanged events of the
+ * battery level per second, due until the end of this poll. Events not
+ * polled for within a second are dropped, not queued up. */
+static void
+vcam_generate_events(vcamera *cam, int timeout) {
+	struct timeval	now, when;
+	uint64_t	us, end;
+
+	gettimeofday (&now, NULL);
+	us = now.tv_sec * 1000000ULL + now.tv_usec;
+	if (cam->nextevent + 1000000 < us)
+		cam->nextevent = us;
+	end = us + timeout * 1000ULL;
+	while (cam->nextevent <= end) {
+		when.tv_sec = cam->nextevent / 1000000;
+		when.tv_usec = cam->nextevent % 1000000;
+		ptp_inject_interrupt_at (cam, &when, 0x4006, 1, 0x5001, 0xffffffff);	/* devicepropchanged */
+		cam->nextevent += (cam->eventrate < 1000000) ? 1000000 / cam->eventrate : 1;
+	}
+}
+
 static int
 vcam_readint(vcamera*cam, unsigned char *data, int bytes, int timeout) {
 	struct timeval		now, end;
 	int 			newtimeout, tocopy;
 	struct ptp_interrupt	*pint;
 
+	if (cam->eventrate)
+		vcam_generate_events (cam, timeout);
+
+	pthread_mutex_lock (&interrupt_lock);
 	if (!first_interrupt) {
+		pthread_mutex_unlock (&interrupt_lock);
 #ifdef FUZZING
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 		usleep (timeout*1000);
@@ -2097,29 +2505,39 @@ vcam_readint(vcamera*cam, unsigned char *data, int bytes, int timeout) {
 		end.tv_usec -= 1000000;
 		end.tv_sec++;
 	}
-	if (first_interrupt->triggertime.tv_sec > end.tv_sec) {
+	if (	(first_interrupt->triggertime.tv_sec > end.tv_sec) ||
+		(	(first_interrupt->triggertime.tv_sec == end.tv_sec) &&
+			(first_interrupt->triggertime.tv_usec > end.tv_usec))
+	) {
+		pthread_mutex_unlock (&interrupt_lock);
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
-		usleep (1000*timeout);
+		if (timeout)
+			usleep (1000*timeout);
 #endif
 		return GP_ERROR_TIMEOUT;
 	}
-	if (	(first_interrupt->triggertime.tv_sec == end.tv_sec) &&
-		(first_interrupt->triggertime.tv_usec > end.tv_usec)
-	) {
+	/* a real camera sends the interrupt when it happens, not before */
+	newtimeout = (first_interrupt->triggertime.tv_sec - now.tv_sec)*1000000 + (first_interrupt->triggertime.tv_usec - now.tv_usec);
+	if (newtimeout > 0) {
+		pthread_mutex_unlock (&interrupt_lock);
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
-		usleep (1000*timeout);
+		usleep (newtimeout);
 #endif
-		return GP_ERROR_TIMEOUT;
+		pthread_mutex_lock (&interrupt_lock);
+		if (!first_interrupt) {
+			pthread_mutex_unlock (&interrupt_lock);
+			return GP_ERROR_TIMEOUT;
+		}
 	}
-	newtimeout = (first_interrupt->triggertime.tv_sec - now.tv_sec)*1000 + (first_interrupt->triggertime.tv_usec - now.tv_usec)/1000;
-	if (newtimeout > timeout)
-		gp_log (GP_LOG_ERROR, __FUNCTION__, "miscalculated? %d vs %d", timeout, newtimeout);
 	tocopy = first_interrupt->size;
 	if (tocopy > bytes)
 		tocopy = bytes;
 	memcpy (data, first_interrupt->data, tocopy);
 	pint = first_interrupt;
 	first_interrupt = first_interrupt->next;
+	if (!first_interrupt)
+		last_interrupt = NULL;
+	pthread_mutex_unlock (&interrupt_lock);
 	free (pint->data);
 	free (pint);
 	return tocopy;
@@ -2135,6 +2553,17 @@ vcamera_new(vcameratype type) {
 	const char *vcameradir_env = getenv("VCAMERADIR");
 	read_tree(vcameradir_env != NULL ? vcameradir_env : VCAMERADIR);
 
+	/* throughput of the virtual camera, unlimited by default */
+	const char *latency_env = getenv("VCAMERA_LATENCY");
+	if (latency_env)
+		cam->latency = atoi(latency_env);
+	const char *byterate_env = getenv("VCAMERA_BYTERATE");
+	if (byterate_env)
+		cam->byterate = atoi(byterate_env);
+	const char *eventrate_env = getenv("VCAMERA_EVENTRATE");
+	if (eventrate_env)
+		cam->eventrate = atoi(eventrate_env);
+
 	cam->init = vcam_init;
 	cam->exit = vcam_exit;
 	cam->open = vcam_open;
@@ -26,6 +26,8 @@
 #define FUZZ_PTP
 
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
 
 typedef struct ptpcontainer {
 	unsigned int size;
@@ -59,6 +61,22 @@ typedef struct vcamera {
 	unsigned char	*outbulk;
 	int		nroutbulk;
 
+	/* data phase produced while it is read, it follows streamat bytes of inbulk */
+	int		streaming;
+	int		streamat;
+	uint32_t	streamid;
+	unsigned int	streamoff, streamsize;
+	FILE		*streamf;
+
+	/* VCAMERA_LATENCY us per bulk transfer, VCAMERA_BYTERATE bytes/s */
+	unsigned int	latency;
+	unsigned int	byterate;
+	struct timespec	busyuntil;
+
+	/* VCAMERA_EVENTRATE events/s, the next one due at nextevent us */
+	unsigned int	eventrate;
+	uint64_t	nextevent;
+
 	unsigned int	seqnr;
 
 	unsigned int	session;
@@ -68,6 +86,10 @@ typedef struct vcamera {
 	unsigned int	shutterspeed;
 	unsigned int	fnumber;
 
+	int		inliveview;
+	unsigned char	*liveview;	/* live view header and JPEG frame */
+	int		nrliveview;
+
 #ifdef FUZZING
 	int		fuzzmode;
 #define FUZZMODE_PROTOCOL	0
@@ -284,10 +284,11 @@ gp_port_vusb_msg_read_lib(GPPort *port, int request, int value, int index,
 }
 
 static int
-gp_port_vusb_find_device_lib(GPPort *port, int idvendor, int idproduct)
+gp_port_vusb_get_device_id_lib(GPPort *port, int *idvendor, int *idproduct)
 {
 #ifdef FUZZ_PTP
-	if ((idvendor == 0x04b0) && (idproduct == 0x0437)) { /* Nikon D750 */
+	*idvendor = 0x04b0; /* Nikon D750 */
+	*idproduct = 0x0437;
 #else
 	GPPortInfo info;
 	char	*path, *s;
@@ -318,9 +319,19 @@ gp_port_vusb_find_device_lib(GPPort *port, int idvendor, int idproduct)
 		}
 	}
 	gp_log(GP_LOG_DEBUG,__FUNCTION__,"(using vendor 0x%04x,0x%04x)", vendor, product);
+	*idvendor = vendor;
+	*idproduct = product;
+#endif
+	return GP_OK;
+}
 
+static int
+gp_port_vusb_find_device_lib(GPPort *port, int idvendor, int idproduct)
+{
+	int vendor, product;
+
+	gp_port_vusb_get_device_id_lib (port, &vendor, &product);
 	if ((idvendor == vendor) && (idproduct == product)) {
-#endif
 		port->settings.usb.config	= 1;
 		port->settings.usb.interface	= 1;
 		port->settings.usb.altsetting	= 1;
@@ -391,5 +402,6 @@ gp_port_library_operations (void)
 
 	ops->find_device 		= gp_port_vusb_find_device_lib;
 	ops->find_device_by_class	= gp_port_vusb_find_device_by_class_lib;
+	ops->get_device_id		= gp_port_vusb_get_device_id_lib;
 	return ops;
 }
@@ -0,0 +1,126 @@
+/* bench-file.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Benchmark of growing a memory CameraFile the way camera drivers do,
+ * by appending 64 KiB chunks, once without and once with a
+ * gp_file_reserve() size hint. Each run happens in a child process, so
+ * the reported peak RSS belongs to that run alone.
+ *
+ * Usage: bench-file [MEGABYTES]    (default 1024)
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <gphoto2/gphoto2-file.h>
+#include <gphoto2/gphoto2-result.h>
+
+#define CHUNKSIZE (64*1024)
+
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static int
+append_file (unsigned long size, int reserve)
+{
+	CameraFile	*file;
+	char		*chunk;
+	const char	*data;
+	unsigned long	done, got;
+	int		res = GP_OK;
+
+	chunk = malloc (CHUNKSIZE);
+	if (!chunk)
+		return 1;
+	memset (chunk, 0x55, CHUNKSIZE);
+
+	gp_file_new (&file);
+	if (reserve)
+		res = gp_file_reserve (file, size);
+	for (done = 0; (res >= GP_OK) && (done < size); done += CHUNKSIZE)
+		res = gp_file_append (file, chunk, (size - done < CHUNKSIZE) ? size - done : CHUNKSIZE);
+	if (res < GP_OK) {
+		printf ("ERROR: %s\n", gp_result_as_string (res));
+		return 1;
+	}
+	gp_file_get_data_and_size (file, &data, &got);
+	if ((got != size) || (data[size - 1] != 0x55)) {
+		printf ("ERROR: file has %lu bytes, expected %lu\n", got, size);
+		return 1;
+	}
+	gp_file_unref (file);
+	free (chunk);
+	return 0;
+}
+
+
+static int
+run (const char *name, unsigned long size, int reserve)
+{
+	struct rusage	usage;
+	double		start = now ();
+	pid_t		pid;
+	int		status;
+
+	fflush (stdout);
+	pid = fork ();
+	if (pid < 0)
+		return 1;
+	if (!pid)
+		_exit (append_file (size, reserve));
+	if (wait4 (pid, &status, 0, &usage) != pid)
+		return 1;
+	if (!WIFEXITED (status) || WEXITSTATUS (status))
+		return 1;
+	printf ("%-8s %lu MiB in 64 KiB chunks: %.3f s, peak RSS %ld MiB\n",
+		name, size / (1024*1024), now () - start, usage.ru_maxrss / 1024);
+	return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	unsigned long	size = 1024;
+	int		ret = 0;
+
+	if (argc > 1)
+		size = strtoul (argv[1], NULL, 0);
+	size *= 1024*1024;
+
+	ret |= run ("append", size, 0);
+	ret |= run ("reserve", size, 1);
+	return ret;
+}
@@ -0,0 +1,765 @@
+/* bench-vusb.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Benchmark of the main workflows of an application against the vusb
+ * virtual camera: init (setting up a camera), abilities (loading the
+ * abilities of all camera drivers), autodetect, list (recursive folder
+ * listing, the default), download and thumbnails (all files of the first
+ * folder, thumbnails only with -g), single (getting and setting exposure
+ * settings by name), liveview (frames with gp_camera_capture_preview()
+ * and from a preview stream) and events (time from a new file on the
+ * camera to the application, waited for and with an event pump).
+ *
+ * IOLIBS has to point to a directory containing only the vusb iolib, so
+ * the autodetection picks up the virtual camera. The card is FOLDERS x
+ * FILES empty JPEG files in a temporary directory, or with -g generated
+ * by the virtual camera itself (VCAMERA_OBJECTS) with files of SIZE bytes.
+ *
+ * With -o FILE the results are also written to FILE, one JSON object per
+ * line with the workflow, metric, value and unit, for comparing runs.
+ *
+ * Usage: bench-vusb [-g] [-s SIZE] [-f FOLDERS] [-n FILES] [-o FILE] [workflow...]
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <pthread.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-port-log.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+
+static int nr_folders = 50;
+static int nr_files = 1000;
+static int generated = 0;
+static int file_size = 65536;
+
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static FILE *results;
+static const char *workflow;
+
+/* One result of the running workflow for -o FILE */
+static void
+report (const char *metric, double value, const char *unit)
+{
+	if (!results)
+		return;
+	fprintf (results, "{\"workflow\": \"%s\", \"metric\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}\n",
+		 workflow, metric, value, unit);
+}
+
+
+static int
+create_card (char *dir)
+{
+	char path[4096];
+	int  i, j;
+
+	snprintf (path, sizeof(path), "%s/DCIM", dir);
+	if (mkdir (path, 0755) < 0)
+		return -1;
+	for (i = 0; i < nr_folders; i++) {
+		snprintf (path, sizeof(path), "%s/DCIM/%03dBENCH", dir, 100 + i);
+		if (mkdir (path, 0755) < 0)
+			return -1;
+		for (j = 0; j < nr_files; j++) {
+			int fd;
+
+			snprintf (path, sizeof(path), "%s/DCIM/%03dBENCH/IMG_%05d.JPG", dir, 100 + i, j);
+			fd = open (path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+			if (fd < 0)
+				return -1;
+			close (fd);
+		}
+	}
+	return 0;
+}
+
+static void
+remove_card (char *dir)
+{
+	char path[4096];
+	int  i, j;
+
+	for (i = 0; !generated && (i < nr_folders); i++) {
+		for (j = 0; j < nr_files; j++) {
+			snprintf (path, sizeof(path), "%s/DCIM/%03dBENCH/IMG_%05d.JPG", dir, 100 + i, j);
+			unlink (path);
+		}
+		snprintf (path, sizeof(path), "%s/DCIM/%03dBENCH", dir, 100 + i);
+		rmdir (path);
+	}
+	snprintf (path, sizeof(path), "%s/DCIM", dir);
+	rmdir (path);
+	rmdir (dir);
+}
+
+
+static int
+list_recursive (Camera *camera, const char *folder, int *folders, int *files,
+		GPContext *context)
+{
+	CameraList *list;
+	int i, n, ret;
+
+	ret = gp_list_new (&list);
+	if (ret < GP_OK)
+		return ret;
+
+	ret = gp_camera_folder_list_files (camera, folder, list, context);
+	if (ret < GP_OK)
+		goto out;
+	*files += gp_list_count (list);
+
+	gp_list_reset (list);
+	ret = gp_camera_folder_list_folders (camera, folder, list, context);
+	if (ret < GP_OK)
+		goto out;
+	n = gp_list_count (list);
+	for (i = 0; i < n; i++) {
+		const char *name;
+		char path[1024];
+
+		gp_list_get_name (list, i, &name);
+		snprintf (path, sizeof(path), "%s%s%s", folder,
+			  strcmp (folder, "/") ? "/" : "", name);
+		(*folders)++;
+		ret = list_recursive (camera, path, folders, files, context);
+		if (ret < GP_OK)
+			goto out;
+	}
+	ret = GP_OK;
+out:
+	gp_list_free (list);
+	return ret;
+}
+
+/* Full recursive listing of the card, as done by "gphoto2 -L" */
+static int
+bench_list (Camera *camera, GPContext *context)
+{
+	int folders = 0, files = 0;
+	double start = now (), secs;
+
+	CHECK (list_recursive (camera, "/", &folders, &files, context));
+	secs = now () - start;
+	printf ("list: %d folders, %d files in %.3f s (%.0f objects/s)\n",
+		folders, files, secs, (folders + files) / secs);
+	report ("objects", folders + files, "objects");
+	report ("rate", (folders + files) / secs, "objects/s");
+	return 0;
+}
+
+
+static unsigned int single_entries, single_total;
+
+static void
+count_entries (GPLogLevel level, const char *domain, const char *str, void *data)
+{
+	const char *s = strstr (str, "config entries to look at");
+
+	if (s)
+		sscanf (strstr (str, "': ") + 3, "%u of %u", &single_entries, &single_total);
+}
+
+/* Setting exposure values one at a time by name */
+static int
+bench_single (Camera *camera, GPContext *context)
+{
+	static const char *names[] = { "f-number", "shutterspeed", "exposurecompensation" };
+	CameraWidget *widget;
+	int i, n = 300, logid;
+	double start, secs;
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		CHECK (gp_camera_get_single_config (camera, names[i % 3], &widget, context));
+		gp_widget_set_changed (widget, 1);
+		CHECK (gp_camera_set_single_config (camera, names[i % 3], widget, context));
+		gp_widget_free (widget);
+	}
+	secs = now () - start;
+
+	logid = gp_log_add_func (GP_LOG_DEBUG, count_entries, NULL);
+	CHECK (gp_camera_get_single_config (camera, "shutterspeed", &widget, context));
+	gp_widget_free (widget);
+	gp_log_remove_func (logid);
+
+	printf ("single: %d get+set in %.3f s (%.3f ms each), %u of %u config entries visited\n",
+		n, secs, secs * 1000 / n, single_entries, single_total);
+	report ("rate", n / secs, "get+set/s");
+	return 0;
+}
+
+
+static unsigned int transactions;
+
+static void
+count_transactions (GPLogLevel level, const char *domain, const char *str, void *data)
+{
+	if (!strncmp (str, "Sending PTP_OC ", 15) && strstr (str, "request..."))
+		transactions++;
+}
+
+
+static int
+check_frame (CameraFile *file, unsigned long *size)
+{
+	const unsigned char *data;
+
+	gp_file_get_data_and_size (file, (const char **)&data, size);
+	if ((*size < 4) || (data[0] != 0xff) || (data[1] != 0xd8) ||
+	    (data[*size - 2] != 0xff) || (data[*size - 1] != 0xd9)) {
+		printf ("ERROR: frame of %lu bytes is no JPEG\n", *size);
+		return 1;
+	}
+	return 0;
+}
+
+/* Fetches n live view frames, the old way or from the preview stream */
+static int
+liveview_frames (Camera *camera, int stream, int n, unsigned long *size, GPContext *context)
+{
+	CameraFile *file;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (stream) {
+			CHECK (gp_camera_get_preview_frame (camera, &file, context));
+		} else {
+			CHECK (gp_file_new (&file));
+			CHECK (gp_camera_capture_preview (camera, file, context));
+		}
+		if (check_frame (file, size))
+			return 1;
+		if (!stream)
+			gp_file_unref (file);
+	}
+	return 0;
+}
+
+/* Live view, frame by frame as before and as a stream into a frame ring */
+static int
+bench_liveview (Camera *camera, GPContext *context)
+{
+	unsigned long size[2];
+	unsigned int count[2];
+	double start, secs[2];
+	int i, n = 300, logid;
+
+	for (i = 0; i < 2; i++) {
+		/* a first round starts live view and lets the ring buffers grow to the frame size */
+		if (i)
+			CHECK (gp_camera_start_preview_stream (camera, 3, context));
+		if (liveview_frames (camera, i, 3, &size[i], context))
+			return 1;
+
+		start = now ();
+		if (liveview_frames (camera, i, n, &size[i], context))
+			return 1;
+		secs[i] = now () - start;
+
+		/* with a log function, all debug messages get formatted */
+		logid = gp_log_add_func (GP_LOG_DEBUG, count_transactions, NULL);
+		transactions = 0;
+		if (liveview_frames (camera, i, 10, &size[i], context))
+			return 1;
+		count[i] = transactions;
+		gp_log_remove_func (logid);
+	}
+	CHECK (gp_camera_stop_preview_stream (camera, context));
+
+	if (size[0] != size[1]) {
+		printf ("ERROR: preview frames of %lu bytes, stream frames of %lu bytes\n", size[0], size[1]);
+		return 1;
+	}
+	for (i = 0; i < 2; i++) {
+		printf ("liveview: %-7s %d frames of %lu bytes, %.3f ms and %.1f transactions each\n",
+			i ? "stream" : "preview", n, size[i], secs[i] * 1000 / n, count[i] / 10.0);
+		report (i ? "stream_rate" : "preview_rate", n / secs[i], "frames/s");
+		report (i ? "stream_throughput" : "preview_throughput", n * size[i] / secs[i] / 1e6, "MB/s");
+	}
+	return 0;
+}
+
+
+/* the virtual camera adds a file and completes the "capture" that many ms
+ * after being asked to with its opcode 0x9999 */
+#define EVENT_DELAY	100
+#define EVENT_COMPLETE	120
+
+static pthread_mutex_t	event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	event_cond = PTHREAD_COND_INITIALIZER;
+static double		event_file_added, event_capture_complete;
+
+static void
+pump_event (Camera *camera, CameraEventType type, void *data, void *user_data)
+{
+	pthread_mutex_lock (&event_lock);
+	if ((type == GP_EVENT_FILE_ADDED) && !event_file_added)
+		event_file_added = now ();
+	if (type == GP_EVENT_CAPTURE_COMPLETE)
+		event_capture_complete = now ();
+	pthread_cond_broadcast (&event_cond);
+	pthread_mutex_unlock (&event_lock);
+}
+
+static int
+emit_event (Camera *camera, int type, int delay, GPContext *context)
+{
+	CameraWidget *widget;
+	char opcode[32];
+	int ret;
+
+	CHECK (gp_camera_get_single_config (camera, "opcode", &widget, context));
+	snprintf (opcode, sizeof(opcode), "0x9999,0x%x,0x%x", type, delay);
+	ret = gp_widget_set_value (widget, opcode);
+	if (ret == GP_OK)
+		ret = gp_camera_set_single_config (camera, "opcode", widget, context);
+	gp_widget_free (widget);
+	CHECK (ret);
+	return 0;
+}
+
+/* One new file, returns the ms until the application learns about it */
+static int
+capture_latency (Camera *camera, int pump, int liveview, double *ms, GPContext *context)
+{
+	CameraEventType type;
+	CameraFile *file;
+	double start, added = 0;
+	void *data;
+	int complete = 0;
+
+	pthread_mutex_lock (&event_lock);
+	event_file_added = event_capture_complete = 0;
+	pthread_mutex_unlock (&event_lock);
+
+	start = now ();
+	if (	emit_event (camera, 0, EVENT_DELAY, context) ||
+		emit_event (camera, 2, EVENT_COMPLETE, context))
+		return 1;
+	while (!complete) {
+		if (liveview) {
+			CHECK (gp_file_new (&file));
+			CHECK (gp_camera_capture_preview (camera, file, context));
+			gp_file_unref (file);
+		}
+		if (pump) {
+			pthread_mutex_lock (&event_lock);
+			if (!liveview && !event_capture_complete)
+				pthread_cond_wait (&event_cond, &event_lock);
+			added = event_file_added;
+			complete = event_capture_complete != 0;
+			pthread_mutex_unlock (&event_lock);
+			continue;
+		}
+		CHECK (gp_camera_wait_for_event (camera, liveview ? 0 : 1000, &type, &data, context));
+		if ((type == GP_EVENT_FILE_ADDED) && !added)
+			added = now ();
+		if (type == GP_EVENT_CAPTURE_COMPLETE)
+			complete = 1;
+		free (data);
+		if (!liveview && (type == GP_EVENT_TIMEOUT)) {
+			printf ("ERROR: no capture complete event\n");
+			return 1;
+		}
+	}
+	if (!added) {
+		printf ("ERROR: no file added event\n");
+		return 1;
+	}
+	*ms = (added - start) * 1000;
+	return 0;
+}
+
+/* Capture events, polled by the application and from the event pump */
+static int
+bench_events (Camera *camera, GPContext *context)
+{
+	static const struct {
+		const char	*name;
+		int		pump, liveview;
+	} modes[] = {
+		{ "wait", 0, 0 },
+		{ "liveview+poll", 0, 1 },
+		{ "pump", 1, 0 },
+		{ "liveview+pump", 1, 1 },
+	};
+	double ms, sum, max;
+	unsigned int m;
+	int i, n = 5;
+
+	for (m = 0; m < sizeof(modes)/sizeof(modes[0]); m++) {
+		if (modes[m].pump)
+			CHECK (gp_camera_start_event_pump (camera, pump_event, NULL, context));
+		/* the first file also adds a folder */
+		if (!m && capture_latency (camera, 0, 0, &ms, context))
+			return 1;
+		sum = max = 0;
+		for (i = 0; i < n; i++) {
+			if (capture_latency (camera, modes[m].pump, modes[m].liveview, &ms, context))
+				return 1;
+			sum += ms;
+			if (ms > max)
+				max = ms;
+		}
+		if (modes[m].pump)
+			CHECK (gp_camera_stop_event_pump (camera, context));
+		printf ("events: %-13s %d files, %.1f ms (max %.1f ms) from the camera to the application\n",
+			modes[m].name, n, sum / n - EVENT_DELAY, max - EVENT_DELAY);
+		report (modes[m].name, sum / n - EVENT_DELAY, "ms");
+	}
+	return 0;
+}
+
+
+/* Descends into the first folders until one has files */
+static int
+first_files_folder (Camera *camera, char *folder, size_t size, CameraList *files,
+		    GPContext *context)
+{
+	CameraList *list;
+	const char *name;
+	size_t len;
+	int ret;
+
+	while (1) {
+		gp_list_reset (files);
+		CHECK (gp_camera_folder_list_files (camera, folder, files, context));
+		if (gp_list_count (files))
+			return 0;
+		CHECK (gp_list_new (&list));
+		ret = gp_camera_folder_list_folders (camera, folder, list, context);
+		if ((ret < GP_OK) || !gp_list_count (list)) {
+			gp_list_free (list);
+			printf ("ERROR: no folder with files\n");
+			return 1;
+		}
+		gp_list_get_name (list, 0, &name);
+		len = strlen (folder);
+		snprintf (folder + len, size - len, "%s%s", strcmp (folder, "/") ? "/" : "", name);
+		gp_list_free (list);
+	}
+}
+
+/* Download of all files of the first folder into memory */
+static int
+bench_download (Camera *camera, GPContext *context)
+{
+	CameraList *files;
+	CameraFile *file;
+	const char *name;
+	const unsigned char *data;
+	unsigned long size;
+	double bytes = 0, start, secs;
+	char folder[1024] = "/";
+	int i, n;
+
+	CHECK (gp_list_new (&files));
+	if (first_files_folder (camera, folder, sizeof(folder), files, context)) {
+		gp_list_free (files);
+		return 1;
+	}
+	n = gp_list_count (files);
+	start = now ();
+	for (i = 0; i < n; i++) {
+		gp_list_get_name (files, i, &name);
+		CHECK (gp_file_new (&file));
+		CHECK (gp_camera_file_get (camera, folder, name, GP_FILE_TYPE_NORMAL, file, context));
+		gp_file_get_data_and_size (file, (const char **)&data, &size);
+		/* generated files are framed like JPEGs, the card's are empty */
+		if (size && check_frame (file, &size)) {
+			gp_file_unref (file);
+			gp_list_free (files);
+			return 1;
+		}
+		bytes += size;
+		gp_file_unref (file);
+	}
+	secs = now () - start;
+	gp_list_free (files);
+	printf ("download: %d files, %.1f MB in %.3f s (%.0f files/s, %.1f MB/s)\n",
+		n, bytes / 1e6, secs, n / secs, bytes / 1e6 / secs);
+	report ("rate", n / secs, "files/s");
+	report ("throughput", bytes / 1e6 / secs, "MB/s");
+	return 0;
+}
+
+
+/* Setting up a camera from scratch, as every application does first */
+static int
+bench_init (Camera *camera, GPContext *context)
+{
+	Camera *icamera;
+	double start, secs;
+	int i, n = 20, ret;
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		CHECK (gp_camera_new (&icamera));
+		ret = gp_camera_init (icamera, context);
+		gp_camera_exit (icamera, context);
+		gp_camera_unref (icamera);
+		CHECK (ret);
+	}
+	secs = now () - start;
+	printf ("init: %d cameras set up in %.3f s (%.3f ms each)\n", n, secs, secs * 1000 / n);
+	report ("rate", n / secs, "inits/s");
+	return 0;
+}
+
+/* Loading the abilities of all camera drivers, as frontends do at start */
+static int
+bench_abilities (Camera *camera, GPContext *context)
+{
+	CameraAbilitiesList *list;
+	double start, secs;
+	int i, n = 20, models = 0;
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		CHECK (gp_abilities_list_new (&list));
+		CHECK (gp_abilities_list_load (list, context));
+		models = gp_abilities_list_count (list);
+		gp_abilities_list_free (list);
+	}
+	secs = now () - start;
+	printf ("abilities: %d loads of %d models in %.3f s (%.3f ms each)\n",
+		n, models, secs, secs * 1000 / n);
+	report ("models", models, "models");
+	report ("rate", n / secs, "loads/s");
+	return 0;
+}
+
+/* Autodetection from scratch, as "gphoto2 --auto-detect" */
+static int
+bench_autodetect (Camera *camera, GPContext *context)
+{
+	CameraList *list;
+	double start, secs;
+	int i, n = 20, cameras = 0;
+
+	CHECK (gp_list_new (&list));
+	start = now ();
+	for (i = 0; i < n; i++) {
+		gp_list_reset (list);
+		CHECK (gp_camera_autodetect (list, context));
+		cameras = gp_list_count (list);
+	}
+	secs = now () - start;
+	gp_list_free (list);
+	if (!cameras) {
+		printf ("ERROR: no camera detected\n");
+		return 1;
+	}
+	printf ("autodetect: %d runs, %d cameras in %.3f s (%.3f ms each)\n",
+		n, cameras, secs, secs * 1000 / n);
+	report ("rate", n / secs, "autodetects/s");
+	return 0;
+}
+
+/* The thumbnails of all files of the first folder, as a browsing frontend */
+static int
+bench_thumbnails (Camera *camera, GPContext *context)
+{
+	CameraList *files;
+	CameraFile *file;
+	const char *name;
+	unsigned long size;
+	double bytes = 0, start, secs;
+	char folder[1024] = "/";
+	int i, n;
+
+	/* the files of the card on disk are empty */
+	if (!generated) {
+		printf ("thumbnails: needs a generated card (-g), skipped\n");
+		return 0;
+	}
+	CHECK (gp_list_new (&files));
+	if (first_files_folder (camera, folder, sizeof(folder), files, context)) {
+		gp_list_free (files);
+		return 1;
+	}
+	n = gp_list_count (files);
+	start = now ();
+	for (i = 0; i < n; i++) {
+		gp_list_get_name (files, i, &name);
+		CHECK (gp_file_new (&file));
+		CHECK (gp_camera_file_get (camera, folder, name, GP_FILE_TYPE_PREVIEW, file, context));
+		if (check_frame (file, &size)) {
+			gp_file_unref (file);
+			gp_list_free (files);
+			return 1;
+		}
+		bytes += size;
+		gp_file_unref (file);
+	}
+	secs = now () - start;
+	gp_list_free (files);
+	printf ("thumbnails: %d thumbnails of %.0f bytes in %.3f s (%.0f thumbnails/s)\n",
+		n, n ? bytes / n : 0, secs, n / secs);
+	report ("rate", n / secs, "thumbnails/s");
+	return 0;
+}
+
+
+static const struct {
+	const char *name;
+	int (*func) (Camera *, GPContext *);
+} workflows[] = {
+	{ "list", bench_list },
+	{ "single", bench_single },
+	{ "liveview", bench_liveview },
+	{ "events", bench_events },
+	{ "download", bench_download },
+	{ "init", bench_init },
+	{ "abilities", bench_abilities },
+	{ "autodetect", bench_autodetect },
+	{ "thumbnails", bench_thumbnails },
+};
+
+static int
+run (const char *name, GPContext *context)
+{
+	Camera *camera;
+	struct rusage usage;
+	double start;
+	unsigned int i;
+	int ret = 1;
+
+	for (i = 0; i < sizeof(workflows)/sizeof(workflows[0]); i++) {
+		if (strcmp (workflows[i].name, name))
+			continue;
+
+		workflow = name;
+		CHECK (gp_camera_new (&camera));
+		start = now ();
+		CHECK (gp_camera_init (camera, context));
+		printf ("init: %.3f s\n", now () - start);
+		report ("init", now () - start, "s");
+		start = now ();
+		ret = workflows[i].func (camera, context);
+		report ("time", now () - start, "s");
+		/* the peak of the whole process so far, in KiB on Linux */
+		if (!getrusage (RUSAGE_SELF, &usage))
+			report ("peak_rss", usage.ru_maxrss, "KiB");
+		gp_camera_exit (camera, context);
+		gp_camera_unref (camera);
+		return ret;
+	}
+	printf ("ERROR: unknown workflow '%s'\n", name);
+	return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/bench-vusb-XXXXXX";
+	GPContext *context;
+	double start;
+	int opt, ret = 0;
+
+	while ((opt = getopt (argc, argv, "gs:f:n:o:")) != -1) {
+		switch (opt) {
+		case 'g': generated = 1; break;
+		case 's': file_size = atoi (optarg); break;
+		case 'f': nr_folders = atoi (optarg); break;
+		case 'n': nr_files = atoi (optarg); break;
+		case 'o':
+			results = fopen (optarg, "w");
+			if (!results) {
+				perror (optarg);
+				return 1;
+			}
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-g] [-s SIZE] [-f FOLDERS] [-n FILES] [-o FILE] [workflow...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	if (generated) {
+		char objects[32], size[16];
+
+		/* an empty directory, the virtual camera adds DCIM and the files */
+		snprintf (objects, sizeof(objects), "%dx%d", nr_folders, nr_files);
+		snprintf (size, sizeof(size), "%d", file_size);
+		setenv ("VCAMERA_OBJECTS", objects, 1);
+		setenv ("VCAMERA_OBJECTSIZE", size, 1);
+		printf ("card: %d folders x %d files of %d bytes generated by the camera\n",
+			nr_folders, nr_files, file_size);
+	} else {
+		start = now ();
+		if (create_card (dir) < 0) {
+			perror ("creating synthetic card");
+			ret = 1;
+			goto out;
+		}
+		printf ("card: %d folders x %d files created in %.3f s\n",
+			nr_folders, nr_files, now () - start);
+	}
+	setenv ("VCAMERADIR", dir, 1);
+
+	context = gp_context_new ();
+	if (optind == argc) {
+		ret = run ("list", context);
+	} else {
+		for (; optind < argc && !ret; optind++)
+			ret = run (argv[optind], context);
+	}
+	gp_context_unref (context);
+out:
+	remove_card (dir);
+	if (results)
+		fclose (results);
+	return ret;
+}
@@ -0,0 +1,154 @@
+/* test-abilities-cache.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Loads the abilities of all camlibs without the abilities cache, then
+ * writing the cache, from the cache and from a stale cache, and checks
+ * that all give the same list, with model lookups finding the first
+ * entry of a model.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-abilities-list.h>
+#include <gphoto2/gphoto2-result.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static int
+load (CameraAbilitiesList **list, const char *cache)
+{
+	setenv ("GP_ABILITIES_CACHE", cache, 1);
+	CHECK (gp_abilities_list_new (list));
+	CHECK (gp_abilities_list_load (*list, NULL));
+	return 0;
+}
+
+static const char *
+entry_model (CameraAbilitiesList *list, int i)
+{
+	static CameraAbilities a;
+
+	gp_abilities_list_get_abilities (list, i, &a);
+	return a.model;
+}
+
+static int
+compare (CameraAbilitiesList *a, CameraAbilitiesList *b, const char *what)
+{
+	CameraAbilities aa, ab;
+	int i, j, count = gp_abilities_list_count (a);
+
+	if (count != gp_abilities_list_count (b)) {
+		printf ("%s: %d models instead of %d\n", what,
+			gp_abilities_list_count (b), count);
+		return 1;
+	}
+	for (i = 0; i < count; i++) {
+		CHECK (gp_abilities_list_get_abilities (a, i, &aa));
+		CHECK (gp_abilities_list_get_abilities (b, i, &ab));
+		if (memcmp (&aa, &ab, sizeof (aa))) {
+			printf ("%s: model %d is '%s' instead of '%s'\n", what,
+				i, ab.model, aa.model);
+			return 1;
+		}
+		for (j = 0; strcasecmp (ab.model, entry_model (b, j)); j++)
+			;
+		if (gp_abilities_list_lookup_model (b, ab.model) != j) {
+			printf ("%s: looking up '%s' gave %d instead of %d\n", what,
+				ab.model, gp_abilities_list_lookup_model (b, ab.model), j);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int
+main (void)
+{
+	CameraAbilitiesList	*uncached, *list;
+	CameraAbilities		a;
+	char			cache[] = "test-abilities-cache.XXXXXX";
+	FILE			*f;
+	int			fd, count;
+
+	fd = mkstemp (cache);
+	if (fd < 0) {
+		perror ("mkstemp");
+		return 1;
+	}
+	close (fd);
+
+	if (load (&uncached, ""))
+		return 1;
+	count = gp_abilities_list_count (uncached);
+	printf ("%d models\n", count);
+	if (count <= 0)
+		return 1;
+
+	/* an empty file is no cache, so the first load writes it */
+	if (load (&list, cache) || compare (uncached, list, "writing the cache"))
+		return 1;
+	gp_abilities_list_free (list);
+
+	if (load (&list, cache) || compare (uncached, list, "from the cache"))
+		return 1;
+
+	/* appending to a list from the cache copies it first */
+	memset (&a, 0, sizeof (a));
+	strcpy (a.model, "Test:Appended");
+	CHECK (gp_abilities_list_append (list, a));
+	CHECK (gp_abilities_list_get_abilities (list, count, &a));
+	if ((gp_abilities_list_count (list) != count + 1) || strcmp (a.model, "Test Appended")) {
+		printf ("appending to the cached list failed\n");
+		return 1;
+	}
+	CHECK (gp_abilities_list_reset (list));
+	gp_abilities_list_free (list);
+
+	/* a cache of other camlibs is replaced */
+	f = fopen (cache, "r+b");
+	if (!f || fseek (f, 64, SEEK_SET) || (fputc ('#', f) == EOF) || fclose (f)) {
+		perror (cache);
+		return 1;
+	}
+	if (load (&list, cache) || compare (uncached, list, "from a stale cache"))
+		return 1;
+	gp_abilities_list_free (list);
+	if (load (&list, cache) || compare (uncached, list, "from the replaced cache"))
+		return 1;
+	gp_abilities_list_free (list);
+
+	gp_abilities_list_free (uncached);
+	unlink (cache);
+	return 0;
+}
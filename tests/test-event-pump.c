@@ -0,0 +1,213 @@
+/* test-event-pump.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Lets the vusb virtual camera "capture" a file and checks the event pump
+ * hands the file added and capture complete events to its callback, while
+ * the camera stays usable from the application. Once the pump is stopped
+ * the events are back with gp_camera_wait_for_event(). Dropping the camera
+ * with a running pump has to stop it.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static pthread_mutex_t	lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	cond = PTHREAD_COND_INITIALIZER;
+static pthread_t	main_thread;
+static CameraFilePath	added;
+static int		file_added, capture_complete, wrong_thread;
+
+static void
+pump_event (Camera *camera, CameraEventType type, void *data, void *user_data)
+{
+	pthread_mutex_lock (&lock);
+	if (pthread_equal (pthread_self (), main_thread))
+		wrong_thread = 1;
+	if (type == GP_EVENT_FILE_ADDED) {
+		added = *(CameraFilePath *)data;
+		file_added++;
+	}
+	/* only counts after the file */
+	if ((type == GP_EVENT_CAPTURE_COMPLETE) && file_added)
+		capture_complete++;
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&lock);
+}
+
+/* The vusb driver opcode, the camera sends the event delay ms later */
+static int
+emit_event (Camera *camera, int type, int delay, GPContext *context)
+{
+	CameraWidget *widget;
+	char opcode[32];
+
+	snprintf (opcode, sizeof(opcode), "0x9999,0x%x,0x%x", type, delay);
+	CHECK (gp_camera_get_single_config (camera, "opcode", &widget, context));
+	CHECK (gp_widget_set_value (widget, opcode));
+	CHECK (gp_camera_set_single_config (camera, "opcode", widget, context));
+	gp_widget_free (widget);
+	return 0;
+}
+
+/* Checks the added file is on the camera */
+static int
+check_added (Camera *camera, CameraFilePath *path, GPContext *context)
+{
+	CameraList *list;
+	int index;
+
+	CHECK (gp_list_new (&list));
+	CHECK (gp_camera_folder_list_files (camera, path->folder, list, context));
+	if (gp_list_find_by_name (list, &index, path->name) < GP_OK) {
+		printf ("ERROR: added file %s/%s is not listed\n", path->folder, path->name);
+		return 1;
+	}
+	gp_list_free (list);
+	return 0;
+}
+
+static int
+run_pump (Camera *camera, GPContext *context)
+{
+	CameraEventType type;
+	CameraFilePath path;
+	struct timespec end;
+	void *data;
+	int ret = 0;
+
+	main_thread = pthread_self ();
+	CHECK (gp_camera_start_event_pump (camera, pump_event, NULL, context));
+	if (gp_camera_start_event_pump (camera, pump_event, NULL, context) != GP_ERROR_CAMERA_BUSY) {
+		printf ("ERROR: started a second event pump\n");
+		return 1;
+	}
+	if (gp_camera_wait_for_event (camera, 10, &type, &data, context) != GP_ERROR_CAMERA_BUSY) {
+		printf ("ERROR: waited for an event while the pump runs\n");
+		return 1;
+	}
+
+	/* the application keeps using the camera meanwhile */
+	if (emit_event (camera, 0, 100, context) || emit_event (camera, 2, 200, context))
+		return 1;
+	clock_gettime (CLOCK_REALTIME, &end);
+	end.tv_sec += 10;
+	pthread_mutex_lock (&lock);
+	while (!capture_complete && !ret)
+		ret = pthread_cond_timedwait (&cond, &lock, &end);
+	path = added;
+	pthread_mutex_unlock (&lock);
+	if (ret == ETIMEDOUT) {
+		printf ("ERROR: %d files added, no capture complete\n", file_added);
+		return 1;
+	}
+	if ((file_added != 1) || wrong_thread) {
+		printf ("ERROR: %d files added, in the %s thread\n", file_added,
+			wrong_thread ? "application" : "pump");
+		return 1;
+	}
+	if (check_added (camera, &path, context))
+		return 1;
+	CHECK (gp_camera_stop_event_pump (camera, context));
+	return 0;
+}
+
+/* The next file without pump, polled for */
+static int
+run_poll (Camera *camera, GPContext *context)
+{
+	CameraEventType type;
+	void *data;
+	int i;
+
+	if (emit_event (camera, 0, 100, context))
+		return 1;
+	for (i = 0; i < 20; i++) {
+		CHECK (gp_camera_wait_for_event (camera, 500, &type, &data, context));
+		if (type == GP_EVENT_FILE_ADDED) {
+			i = check_added (camera, data, context);
+			free (data);
+			return i;
+		}
+		free (data);
+	}
+	printf ("ERROR: no file added after the pump stopped\n");
+	return 1;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-event-pump-XXXXXX", file[1024];
+	GPContext *context;
+	Camera *camera;
+	FILE *f;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* the virtual camera copies a JPEG of the card for new files */
+	snprintf (file, sizeof(file), "%s/a.jpg", dir);
+	f = fopen (file, "w");
+	if (!f) {
+		perror (file);
+		return 1;
+	}
+	fputs ("not a real picture\n", f);
+	fclose (f);
+	setenv ("VCAMERADIR", dir, 1);
+
+	context = gp_context_new ();
+	CHECK (gp_camera_new (&camera));
+	ret = gp_camera_init (camera, context);
+	if (ret < GP_OK)
+		printf ("ERROR: %s\n", gp_result_as_string (ret));
+	else
+		ret = run_pump (camera, context) || run_poll (camera, context);
+	/* the last reference goes with the pump still running */
+	if (!ret)
+		ret = gp_camera_start_event_pump (camera, pump_event, NULL, context) < GP_OK;
+	gp_camera_unref (camera);
+	gp_context_unref (context);
+	unlink (file);
+	rmdir (dir);
+	return ret;
+}
@@ -0,0 +1,159 @@
+/* test-file-buffer.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Downloads into caller supplied memory: CameraFiles made with
+ * gp_file_new_from_buffer() keep their data in the buffer and refuse
+ * what does not fit, gp_file_get_append_buffer() hands out the place the
+ * next gp_file_append() puts its data, which is then not copied.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <gphoto2/gphoto2-file.h>
+#include <gphoto2/gphoto2-result.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+#define EXPECT(cond) \
+	do { \
+		if (!(cond)) { \
+			printf ("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			return (1); \
+		} \
+	} while (0)
+
+/* the size and data of file are size bytes of what, in place at where */
+static int
+check_data (CameraFile *file, const char *where, const char *what, unsigned long size)
+{
+	const char *data;
+	unsigned long fsize;
+
+	CHECK (gp_file_get_data_and_size (file, &data, &fsize));
+	EXPECT (fsize == size);
+	EXPECT (!where || (data == where));
+	EXPECT (!memcmp (data, what, size));
+	return 0;
+}
+
+static int
+test_caller_buffer (void)
+{
+	static char buffer[16];
+	CameraFile *file;
+	char *append;
+
+	CHECK (gp_file_new_from_buffer (&file, buffer, sizeof(buffer)));
+	CHECK (gp_file_append (file, "0123456789", 10));
+	if (check_data (file, buffer, "0123456789", 10))
+		return 1;
+
+	/* too much for the rest of the buffer, nothing is appended */
+	EXPECT (gp_file_append (file, "abcdefghij", 10) == GP_ERROR_NO_MEMORY);
+	EXPECT (gp_file_get_append_buffer (file, 7, &append) == GP_ERROR_NO_MEMORY);
+	if (check_data (file, buffer, "0123456789", 10))
+		return 1;
+
+	/* the rest of it, filled in place */
+	CHECK (gp_file_get_append_buffer (file, 6, &append));
+	EXPECT (append == buffer + 10);
+	memcpy (append, "abcdef", 6);
+	CHECK (gp_file_append (file, append, 6));
+	if (check_data (file, buffer, "0123456789abcdef", 16))
+		return 1;
+
+	/* cleaning keeps the buffer, which stays the caller's */
+	CHECK (gp_file_clean (file));
+	CHECK (gp_file_append (file, "xyz", 3));
+	if (check_data (file, buffer, "xyz", 3))
+		return 1;
+	CHECK (gp_file_unref (file));
+	EXPECT (!memcmp (buffer, "xyz", 3));
+	return 0;
+}
+
+static int
+test_append_buffer (void)
+{
+	CameraFile *file;
+	char *append;
+	const char *data;
+	unsigned long size;
+	int i;
+
+	CHECK (gp_file_new (&file));
+	/* in pieces, as a driver receiving a download chunk by chunk */
+	for (i = 0; i < 100; i++) {
+		CHECK (gp_file_get_append_buffer (file, 1000, &append));
+		CHECK (gp_file_get_data_and_size (file, &data, &size));
+		EXPECT (size == i * 500UL);
+		EXPECT (!size || (append == data + size));
+		memset (append, i, 1000);
+		/* only a part of what was asked for */
+		CHECK (gp_file_append (file, append, 500));
+	}
+	CHECK (gp_file_get_data_and_size (file, &data, &size));
+	EXPECT (size == 100 * 500);
+	for (i = 0; i < 100; i++)
+		EXPECT ((data[i * 500] == i) && (data[i * 500 + 499] == i));
+	CHECK (gp_file_unref (file));
+	return 0;
+}
+
+static int
+test_fd_file (void)
+{
+	char path[] = "/tmp/test-file-buffer-XXXXXX";
+	CameraFile *file;
+	char *append;
+	int fd;
+
+	fd = mkstemp (path);
+	if (fd < 0) {
+		perror ("mkstemp");
+		return 1;
+	}
+	unlink (path);
+	CHECK (gp_file_new_from_fd (&file, fd));
+	EXPECT (gp_file_get_append_buffer (file, 10, &append) == GP_ERROR_NOT_SUPPORTED);
+	CHECK (gp_file_unref (file));
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	if (test_caller_buffer () || test_append_buffer () || test_fd_file ())
+		return 1;
+	return 0;
+}
@@ -22,12 +22,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
 #ifdef HAVE_MCHECK_H
 #include <mcheck.h>
 #endif
 
 #include <gphoto2/gphoto2-filesys.h>
+#include <gphoto2/gphoto2-file.h>
 #include <gphoto2/gphoto2-result.h>
 #include <gphoto2/gphoto2-port-log.h>
 
@@ -131,15 +133,207 @@ delete_file_func (CameraFilesystem __unused__ *fs, const char *folder,
 	return (GP_OK);
 }
 
+static int
+get_file_func (CameraFilesystem __unused__ *fs, const char *folder,
+	       const char *file, CameraFileType __unused__ type,
+	       CameraFile *camera_file, void __unused__ *data,
+	       GPContext __unused__ *context)
+{
+	char buf[256];
+
+	snprintf (buf, sizeof(buf), "%s/%s", folder, file);
+	return gp_file_append (camera_file, buf, strlen (buf));
+}
+
+static int
+get_files_func (CameraFilesystem *fs, int count, const char *folders[],
+		const char *files[], CameraFileType type,
+		CameraFileBatchOpenFunc open_func,
+		CameraFileBatchDoneFunc done_func, void *batchdata,
+		void *data, GPContext *context)
+{
+	int i;
+
+	printf ("### -> The camera will download %i files in one go here.\n", count);
+	for (i = 0; i < count; i++) {
+		CameraFile *file;
+
+		CHECK (open_func (folders[i], files[i], type, &file, batchdata));
+		CHECK (done_func (folders[i], files[i], type, file,
+			get_file_func (fs, folders[i], files[i], type, file, data, context),
+			batchdata));
+	}
+	return (GP_OK);
+}
+
 static CameraFilesystemFuncs fsfuncs = {
 	.get_info_func = get_info_func,
 	.set_info_func = set_info_func,
 	.del_file_func = delete_file_func,
 	.file_list_func = file_list_func,
 	.folder_list_func = folder_list_func,
+	.get_file_func = get_file_func,
+};
+
+static int batch_ok, batch_failed;
+
+static int
+batch_done_func (const char *folder, const char *filename,
+		 CameraFileType __unused__ type, CameraFile *file, int result,
+		 void __unused__ *data)
+{
+	const char *content, *name;
+	unsigned long size;
+	char buf[256];
+
+	if (result < GP_OK) {
+		printf (" %s/%s: %s\n", folder, filename, gp_result_as_string (result));
+		batch_failed++;
+		return (GP_OK);
+	}
+	snprintf (buf, sizeof(buf), "%s/%s", folder, filename);
+	CHECK (gp_file_get_data_and_size (file, &content, &size));
+	CHECK (gp_file_get_name (file, &name));
+	if ((size != strlen (buf)) || memcmp (content, buf, size) || strcmp (name, filename)) {
+		printf (" %s/%s: wrong file\n", folder, filename);
+		return (GP_ERROR);
+	}
+	batch_ok++;
+	return (GP_OK);
+}
+
+/* downloads file1, file2 and a missing file from /whatever */
+static int
+batch_get (CameraFilesystem *fs, GPContext *context)
+{
+	const char *folders[] = { "/whatever", "/whatever", "/whatever" };
+	const char *files[] = { "file1", "file2", "nofile" };
+
+	batch_ok = batch_failed = 0;
+	CHECK (gp_filesystem_get_files (fs, 3, folders, files,
+		GP_FILE_TYPE_NORMAL, NULL, batch_done_func, NULL, context));
+	if ((batch_ok != 2) || (batch_failed != 1)) {
+		printf ("Batch download got %d files, %d failed\n", batch_ok, batch_failed);
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * Batch downloads, once file by file through the get_file_func and
+ * once handed to the get_files_func of the camera driver.
+ */
+static int
+batch (void)
+{
+	CameraFilesystem *fs;
+	GPContext *context;
+
+	context = gp_context_new ();
+	CHECK (gp_filesystem_new (&fs));
+
+	printf ("*** Downloading files one by one in a batch...\n");
+	CHECK (gp_filesystem_set_funcs (fs, &fsfuncs, NULL));
+	if (batch_get (fs, context))
+		return (1);
+
+	printf ("*** Downloading files with the batch function...\n");
+	fsfuncs.get_files_func = get_files_func;
+	CHECK (gp_filesystem_set_funcs (fs, &fsfuncs, NULL));
+	if (batch_get (fs, context))
+		return (1);
+
+	CHECK (gp_filesystem_free (fs));
+	gp_context_unref (context);
+	return (0);
+}
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int
+bench_get_info_func (CameraFilesystem __unused__ *fs, const char __unused__ *folder,
+		     const char __unused__ *file, CameraFileInfo *info,
+		     void __unused__ *data, GPContext __unused__ *context)
+{
+	info->preview.fields = GP_FILE_INFO_NONE;
+	info->file.fields    = GP_FILE_INFO_SIZE;
+	info->file.size      = 1;
+	return (GP_OK);
+}
+
+static CameraFilesystemFuncs benchfuncs = {
+	.get_info_func = bench_get_info_func,
 };
+
+/*
+ * Populates a single folder with n files and times the lookups by name
+ * and by number, as done by camera drivers and frontends for each file.
+ */
+static int
+bench (int n)
+{
+	CameraFilesystem *fs;
+	CameraFileInfo info;
+	GPContext *context;
+	const char *name;
+	char filename[32];
+	const char *folder = "/DCIM";
+	double start;
+	int i;
+
+	context = gp_context_new ();
+	CHECK (gp_filesystem_new (&fs));
+	CHECK (gp_filesystem_set_funcs (fs, &benchfuncs, NULL));
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		snprintf (filename, sizeof(filename), "IMG_%06d.JPG", i);
+		CHECK (gp_filesystem_append (fs, folder, filename, context));
+	}
+	printf ("append:   %d files in %.3f s\n", n, now () - start);
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		snprintf (filename, sizeof(filename), "IMG_%06d.JPG", (int)(i * 7919L % n));
+		CHECK (gp_filesystem_get_info (fs, folder, filename, &info, context));
+	}
+	printf ("get_info: %d lookups in %.3f s\n", n, now () - start);
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		snprintf (filename, sizeof(filename), "IMG_%06d.JPG", (int)(i * 7919L % n));
+		if (gp_filesystem_number (fs, folder, filename, context) != (int)(i * 7919L % n)) {
+			printf ("Wrong number for %s\n", filename);
+			return (1);
+		}
+	}
+	printf ("number:   %d lookups in %.3f s\n", n, now () - start);
+
+	start = now ();
+	for (i = 0; i < n; i++) {
+		CHECK (gp_filesystem_name (fs, folder, i, &name, context));
+		snprintf (filename, sizeof(filename), "IMG_%06d.JPG", i);
+		if (strcmp (name, filename)) {
+			printf ("Wrong name for number %d: %s\n", i, name);
+			return (1);
+		}
+	}
+	printf ("name:     %d lookups in %.3f s\n", n, now () - start);
+
+	CHECK (gp_filesystem_free (fs));
+	gp_context_unref (context);
+	return (0);
+}
+
 int
-main ()
+main (int argc, char *argv[])
 {
 	CameraFilesystem *fs;
 	CameraFileInfo info;
@@ -150,6 +344,11 @@ main ()
 	GPContext *context;
 	int logid;
 
+	if ((argc > 1) && !strcmp (argv[1], "bench"))
+		return bench ((argc > 2) ? atoi (argv[2]) : 100000);
+	if ((argc > 1) && !strcmp (argv[1], "batch"))
+		return batch ();
+
 #ifdef HAVE_MCHECK_H
 	mtrace();
 #endif
@@ -0,0 +1,195 @@
+/* test-lazy-config.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Builds the configuration tree of the vusb virtual camera without and
+ * with the ptp2 lazyconfig setting, and checks that both show the same
+ * widgets, names, values and choices. The virtual camera poses as a Nikon
+ * D7100, whose config tables have entries of different names for the same
+ * property code, with one the camera does not match.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-setting.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static int lazy;
+
+static int
+lazy_setting (char *id, char *key, char *value, void *data)
+{
+	if (!lazy || strcmp (id, "ptp2") || strcmp (key, "lazyconfig"))
+		return GP_ERROR;
+	strcpy (value, "on");
+	return GP_OK;
+}
+
+/* Appends what an application would show of the tree, fails on widgets
+ * which cannot be loaded */
+static int
+describe_tree (CameraWidget *widget, char **desc, size_t *len)
+{
+	CameraWidgetType type;
+	const char *name, *label, *choice;
+	char buf[1024], *str;
+	float f, min, max, inc;
+	int i, ro, val;
+
+	gp_widget_get_name (widget, &name);
+	gp_widget_get_label (widget, &label);
+	if (gp_widget_get_type (widget, &type) < GP_OK) {
+		printf ("ERROR: widget '%s' cannot be loaded\n", name);
+		return 1;
+	}
+	gp_widget_get_readonly (widget, &ro);
+	snprintf (buf, sizeof(buf), "%s|%s|%d|%d|", name, label, type, ro);
+	switch (type) {
+	case GP_WIDGET_TEXT:
+	case GP_WIDGET_RADIO:
+	case GP_WIDGET_MENU:
+		gp_widget_get_value (widget, &str);
+		strncat (buf, str ? str : "(null)", sizeof(buf) - strlen (buf) - 1);
+		if (type == GP_WIDGET_TEXT)
+			break;
+		for (i = 0; i < gp_widget_count_choices (widget); i++) {
+			gp_widget_get_choice (widget, i, &choice);
+			strncat (buf, ",", sizeof(buf) - strlen (buf) - 1);
+			strncat (buf, choice, sizeof(buf) - strlen (buf) - 1);
+		}
+		break;
+	case GP_WIDGET_RANGE:
+		gp_widget_get_value (widget, &f);
+		gp_widget_get_range (widget, &min, &max, &inc);
+		snprintf (buf + strlen (buf), sizeof(buf) - strlen (buf), "%g %g %g %g", f, min, max, inc);
+		break;
+	case GP_WIDGET_TOGGLE:
+		gp_widget_get_value (widget, &val);
+		snprintf (buf + strlen (buf), sizeof(buf) - strlen (buf), "%d", val);
+		break;
+	default:
+		/* the date changes from one tree to the next */
+		break;
+	}
+	strncat (buf, "\n", sizeof(buf) - strlen (buf) - 1);
+	*desc = realloc (*desc, *len + strlen (buf) + 1);
+	strcpy (*desc + *len, buf);
+	*len += strlen (buf);
+
+	for (i = 0; i < gp_widget_count_children (widget); i++) {
+		CameraWidget *child;
+
+		gp_widget_get_child (widget, i, &child);
+		if (describe_tree (child, desc, len))
+			return 1;
+	}
+	return 0;
+}
+
+static int
+config_tree (char **desc, GPContext *context)
+{
+	CameraAbilitiesList *al;
+	CameraAbilities a;
+	GPPortInfoList *il;
+	GPPortInfo info;
+	Camera *camera;
+	CameraWidget *window;
+	size_t len = 0;
+	int ret;
+
+	CHECK (gp_abilities_list_new (&al));
+	CHECK (gp_abilities_list_load (al, context));
+	CHECK (ret = gp_abilities_list_lookup_model (al, "Nikon DSC D7100"));
+	CHECK (gp_abilities_list_get_abilities (al, ret, &a));
+	gp_abilities_list_free (al);
+	/* the virtual camera has the USB ids of another model, but is found
+	 * as a PTP class device */
+	a.usb_class = 6;
+	a.usb_subclass = 1;
+	a.usb_protocol = 1;
+
+	CHECK (gp_port_info_list_new (&il));
+	CHECK (gp_port_info_list_load (il));
+	CHECK (ret = gp_port_info_list_lookup_path (il, "usb:001,001"));
+	CHECK (gp_port_info_list_get_info (il, ret, &info));
+
+	CHECK (gp_camera_new (&camera));
+	CHECK (gp_camera_set_abilities (camera, a));
+	CHECK (gp_camera_set_port_info (camera, info));
+	gp_port_info_list_free (il);
+	CHECK (gp_camera_init (camera, context));
+	CHECK (gp_camera_get_config (camera, &window, context));
+	ret = describe_tree (window, desc, &len);
+	gp_widget_free (window);
+	gp_camera_exit (camera, context);
+	gp_camera_unref (camera);
+	return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-lazy-config-XXXXXX";
+	char *eager = NULL, *lazytree = NULL;
+	GPContext *context;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* an empty card */
+	setenv ("VCAMERADIR", dir, 1);
+
+	context = gp_context_new ();
+	gp_setting_set_get_func (lazy_setting, NULL);
+	ret = config_tree (&eager, context);
+	lazy = 1;
+	if (!ret)
+		ret = config_tree (&lazytree, context);
+	gp_setting_set_get_func (NULL, NULL);
+	gp_context_unref (context);
+	rmdir (dir);
+
+	if (!ret && strcmp (eager, lazytree)) {
+		printf ("ERROR: lazy tree differs from the eager one\n--- eager\n%s--- lazy\n%s",
+			eager, lazytree);
+		ret = 1;
+	}
+	free (eager);
+	free (lazytree);
+	return ret;
+}
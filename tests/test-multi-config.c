@@ -0,0 +1,186 @@
+/* test-multi-config.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Sets exposure presets on the vusb virtual camera with
+ * gp_camera_set_multi_config() and one setting at a time, and checks the
+ * camera ends up the same way. A preset with a name that does not exist
+ * or a read-only setting must fail before anything is set.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static const char *names[] = { "f-number", "shutterspeed", "exposurecompensation" };
+#define NR_NAMES (sizeof(names)/sizeof(names[0]))
+
+/* The values of all names, as one string */
+static int
+current (Camera *camera, char *values, size_t size, GPContext *context)
+{
+	CameraWidget *widget;
+	unsigned int i;
+	char *value;
+
+	values[0] = '\0';
+	for (i = 0; i < NR_NAMES; i++) {
+		CHECK (gp_camera_get_single_config (camera, names[i], &widget, context));
+		CHECK (gp_widget_get_value (widget, &value));
+		snprintf (values + strlen (values), size - strlen (values), "%s=%s ", names[i], value);
+		gp_widget_free (widget);
+	}
+	return 0;
+}
+
+static int
+set_one_by_one (Camera *camera, CameraList *preset, GPContext *context)
+{
+	CameraWidget *widget;
+	const char *name, *value;
+	int i;
+
+	for (i = 0; i < gp_list_count (preset); i++) {
+		gp_list_get_name (preset, i, &name);
+		gp_list_get_value (preset, i, &value);
+		CHECK (gp_camera_get_single_config (camera, name, &widget, context));
+		CHECK (gp_widget_set_value (widget, value));
+		CHECK (gp_camera_set_single_config (camera, name, widget, context));
+		gp_widget_free (widget);
+	}
+	return 0;
+}
+
+static int
+run (Camera *camera, GPContext *context)
+{
+	CameraList *presets[2], *bad;
+	CameraWidget *widget;
+	const char *value;
+	char single[2][1024], multi[1024], before[1024];
+	unsigned int i, j;
+
+	/* the first two choices of each setting make up the presets */
+	for (i = 0; i < 2; i++)
+		CHECK (gp_list_new (&presets[i]));
+	for (j = 0; j < NR_NAMES; j++) {
+		CHECK (gp_camera_get_single_config (camera, names[j], &widget, context));
+		for (i = 0; i < 2; i++) {
+			CHECK (gp_widget_get_choice (widget, i, &value));
+			gp_list_append (presets[i], names[j], value);
+		}
+		gp_widget_free (widget);
+	}
+
+	for (i = 0; i < 2; i++)
+		if (	set_one_by_one (camera, presets[i], context) ||
+			current (camera, single[i], sizeof(single[i]), context))
+			return 1;
+	if (!strcmp (single[0], single[1])) {
+		printf ("ERROR: both presets give %s\n", single[0]);
+		return 1;
+	}
+	for (i = 0; i < 2; i++) {
+		CHECK (gp_camera_set_multi_config (camera, presets[i], context));
+		if (current (camera, multi, sizeof(multi), context))
+			return 1;
+		if (strcmp (multi, single[i])) {
+			printf ("ERROR: preset %u set at once gives %s, one by one %s\n", i, multi, single[i]);
+			return 1;
+		}
+	}
+
+	/* the camera is at preset 1, preset 0 with a mistake must not change it */
+	CHECK (gp_list_new (&bad));
+	for (j = 0; j < 3; j++) {
+		gp_list_reset (bad);
+		for (i = 0; i < NR_NAMES; i++) {
+			const char *name;
+
+			gp_list_get_name (presets[0], i, &name);
+			gp_list_get_value (presets[0], i, &value);
+			gp_list_append (bad, name, value);
+		}
+		if (j == 0)
+			gp_list_append (bad, "nosuchsetting", "1");
+		else if (j == 1)
+			gp_list_append (bad, "batterylevel", "10");
+		else
+			gp_list_append (bad, "datetime", "yesterday");
+		if (gp_camera_set_multi_config (camera, bad, context) >= GP_OK) {
+			printf ("ERROR: preset %u with a mistake was set\n", j);
+			return 1;
+		}
+		if (current (camera, before, sizeof(before), context))
+			return 1;
+		if (strcmp (before, single[1])) {
+			printf ("ERROR: preset %u with a mistake left %s behind\n", j, before);
+			return 1;
+		}
+	}
+	gp_list_free (bad);
+	for (i = 0; i < 2; i++)
+		gp_list_free (presets[i]);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-multi-config-XXXXXX";
+	GPContext *context;
+	Camera *camera;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* an empty card */
+	setenv ("VCAMERADIR", dir, 1);
+
+	context = gp_context_new ();
+	CHECK (gp_camera_new (&camera));
+	ret = gp_camera_init (camera, context);
+	if (ret < GP_OK)
+		printf ("ERROR: %s\n", gp_result_as_string (ret));
+	else
+		ret = run (camera, context);
+	gp_camera_exit (camera, context);
+	gp_camera_unref (camera);
+	gp_context_unref (context);
+	rmdir (dir);
+	return ret ? 1 : 0;
+}
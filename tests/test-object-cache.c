@@ -0,0 +1,226 @@
+/* test-object-cache.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Checks when the ptp2 objectcache setting takes the object cache of the
+ * last session over: files put on the card of the vusb virtual camera
+ * behind its back only show up once the saved cache is rejected, because
+ * the serial number or the storage it was saved for differs.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-setting.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static char card[] = "/tmp/test-object-cache-XXXXXX";
+static char config[] = "/tmp/test-object-cache-config-XXXXXX";
+
+static int
+objectcache_setting (char *id, char *key, char *value, void *data)
+{
+	if (strcmp (id, "ptp2") || strcmp (key, "objectcache"))
+		return GP_ERROR;
+	strcpy (value, "on");
+	return GP_OK;
+}
+
+static int
+add_file (const char *name)
+{
+	char path[1024];
+	FILE *f;
+
+	snprintf (path, sizeof(path), "%s/%s", card, name);
+	f = fopen (path, "w");
+	if (!f) {
+		perror (path);
+		return 1;
+	}
+	fputs ("not a real picture\n", f);
+	fclose (f);
+	return 0;
+}
+
+/* Lists the card in a new session and compares the names with expected */
+static int
+session (const char *expected, GPContext *context)
+{
+	Camera *camera;
+	CameraList *list;
+	const char *name;
+	char names[1024] = "";
+	int i;
+
+	CHECK (gp_camera_new (&camera));
+	CHECK (gp_camera_init (camera, context));
+	CHECK (gp_list_new (&list));
+	CHECK (gp_camera_folder_list_files (camera, "/store_00010001", list, context));
+	gp_list_sort (list);
+	for (i = 0; i < gp_list_count (list); i++) {
+		gp_list_get_name (list, i, &name);
+		strncat (names, name, sizeof(names) - strlen (names) - 2);
+		strcat (names, " ");
+	}
+	gp_list_free (list);
+	/* writes the cache back */
+	CHECK (gp_camera_exit (camera, context));
+	gp_camera_unref (camera);
+
+	if (strcmp (names, expected)) {
+		printf ("ERROR: listed '%s', expected '%s'\n", names, expected);
+		return 1;
+	}
+	return 0;
+}
+
+/* Replaces line number line of the camera state saved with the cache */
+static int
+change_saved_state (int line, const char *from, const char *to)
+{
+	char dir[1024], path[2048], key[4096], *s;
+	struct dirent *de;
+	uint32_t len;
+	FILE *f;
+	DIR *d;
+	int i;
+
+	CHECK (gp_setting_get_dir (dir, sizeof(dir)));
+	d = opendir (dir);
+	if (!d) {
+		perror (dir);
+		return 1;
+	}
+	path[0] = '\0';
+	while ((de = readdir (d)))
+		if (!strncmp (de->d_name, "ptp2-objects-", 13))
+			snprintf (path, sizeof(path), "%s/%s", dir, de->d_name);
+	closedir (d);
+	if (!path[0]) {
+		printf ("ERROR: no object cache saved in '%s'\n", dir);
+		return 1;
+	}
+
+	/* magic, version and byte order, then the state as a counted string */
+	f = fopen (path, "r+b");
+	if (!f || fseek (f, 16, SEEK_SET) || (fread (&len, 4, 1, f) != 1) ||
+	    (len >= sizeof(key)) || (fread (key, len, 1, f) != 1)) {
+		printf ("ERROR: cannot read object cache '%s'\n", path);
+		return 1;
+	}
+	key[len] = '\0';
+	for (s = key, i = 0; s && (i < line); i++)
+		if ((s = strchr (s, '\n')))
+			s++;
+	if (!s || !(s = strstr (s, from)) || (strlen (from) != strlen (to))) {
+		printf ("ERROR: '%s' not in line %d of '%s'\n", from, line, key);
+		return 1;
+	}
+	memcpy (s, to, strlen (to));
+	fseek (f, 20, SEEK_SET);
+	fwrite (key, len, 1, f);
+	fclose (f);
+	return 0;
+}
+
+static void
+remove_dir (const char *path)
+{
+	struct dirent *de;
+	char sub[2048];
+	DIR *d;
+
+	d = opendir (path);
+	if (!d)
+		return;
+	while ((de = readdir (d))) {
+		if (!strcmp (de->d_name, ".") || !strcmp (de->d_name, ".."))
+			continue;
+		snprintf (sub, sizeof(sub), "%s/%s", path, de->d_name);
+		if (unlink (sub))
+			remove_dir (sub);
+	}
+	closedir (d);
+	rmdir (path);
+}
+
+static int
+run (GPContext *context)
+{
+	if (add_file ("a.txt") || session ("a.txt ", context))
+		return 1;
+
+	/* the card nobody touched, as far as the camera tells */
+	if (add_file ("b.txt") || session ("a.txt ", context))
+		return 1;
+
+	/* free space changed */
+	if (change_saved_state (3, "555819297", "555819296") ||
+	    session ("a.txt b.txt ", context))
+		return 1;
+
+	/* another body */
+	if (add_file ("c.txt") || session ("a.txt b.txt ", context))
+		return 1;
+	if (change_saved_state (1, "1", "2") ||
+	    session ("a.txt b.txt c.txt ", context))
+		return 1;
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPContext *context;
+	int ret;
+
+	if (!mkdtemp (card) || !mkdtemp (config)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	setenv ("VCAMERADIR", card, 1);
+	/* the cache goes to the settings directory */
+	setenv ("XDG_CONFIG_HOME", config, 1);
+
+	context = gp_context_new ();
+	gp_setting_set_get_func (objectcache_setting, NULL);
+	ret = run (context);
+	gp_setting_set_get_func (NULL, NULL);
+	gp_context_unref (context);
+	remove_dir (card);
+	remove_dir (config);
+	return ret;
+}
@@ -0,0 +1,221 @@
+/* test-port-trace.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Traces the port transactions of a session with the vusb virtual camera
+ * and checks the trace file: the port is opened first, the PTP commands
+ * written are complete containers, and a small ring keeps just the last
+ * transactions, with their data cut to the prefix size. Nothing is traced
+ * after the trace stopped.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-port-trace.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static char trace[] = "/tmp/test-port-trace-XXXXXX";
+static char *data;
+static long size;
+
+/* Reads the trace file into data */
+static int
+read_trace (void)
+{
+	FILE *f;
+
+	free (data);
+	data = NULL;
+	f = fopen (trace, "rb");
+	if (!f || fseek (f, 0, SEEK_END) || ((size = ftell (f)) < (long)sizeof(GPPortTraceHeader))) {
+		printf ("ERROR: no trace in '%s'\n", trace);
+		return 1;
+	}
+	rewind (f);
+	data = malloc (size);
+	if (!data || (fread (data, size, 1, f) != 1)) {
+		printf ("ERROR: cannot read trace '%s'\n", trace);
+		return 1;
+	}
+	fclose (f);
+	return 0;
+}
+
+static GPPortTraceRecord *
+record (uint64_t index)
+{
+	GPPortTraceHeader *t = (GPPortTraceHeader *)data;
+
+	return (GPPortTraceRecord *)(data + t->header_size + (index % t->records) * t->record_size);
+}
+
+/* Checks the header, and that the last records of the ring are filled in */
+static int
+check_trace (unsigned int records, unsigned int prefix)
+{
+	GPPortTraceHeader *t = (GPPortTraceHeader *)data;
+	GPPortTraceRecord *r;
+	uint64_t i;
+
+	if (	memcmp (t->magic, GP_PORT_TRACE_MAGIC, sizeof(t->magic)) ||
+		(t->version != GP_PORT_TRACE_VERSION) || (t->byteorder != GP_PORT_TRACE_BYTEORDER) ||
+		(t->records != records) || (t->prefix != prefix) ||
+		(size < (long)(t->header_size + (uint64_t)t->records * t->record_size))) {
+		printf ("ERROR: bad trace header\n");
+		return 1;
+	}
+	if (!t->next) {
+		printf ("ERROR: nothing traced\n");
+		return 1;
+	}
+	for (i = (t->next > records) ? t->next - records : 0; i < t->next; i++) {
+		r = record (i);
+		if (	(r->seq != i + 1) || !r->op || (r->op > GP_PORT_TRACE_MSG_CLASS_READ) ||
+			(r->len > prefix) || (r->time < t->start_time)) {
+			printf ("ERROR: bad record %lu\n", (unsigned long)i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+session (GPContext *context)
+{
+	CameraList *list;
+	Camera *camera;
+
+	CHECK (gp_camera_new (&camera));
+	CHECK (gp_camera_init (camera, context));
+	CHECK (gp_list_new (&list));
+	CHECK (gp_camera_folder_list_folders (camera, "/", list, context));
+	gp_list_free (list);
+	CHECK (gp_camera_exit (camera, context));
+	gp_camera_unref (camera);
+	return 0;
+}
+
+static int
+run (GPContext *context)
+{
+	GPPortTraceHeader *t;
+	GPPortTraceRecord *r;
+	const unsigned char *d;
+	uint64_t i, next;
+	int opened = 0, writes = 0;
+
+	/* all of a session */
+	CHECK (gp_port_trace_start (trace, 4096, 64));
+	if (session (context))
+		return 1;
+	CHECK (gp_port_trace_stop ());
+	if (read_trace () || check_trace (4096, 64))
+		return 1;
+	t = (GPPortTraceHeader *)data;
+	for (i = 0; i < t->next; i++) {
+		r = record (i);
+		d = (const unsigned char *)(r + 1);
+		if (r->op == GP_PORT_TRACE_OPEN)
+			opened = !strncmp ((char *)d, "usb:", 4);
+		if (!opened && (r->op != GP_PORT_TRACE_CLOSE)) {
+			printf ("ERROR: record %lu comes before opening the port\n", (unsigned long)i);
+			return 1;
+		}
+		if ((r->op != GP_PORT_TRACE_WRITE) || (r->len < 6) || (d[4] != 1))
+			continue;
+		/* a command container, as long as written */
+		writes++;
+		if (	(r->result != r->size) ||
+			(d[0] | d[1] << 8 | d[2] << 16 | (unsigned int)d[3] << 24) != (unsigned int)r->size) {
+			printf ("ERROR: record %lu is no command of %d bytes\n", (unsigned long)i, r->size);
+			return 1;
+		}
+	}
+	if (!writes) {
+		printf ("ERROR: no commands traced\n");
+		return 1;
+	}
+
+	/* the ring comes around */
+	CHECK (gp_port_trace_start (trace, 8, 4));
+	if (session (context))
+		return 1;
+	CHECK (gp_port_trace_stop ());
+	if (read_trace () || check_trace (8, 4))
+		return 1;
+	t = (GPPortTraceHeader *)data;
+	if (t->next <= 8) {
+		printf ("ERROR: only %lu records traced\n", (unsigned long)t->next);
+		return 1;
+	}
+
+	/* stopped */
+	next = t->next;
+	if (session (context) || read_trace ())
+		return 1;
+	t = (GPPortTraceHeader *)data;
+	if (t->next != next) {
+		printf ("ERROR: traced after the trace stopped\n");
+		return 1;
+	}
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-port-trace-card-XXXXXX";
+	GPContext *context;
+	int fd, ret;
+
+	fd = mkstemp (trace);
+	if ((fd < 0) || !mkdtemp (dir)) {
+		perror ("mkstemp");
+		return 1;
+	}
+	close (fd);
+	/* an empty card */
+	setenv ("VCAMERADIR", dir, 1);
+	unsetenv ("GP_PORT_TRACE");
+
+	context = gp_context_new ();
+	ret = run (context);
+	gp_context_unref (context);
+	free (data);
+	unlink (trace);
+	rmdir (dir);
+	return ret;
+}
@@ -0,0 +1,291 @@
+/* test-preview-image.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Decodes live view frames of the vusb virtual camera with
+ * gp_camera_get_preview_image() and compares them with the frame decoded
+ * here at full size: the same pixels at scale 1, close to the average of
+ * each block of pixels when scaled down. Too small buffers and frames
+ * which are no JPEG must give an error. Without libjpeg the call is
+ * expected to give GP_ERROR_NOT_SUPPORTED.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#include <gphoto2/gphoto2-camera.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+#define WIDTH	1280
+#define HEIGHT	720
+
+static char dir[] = "/tmp/test-preview-image-XXXXXX";
+
+#ifdef HAVE_LIBJPEG
+static char frame[1024];
+static unsigned char *full;
+
+/* Writes a 4:2:0 frame with gradients and squares to the frame file */
+static int
+write_frame (void)
+{
+	struct jpeg_compress_struct	cinfo;
+	struct jpeg_error_mgr		jerr;
+	unsigned char			row[WIDTH * 3], *rowp = row;
+	int				x, y;
+	FILE				*f;
+
+	f = fopen (frame, "wb");
+	if (!f) {
+		perror (frame);
+		return 1;
+	}
+	cinfo.err = jpeg_std_error (&jerr);
+	jpeg_create_compress (&cinfo);
+	jpeg_stdio_dest (&cinfo, f);
+	cinfo.image_width = WIDTH;
+	cinfo.image_height = HEIGHT;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults (&cinfo);
+	jpeg_set_quality (&cinfo, 85, TRUE);
+	jpeg_start_compress (&cinfo, TRUE);
+	for (y = 0; y < HEIGHT; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			row[3*x]   = x * 255 / WIDTH;
+			row[3*x+1] = y * 255 / HEIGHT;
+			row[3*x+2] = ((x / 16) ^ (y / 16)) & 1 ? 200 : 50;
+		}
+		jpeg_write_scanlines (&cinfo, &rowp, 1);
+	}
+	jpeg_finish_compress (&cinfo);
+	jpeg_destroy_compress (&cinfo);
+	fclose (f);
+	return 0;
+}
+
+/* Decodes the frame file at full size into full */
+static int
+read_frame (void)
+{
+	struct jpeg_decompress_struct	cinfo;
+	struct jpeg_error_mgr		jerr;
+	JSAMPROW			row;
+	FILE				*f;
+
+	f = fopen (frame, "rb");
+	if (!f) {
+		perror (frame);
+		return 1;
+	}
+	cinfo.err = jpeg_std_error (&jerr);
+	jpeg_create_decompress (&cinfo);
+	jpeg_stdio_src (&cinfo, f);
+	jpeg_read_header (&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+	jpeg_start_decompress (&cinfo);
+	while (cinfo.output_scanline < cinfo.output_height) {
+		row = full + cinfo.output_scanline * WIDTH * 3;
+		jpeg_read_scanlines (&cinfo, &row, 1);
+	}
+	jpeg_finish_decompress (&cinfo);
+	jpeg_destroy_decompress (&cinfo);
+	fclose (f);
+	return 0;
+}
+
+/* Component c of the full frame averaged over the scale x scale block at x, y */
+static int
+block (unsigned int scale, unsigned int x, unsigned int y, unsigned int c)
+{
+	unsigned int i, j, sum = 0;
+
+	for (j = 0; j < scale; j++)
+		for (i = 0; i < scale; i++)
+			sum += full[((y * scale + j) * WIDTH + x * scale + i) * 3 + c];
+	return sum / (scale * scale);
+}
+
+static int
+check_scaled (const char *name, const unsigned char *buffer, unsigned int scale, int yuv)
+{
+	unsigned int x, y, c, w = WIDTH / scale, h = HEIGHT / scale;
+	unsigned long diff = 0, n = 0;
+	int expected;
+
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++) {
+			if (yuv) {
+				expected = (299 * block (scale, x, y, 0) + 587 * block (scale, x, y, 1) +
+					    114 * block (scale, x, y, 2)) / 1000;
+				diff += abs (buffer[y * w + x] - expected);
+				n++;
+				continue;
+			}
+			for (c = 0; c < 3; c++) {
+				diff += abs (buffer[(y * w + x) * 3 + c] - block (scale, x, y, c));
+				n++;
+			}
+		}
+	/* the DCT domain scaling is no box filter and the chroma is
+	 * upsampled differently, but it is close */
+	if (diff > 8 * n) {
+		printf ("ERROR: %s frame differs by %.1f per sample from the full frame\n",
+			name, (double)diff / n);
+		return 1;
+	}
+	return 0;
+}
+
+static int
+get_image (Camera *camera, CameraPreviewFormat format, unsigned int scale,
+	   unsigned char *buffer, unsigned long size, GPContext *context)
+{
+	unsigned int width, height;
+
+	CHECK (gp_camera_get_preview_image (camera, format, scale, buffer, size,
+					    &width, &height, context));
+	if ((width != WIDTH / scale) || (height != HEIGHT / scale)) {
+		printf ("ERROR: frame of %ux%u at scale %u\n", width, height, scale);
+		return 1;
+	}
+	return 0;
+}
+
+static int
+run (Camera *camera, GPContext *context)
+{
+	static unsigned char buffer[WIDTH * HEIGHT * 3];
+	unsigned int width = 0, height = 0;
+
+	if (get_image (camera, GP_PREVIEW_FORMAT_RGB24, 1, buffer, sizeof(buffer), context))
+		return 1;
+	if (memcmp (buffer, full, sizeof(buffer))) {
+		printf ("ERROR: rgb24 frame at scale 1 differs from the full frame\n");
+		return 1;
+	}
+	if (	get_image (camera, GP_PREVIEW_FORMAT_RGB24, 4, buffer, sizeof(buffer), context) ||
+		check_scaled ("rgb24/4", buffer, 4, 0))
+		return 1;
+	if (	get_image (camera, GP_PREVIEW_FORMAT_YUV420P, 4, buffer, sizeof(buffer), context) ||
+		check_scaled ("yuv420p/4", buffer, 4, 1))
+		return 1;
+
+	if (gp_camera_get_preview_image (camera, GP_PREVIEW_FORMAT_RGB24, 2, buffer,
+			WIDTH / 2 * HEIGHT / 2 * 3 - 1, &width, &height, context) != GP_ERROR_FIXED_LIMIT_EXCEEDED) {
+		printf ("ERROR: decoded into a too small buffer\n");
+		return 1;
+	}
+	if ((width != WIDTH / 2) || (height != HEIGHT / 2)) {
+		printf ("ERROR: too small buffer for a frame of %ux%u\n", width, height);
+		return 1;
+	}
+	return 0;
+}
+#endif /* HAVE_LIBJPEG */
+
+/* One camera session with a preview stream, expect what decoding gives */
+static int
+session (int expected, GPContext *context)
+{
+	static unsigned char buffer[WIDTH * HEIGHT * 3];
+	unsigned int width, height;
+	Camera *camera;
+	int ret;
+
+	CHECK (gp_camera_new (&camera));
+	ret = gp_camera_init (camera, context);
+	if (ret == GP_OK)
+		ret = gp_camera_start_preview_stream (camera, 2, context);
+	if (ret < GP_OK) {
+		printf ("ERROR: %s\n", gp_result_as_string (ret));
+		ret = 1;
+#ifdef HAVE_LIBJPEG
+	} else if (expected == GP_OK) {
+		ret = run (camera, context);
+#endif
+	} else {
+		ret = gp_camera_get_preview_image (camera, GP_PREVIEW_FORMAT_RGB24, 1, buffer,
+						   sizeof(buffer), &width, &height, context);
+		if (ret != expected) {
+			printf ("ERROR: decoding gave '%s', not '%s'\n",
+				gp_result_as_string (ret), gp_result_as_string (expected));
+			ret = 1;
+		} else
+			ret = 0;
+	}
+	gp_camera_exit (camera, context);
+	gp_camera_unref (camera);
+	return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPContext *context;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* the card, the frame is kept there too */
+	setenv ("VCAMERADIR", dir, 1);
+	context = gp_context_new ();
+
+#ifdef HAVE_LIBJPEG
+	snprintf (frame, sizeof(frame), "%s/frame.jpg", dir);
+	full = malloc (WIDTH * HEIGHT * 3);
+	if (!full || write_frame () || read_frame ())
+		return 1;
+	setenv ("VCAMERA_LIVEVIEW", frame, 1);
+	ret = session (GP_OK, context);
+
+	/* the frame vusb makes up is framed like a JPEG, but none */
+	unsetenv ("VCAMERA_LIVEVIEW");
+	if (!ret)
+		ret = session (GP_ERROR_CORRUPTED_DATA, context);
+	unlink (frame);
+	free (full);
+#else
+	ret = session (GP_ERROR_NOT_SUPPORTED, context);
+#endif
+
+	gp_context_unref (context);
+	rmdir (dir);
+	return ret;
+}
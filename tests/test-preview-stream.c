@@ -0,0 +1,153 @@
+/* test-preview-stream.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Reads live view frames of the vusb virtual camera from a preview
+ * stream and checks they are the JPEG frames gp_camera_capture_preview()
+ * gives, that the frame files go round the ring, and that live view
+ * still works the old way once the stream is stopped.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+#define RING	3
+
+/* Compares a frame with the one read with capture_preview */
+static int
+check_frame (CameraFile *file, const char *expected, unsigned long expected_size)
+{
+	const char *data;
+	unsigned long size;
+
+	CHECK (gp_file_get_data_and_size (file, &data, &size));
+	if (	(size < 4) ||
+		((unsigned char)data[0] != 0xff) || ((unsigned char)data[1] != 0xd8) ||
+		((unsigned char)data[size - 2] != 0xff) || ((unsigned char)data[size - 1] != 0xd9)) {
+		printf ("ERROR: frame of %lu bytes is no JPEG\n", size);
+		return 1;
+	}
+	if ((size != expected_size) || memcmp (data, expected, size)) {
+		printf ("ERROR: frame of %lu bytes differs from the preview of %lu bytes\n",
+			size, expected_size);
+		return 1;
+	}
+	return 0;
+}
+
+static int
+run (Camera *camera, GPContext *context)
+{
+	CameraFile *preview, *frames[2 * RING + 1];
+	const char *preview_data;
+	char *data;
+	unsigned long size;
+	int i;
+
+	CHECK (gp_file_new (&preview));
+	CHECK (gp_camera_capture_preview (camera, preview, context));
+	CHECK (gp_file_get_data_and_size (preview, &preview_data, &size));
+	data = malloc (size);
+	if (!data)
+		return 1;
+	memcpy (data, preview_data, size);
+	if (check_frame (preview, data, size))
+		return 1;
+
+	if (gp_camera_get_preview_frame (camera, &frames[0], context) >= GP_OK) {
+		printf ("ERROR: got a frame without a preview stream\n");
+		return 1;
+	}
+	CHECK (gp_camera_start_preview_stream (camera, RING, context));
+	if (gp_camera_start_preview_stream (camera, RING, context) != GP_ERROR_CAMERA_BUSY) {
+		printf ("ERROR: started a second preview stream\n");
+		return 1;
+	}
+	for (i = 0; i < 2 * RING + 1; i++) {
+		CHECK (gp_camera_get_preview_frame (camera, &frames[i], context));
+		if (check_frame (frames[i], data, size))
+			return 1;
+		if ((i >= RING) && (frames[i] != frames[i - RING])) {
+			printf ("ERROR: frame %d is not the frame file of frame %d\n", i, i - RING);
+			return 1;
+		}
+		if ((i % RING) && (frames[i] == frames[i - 1])) {
+			printf ("ERROR: frame %d overwrote frame %d\n", i, i - 1);
+			return 1;
+		}
+	}
+	CHECK (gp_camera_stop_preview_stream (camera, context));
+	CHECK (gp_camera_stop_preview_stream (camera, context));
+
+	/* live view was left, the old way starts it again */
+	CHECK (gp_file_clean (preview));
+	CHECK (gp_camera_capture_preview (camera, preview, context));
+	if (check_frame (preview, data, size))
+		return 1;
+	gp_file_unref (preview);
+	free (data);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-preview-stream-XXXXXX";
+	GPContext *context;
+	Camera *camera;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* an empty card, and the frame vusb makes up */
+	setenv ("VCAMERADIR", dir, 1);
+	unsetenv ("VCAMERA_LIVEVIEW");
+
+	context = gp_context_new ();
+	CHECK (gp_camera_new (&camera));
+	ret = gp_camera_init (camera, context);
+	if (ret < GP_OK)
+		printf ("ERROR: %s\n", gp_result_as_string (ret));
+	else
+		ret = run (camera, context);
+	gp_camera_exit (camera, context);
+	gp_camera_unref (camera);
+	gp_context_unref (context);
+	rmdir (dir);
+	return ret ? 1 : 0;
+}
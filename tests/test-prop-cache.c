@@ -0,0 +1,143 @@
+/* test-prop-cache.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Checks that a DevicePropChanged event makes ptp2 refetch the cached
+ * property descriptor: the vusb virtual camera is told to change its
+ * aperture on its own, which it announces with the event. With the ptp2
+ * setting propcache=timer the event is not looked at, and the cached
+ * value is shown until cachetime, set long enough here, runs out.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-setting.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+static int timer;
+
+static int
+prop_setting (char *id, char *key, char *value, void *data)
+{
+	if (strcmp (id, "ptp2"))
+		return GP_ERROR;
+	if (!strcmp (key, "cachetime")) {
+		strcpy (value, "60");
+		return GP_OK;
+	}
+	if (timer && !strcmp (key, "propcache")) {
+		strcpy (value, "timer");
+		return GP_OK;
+	}
+	return GP_ERROR;
+}
+
+static int
+get_fnumber (Camera *camera, char *value, GPContext *context)
+{
+	CameraWidget *widget;
+	char *str;
+
+	CHECK (gp_camera_get_single_config (camera, "f-number", &widget, context));
+	CHECK (gp_widget_get_value (widget, &str));
+	strcpy (value, str);
+	gp_widget_free (widget);
+	return 0;
+}
+
+/* the vusb driver opcode, changing the aperture on the camera side */
+static int
+change_aperture (Camera *camera, GPContext *context)
+{
+	CameraWidget *widget;
+
+	CHECK (gp_camera_get_single_config (camera, "opcode", &widget, context));
+	CHECK (gp_widget_set_value (widget, "0x9999,0x3,0x0"));
+	CHECK (gp_camera_set_single_config (camera, "opcode", widget, context));
+	gp_widget_free (widget);
+	return 0;
+}
+
+static int
+session (GPContext *context)
+{
+	Camera *camera;
+	char before[64], after[64];
+
+	CHECK (gp_camera_new (&camera));
+	CHECK (gp_camera_init (camera, context));
+	if (get_fnumber (camera, before, context) ||
+	    change_aperture (camera, context) ||
+	    get_fnumber (camera, after, context))
+		return 1;
+	gp_camera_exit (camera, context);
+	gp_camera_unref (camera);
+
+	if (timer && strcmp (before, after)) {
+		printf ("ERROR: with propcache=timer '%s' was refetched as '%s'\n", before, after);
+		return 1;
+	}
+	if (!timer && !strcmp (before, after)) {
+		printf ("ERROR: still '%s' after the camera changed it\n", after);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-prop-cache-XXXXXX";
+	GPContext *context;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* an empty card */
+	setenv ("VCAMERADIR", dir, 1);
+
+	context = gp_context_new ();
+	gp_setting_set_get_func (prop_setting, NULL);
+	ret = session (context);
+	timer = 1;
+	if (!ret)
+		ret = session (context);
+	gp_setting_set_get_func (NULL, NULL);
+	gp_context_unref (context);
+	rmdir (dir);
+	return ret;
+}
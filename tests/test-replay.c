@@ -0,0 +1,193 @@
+/* test-replay.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Records a session with the vusb virtual camera (GP_PORT_RECORD) and
+ * replays it with the replay iolib (GP_PORT_REPLAY): the replay has to go
+ * as recorded, and the camera driver has to see the same card and file
+ * data. A session doing something else than the recorded one must be
+ * noticed.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib,
+ * REPLAY_IOLIBS to one containing the replay iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-port-log.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+#define CR(f) \
+	do { \
+		int res = f; \
+		if (res < 0) \
+			return (res); \
+	} while (0)
+
+#define CONTENT	"not a real picture, but recorded and replayed\n"
+
+static unsigned int differed;
+
+static void
+count_differed (GPLogLevel level, const char *domain, const char *str, void *data)
+{
+	if (strstr (str, "differs from transaction"))
+		differed++;
+}
+
+/* Lists the card and downloads a.jpg, or reads a setting instead.
+ * Returns a gphoto2 error code, a replay going wrong may fail. */
+static int
+session (int download, char *listing, size_t size, GPContext *context)
+{
+	CameraWidget *widget;
+	CameraList *list;
+	CameraFile *file;
+	Camera *camera;
+	const char *name, *data;
+	unsigned long datasize;
+	int i;
+
+	listing[0] = '\0';
+	CR (gp_camera_new (&camera));
+	CR (gp_camera_init (camera, context));
+	CR (gp_list_new (&list));
+	CR (gp_camera_folder_list_files (camera, "/store_00010001", list, context));
+	for (i = 0; i < gp_list_count (list); i++) {
+		gp_list_get_name (list, i, &name);
+		snprintf (listing + strlen (listing), size - strlen (listing), "%s ", name);
+	}
+	gp_list_free (list);
+	if (download) {
+		CR (gp_file_new (&file));
+		CR (gp_camera_file_get (camera, "/store_00010001", "a.jpg",
+				GP_FILE_TYPE_NORMAL, file, context));
+		CR (gp_file_get_data_and_size (file, &data, &datasize));
+		snprintf (listing + strlen (listing), size - strlen (listing), "%.*s",
+			  (int)datasize, data);
+		gp_file_unref (file);
+	} else {
+		CR (gp_camera_get_single_config (camera, "f-number", &widget, context));
+		gp_widget_free (widget);
+	}
+	CR (gp_camera_exit (camera, context));
+	gp_camera_unref (camera);
+	return GP_OK;
+}
+
+static int
+run (const char *recording, const char *replay_iolibs, GPContext *context)
+{
+	char recorded[1024], replayed[1024];
+	int logid, ret;
+
+	setenv ("GP_PORT_RECORD", recording, 1);
+	ret = session (1, recorded, sizeof(recorded), context);
+	unsetenv ("GP_PORT_RECORD");
+	CHECK (ret);
+	if (strcmp (recorded, "a.jpg " CONTENT)) {
+		printf ("ERROR: recorded '%s'\n", recorded);
+		return 1;
+	}
+
+	setenv ("IOLIBS", replay_iolibs, 1);
+	setenv ("GP_PORT_REPLAY", recording, 1);
+	setenv ("GP_PORT_REPLAY_SCALE", "0", 1);
+	logid = gp_log_add_func (GP_LOG_DEBUG, count_differed, NULL);
+
+	ret = session (1, replayed, sizeof(replayed), context);
+	if (ret < GP_OK) {
+		printf ("ERROR: replay failed: %s\n", gp_result_as_string (ret));
+		ret = 1;
+	} else if (differed) {
+		printf ("ERROR: %u transactions differed from the recording\n", differed);
+		ret = 1;
+	}
+	if (!ret && strcmp (replayed, recorded)) {
+		printf ("ERROR: replayed '%s', recorded '%s'\n", replayed, recorded);
+		ret = 1;
+	}
+
+	/* not the recorded session, whether it fails or goes on */
+	if (!ret) {
+		session (0, replayed, sizeof(replayed), context);
+		if (!differed) {
+			printf ("ERROR: another session replayed without differences\n");
+			ret = 1;
+		}
+	}
+
+	gp_log_remove_func (logid);
+	unsetenv ("GP_PORT_REPLAY_SCALE");
+	unsetenv ("GP_PORT_REPLAY");
+	return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-replay-XXXXXX", recording[] = "/tmp/test-replay-rec-XXXXXX";
+	char file[1024];
+	const char *replay_iolibs = getenv ("REPLAY_IOLIBS");
+	GPContext *context;
+	FILE *f;
+	int fd, ret;
+
+	if (!replay_iolibs) {
+		printf ("REPLAY_IOLIBS not set, skipped\n");
+		return 77;
+	}
+	fd = mkstemp (recording);
+	if ((fd < 0) || !mkdtemp (dir)) {
+		perror ("mkstemp");
+		return 1;
+	}
+	close (fd);
+	snprintf (file, sizeof(file), "%s/a.jpg", dir);
+	f = fopen (file, "w");
+	if (!f) {
+		perror (file);
+		return 1;
+	}
+	fputs (CONTENT, f);
+	fclose (f);
+	setenv ("VCAMERADIR", dir, 1);
+
+	context = gp_context_new ();
+	ret = run (recording, replay_iolibs, context);
+	gp_context_unref (context);
+	unlink (file);
+	rmdir (dir);
+	unlink (recording);
+	return ret;
+}
@@ -0,0 +1,183 @@
+/* test-vusb-generated.c
+ *
+ * Copyright 2026 The gPhoto project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Lets the vusb virtual camera generate its card (VCAMERA_OBJECTS and
+ * VCAMERA_OBJECTSIZE) and checks the folders and files are all there, and
+ * that each download has the size the file info gives and the generated
+ * content: framed like a JPEG, with a pattern in between which shows
+ * whether the streamed data lost or repeated bytes. Thumbnails are
+ * generated too.
+ *
+ * IOLIBS has to point to a directory containing the vusb iolib.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+
+#define CHECK(f) \
+	do { \
+		int res = f; \
+		if (res < 0) { \
+			printf ("ERROR: %s\n", gp_result_as_string (res)); \
+			return (1); \
+		} \
+	} while (0)
+
+#define FOLDERS		3
+#define FILES		5
+#define MINSIZE		100000
+#define MAXSIZE		300000
+
+/* SOI, bytes going up by 31, EOI */
+static int
+check_data (const char *path, CameraFile *file, unsigned long expected)
+{
+	const unsigned char *d;
+	const char *data;
+	unsigned long size, i;
+
+	CHECK (gp_file_get_data_and_size (file, &data, &size));
+	d = (const unsigned char *)data;
+	if (size != expected) {
+		printf ("ERROR: %s has %lu bytes, not %lu\n", path, size, expected);
+		return 1;
+	}
+	if ((size < 4) || (d[0] != 0xff) || (d[1] != 0xd8) || (d[size - 2] != 0xff) || (d[size - 1] != 0xd9)) {
+		printf ("ERROR: %s is not framed like a JPEG\n", path);
+		return 1;
+	}
+	for (i = 3; i < size - 2; i++)
+		if ((unsigned char)(d[i] - d[i - 1]) != 31) {
+			printf ("ERROR: %s differs from the generated data at byte %lu\n", path, i);
+			return 1;
+		}
+	return 0;
+}
+
+static int
+check_file (Camera *camera, const char *folder, const char *name, GPContext *context)
+{
+	CameraFileInfo info;
+	CameraFile *file;
+	char path[2048];
+
+	snprintf (path, sizeof(path), "%s/%s", folder, name);
+	CHECK (gp_camera_file_get_info (camera, folder, name, &info, context));
+	if (	!(info.file.fields & GP_FILE_INFO_SIZE) ||
+		(info.file.size < MINSIZE) || (info.file.size > MAXSIZE)) {
+		printf ("ERROR: %s has %lu bytes\n", path, (unsigned long)info.file.size);
+		return 1;
+	}
+	CHECK (gp_file_new (&file));
+	CHECK (gp_camera_file_get (camera, folder, name, GP_FILE_TYPE_NORMAL, file, context));
+	if (check_data (path, file, info.file.size))
+		return 1;
+	gp_file_clean (file);
+	CHECK (gp_camera_file_get (camera, folder, name, GP_FILE_TYPE_PREVIEW, file, context));
+	if (check_data (path, file, 8192))
+		return 1;
+	gp_file_unref (file);
+	return 0;
+}
+
+static int
+run (Camera *camera, GPContext *context)
+{
+	CameraList *folders, *files;
+	const char *name;
+	char folder[1024], expected[32];
+	int i, j;
+
+	CHECK (gp_list_new (&folders));
+	CHECK (gp_list_new (&files));
+	CHECK (gp_camera_folder_list_folders (camera, "/store_00010001/DCIM", folders, context));
+	gp_list_sort (folders);
+	if (gp_list_count (folders) != FOLDERS) {
+		printf ("ERROR: %d folders, not %d\n", gp_list_count (folders), FOLDERS);
+		return 1;
+	}
+	for (i = 0; i < FOLDERS; i++) {
+		gp_list_get_name (folders, i, &name);
+		snprintf (expected, sizeof(expected), "%03dGPGEN", 100 + i);
+		if (strcmp (name, expected)) {
+			printf ("ERROR: folder %s, not %s\n", name, expected);
+			return 1;
+		}
+		snprintf (folder, sizeof(folder), "/store_00010001/DCIM/%s", name);
+		CHECK (gp_camera_folder_list_files (camera, folder, files, context));
+		gp_list_sort (files);
+		if (gp_list_count (files) != FILES) {
+			printf ("ERROR: %d files in %s, not %d\n", gp_list_count (files), folder, FILES);
+			return 1;
+		}
+		for (j = 0; j < FILES; j++) {
+			gp_list_get_name (files, j, &name);
+			snprintf (expected, sizeof(expected), "GEN_%05d.JPG", j);
+			if (strcmp (name, expected)) {
+				printf ("ERROR: file %s/%s, not %s\n", folder, name, expected);
+				return 1;
+			}
+			if (check_file (camera, folder, name, context))
+				return 1;
+		}
+	}
+	gp_list_free (files);
+	gp_list_free (folders);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char dir[] = "/tmp/test-vusb-generated-XXXXXX", objects[32], objectsize[32];
+	GPContext *context;
+	Camera *camera;
+	int ret;
+
+	if (!mkdtemp (dir)) {
+		perror ("mkdtemp");
+		return 1;
+	}
+	/* an empty card, all files are generated */
+	setenv ("VCAMERADIR", dir, 1);
+	snprintf (objects, sizeof(objects), "%dx%d", FOLDERS, FILES);
+	setenv ("VCAMERA_OBJECTS", objects, 1);
+	snprintf (objectsize, sizeof(objectsize), "%d-%d", MINSIZE, MAXSIZE);
+	setenv ("VCAMERA_OBJECTSIZE", objectsize, 1);
+
+	context = gp_context_new ();
+	CHECK (gp_camera_new (&camera));
+	ret = gp_camera_init (camera, context);
+	if (ret < GP_OK)
+		printf ("ERROR: %s\n", gp_result_as_string (ret));
+	else
+		ret = run (camera, context);
+	gp_camera_exit (camera, context);
+	gp_camera_unref (camera);
+	gp_context_unref (context);
+	rmdir (dir);
+	return ret ? 1 : 0;
+}